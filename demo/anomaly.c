@@ -0,0 +1,204 @@
+/*
+ * anomaly.c — Streaming per-endpoint anomaly detection
+ *
+ * "Did an endpoint's error rate or p95 just leave its normal range?"
+ * answered as the log streams by.  Time (log time, not wall time) is cut
+ * into fixed buckets; per route and bucket the detector counts requests
+ * and 5xx, and drops each latency into a log-linear sketch:
+ * ANOM_SUB_BITS mantissa bits under the binary exponent, read straight
+ * from the double's bits, so a bin is 1/16 of an octave (p95 within
+ * ~3%) and the update is a shift and a mask — O(1) per line.
+ *
+ * When log time moves past a bucket, every route active in it is
+ * closed: its 5xx ratio and sketch p95 are compared with the route's
+ * EWMA baselines (mean and EWMA variance), an upward deviation of more
+ * than k standard deviations is an alert, and the value is folded into
+ * the baselines.  Closing costs O(routes active) once per bucket, so it
+ * amortizes to O(1) per line too.
+ *
+ * Guards against noise: a route needs ANOM_WARMUP judged buckets before
+ * it can alert, buckets under ANOM_MIN_REQS requests are skipped, the
+ * deviation must also clear an absolute floor (a 5xx ratio is never
+ * judged finer than its binomial error), and an alerting value is
+ * folded in clamped to mean + k·sd, so one incident does not widen the
+ * band enough to hide the next one while a lasting shift still becomes
+ * the new normal within a few buckets.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ANOM_SUB_BITS 4
+#define ANOM_MIN_EXP  (-7)      /* 2^-7 ms: the sketch's lower edge */
+#define ANOM_OCTAVES  28        /* up to 2^21 ms, ~35 minutes */
+#define ANOM_BINS     (ANOM_OCTAVES << ANOM_SUB_BITS)
+#define ANOM_WARMUP   8         /* judged buckets before a route alerts */
+#define ANOM_MIN_REQS 20        /* smaller buckets are not judged */
+#define ANOM_ALERTS   4096      /* kept for printing; older ones are counted */
+
+enum { ANOM_ERRORS, ANOM_P95, ANOM_METRICS };
+static const char *const anom_metric_names[ANOM_METRICS] = { "5xx", "p95" };
+
+typedef struct {
+    double mean, var;
+} AnomEwma;
+
+typedef struct {
+    uint32_t n, err;            /* the open bucket */
+    int      active;            /* on the detector's active list */
+    int      seen;              /* buckets folded into the baselines */
+    AnomEwma base[ANOM_METRICS];
+    uint32_t bins[ANOM_BINS];
+} AnomRoute;
+
+typedef struct {
+    int     route, metric;
+    int64_t bucket;             /* start, in log seconds */
+    double  value, mean, sd;
+    uint32_t n;
+} AnomAlert;
+
+typedef struct {
+    AnomRoute **route;          /* by route id, allocated on first use */
+    int         n_route;
+    int        *active;
+    int         n_active;
+    int64_t     bucket;         /* open bucket start; INT64_MIN before the first line */
+    int         bucket_sec;
+    double      alpha, k;
+    AnomAlert  *alerts;         /* ring of the last ANOM_ALERTS */
+    uint64_t    n_alerts;
+    uint64_t    buckets, judged, late;
+} AnomDetector;
+
+static void anom_init(AnomDetector *d, int bucket_sec, double alpha, double k) {
+    memset(d, 0, sizeof(*d));
+    d->bucket = INT64_MIN;
+    d->bucket_sec = bucket_sec > 0 ? bucket_sec : 60;
+    d->alpha = alpha;
+    d->k = k;
+    d->alerts = malloc(ANOM_ALERTS * sizeof(AnomAlert));
+}
+
+static void anom_free(AnomDetector *d) {
+    for (int i = 0; i < d->n_route; i++) free(d->route[i]);
+    free(d->route);
+    free(d->active);
+    free(d->alerts);
+}
+
+static inline int anom_bin(double ms) {
+    uint64_t b;
+    memcpy(&b, &ms, sizeof(b));
+    if (!(ms > 0)) return 0;
+    int e = (int)(b >> 52) - 1023 - ANOM_MIN_EXP;
+    if (e < 0) return 0;
+    if (e >= ANOM_OCTAVES) return ANOM_BINS - 1;
+    return e << ANOM_SUB_BITS | (int)(b >> (52 - ANOM_SUB_BITS) & ((1 << ANOM_SUB_BITS) - 1));
+}
+
+/* Midpoint of a bin, in ms. */
+static double anom_bin_value(int bin) {
+    int e = (bin >> ANOM_SUB_BITS) + ANOM_MIN_EXP, sub = bin & ((1 << ANOM_SUB_BITS) - 1);
+    return ldexp(1.0 + (sub + 0.5) / (1 << ANOM_SUB_BITS), e);
+}
+
+static double anom_p95(const AnomRoute *r) {
+    uint32_t rank = r->n - r->n / 20, seen = 0;   /* ceil(0.95 n) */
+    for (int b = 0; b < ANOM_BINS; b++)
+        if ((seen += r->bins[b]) >= rank) return anom_bin_value(b);
+    return anom_bin_value(ANOM_BINS - 1);
+}
+
+static void anom_alert(AnomDetector *d, int id, int metric, double value, const AnomEwma *b,
+                       double sd, uint32_t n) {
+    d->alerts[d->n_alerts++ % ANOM_ALERTS] =
+        (AnomAlert){ id, metric, d->bucket, value, b->mean, sd, n };
+}
+
+/* Judges one metric of a closed bucket, then folds it into the baseline. */
+static void anom_judge(AnomDetector *d, int id, int metric, double x, double floor, uint32_t n) {
+    AnomRoute *r = d->route[id];
+    AnomEwma *b = &r->base[metric];
+    if (r->seen == 0) {
+        b->mean = x;
+        b->var = 0;
+        return;
+    }
+    double sd = sqrt(b->var);
+    if (sd < floor) sd = floor;
+    if (r->seen >= ANOM_WARMUP && x - b->mean > d->k * sd) {
+        anom_alert(d, id, metric, x, b, sd, n);
+        x = b->mean + d->k * sd;
+    }
+    double dev = x - b->mean;
+    b->mean += d->alpha * dev;
+    b->var = (1 - d->alpha) * (b->var + d->alpha * dev * dev);
+}
+
+static void anom_close(AnomDetector *d) {
+    for (int i = 0; i < d->n_active; i++) {
+        int id = d->active[i];
+        AnomRoute *r = d->route[id];
+        if (r->n >= ANOM_MIN_REQS) {
+            double p = (double)r->err / r->n, p95 = anom_p95(r);
+            AnomEwma *e = &r->base[ANOM_ERRORS];
+            double binom = sqrt(e->mean * (1 - e->mean) / r->n);
+            anom_judge(d, id, ANOM_ERRORS, p, binom > 0.005 ? binom : 0.005, r->n);
+            anom_judge(d, id, ANOM_P95, p95, 0.05 * r->base[ANOM_P95].mean, r->n);
+            r->seen++;
+            d->judged++;
+        }
+        r->n = r->err = 0;
+        r->active = 0;
+        memset(r->bins, 0, sizeof(r->bins));
+    }
+    d->n_active = 0;
+    d->buckets++;
+}
+
+/* One request.  Lines older than the open bucket count toward it (and as late). */
+static inline void anom_add(AnomDetector *d, int id, int64_t sec, int status, double latency_ms) {
+    if (__builtin_expect((uint64_t)sec - (uint64_t)d->bucket >= (uint64_t)d->bucket_sec, 0)) {
+        int64_t b = sec - ((sec % d->bucket_sec) + d->bucket_sec) % d->bucket_sec;
+        if (b > d->bucket) {
+            if (d->bucket != INT64_MIN) anom_close(d);
+            d->bucket = b;
+        } else {
+            d->late++;
+        }
+    }
+    if (id >= d->n_route) {
+        int n = d->n_route ? d->n_route : 64;
+        while (n <= id) n *= 2;
+        d->route = realloc(d->route, n * sizeof(AnomRoute *));
+        d->active = realloc(d->active, n * sizeof(int));
+        memset(d->route + d->n_route, 0, (n - d->n_route) * sizeof(AnomRoute *));
+        d->n_route = n;
+    }
+    AnomRoute *r = d->route[id];
+    if (!r) r = d->route[id] = calloc(1, sizeof(AnomRoute));
+    if (!r->active) {
+        r->active = 1;
+        d->active[d->n_active++] = id;
+    }
+    r->n++;
+    r->err += status >= 500;
+    r->bins[anom_bin(latency_ms)]++;
+}
+
+/* Closes the open bucket: at the end of input, so it is judged too. */
+static void anom_flush(AnomDetector *d) {
+    if (d->bucket != INT64_MIN && d->n_active) anom_close(d);
+}
+
+/* Forgets everything, keeping the bucket size and thresholds. */
+static void anom_reset(AnomDetector *d) {
+    int bucket_sec = d->bucket_sec;
+    double alpha = d->alpha, k = d->k;
+    anom_free(d);
+    anom_init(d, bucket_sec, alpha, k);
+}
@@ -0,0 +1,317 @@
+/*
+ * external_agg.c — Hash aggregation under a memory budget (Grace style)
+ *
+ * Keys are arbitrary byte strings (an IP, or IP + path) with a count and
+ * a latency sum.  Aggregation starts in an ordinary open-addressed table
+ * that doubles until it would outgrow the budget.  When it is full at
+ * that size, every entry — already partially
+ * aggregated — is appended to one of EXT_FANOUT run files chosen by hash
+ * bits, and the table is cleared.  At the end, each run file is
+ * aggregated in turn by a fresh table; equal keys always land in the
+ * same run file, so each partition's totals are final.
+ * A partition that still overflows spills again on the next hash bits
+ * (one more level), so any key set finishes with the same peak memory.
+ *
+ * Run records are LEB128 (key length, key, count, latency µs) through
+ * the snapshot varint helpers.  Run files are unlinked as soon as they
+ * are created and vanish when closed.
+ *
+ * #included by log_analyzer.c after snapshot.c (varints).
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EXT_FANOUT     16
+#define EXT_FANOUT_BITS 4
+#define EXT_MAX_LEVEL  12       /* 48 hash bits for partitioning */
+#define EXT_TOP        10
+#define EXT_KEY_MAX    1024
+
+typedef struct {
+    uint64_t hash;              /* 0 = empty */
+    uint64_t count, lat_us;
+    uint32_t off, len;          /* key bytes in the arena */
+} ExtEntry;
+
+typedef struct {
+    char    *key;
+    uint32_t len;
+    uint64_t count, lat_us;
+} ExtTop;
+
+typedef struct {
+    uint64_t records, bytes, keys;
+    double   ms;
+    int      depth;             /* extra levels this partition needed */
+} ExtPartStat;
+
+typedef struct {
+    uint64_t    keys;           /* distinct */
+    uint64_t    spills, spill_records, spill_bytes;
+    int         max_level;
+    ExtTop      top[EXT_TOP];
+    int         n_top;
+    ExtPartStat part[EXT_FANOUT];   /* level-0 partitions */
+} ExtResult;
+
+typedef struct {
+    ExtEntry   *slot;
+    size_t      mask, used;
+    char       *arena;
+    size_t      arena_cap, arena_used;
+    size_t      budget;         /* bytes for slots + arena */
+    int         level;
+    const char *dir;
+    FILE       *run[EXT_FANOUT];
+    uint64_t    run_records[EXT_FANOUT];
+    ExtResult  *res;
+} ExtAgg;
+
+static inline uint64_t ext_hash(const char *k, size_t n) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ n, w;
+    for (; n >= 8; k += 8, n -= 8) {
+        memcpy(&w, k, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    w = 0;
+    memcpy(&w, k, n);
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+    return h | 1;               /* never 0: marks empty slots */
+}
+
+/* Partition of a hash at a level: high bits first, the table uses low ones. */
+static inline int ext_part(uint64_t h, int level) {
+    return (int)(h >> (64 - EXT_FANOUT_BITS * (level + 1))) & (EXT_FANOUT - 1);
+}
+
+static void ext_init(ExtAgg *a, size_t budget, int level, const char *dir, ExtResult *res) {
+    memset(a, 0, sizeof(*a));
+    a->slot = calloc(1024, sizeof(ExtEntry));
+    a->mask = 1023;
+    a->arena_cap = 64 * EXT_KEY_MAX;
+    a->arena = malloc(a->arena_cap);
+    a->budget = budget;
+    a->level = level;
+    a->dir = dir;
+    a->res = res;
+}
+
+/* Doubles the slot array if the budget allows; rehashes in place of a spill. */
+static int ext_grow(ExtAgg *a) {
+    size_t cap = (a->mask + 1) * 2;
+    if (cap * sizeof(ExtEntry) + a->arena_cap > a->budget) return -1;
+    ExtEntry *slot = calloc(cap, sizeof(ExtEntry));
+    if (!slot) return -1;
+    for (size_t i = 0; i <= a->mask; i++) {
+        if (!a->slot[i].hash) continue;
+        size_t j = a->slot[i].hash & (cap - 1);
+        while (slot[j].hash) j = (j + 1) & (cap - 1);
+        slot[j] = a->slot[i];
+    }
+    free(a->slot);
+    a->slot = slot;
+    a->mask = cap - 1;
+    return 0;
+}
+
+static int ext_grow_arena(ExtAgg *a) {
+    size_t cap = a->arena_cap * 2;
+    if ((a->mask + 1) * sizeof(ExtEntry) + cap > a->budget) return -1;
+    char *arena = realloc(a->arena, cap);
+    if (!arena) return -1;
+    a->arena = arena;
+    a->arena_cap = cap;
+    return 0;
+}
+
+/* Frees a's memory and closes any run files it still holds. */
+static void ext_free(ExtAgg *a) {
+    free(a->slot);
+    free(a->arena);
+    for (int p = 0; p < EXT_FANOUT; p++)
+        if (a->run[p]) fclose(a->run[p]);
+}
+
+static FILE *ext_run_open(const char *dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/la-spill-XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) return NULL;
+    unlink(path);
+    FILE *f = fdopen(fd, "w+b");
+    if (f) setvbuf(f, NULL, _IOFBF, 1 << 16);
+    return f;
+}
+
+/* Writes every entry to its run file and empties the table. */
+static int ext_spill(ExtAgg *a) {
+    ExtResult *r = a->res;
+    for (size_t i = 0; i <= a->mask; i++) {
+        ExtEntry *e = &a->slot[i];
+        if (!e->hash) continue;
+        int p = ext_part(e->hash, a->level);
+        if (!a->run[p] && !(a->run[p] = ext_run_open(a->dir))) {
+            fprintf(stderr, "spill: cannot create run file in %s: %s\n", a->dir, strerror(errno));
+            return -1;
+        }
+        long before = ftell(a->run[p]);
+        snap_put_varint(a->run[p], e->len);
+        fwrite(a->arena + e->off, 1, e->len, a->run[p]);
+        snap_put_varint(a->run[p], e->count);
+        snap_put_varint(a->run[p], e->lat_us);
+        r->spill_bytes += (uint64_t)(ftell(a->run[p]) - before);
+        r->spill_records++;
+        a->run_records[p]++;
+        e->hash = 0;
+    }
+    r->spills++;
+    a->used = a->arena_used = 0;
+    return 0;
+}
+
+static int ext_add(ExtAgg *a, const char *key, uint32_t len, uint64_t count, uint64_t lat_us) {
+    uint64_t h = ext_hash(key, len);
+    for (;;) {
+        size_t i = h & a->mask;
+        for (;;) {
+            ExtEntry *e = &a->slot[i];
+            if (!e->hash) break;
+            if (e->hash == h && e->len == len && memcmp(a->arena + e->off, key, len) == 0) {
+                e->count += count;
+                e->lat_us += lat_us;
+                return 0;
+            }
+            i = (i + 1) & a->mask;
+        }
+        /* New key: grow while the budget allows, else spill and retry. */
+        if ((a->used + 1) * 2 > a->mask + 1) {
+            if (ext_grow(a) == 0) continue;
+        } else if (a->arena_used + len > a->arena_cap) {
+            if (ext_grow_arena(a) == 0) continue;
+        } else {
+            ExtEntry *e = &a->slot[i];
+            e->hash = h;
+            e->count = count;
+            e->lat_us = lat_us;
+            e->off = (uint32_t)a->arena_used;
+            e->len = len;
+            memcpy(a->arena + a->arena_used, key, len);
+            a->arena_used += len;
+            a->used++;
+            return 0;
+        }
+        if (ext_spill(a) != 0) return -1;
+    }
+}
+
+/* Keeps top[] ordered by count, then key bytes; copies a key on entry. */
+static void ext_top_add(ExtResult *r, const char *key, uint32_t len, uint64_t count,
+                        uint64_t lat_us) {
+    int i = r->n_top;
+    while (i > 0) {
+        const ExtTop *t = &r->top[i - 1];
+        int c = memcmp(t->key, key, t->len < len ? t->len : len);
+        if (t->count > count || (t->count == count && (c < 0 || (c == 0 && t->len <= len))))
+            break;
+        i--;
+    }
+    if (i >= EXT_TOP) return;
+    if (r->n_top == EXT_TOP) free(r->top[EXT_TOP - 1].key);
+    else r->n_top++;
+    memmove(&r->top[i + 1], &r->top[i], (r->n_top - 1 - i) * sizeof(ExtTop));
+    r->top[i] = (ExtTop){ malloc(len ? len : 1), len, count, lat_us };
+    memcpy(r->top[i].key, key, len);
+}
+
+static double ext_ms_since(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+/*
+ * Final totals of everything added to a: straight from the table if it
+ * never spilled, otherwise partition by partition.  Returns the number
+ * of levels below a that were needed, or -1.  Frees a.
+ */
+static int ext_finish(ExtAgg *a) {
+    ExtResult *r = a->res;
+    size_t budget = a->budget;
+    int spilled = 0, depth = 0;
+    for (int p = 0; p < EXT_FANOUT; p++) spilled |= a->run[p] != NULL;
+    if (!spilled) {
+        for (size_t i = 0; i <= a->mask; i++) {
+            const ExtEntry *e = &a->slot[i];
+            if (!e->hash) continue;
+            r->keys++;
+            ext_top_add(r, a->arena + e->off, e->len, e->count, e->lat_us);
+        }
+        ext_free(a);
+        return 0;
+    }
+    if (a->level >= EXT_MAX_LEVEL) {
+        fprintf(stderr, "spill: budget too small to finish a partition\n");
+        ext_free(a);
+        return -1;
+    }
+    int err = ext_spill(a) != 0;
+    int level = a->level;
+    const char *dir = a->dir;
+    FILE *run[EXT_FANOUT];
+    uint64_t records[EXT_FANOUT];
+    memcpy(run, a->run, sizeof(run));
+    memcpy(records, a->run_records, sizeof(records));
+    memset(a->run, 0, sizeof(a->run));      /* read below, closed here */
+    ext_free(a);                /* this table's memory goes to the children */
+    if (level + 1 > r->max_level) r->max_level = level + 1;
+
+    char *key = malloc(EXT_KEY_MAX);
+    for (int p = 0; p < EXT_FANOUT; p++) {
+        if (!run[p]) continue;
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        uint64_t keys0 = r->keys;
+        long bytes = ftell(run[p]);
+        rewind(run[p]);
+        ExtAgg child;
+        ext_init(&child, budget, level + 1, dir, r);
+        for (uint64_t n = 0; n < records[p] && !err; n++) {
+            uint64_t len, count, lat_us;
+            if (snap_get_varint(run[p], &len) || len > EXT_KEY_MAX ||
+                fread(key, 1, len, run[p]) != len || snap_get_varint(run[p], &count) ||
+                snap_get_varint(run[p], &lat_us)) {
+                fprintf(stderr, "spill: run file truncated\n");
+                err = 1;
+                break;
+            }
+            err = ext_add(&child, key, (uint32_t)len, count, lat_us) != 0;
+        }
+        fclose(run[p]);
+        int d = err ? -1 : ext_finish(&child);
+        if (err) ext_free(&child);
+        if (d < 0) err = 1;
+        if (d + 1 > depth) depth = d + 1;
+        if (level == 0) {
+            ExtPartStat *s = &r->part[p];
+            s->records = records[p];
+            s->bytes = (uint64_t)bytes;
+            s->keys = r->keys - keys0;
+            s->ms = ext_ms_since(&t0);
+            s->depth = d;
+        }
+    }
+    free(key);
+    return err ? -1 : depth;
+}
+
+static void ext_result_free(ExtResult *r) {
+    for (int i = 0; i < r->n_top; i++) free(r->top[i].key);
+    r->n_top = 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * follow.c — Tailing a growing log without re-reading it
+ *
+ * A Tailer remembers the byte offset of the last complete line it
+ * handed out and only ever pread()s from there, so each wakeup costs
+ * the new bytes, never the whole file.  A trailing partial line is kept
+ * in the buffer until its newline arrives.
+ *
+ * Wakeups come from inotify on Linux: IN_MODIFY on the file for appends,
+ * plus the parent directory for IN_CREATE / IN_MOVED_TO of the same name
+ * so rotation is noticed even while the old file is quiet.  Elsewhere
+ * the wait degrades to a plain sleep and the same checks.
+ *
+ * Rotation (path now names a different inode): the old descriptor is
+ * drained to EOF first — writers may still append there until they
+ * reopen — and then the new file is read from offset 0.  Truncation
+ * in place (copytruncate: same inode, size below our offset) restarts
+ * at 0 as well.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <libgen.h>
+#include <sys/inotify.h>
+#endif
+
+#define TAIL_READ (1 << 20)     /* max bytes per read() */
+
+typedef struct {
+    const char *path;
+    int         fd;
+    dev_t       dev;
+    ino_t       ino;
+    off_t       offset;         /* file offset of buf[0] + len */
+    char       *buf;            /* carried partial line + new bytes */
+    size_t      len, cap;
+    uint64_t    bytes, rotations, truncations;
+    int         ino_fd, wd_file, wd_dir;
+    char        name[NAME_MAX + 1];
+} Tailer;
+
+static void tail_watch_file(Tailer *t) {
+#if defined(__linux__)
+    if (t->ino_fd < 0) return;
+    if (t->wd_file >= 0) inotify_rm_watch(t->ino_fd, t->wd_file);
+    t->wd_file = inotify_add_watch(t->ino_fd, t->path,
+                                   IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+#else
+    (void)t;
+#endif
+}
+
+static int tail_reopen(Tailer *t) {
+    int fd = open(t->path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    fstat(fd, &st);
+    if (t->fd >= 0) close(t->fd);
+    t->fd = fd;
+    t->dev = st.st_dev;
+    t->ino = st.st_ino;
+    t->offset = 0;
+    tail_watch_file(t);
+    return 0;
+}
+
+/* from_start = 0 skips what is already in the file, like tail -f. */
+static int tail_open(Tailer *t, const char *path, int from_start) {
+    memset(t, 0, sizeof(*t));
+    t->path = path;
+    t->fd = t->ino_fd = t->wd_file = t->wd_dir = -1;
+    t->cap = TAIL_READ * 2;
+    t->buf = malloc(t->cap);
+#if defined(__linux__)
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    snprintf(t->name, sizeof(t->name), "%s", basename(dir));
+    snprintf(dir, sizeof(dir), "%s", path);
+    t->ino_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (t->ino_fd >= 0)
+        t->wd_dir = inotify_add_watch(t->ino_fd, dirname(dir), IN_CREATE | IN_MOVED_TO);
+#endif
+    if (tail_reopen(t) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (!from_start) t->offset = lseek(t->fd, 0, SEEK_END);
+    return 0;
+}
+
+static void tail_close(Tailer *t) {
+    if (t->fd >= 0) close(t->fd);
+#if defined(__linux__)
+    if (t->ino_fd >= 0) close(t->ino_fd);
+#endif
+    free(t->buf);
+}
+
+/* Appends whatever fd has past t->offset.  Returns bytes read. */
+static size_t tail_drain(Tailer *t) {
+    size_t got = 0;
+    for (;;) {
+        if (t->cap - t->len < TAIL_READ) {
+            t->cap *= 2;
+            t->buf = realloc(t->buf, t->cap);
+        }
+        ssize_t n = pread(t->fd, t->buf + t->len, TAIL_READ, t->offset);
+        if (n <= 0) break;
+        t->len += n;
+        t->offset += n;
+        got += n;
+        if (n < TAIL_READ) break;
+    }
+    t->bytes += got;
+    return got;
+}
+
+/*
+ * Reads everything new, following rotation and truncation.  Returns the
+ * length of the complete-line prefix of t->buf; call tail_consume() with
+ * it once parsed.
+ */
+static size_t tail_poll(Tailer *t) {
+    tail_drain(t);
+
+    struct stat st;
+    if (stat(t->path, &st) == 0) {
+        if (st.st_ino != t->ino || st.st_dev != t->dev) {
+            tail_drain(t);                      /* last writes to the old file */
+            if (t->len && t->buf[t->len - 1] != '\n') {
+                if (t->len == t->cap) t->buf = realloc(t->buf, t->cap *= 2);
+                t->buf[t->len++] = '\n';        /* its final line is complete */
+            }
+            if (tail_reopen(t) == 0) t->rotations++;
+            tail_drain(t);
+        } else if (st.st_size < t->offset) {
+            t->offset = 0;
+            t->len = 0;                         /* partial line died with it */
+            t->truncations++;
+            tail_drain(t);
+        }
+    }
+
+    size_t n = t->len;
+    while (n > 0 && t->buf[n - 1] != '\n') n--;
+    return n;
+}
+
+static void tail_consume(Tailer *t, size_t n) {
+    memmove(t->buf, t->buf + n, t->len - n);
+    t->len -= n;
+}
+
+/*
+ * Sleeps until the file or its directory changes, or timeout_ms passes.
+ * Returns 1 if something changed (or may have, without inotify).
+ */
+static int tail_wait(Tailer *t, int timeout_ms) {
+    if (timeout_ms < 0) timeout_ms = 0;
+#if defined(__linux__)
+    if (t->ino_fd >= 0) {
+        struct pollfd p = { .fd = t->ino_fd, .events = POLLIN };
+        int r = poll(&p, 1, timeout_ms);
+        if (r <= 0) return 0;
+        char ev[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        int hit = 0;
+        ssize_t n;
+        while ((n = read(t->ino_fd, ev, sizeof(ev))) > 0)
+            for (char *p2 = ev; p2 < ev + n;) {
+                const struct inotify_event *e = (const struct inotify_event *)p2;
+                if (e->wd != t->wd_dir || (e->len && strcmp(e->name, t->name) == 0)) hit = 1;
+                p2 += sizeof(*e) + e->len;
+            }
+        return hit;
+    }
+#endif
+    usleep((useconds_t)timeout_ms * 1000);
+    return 1;
+}
@@ -0,0 +1,82 @@
+/*
+ * histogram.c — Small dense histograms with interleaved sub-histograms
+ *
+ * status_counts[status]++ on every line is a load-add-store on a
+ * counter that, with 200 the status of most lines, was usually just
+ * stored by the previous line: in a tight loop each increment waits for
+ * the previous one through store-to-load forwarding, ~4-5 cycles apart
+ * however wide the core.  Keeping 1 << shift copies of every bin and
+ * letting line i count in copy i mod k breaks that chain into k
+ * independent ones; the copies are summed once, when the histogram is
+ * drained.
+ *
+ * The copies of one bin are adjacent (bin-major), so a hot bin still
+ * costs one cache line and the whole status histogram stays in L1.
+ *
+ * Also the method × status-class table (GET..OPTIONS and "other" by
+ * 1xx..5xx and "none"), a second Hist filled by the same paths with
+ * --methods.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIST_SHIFT    2         /* default: 4 sub-histograms */
+
+typedef struct {
+    uint32_t *c;                /* c[bin << shift | copy] */
+    int       bins, shift;
+} Hist;
+
+static void hist_init(Hist *h, int bins, int shift) {
+    h->bins = bins;
+    h->shift = shift;
+    h->c = calloc((size_t)bins << shift, sizeof(uint32_t));
+}
+
+static void hist_free(Hist *h) {
+    free(h->c);
+    h->c = NULL;
+}
+
+/* One count in bin, from line number i (any counter that steps by one). */
+static inline void hist_add(Hist *h, int bin, unsigned i) {
+    h->c[(unsigned)bin << h->shift | (i & ((1u << h->shift) - 1))]++;
+}
+
+/* Adds every bin's total to out[bin] and zeroes the histogram. */
+static void hist_drain(Hist *h, int *out) {
+    int k = 1 << h->shift;
+    for (int b = 0; b < h->bins; b++) {
+        uint32_t *c = &h->c[(size_t)b << h->shift];
+        for (int j = 0; j < k; j++) out[b] += (int)c[j];
+    }
+    memset(h->c, 0, ((size_t)h->bins << h->shift) * sizeof(uint32_t));
+}
+
+/* ── Method × status class ──────────────────────────────────────────────── */
+
+enum { HM_GET, HM_POST, HM_PUT, HM_DELETE, HM_PATCH, HM_HEAD, HM_OPTIONS, HM_OTHER, HIST_METHODS };
+#define HIST_CLASSES 6          /* 1xx..5xx, then none (jsonl without a status) */
+
+static const char *const hist_method_names[HIST_METHODS] = {
+    "GET", "POST", "PUT", "DELETE", "PATCH", "HEAD", "OPTIONS", "other",
+};
+
+static inline int hist_method(const char *m, int len) {
+    switch (len) {
+    case 3: return memcmp(m, "GET", 3) == 0 ? HM_GET : memcmp(m, "PUT", 3) == 0 ? HM_PUT : HM_OTHER;
+    case 4: return memcmp(m, "POST", 4) == 0 ? HM_POST : memcmp(m, "HEAD", 4) == 0 ? HM_HEAD : HM_OTHER;
+    case 5: return memcmp(m, "PATCH", 5) == 0 ? HM_PATCH : HM_OTHER;
+    case 6: return memcmp(m, "DELETE", 6) == 0 ? HM_DELETE : HM_OTHER;
+    case 7: return memcmp(m, "OPTIONS", 7) == 0 ? HM_OPTIONS : HM_OTHER;
+    default: return HM_OTHER;
+    }
+}
+
+static inline int hist_method_bin(const char *m, int len, int status) {
+    unsigned cls = (unsigned)(status / 100 - 1);
+    return hist_method(m, len) * HIST_CLASSES + (cls < HIST_CLASSES - 1 ? (int)cls : HIST_CLASSES - 1);
+}
@@ -0,0 +1,372 @@
+/*
+ * json_index.c — JSON-lines parsing through a structural index
+ *
+ * Two stages, after simdjson:
+ *
+ *   1. Classify 64 bytes at a time into bitmasks (quote, backslash,
+ *      structural operator) with NEON/SSE2 compares.  Escaped quotes are
+ *      removed with the odd-backslash-run trick, in-string regions come
+ *      from a prefix XOR of the quote mask, and the surviving structural
+ *      bits are flattened into an array of offsets.
+ *   2. Walk the offsets line by line.  Top-level keys are compared
+ *      against the handful the aggregation wants; matching values are
+ *      converted in place, everything else (including nested objects and
+ *      strings full of escaped quotes) is skipped by jumping between
+ *      offsets.  No objects or strings are materialized.
+ *
+ * Newlines cannot occur inside JSON strings, so string state restarts
+ * at every newline: a truncated line or an unbalanced quote is one parse
+ * error, not a string that swallows the structure of the lines after it.
+ * The input is cut into chunks on line boundaries.
+ *
+ * Also home to FOR_EACH_FORMAT, the run-time format dispatch, since it
+ * needs both the descriptor parsers and json_lines_scan().
+ *
+ * #included by log_analyzer.c after log_formats.c.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(SCAN_SSE2) && defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+#define JSON_CHUNK (256 * 1024)
+
+enum { JK_IP, JK_STATUS, JK_LATENCY, JK_PATH, JK_METHOD, JK_COUNT };
+
+typedef struct {
+    const char *name[JK_COUNT];
+    int         len[JK_COUNT];
+} JsonKeys;
+
+static JsonKeys json_keys = {
+    { "client_ip", "status", "latency_ms", "path", "method" },
+    { 9, 6, 10, 4, 6 },
+};
+
+/*
+ * "ip,status,latency,path[,method]" → key names for the extracted
+ * fields, in that order.  Returns -1 on a malformed list.  The names
+ * point into spec, which must outlive the scan.
+ */
+static int json_keys_parse(JsonKeys *k, char *spec) {
+    int i = 0;
+    for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+        if (i == JK_COUNT) return -1;
+        k->name[i] = tok;
+        k->len[i] = (int)strlen(tok);
+        i++;
+    }
+    return i >= JK_PATH + 1 ? 0 : -1;
+}
+
+/* ── Stage 1: 64-byte classification ────────────────────────────────────── */
+
+typedef struct {
+    uint64_t quote, backslash, op, nl;
+} JsonBlock;
+
+#if defined(SCAN_NEON)
+static inline JsonBlock json_classify(const char *p) {
+    uint8x16_t v[4], q[4], bs[4], op[4], nl[4];
+    const uint8x16_t quote = vdupq_n_u8('"'), bslash = vdupq_n_u8('\\');
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    for (int i = 0; i < 4; i++) {
+        v[i] = vld1q_u8((const uint8_t *)p + 16 * i);
+        /* '[' | 0x20 == '{', ']' | 0x20 == '}' */
+        uint8x16_t f = vorrq_u8(v[i], lower);
+        q[i]  = vceqq_u8(v[i], quote);
+        bs[i] = vceqq_u8(v[i], bslash);
+        nl[i] = vceqq_u8(v[i], vdupq_n_u8('\n'));
+        op[i] = vorrq_u8(vorrq_u8(vceqq_u8(f, vdupq_n_u8('{')), vceqq_u8(f, vdupq_n_u8('}'))),
+                         vorrq_u8(vorrq_u8(vceqq_u8(v[i], vdupq_n_u8(':')),
+                                           vceqq_u8(v[i], vdupq_n_u8(','))), nl[i]));
+    }
+    JsonBlock b = {
+        neon_bitmask64(q[0], q[1], q[2], q[3]),
+        neon_bitmask64(bs[0], bs[1], bs[2], bs[3]),
+        neon_bitmask64(op[0], op[1], op[2], op[3]),
+        neon_bitmask64(nl[0], nl[1], nl[2], nl[3]),
+    };
+    return b;
+}
+#elif defined(SCAN_SSE2)
+static inline JsonBlock json_classify(const char *p) {
+    JsonBlock b = { 0, 0, 0, 0 };
+    const __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        __m128i f = _mm_or_si128(v, lower);
+        __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(f, _mm_set1_epi8('{')), _mm_cmpeq_epi8(f, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8(','))), nl));
+        b.quote     |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << (16 * i);
+        b.backslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, bslash)) << (16 * i);
+        b.op        |= (uint64_t)(uint32_t)_mm_movemask_epi8(op) << (16 * i);
+        b.nl        |= (uint64_t)(uint32_t)_mm_movemask_epi8(nl) << (16 * i);
+    }
+    return b;
+}
+#else
+static inline JsonBlock json_classify(const char *p) {
+    JsonBlock b = { 0, 0, 0, 0 };
+    for (int i = 0; i < 64; i++) {
+        char c = p[i], f = (char)(c | 0x20);
+        uint64_t bit = 1ULL << i;
+        if (c == '"')  b.quote |= bit;
+        if (c == '\\') b.backslash |= bit;
+        if (c == '\n') b.nl |= bit;
+        if (f == '{' || f == '}' || c == ':' || c == ',' || c == '\n') b.op |= bit;
+    }
+    return b;
+}
+#endif
+
+/* Bit i set = byte i is inside a string (opening quote included). */
+static inline uint64_t prefix_xor(uint64_t x) {
+#if defined(SCAN_NEON) && defined(__ARM_FEATURE_AES)
+    return vgetq_lane_u64(vreinterpretq_u64_p128(vmull_p64(x, ~0ULL)), 0);
+#elif defined(SCAN_SSE2) && defined(__PCLMUL__)
+    __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x),
+                                     _mm_set1_epi8((char)0xFF), 0);
+    return (uint64_t)_mm_cvtsi128_si64(r);
+#else
+    x ^= x << 1;  x ^= x << 2;  x ^= x << 4;
+    x ^= x << 8;  x ^= x << 16; x ^= x << 32;
+    return x;
+#endif
+}
+
+typedef struct {
+    uint64_t in_string;   /* all-ones if the previous block ended in a string */
+    uint64_t escaped;     /* 1 if the previous block ended in an odd backslash run */
+} JsonCarry;
+
+/*
+ * In-string bits when a newline fell inside a string, which valid JSON
+ * lines never produce: bit by bit, with the state cleared at every
+ * newline.  carry is the state at the start of the block.
+ */
+static uint64_t json_in_string_by_line(uint64_t quote, uint64_t nl, uint64_t carry) {
+    uint64_t in_string = 0, state = carry & 1;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        if (nl & bit)         state = 0;
+        else if (quote & bit) state ^= 1;
+        in_string |= state << i;
+    }
+    return in_string;
+}
+
+/* Structural bits of one block: unescaped quotes + operators outside strings. */
+static inline uint64_t json_structurals(const JsonBlock *b, JsonCarry *c) {
+    const uint64_t odd = 0xAAAAAAAAAAAAAAAAULL;
+    uint64_t quote = b->quote;
+
+    if (b->backslash | c->escaped) {
+        /* A char is escaped when preceded by an odd-length backslash run. */
+        uint64_t potential = b->backslash & ~c->escaped;
+        uint64_t codes = (((potential << 1) | odd) - potential) ^ odd;
+        uint64_t escaped = codes ^ (b->backslash | c->escaped);
+        c->escaped = (codes & b->backslash) >> 63;
+        quote &= ~escaped;
+    }
+
+    uint64_t in_string = prefix_xor(quote) ^ c->in_string;
+    if (in_string & b->nl)
+        in_string = json_in_string_by_line(quote, b->nl, c->in_string);
+    c->in_string = (uint64_t)((int64_t)in_string >> 63);
+    return (b->op & ~in_string) | quote;
+}
+
+/* Offsets of every structural byte in [p, p + len); returns the count. */
+static size_t json_index_chunk(const char *p, size_t len, uint32_t *pos) {
+    JsonCarry carry = { 0, 0 };
+    size_t n = 0, off = 0;
+    char tail[64];
+
+    while (off < len) {
+        const char *blk = p + off;
+        if (len - off < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, blk, len - off);
+            blk = tail;
+        }
+        JsonBlock b = json_classify(blk);
+        uint64_t s = json_structurals(&b, &carry);
+        while (s) {
+            pos[n++] = (uint32_t)(off + __builtin_ctzll(s));
+            s &= s - 1;
+        }
+        off += 64;
+    }
+    return n;
+}
+
+/* ── Stage 2: per-line key extraction ───────────────────────────────────── */
+
+static inline int json_match_key(const JsonKeys *k, const char *s, int len) {
+    for (int i = 0; i < JK_COUNT; i++)
+        if (k->len[i] == len && k->name[i] && memcmp(k->name[i], s, len) == 0)
+            return i;
+    return -1;
+}
+
+static inline void json_store(LogRecord *r, int key, const char *b, const char *e) {
+    switch (key) {
+    case JK_IP:      lf_store_IP(r, b, e); break;
+    case JK_METHOD:  lf_store_METHOD(r, b, e); break;
+    case JK_PATH:    lf_store_PATH(r, b, e); break;
+    case JK_LATENCY: lf_store_LAT_MS(r, b, e); break;
+    case JK_STATUS:
+        if (lf_store_STATUS(r, b, e)) r->status = 0;
+        break;
+    }
+}
+
+/*
+ * Parses the line whose '{' is at pos[*i].  On return *i is past the
+ * line's '\n' (or at n).  Returns 0 if the line had an IP and a valid
+ * status.
+ */
+static int json_parse_line(const char *c, const uint32_t *pos, size_t n,
+                           size_t *i, const JsonKeys *keys, LogRecord *r) {
+    size_t k = *i;
+    memset(r, 0, sizeof(*r));
+
+    if (c[pos[k]] != '{') goto bad;
+    k++;
+    for (;;) {
+        /* "key" : */
+        if (k + 2 >= n || c[pos[k]] != '"' || c[pos[k + 1]] != '"' ||
+            c[pos[k + 2]] != ':')
+            goto bad;
+        int key = json_match_key(keys, c + pos[k] + 1, (int)(pos[k + 1] - pos[k] - 1));
+        const char *v = c + pos[k + 2] + 1;
+        k += 3;
+
+        /* The next structural bounds the blank skip: v may be the end of the input. */
+        if (k >= n) goto bad;
+        while (v < c + pos[k] && (*v == ' ' || *v == '\t')) v++;
+        if (*v == '"') {
+            if (k + 1 >= n || c[pos[k + 1]] != '"') goto bad;
+            if (key >= 0) json_store(r, key, v + 1, c + pos[k + 1]);
+            k += 2;
+        } else if (*v == '{' || *v == '[') {
+            int depth = 0;
+            do {
+                if (c[pos[k]] == '\n') goto bad;
+                char ch = c[pos[k]] | 0x20;   /* folds [ ] onto { } */
+                depth += (ch == '{') - (ch == '}');
+                k++;
+            } while (depth > 0 && k < n);
+            if (depth) goto bad;
+        } else if (key >= 0) {
+            const char *e = c + pos[k];
+            while (e > v && (e[-1] == ' ' || e[-1] == '\t')) e--;
+            json_store(r, key, v, e);
+        }
+
+        if (k >= n) goto bad;
+        char sep = c[pos[k]];
+        if (sep != '}' && sep != ',') goto bad;   /* leaves a '\n' for bad: */
+        k++;
+        if (sep == '}') break;
+    }
+    if (k < n) {
+        if (c[pos[k]] != '\n') goto bad;
+        k++;
+    }
+    *i = k;
+    return (r->ip_len > 0 && r->status) ? 0 : -1;
+
+bad:
+    while (k < n && c[pos[k]] != '\n') k++;
+    *i = k < n ? k + 1 : n;
+    return -1;
+}
+
+typedef struct {
+    long lines, errors;
+} JsonStats;
+
+/*
+ * Index and parse buf[0..len) chunk by chunk, calling emit() for every
+ * line that yields an IP and a status.
+ */
+static JsonStats json_lines_scan(const char *buf, size_t len, const JsonKeys *keys,
+                                 void (*emit)(const LogRecord *, void *), void *ctx) {
+    JsonStats st = { 0, 0 };
+    size_t cap = JSON_CHUNK + 64;
+    uint32_t *pos = malloc(cap * sizeof(uint32_t));
+
+    for (size_t off = 0; off < len; ) {
+        size_t clen = len - off;
+        if (clen > JSON_CHUNK) {
+            /* End the chunk after the last newline; grow for huge lines. */
+            clen = JSON_CHUNK;
+            while (clen > 0 && buf[off + clen - 1] != '\n') clen--;
+            if (clen == 0) {
+                const char *nl = memchr(buf + off, '\n', len - off);
+                clen = nl ? (size_t)(nl - (buf + off)) + 1 : len - off;
+            }
+        }
+        if (clen + 64 > cap) {
+            cap = clen + 64;
+            pos = realloc(pos, cap * sizeof(uint32_t));
+        }
+
+        const char *c = buf + off;
+        size_t n = json_index_chunk(c, clen, pos);
+        for (size_t i = 0; i < n; ) {
+            LogRecord r;
+            st.lines++;
+            if (json_parse_line(c, pos, n, &i, keys, &r) == 0) emit(&r, ctx);
+            else st.errors++;
+        }
+        off += clen;
+    }
+    free(pos);
+    return st;
+}
+
+/* ── Run-time format dispatch ───────────────────────────────────────────── */
+
+/*
+ * The one switch from a run-time format to its parser.  LOOP(NAME, ...)
+ * is a per-layout loop macro expanded once for each descriptor format,
+ * so every copy keeps parse_fmt_<NAME>() inlined; JSONL has no per-line
+ * parser and streams through json_lines_scan() with cb(rec, ctx), which
+ * must do what the loop body does.
+ */
+#define FOR_EACH_FORMAT(fmt, buf, len, nlines, nerrors, cb, ctx, LOOP, ...)  \
+    do {                                                                    \
+        switch (fmt) {                                                      \
+        case FMT_APACHE: LOOP(apache, __VA_ARGS__); break;                  \
+        case FMT_NGINX:  LOOP(nginx,  __VA_ARGS__); break;                  \
+        case FMT_TSV:    LOOP(tsv,    __VA_ARGS__); break;                  \
+        case FMT_JSON:   LOOP(json,   __VA_ARGS__); break;                  \
+        case FMT_JSONL: {                                                   \
+            JsonStats st_ = json_lines_scan(buf, len, &json_keys, cb, ctx); \
+            (nlines) += st_.lines;                                          \
+            (nerrors) += st_.errors;                                        \
+            break;                                                          \
+        }                                                                   \
+        }                                                                   \
+    } while (0)
+
+#define FORMAT_RECORD_LOOP(NAME, buf, len, lines, errors, cb, ctx)          \
+    FOR_EACH_RECORD(parse_fmt_##NAME, buf, len, lines, errors, r_, cb(&r_, ctx))
+
+/*
+ * FOR_EACH_RECORD for any format: cb(&rec, ctx) for every accepted line.
+ * cb is a static function, so the descriptor loops inline it too.
+ */
+#define FOR_EACH_FORMAT_RECORD(fmt, buf, len, lines, errors, cb, ctx)       \
+    FOR_EACH_FORMAT(fmt, buf, len, lines, errors, cb, ctx,                  \
+                    FORMAT_RECORD_LOOP, buf, len, lines, errors, cb, ctx)
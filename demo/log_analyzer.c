@@ -1,19 +1,84 @@
 /*
- * log_analyzer.c — Realistic log file analyzer (original, unoptimized)
+ * log_analyzer.c — Access log analyzer: a fixed baseline and optimized paths
  *
- * Parses Apache-style access logs, aggregates:
- *   - IP request counts (hash table with linear probing)
- *   - HTTP status code distribution
- *   - Latency percentiles (p50/p95/p99 via qsort)
+ * Aggregates an access log into per-client request counts, the HTTP
+ * status distribution and latency percentiles (p50/p95/p99).
  *
- * Written "normally" — competent C, no ARM-specific tricks.
- * Designed to process ~4M lines for meaningful perf profiling.
+ * The default run (no options) is the profiling baseline and stays as
+ * first written: fgets + parse_line over Apache lines, an IP table with
+ * linear probing, percentiles via qsort, on a generated log (~4M lines
+ * for meaningful perf runs).  Its report is the reference the other
+ * paths must reproduce.
+ *
+ * Options select the optimized paths, built from the modules #included
+ * below: mapped input and per-format parsers with NEON/SSE2 delimiter
+ * scans and SWAR fields (--mmap, --format), 64-bit-key aggregation on
+ * N threads (--threads, --agg), JSON key selection and predicates
+ * (--json-keys, --select, --where), route templates, rate windows,
+ * anomaly detection, sampling, external aggregation and snapshots.
+ * Subcommands benchmark those paths against the baseline, merge
+ * snapshots, or run them on a followed file or a socket:
+ *
+ *   log_analyzer [lines] [passes] [-s] [--format apache|nginx|tsv|json|jsonl]
+ *                [--json-keys ip,status,latency,path[,method]]
+ *                [--select ip,status,latency] [--where PRED]...
+ *                [--threads N] [--agg local|shared|split]
+ *                [--routes auto|/tmpl/:id,...] [--id-paths] [--steady-times]
+ *                [--log FILE|DIR]... [--snapshot FILE]
+ *                [--sample N] [--sample-by chunk|line] [--seed N]
+ *                [--external MB] [--key ip|ip+path] [--spill-dir DIR]
+ *                [--rate-limit N] [--rate-keys N] [--anomaly SEC]
+ *                [--anomaly-k K] [--chunk MB] [--no-steal] [--mmap] [--methods]
+ *   log_analyzer bench-formats [lines]
+ *   log_analyzer bench-swar [lines]
+ *   log_analyzer bench-hist [lines]
+ *   log_analyzer bench-query [lines]
+ *   log_analyzer bench-agg [samples] [distinct] [max_threads]
+ *   log_analyzer bench-routes [lines]
+ *   log_analyzer bench-quantiles [samples] [threads]
+ *   log_analyzer bench-files [threads] [files] [big_lines] [small_lines]
+ *   log_analyzer bench-anomaly [lines]
+ *   log_analyzer bench-sample [lines] [rate] [seeds]
+ *   log_analyzer merge [-o OUT] SNAPSHOT...
+ *   log_analyzer follow FILE [--format F] [--interval SEC] [--refreshes N]
+ *                       [--from-start] [--anomaly SEC]
+ *   log_analyzer listen SOCKET [--format F] [--stream] [--batch N]
+ *                       [--interval SEC] [--refreshes N]
+ *   log_analyzer bench-ingest [messages] [rate]
+ *
+ * Build: make (or gcc -O2 -pthread -o log_analyzer log_analyzer.c -lm);
+ * make bench runs bench_suite.c's variant matrix.
  */
+#define _GNU_SOURCE         /* recvmmsg(), accept4() for socket_ingest.c */
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "simd_scan.c"
+#include "swar_int.c"
+#include "log_formats.c"
+#include "json_index.c"
+#include "query.c"
+#include "parallel_agg.c"
+#include "work_steal.c"
+#include "route_trie.c"
+#include "rate_window.c"
+#include "histogram.c"
+#include "anomaly.c"
+#include "quantile.c"
+#include "snapshot.c"
+#include "follow.c"
+#include "socket_ingest.c"
+#include "sample.c"
+#include "external_agg.c"
+
 #define HASH_SIZE   (1 << 17)   /* 131072 slots */
 #define MAX_LINE    1024
 #define INIT_LAT    (1 << 20)   /* initial latency array capacity */
@@ -57,9 +122,13 @@ static IPEntry *find_or_insert(const char *ip) {
 /* ── Statistics ─────────────────────────────────────────────────────────── */
 
 static int    status_counts[600];
+static Hist   status_hist;      /* formatted paths; drained into status_counts */
+static Hist   method_hist;      /* with --methods: method × status class */
+static int    method_counts[HIST_METHODS * HIST_CLASSES];
+static int    count_methods;
 static double *latencies;
 static int    lat_count, lat_cap;
-static int    total_lines, parse_errors;
+static int    total_lines, parse_errors, filtered_lines;
 
 static void add_latency(double t) {
     if (lat_count >= lat_cap) {
@@ -69,6 +138,102 @@ static void add_latency(double t) {
     latencies[lat_count++] = t;
 }
 
+/* Per random group counts while --sample runs (see sample.c). */
+static uint32_t *sample_ip_groups;      /* [HASH_SIZE][SAMPLE_GROUPS] */
+static int       sample_status[SAMPLE_GROUPS][600];
+static int       sample_group;
+
+/* All of record_hit but the status count. */
+static void record_client(const char *ip, int status, double rtime) {
+    IPEntry *e = find_or_insert(ip);
+    if (e) { e->count++; e->total_time += rtime; }
+    add_latency(rtime);
+    if (sample_ip_groups) {
+        if (e) sample_ip_groups[(size_t)(e - ip_table) * SAMPLE_GROUPS + sample_group]++;
+        sample_status[sample_group][status]++;
+    }
+}
+
+static void record_hit(const char *ip, int status, double rtime) {
+    status_counts[status]++;
+    record_client(ip, status, rtime);
+}
+
+static RouteTrie    *routes;   /* per-endpoint stats when --routes is given */
+static RateTable    *rates;    /* sliding-window client rates with --rate-limit */
+static AnomDetector *anomaly;  /* per-endpoint baselines with --anomaly */
+static int           time_fmt; /* layout lf_timestamp() reads for the two above */
+static LfTimeMemo    time_memo;
+static uint64_t      time_bad; /* lines whose time did not parse */
+
+/*
+ * Same as record_hit, for a parsed record whose IP is not NUL-terminated;
+ * the status goes to status_hist, drained at the end of the buffer.
+ */
+static void record_log(const LogRecord *r) {
+    int64_t sec = 0;
+    int timed = 0;
+    if (rates || anomaly) {
+        timed = lf_timestamp(&time_memo, time_fmt, r, &sec) == 0;
+        time_bad += !timed;
+    }
+    if (rates && timed) rate_hit(rates, rate_key(r->ip, r->ip_len), sec);
+    if (routes) {
+        int id = route_match(routes, r->path, r->path_len);
+        route_record(routes, id, r->status, r->latency_ms);
+        if (anomaly && timed) anom_add(anomaly, id, sec, r->status, r->latency_ms);
+    }
+    hist_add(&status_hist, r->status, (unsigned)total_lines);
+    if (count_methods)
+        hist_add(&method_hist, hist_method_bin(r->method, r->method_len, r->status), (unsigned)total_lines);
+    char ip[48];
+    int n = r->ip_len < 47 ? r->ip_len : 47;
+    memcpy(ip, r->ip, n);
+    ip[n] = '\0';
+    record_client(ip, r->status, r->latency_ms);
+}
+
+static void record_log_cb(const LogRecord *r, void *ctx) {
+    (void)ctx;
+    record_log(r);
+}
+
+/* record_log restricted to the query's projection. */
+static void record_query(const Query *q, const LogRecord *r) {
+    if (q->select & QF_IP) {
+        char ip[48];
+        int n = r->ip_len < 47 ? r->ip_len : 47;
+        memcpy(ip, r->ip, n);
+        ip[n] = '\0';
+        IPEntry *e = find_or_insert(ip);
+        if (e) { e->count++; e->total_time += r->latency_ms; }
+    }
+    if (q->select & QF_STATUS)  hist_add(&status_hist, r->status, (unsigned)total_lines);
+    if (q->select & QF_LATENCY) add_latency(r->latency_ms);
+}
+
+/* jsonl has no lazy parser: filter after full extraction. */
+static void record_query_cb(const LogRecord *r, void *ctx) {
+    const Query *q = ctx;
+    if (query_accepts(q, r)) record_query(q, r);
+    else                     filtered_lines++;
+}
+
+static void reset_state(void) {
+    memset(ip_table, 0, sizeof(ip_table));
+    ip_table_size = 0;
+    memset(status_counts, 0, sizeof(status_counts));
+    memset(method_counts, 0, sizeof(method_counts));
+    lat_count = 0;
+    total_lines = 0;
+    parse_errors = 0;
+    filtered_lines = 0;
+    if (routes) route_reset_stats(routes);
+    if (rates) rate_reset(rates);
+    if (anomaly) anom_reset(anomaly);
+    time_bad = 0;
+}
+
 /* ── Line parser ────────────────────────────────────────────────────────── */
 
 /*
@@ -113,13 +278,42 @@ static int cmp_double(const void *a, const void *b) {
     return (da > db) - (da < db);
 }
 
+/* By count, ties by address, so every path prints the same top list. */
 static int cmp_ip_count(const void *a, const void *b) {
-    return ((const IPEntry *)b)->count - ((const IPEntry *)a)->count;
+    const IPEntry *x = a, *y = b;
+    if (x->count != y->count) return y->count - x->count;
+    return strcmp(x->ip, y->ip);
 }
 
 /* ── Log generator ──────────────────────────────────────────────────────── */
 
-static void generate_log(const char *path, int n) {
+static int gen_steady_times;    /* --steady-times: no hourly wrap, for rate and anomaly runs */
+
+/*
+ * With --id-paths (and in bench-routes and bench-anomaly), three of every
+ * four requests to an entity collection address one entity: numeric
+ * user IDs, hex product IDs, UUID orders.  Derived from the line number
+ * so the rand() stream, and with it every other field, stays the same.
+ * Off by default, so the baseline log is unchanged.
+ */
+static int gen_id_paths;
+
+static const char *id_path(char *buf, size_t n, const char *url, int i) {
+    uint32_t h = (uint32_t)i * 2654435761u, g = h * 2246822519u + 374761393u;
+    if (i % 4 == 0) return url;
+    if (strcmp(url, "/api/users") == 0)
+        snprintf(buf, n, "%s/%u", url, h % 100000);
+    else if (strcmp(url, "/api/products") == 0)
+        snprintf(buf, n, "%s/%08x%08x%08x", url, h, g, h ^ g);
+    else if (strcmp(url, "/api/orders") == 0)
+        snprintf(buf, n, "%s/%08x-%04x-4%03x-a%03x-%08x%04x/items", url,
+                 h, g >> 16, g & 0xfff, h >> 20, g ^ h, h & 0xffff);
+    else
+        return url;
+    return buf;
+}
+
+static void generate_log(const char *path, int n, int fmt) {
     FILE *f = fopen(path, "w");
     if (!f) { perror("fopen"); exit(1); }
 
@@ -130,6 +324,8 @@ static void generate_log(const char *path, int n) {
                             "/static/app.js","/api/cart","/health",
                             "/api/notifications"};
     int codes[] = {200,200,200,200,200,201,204,301,400,403,404,404,500,502,503};
+    const char *mons[]   = {"Jan","Feb","Mar","Apr","May","Jun",
+                            "Jul","Aug","Sep","Oct","Nov","Dec"};
 
     char buf[512];
     for (int i = 0; i < n; i++) {
@@ -144,109 +340,2978 @@ static void generate_log(const char *path, int n) {
         if (rand() % 20 == 0)  rt += 500.0;
         if (rand() % 100 == 0) rt += 5000.0;
 
-        int len = snprintf(buf, sizeof(buf),
-            "%d.%d.%d.%d - - [28/Feb/2026:10:%02d:%02d +0000] "
-            "\"%s %s HTTP/1.1\" %d %d %.1f\n",
-            a,b,c,d, (i/3600)%60, (i/60)%60,
-            meths[rand()%5], paths[rand()%10], st, rand()%50000+100, rt);
+        /* Same random stream for every format, so all layouts of one
+         * generated log aggregate to identical results.  Drawn in the
+         * order GCC evaluated the original single snprintf()'s arguments
+         * (last first), so the apache log is the baseline's byte for byte. */
+        int size = rand() % 50000 + 100;
+        const char *url  = paths[rand() % 10];
+        const char *meth = meths[rand() % 5];
+        char idurl[96];
+        if (gen_id_paths) url = id_path(idurl, sizeof(idurl), url, i);
+        /* 60 requests a second from 28/Feb/2026 10:00:00 UTC; the clock
+         * wraps back to 10:00 after an hour unless --steady-times. */
+        time_t when = 1772272800 + (gen_steady_times ? i / 60 : i / 60 % 3600);
+        struct tm tm;
+        gmtime_r(&when, &tm);
+
+        int len;
+        switch (fmt) {
+        case FMT_NGINX:
+            len = snprintf(buf, sizeof(buf),
+                "%d.%d.%d.%d - - [%02d/%s/%d:%02d:%02d:%02d +0000] "
+                "\"%s %s HTTP/1.1\" %d %d \"-\" \"curl/8.5.0\" %.4f\n",
+                a,b,c,d, tm.tm_mday, mons[tm.tm_mon], tm.tm_year + 1900,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, meth, url, st, size, rt / 1000.0);
+            break;
+        case FMT_TSV:
+            len = snprintf(buf, sizeof(buf),
+                "%d-%02d-%02dT%02d:%02d:%02dZ\t%d.%d.%d.%d\t%s\t%s\t%d\t%d\t%.1f\n",
+                tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+                tm.tm_sec, a,b,c,d, meth, url, st, size, rt);
+            break;
+        case FMT_JSONL:
+            /* Reordered keys, a nested object with its own "status" and
+             * strings with escaped quotes and trailing backslashes. */
+            len = snprintf(buf, sizeof(buf),
+                "{\"time\":\"%d-%02d-%02dT%02d:%02d:%02dZ\",\"level\":\"info\","
+                "\"msg\":\"handled \\\"%s %s\\\", ok\",\"status\":%d,"
+                "\"upstream\":{\"status\":%d,\"addr\":\"10.9.0.%d:8080\",\"tags\":[\"a\",\"b\"]},"
+                "\"path\":\"%s\",\"method\":\"%s\",\"dir\":\"C:\\\\logs\\\\\","
+                "\"latency_ms\":%.1f,\"client_ip\":\"%d.%d.%d.%d\",\"bytes\":%d}\n",
+                tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+                tm.tm_sec, meth, url, st, st, d, url, meth, rt, a,b,c,d, size);
+            break;
+        case FMT_JSON:
+            len = snprintf(buf, sizeof(buf),
+                "{\"ts\":\"%d-%02d-%02dT%02d:%02d:%02dZ\",\"ip\":\"%d.%d.%d.%d\","
+                "\"method\":\"%s\",\"path\":\"%s\",\"status\":%d,"
+                "\"bytes\":%d,\"latency_ms\":%.1f}\n",
+                tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+                tm.tm_sec, a,b,c,d, meth, url, st, size, rt);
+            break;
+        default:
+            len = snprintf(buf, sizeof(buf),
+                "%d.%d.%d.%d - - [%02d/%s/%d:%02d:%02d:%02d +0000] "
+                "\"%s %s HTTP/1.1\" %d %d %.1f\n",
+                a,b,c,d, tm.tm_mday, mons[tm.tm_mon], tm.tm_year + 1900,
+                tm.tm_hour, tm.tm_min, tm.tm_sec, meth, url, st, size, rt);
+            break;
+        }
         fwrite(buf, 1, len, f);
     }
     fclose(f);
 }
 
-/* ── Main ───────────────────────────────────────────────────────────────── */
+/* Whole file into a NUL-terminated heap buffer. */
+static char *load_file(const char *path, size_t *len_out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror("fopen"); exit(1); }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc((size_t)len + 1);
+    if (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        fprintf(stderr, "failed to read %s\n", path);
+        exit(1);
+    }
+    buf[len] = '\0';
+    fclose(f);
+    *len_out = (size_t)len;
+    return buf;
+}
 
-static void reset_state(void) {
-    memset(ip_table, 0, sizeof(ip_table));
-    ip_table_size = 0;
-    memset(status_counts, 0, sizeof(status_counts));
-    lat_count = 0;
-    total_lines = 0;
-    parse_errors = 0;
+static double elapsed_since(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
 }
 
-int main(int argc, char **argv) {
-    int num_lines = 500000;
-    const char *logfile = "/tmp/access.log";
-    int passes = 30;  /* re-analyze the file multiple times for stable profiling */
-    int skip_gen = 0;
-    if (argc > 1) num_lines = atoi(argv[1]);
-    if (argc > 2) passes = atoi(argv[2]);
-    if (argc > 3 && strcmp(argv[3], "-s") == 0) skip_gen = 1;
+/* status_hist (and method_hist) for the serial paths, allocated on first use. */
+static void hists_begin(void) {
+    if (!status_hist.c) hist_init(&status_hist, 600, HIST_SHIFT);
+    if (count_methods && !method_hist.c) hist_init(&method_hist, HIST_METHODS * HIST_CLASSES, HIST_SHIFT);
+}
 
-    /* Phase 1: generate (skip with -s flag, useful for profiling) */
-    if (!skip_gen) {
-        printf("Generating %d log lines to %s ...\n", num_lines, logfile);
-        generate_log(logfile, num_lines);
+static void hists_end(void) {
+    hist_drain(&status_hist, status_counts);
+    if (method_hist.c) hist_drain(&method_hist, method_counts);
+}
+
+static void print_method_table(void) {
+    printf("\nMethods × Status Class:\n");
+    printf("  %-8s %9s %9s %9s %9s %9s %9s\n", "", "1xx", "2xx", "3xx", "4xx", "5xx", "none");
+    for (int m = 0; m < HIST_METHODS; m++) {
+        const int *row = &method_counts[m * HIST_CLASSES];
+        int sum = 0;
+        for (int c = 0; c < HIST_CLASSES; c++) sum += row[c];
+        if (sum == 0) continue;
+        printf("  %-8s", hist_method_names[m]);
+        for (int c = 0; c < HIST_CLASSES; c++) printf(" %9d", row[c]);
+        printf("\n");
+    }
+}
+
+/* One pass over an in-memory log with the specialized parser for fmt. */
+static void analyze_formatted(const char *buf, size_t len, int fmt) {
+    hists_begin();
+    FOR_EACH_FORMAT_RECORD(fmt, buf, len, total_lines, parse_errors, record_log_cb, NULL);
+    hists_end();
+}
+
+/* One pass with projection/predicate pushdown. */
+static void analyze_query(const Query *q, const char *buf, size_t len, int fmt) {
+    hists_begin();
+    FOR_EACH_FORMAT(fmt, buf, len, total_lines, parse_errors, record_query_cb, (void *)q,
+                    FOR_EACH_QUERY_RECORD, q, buf, len, total_lines, parse_errors,
+                    filtered_lines, r, record_query(q, &r));
+    hists_end();
+}
+
+/* ── Parallel analysis ──────────────────────────────────────────────────── */
+
+typedef struct {
+    const char *buf;
+    size_t      begin, end;
+    int         fmt, backend, lane;
+    AggTable   *shared;
+    AggTable    local;
+    Hist        status, methods;    /* methods only with --methods */
+    double     *lat;
+    size_t      lat_n, lat_cap;
+    long        lines, errors;
+} AggWorker;
+
+static inline void agg_worker_record(AggWorker *w, const LogRecord *r) {
+    AggKey key = agg_key_text(r->ip, r->ip_len);
+    uint64_t us = (uint64_t)llround(r->latency_ms * 1000.0);
+    if (w->backend == AGG_LOCAL) agg_local_add(&w->local, key, 1, us);
+    else                         agg_shared_add(w->shared, key, us, w->lane);
+    hist_add(&w->status, r->status, (unsigned)w->lat_n);
+    if (w->methods.c)
+        hist_add(&w->methods, hist_method_bin(r->method, r->method_len, r->status), (unsigned)w->lat_n);
+    if (w->lat_n == w->lat_cap) {
+        w->lat_cap = w->lat_cap ? w->lat_cap * 2 : 4096;
+        w->lat = realloc(w->lat, w->lat_cap * sizeof(double));
+    }
+    w->lat[w->lat_n++] = r->latency_ms;
+}
+
+static void agg_worker_hists(AggWorker *w) {
+    hist_init(&w->status, 600, HIST_SHIFT);
+    if (count_methods) hist_init(&w->methods, HIST_METHODS * HIST_CLASSES, HIST_SHIFT);
+}
+
+static void agg_worker_cb(const LogRecord *r, void *ctx) {
+    agg_worker_record(ctx, r);
+}
+
+/* Parses b[0..len) into the worker's aggregates. */
+static void agg_worker_parse(AggWorker *w, const char *b, size_t len) {
+    FOR_EACH_FORMAT_RECORD(w->fmt, b, len, w->lines, w->errors, agg_worker_cb, w);
+}
+
+static void *agg_worker_run(void *arg) {
+    AggWorker *w = arg;
+    agg_worker_parse(w, w->buf + w->begin, w->end - w->begin);
+    return NULL;
+}
+
+static void key_sample_cb(const LogRecord *r, void *ctx) {
+    AggKey **k = ctx;
+    *(*k)++ = agg_key_text(r->ip, r->ip_len);
+}
+
+/* Up to max IP keys from the start of buf, to pick hot keys for AGG_SPLIT. */
+static size_t sample_keys(const char *buf, size_t len, int fmt, AggKey *keys, size_t max) {
+    long lines = 0, errors = 0;
+    const char *end = buf;
+    for (size_t i = 0; i < max && end < buf + len; i++) {
+        const char *nl = memchr(end, '\n', buf + len - end);
+        end = nl ? nl + 1 : buf + len;
+    }
+    size_t slen = (size_t)(end - buf);
+    AggKey *out = keys;
+    FOR_EACH_FORMAT_RECORD(fmt, buf, slen, lines, errors, key_sample_cb, &out);
+    return (size_t)(out - keys);
+}
+
+/* Dotted quad for an IPv4 key, the stored text otherwise. */
+static void agg_key_str(const AggSlot *s, char *out, size_t n) {
+    uint64_t key = s->key;
+    if (key >> 32 == 1)
+        snprintf(out, n, "%u.%u.%u.%u", (unsigned)(key >> 24) & 255,
+                 (unsigned)(key >> 16) & 255, (unsigned)(key >> 8) & 255,
+                 (unsigned)key & 255);
+    else
+        snprintf(out, n, "%.*s", (int)s->len, s->text);
+}
+
+static int cmp_slot_count(const void *a, const void *b) {
+    uint64_t ca = (*(const AggSlot *const *)a)->count, cb = (*(const AggSlot *const *)b)->count;
+    return (ca < cb) - (ca > cb);
+}
+
+/*
+ * Lines in buf, from the newline density of 16 windows spread over it;
+ * the shared table's cardinality bound.
+ */
+static size_t agg_estimate_lines(const char *buf, size_t len) {
+    size_t win = 65536, seen = 0, nl = 0;
+    if (len <= 16 * win) win = len / 16 + 1;
+    for (int i = 0; i < 16; i++) {
+        size_t at = (len - (len < win ? len : win)) / 15 * i;
+        const char *p = buf + at, *end = buf + (at + win < len ? at + win : len);
+        seen += (size_t)(end - p);
+        while ((p = memchr(p, '\n', (size_t)(end - p)))) { nl++; p++; }
+    }
+    return seen ? (size_t)((double)len * (nl + 1) / seen) + 1 : 1;
+}
+
+/*
+ * Folds per-worker counters and latencies and the merged IP table into
+ * the globals the serial path fills; frees the workers' buffers and
+ * result.  ip_table is the serial path's fixed-size table: past 3/4 of
+ * it only the busiest clients go in, while Unique IPs still reports the
+ * full count.
+ */
+static void agg_workers_collect(AggWorker *w, int threads, AggTable *result) {
+    for (int i = 0; i < threads; i++) {
+        total_lines += (int)w[i].lines;
+        parse_errors += (int)w[i].errors;
+        hist_drain(&w[i].status, status_counts);
+        hist_free(&w[i].status);
+        if (w[i].methods.c) {
+            hist_drain(&w[i].methods, method_counts);
+            hist_free(&w[i].methods);
+        }
+        for (size_t j = 0; j < w[i].lat_n; j++) add_latency(w[i].lat[j]);
+        free(w[i].lat);
+    }
+    const AggSlot **order = malloc((result->used + 1) * sizeof(AggSlot *));
+    size_t n = 0, keep = HASH_SIZE / 4 * 3;
+    for (size_t i = 0; i <= result->mask; i++)
+        if (result->slots[i].key) order[n++] = &result->slots[i];
+    if (n > keep) {
+        qsort(order, n, sizeof(AggSlot *), cmp_slot_count);
+        fprintf(stderr, "note: report table holds the %zu busiest of %zu clients\n", keep, n);
+    }
+    for (size_t i = 0; i < n && i < keep; i++) {
+        char ip[48];
+        agg_key_str(order[i], ip, sizeof(ip));
+        IPEntry *e = find_or_insert(ip);
+        if (e) { e->count += (int)order[i]->count; e->total_time += order[i]->lat_us / 1000.0; }
+    }
+    if (n > keep) ip_table_size += (int)(n - keep);
+    free(order);
+
+    agg_free(result);
+}
+
+/*
+ * One pass over buf on `threads` threads with the given backend; the
+ * merged result lands in the same globals as the serial path.  The
+ * shared table is sized for every line being a new client, the only
+ * bound known before the run; returns -1 if it overflowed anyway.
+ */
+static int analyze_parallel(const char *buf, size_t len, int fmt, int threads, int backend) {
+    AggWorker *w = calloc(threads, sizeof(AggWorker));
+    size_t *bounds = malloc((threads + 1) * sizeof(size_t));
+    AggTable shared, merged;
+    agg_split_lines(buf, len, threads, bounds);
+
+    if (backend != AGG_LOCAL) {
+        agg_init(&shared, agg_estimate_lines(buf, len) / 4 * 5);
+        if (backend == AGG_SPLIT) {
+            size_t max = 65536;
+            AggKey *keys = malloc(max * sizeof(AggKey));
+            agg_split_hot(&shared, keys, sample_keys(buf, len, fmt, keys, max), AGG_HOT_KEYS);
+            free(keys);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        w[i].buf = buf;
+        w[i].begin = bounds[i];
+        w[i].end = bounds[i + 1];
+        w[i].fmt = fmt;
+        w[i].backend = backend;
+        w[i].lane = i;
+        w[i].shared = &shared;
+        agg_worker_hists(&w[i]);
+        if (backend == AGG_LOCAL) agg_init(&w[i].local, HASH_SIZE);
+    }
+
+    agg_run_threads(threads, agg_worker_run, w, sizeof(AggWorker));
+
+    AggTable *result = &shared;
+    if (backend == AGG_LOCAL) {
+        agg_init(&merged, HASH_SIZE);
+        for (int i = 0; i < threads; i++) {
+            agg_merge_into(&merged, &w[i].local);
+            agg_free(&w[i].local);
+        }
+        result = &merged;
     } else {
-        printf("Skipping generation, using existing %s\n", logfile);
+        agg_fold_hot(&shared);
+    }
+    size_t dropped = result->dropped;
+    agg_workers_collect(w, threads, result);
+    free(bounds);
+    free(w);
+    if (dropped) {
+        fprintf(stderr, "error: shared IP table full, %zu updates dropped (try --agg local)\n",
+                dropped);
+        return -1;
+    }
+    return 0;
+}
+
+/* ── Multi-file analysis ────────────────────────────────────────────────── */
+
+static void files_chunk(void *ctx, const WsTask *t) {
+    agg_worker_parse(ctx, t->buf, t->len);
+}
+
+/*
+ * Every file through the chunk scheduler on `threads` workers, each
+ * with its own AGG_LOCAL table, merged into the globals at the end.
+ * The pool is left initialized for print_schedule().
+ */
+static void analyze_files(WsPool *pool, const WsFile *files, int n_files, int fmt, int threads,
+                          size_t chunk, int steal) {
+    AggWorker *w = calloc(threads, sizeof(AggWorker));
+    for (int i = 0; i < threads; i++) {
+        w[i].fmt = fmt;
+        w[i].backend = AGG_LOCAL;
+        w[i].lane = i;
+        agg_worker_hists(&w[i]);
+        agg_init(&w[i].local, HASH_SIZE);
     }
+    ws_init(pool, threads, files, n_files, chunk, steal);
+    ws_run(pool, files_chunk, w, sizeof(AggWorker));
 
-    /* Phase 2: analyze (timed) — run 'passes' iterations, keep last results */
-    printf("Analyzing (%d passes) ...\n", passes);
+    AggTable merged;
+    agg_init(&merged, HASH_SIZE);
+    for (int i = 0; i < threads; i++) {
+        agg_merge_into(&merged, &w[i].local);
+        agg_free(&w[i].local);
+    }
+    agg_workers_collect(w, threads, &merged);
+    free(w);
+}
+
+/* Critical path: the largest worker busy time, the run's length on idle cores. */
+static double sched_critical_path(const WsPool *p, double *mean) {
+    double max = 0, sum = 0;
+    for (int i = 0; i < p->n; i++) {
+        sum += p->stats[i].busy;
+        if (p->stats[i].busy > max) max = p->stats[i].busy;
+    }
+    *mean = sum / p->n;
+    return max;
+}
+
+static void print_schedule(const WsPool *p, int n_files, uint64_t bytes, size_t chunk) {
+    uint64_t chunks = 0, stolen = 0, probes = 0;
+    for (int i = 0; i < p->n; i++) {
+        chunks += p->stats[i].chunks;
+        stolen += p->stats[i].stolen;
+        probes += p->stats[i].failed_probes;
+    }
+    printf("\nSchedule: %s, %d workers, %d files (%.1f MB), %llu chunks of ~%zu MB\n",
+           p->steal ? "work stealing" : "static (file per worker)", p->n, n_files, bytes / 1e6,
+           (unsigned long long)chunks, chunk >> 20);
+    printf("  %6s %6s %7s %7s %9s %8s %10s\n", "worker", "files", "chunks", "stolen", "MB",
+           "busy s", "done at s");
+    for (int i = 0; i < p->n; i++) {
+        const WsStats *s = &p->stats[i];
+        printf("  %6d %6d %7llu %7llu %9.1f %8.3f %10.3f\n", i, s->files,
+               (unsigned long long)s->chunks, (unsigned long long)s->stolen, s->bytes / 1e6,
+               s->busy, s->done_at);
+    }
+    double mean, crit = sched_critical_path(p, &mean);
+    printf("  steals %llu (%llu empty or lost probes); busy max/mean %.2f; critical path %.3f s\n",
+           (unsigned long long)stolen, (unsigned long long)probes, mean > 0 ? crit / mean : 0, crit);
+}
+
+/*
+ * A skewed set of hourly files — one large, the rest small — on the
+ * static file-per-worker split and with work stealing.  On an idle
+ * machine the run takes about as long as its critical path, so that is
+ * what the comparison reports alongside wall time.
+ */
+static int cmd_bench_files(int argc, char **argv) {
+    int threads = argc > 0 ? atoi(argv[0]) : 4;
+    int n_files = argc > 1 ? atoi(argv[1]) : 12;
+    int big = argc > 2 ? atoi(argv[2]) : 400000;
+    int small = argc > 3 ? atoi(argv[3]) : 30000;
+    size_t chunk = 4 << 20;
+    const char *dir = "/tmp/bench.files";
+    if (threads < 1 || n_files < 1) {
+        fprintf(stderr, "usage: log_analyzer bench-files [threads] [files] [big_lines] [small_lines]\n");
+        return 1;
+    }
+
+    mkdir(dir, 0755);
+    WsFile *files = calloc(n_files, sizeof(WsFile));
+    char **paths = malloc(n_files * sizeof(char *));
+    uint64_t bytes = 0;
+    printf("Benchmark: %d files (1 x %d lines, %d x %d lines), %d workers\n\n", n_files, big,
+           n_files - 1, small, threads);
+    for (int i = 0; i < n_files; i++) {
+        paths[i] = malloc(64);
+        snprintf(paths[i], 64, "%s/access.log.%02d", dir, i);
+        generate_log(paths[i], i == 0 ? big : small, FMT_APACHE);
+        if (ws_map(&files[i], paths[i]) != 0) return 1;
+        bytes += files[i].size;
+    }
     lat_cap = INIT_LAT;
     latencies = malloc(lat_cap * sizeof(double));
 
-    struct timespec t0, t1;
-    clock_gettime(CLOCK_MONOTONIC, &t0);
+    /* Reference: each file serially. */
+    reset_state();
+    for (int i = 0; i < n_files; i++) analyze_formatted(files[i].map, files[i].size, FMT_APACHE);
+    int ref_lines = total_lines, ref_ips = ip_table_size, ref_status[600];
+    memcpy(ref_status, status_counts, sizeof(ref_status));
 
-    for (int pass = 0; pass < passes; pass++) {
+    printf("%-10s %8s %10s %8s %8s %9s  %s\n", "schedule", "wall s", "crit. s", "max/mean",
+           "steals", "speedup", "result");
+    int ok = 1;
+    double base = 0;
+    for (int steal = 0; steal < 2; steal++) {
+        WsPool pool;
         reset_state();
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        analyze_files(&pool, files, n_files, FMT_APACHE, threads, chunk, steal);
+        double wall = elapsed_since(&t0), mean, crit = sched_critical_path(&pool, &mean);
+        uint64_t stolen = 0;
+        for (int i = 0; i < threads; i++) stolen += pool.stats[i].stolen;
+        if (!steal) base = crit;
+        int match = total_lines == ref_lines && ip_table_size == ref_ips &&
+                    memcmp(status_counts, ref_status, sizeof(ref_status)) == 0;
+        ok &= match;
+        printf("%-10s %8.3f %10.3f %8.2f %8llu %8.2fx  %s\n", steal ? "stealing" : "static",
+               wall, crit, crit / mean, (unsigned long long)stolen, base / crit,
+               match ? "PASS" : "FAIL");
+        if (steal) print_schedule(&pool, n_files, bytes, chunk);
+        ws_free(&pool);
+    }
+    for (int i = 0; i < n_files; i++) {
+        ws_unmap(&files[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    free(files);
+    free(latencies);
+    return ok ? 0 : 1;
+}
 
-        FILE *f = fopen(logfile, "r");
-        if (!f) { perror("fopen"); return 1; }
+/* ── Benchmarks ─────────────────────────────────────────────────────────── */
 
-        char line[MAX_LINE];
-        char ip[48];
-        int  status;
-        double rtime;
+typedef struct {
+    long   lines, errors, status_sum, ip_bytes;
+    double lat_sum;
+} ParseSums;
 
-        while (fgets(line, sizeof(line), f)) {
-            total_lines++;
-            if (parse_line(line, ip, &status, &rtime) != 0) {
-                parse_errors++;
-                continue;
+static void sum_record_cb(const LogRecord *r, void *ctx) {
+    ParseSums *s = ctx;
+    s->status_sum += r->status;
+    s->ip_bytes += r->ip_len;
+    s->lat_sum += r->latency_ms;
+}
+
+static ParseSums sums_formatted(const char *buf, size_t len, int fmt) {
+    ParseSums s = {0};
+    FOR_EACH_FORMAT_RECORD(fmt, buf, len, s.lines, s.errors, sum_record_cb, &s);
+    return s;
+}
+
+/* The hand-written parse_line over the same buffer, for reference. */
+static ParseSums sums_parse_line(const char *buf, size_t len) {
+    ParseSums s = {0};
+    const char *p = buf, *end = buf + len;
+    char ip[48];
+    int status;
+    double rtime;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        s.lines++;
+        if (parse_line(p, ip, &status, &rtime) == 0) {
+            s.status_sum += status;
+            s.ip_bytes += (long)strlen(ip);
+            s.lat_sum += rtime;
+        } else {
+            s.errors++;
+        }
+        p = eol + 1;
+    }
+    return s;
+}
+
+static int same_sums(const ParseSums *a, const ParseSums *b) {
+    return a->lines == b->lines && a->errors == b->errors &&
+           a->status_sum == b->status_sum && a->ip_bytes == b->ip_bytes &&
+           a->lat_sum == b->lat_sum;
+}
+
+/*
+ * The JSON-lines file of bench-formats with broken lines spliced in: an
+ * unbalanced quote at the top and a truncated line in the middle.  Each
+ * must cost one parse error and leave every other line's fields intact.
+ */
+static int bench_jsonl_broken(const ParseSums *ref) {
+    static const char unbalanced[] = "{\"client_ip\":\"10.9.9.9,\"status\":200,\"latency_ms\":1.0}\n";
+    static const char truncated[]  = "{\"client_ip\":\"10.9.9.9\",\"status\":2\n";
+    char path[64];
+    size_t len;
+    snprintf(path, sizeof(path), "/tmp/bench.%s.log", format_names[FMT_JSONL]);
+    char *src = load_file(path, &len);
+
+    const char *mid = memchr(src + len / 2, '\n', len - len / 2);
+    size_t head = mid ? (size_t)(mid - src) + 1 : len;
+    size_t blen = len + sizeof(unbalanced) - 1 + sizeof(truncated) - 1, off = 0;
+    char *buf = malloc(blen);
+    memcpy(buf + off, unbalanced, sizeof(unbalanced) - 1); off += sizeof(unbalanced) - 1;
+    memcpy(buf + off, src, head);                           off += head;
+    memcpy(buf + off, truncated, sizeof(truncated) - 1);    off += sizeof(truncated) - 1;
+    memcpy(buf + off, src + head, len - head);
+
+    ParseSums s = sums_formatted(buf, blen, FMT_JSONL), want = *ref;
+    want.lines += 2;
+    want.errors += 2;
+    int match = same_sums(&s, &want);
+    printf("%-22s %10zu %10s %9s %9s  %s (%ld errors)\n", "parse_fmt jsonl+broken", blen,
+           "", "", "", match ? "PASS" : "FAIL", s.errors);
+    free(buf);
+    free(src);
+    return match;
+}
+
+/*
+ * Parse-only throughput of every specialized format parser against the
+ * hand-written Apache parse_line.  All formats are generated from the
+ * same random stream, so their field sums must agree exactly.
+ */
+static int cmd_bench_formats(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    const int reps = 10;
+    char path[64];
+
+    printf("Benchmark: specialized format parsers (%d lines, %d reps)\n\n",
+           num_lines, reps);
+    printf("%-22s %10s %10s %9s %9s  %s\n",
+           "parser", "bytes", "ns/line", "GB/s", "vs hand", "check");
+
+    ParseSums ref = {0};
+    double ref_ns = 0;
+    int ok = 1;
+
+    for (int fmt = -1; fmt < FMT_COUNT; fmt++) {
+        int gen_fmt = fmt < 0 ? FMT_APACHE : fmt;
+        snprintf(path, sizeof(path), "/tmp/bench.%s.log", format_names[gen_fmt]);
+        if (fmt != FMT_APACHE)  /* parse_line's apache file is reused */
+            generate_log(path, num_lines, gen_fmt);
+
+        size_t len;
+        char *buf = load_file(path, &len);
+        ParseSums s = fmt < 0 ? sums_parse_line(buf, len) : sums_formatted(buf, len, fmt);
+
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < reps; r++) {
+            ParseSums t = fmt < 0 ? sums_parse_line(buf, len) : sums_formatted(buf, len, fmt);
+            __asm__ volatile("" :: "r"(t.status_sum));
+        }
+        double sec = elapsed_since(&t0);
+        double ns_line = sec * 1e9 / ((double)reps * s.lines);
+
+        int match = 1;
+        if (fmt < 0) { ref = s; ref_ns = ns_line; }
+        else         { match = same_sums(&s, &ref); ok &= match; }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s %s", fmt < 0 ? "parse_line" : "parse_fmt",
+                 format_names[gen_fmt]);
+        printf("%-22s %10zu %10.1f %9.2f %8.2fx  %s\n", name, len, ns_line,
+               (double)len * reps / sec / 1e9, ref_ns / ns_line,
+               fmt < 0 ? "ref" : match ? "PASS" : "FAIL");
+        free(buf);
+    }
+    ok &= bench_jsonl_broken(&ref);
+    return ok ? 0 : 1;
+}
+
+/* ── bench-swar ── */
+
+/* A hardware counter (PERF_COUNT_HW_*) of this thread, if the PMU is available (else fd -1). */
+static int hw_counter_open(uint64_t config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = config;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static uint64_t hw_counter_read(int fd) {
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != sizeof(v)) return 0;
+    return v;
+}
+
+/* Status and size as parse_line reads them: atoi, then the skip loops. */
+static long fields_atoi(const char *const *at, size_t n) {
+    long sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        const char *p = at[i];
+        int status = atoi(p);
+        while (*p && *p != ' ') p++;
+        while (*p == ' ') p++;
+        long size = atol(p);
+        while (*p && *p != ' ') p++;
+        sum += status + size + (p - at[i]);
+    }
+    return sum;
+}
+
+/* The format parsers' former steps: scan for the delimiter, then convert. */
+static long fields_scan(const char *const *at, size_t n, const char *end) {
+    long sum = 0;
+    LogRecord r;
+    for (size_t i = 0; i < n; i++) {
+        const char *p = lf_field_STATUS_SCAN(&r, at[i], end, ' ');
+        if (p) p = lf_field_SIZE_SCAN(&r, p + 1, end, ' ');
+        if (p) sum += r.status + r.size + (p - at[i]);
+    }
+    return sum;
+}
+
+static long fields_swar(const char *const *at, size_t n, const char *end) {
+    long sum = 0;
+    LogRecord r;
+    for (size_t i = 0; i < n; i++) {
+        const char *p = lf_field_STATUS(&r, at[i], end, ' ');
+        if (p) p = lf_field_SIZE(&r, p + 1, end, ' ');
+        if (p) sum += r.status + r.size + (p - at[i]);
+    }
+    return sum;
+}
+
+/*
+ * Exhaustive check of swar_status() against the scalar step: every
+ * 3-digit code with each delimiter, every code with one byte (all 256
+ * values) replaced, and 2- and 4-digit fields.  Returns mismatches.
+ */
+static long swar_check_status(long *cases) {
+    static const char delims[] = { ' ', '\t', ',', '"' };
+    char buf[16];
+    LogRecord r;
+    long bad = 0;
+    *cases = 0;
+    for (int code = 0; code < 1000; code++) {
+        for (size_t d = 0; d < sizeof(delims); d++) {
+            for (int pos = -1; pos < 4; pos++) {
+                for (int b = 0; b < (pos < 0 ? 1 : 256); b++) {
+                    memset(buf, 'x', sizeof(buf));
+                    snprintf(buf, sizeof(buf), "%03d%c1234 5", code, delims[d]);
+                    if (pos >= 0) buf[pos] = (char)b;
+                    const char *end = buf + 12;
+                    const char *e = lf_field_STATUS_SCAN(&r, buf, end, delims[d]);
+                    int want = e ? r.status : -1;
+                    bad += swar_status(buf, delims[d]) != want;
+                    ++*cases;
+                }
             }
-            IPEntry *e = find_or_insert(ip);
-            if (e) { e->count++; e->total_time += rtime; }
-            status_counts[status]++;
-            add_latency(rtime);
         }
-        fclose(f);
     }
+    for (int code = 0; code < 10000; code++) {
+        snprintf(buf, sizeof(buf), code < 100 ? "%02d 12345 6" : "%04d 1234 5", code);
+        const char *e = lf_field_STATUS_SCAN(&r, buf, buf + 11, ' ');
+        bad += swar_status(buf, ' ') != (e ? r.status : -1);
+        ++*cases;
+    }
+    return bad;
+}
+
+/*
+ * Sizes: every value below 10^7, a million spread over 8 to 12 digits,
+ * and every byte value after each digit prefix, against
+ * lf_field_SIZE_SCAN.
+ */
+static long swar_check_size(long *cases) {
+    char buf[32];
+    LogRecord r = {0}, s = {0};
+    long bad = 0;
+    *cases = 0;
+    for (long v = 0; v < 11000000; v++) {
+        long x = v < 10000000 ? v : (v - 10000000) * 104729L;
+        int len = snprintf(buf, sizeof(buf), "%ld 1.5           ", x);
+        const char *end = buf + len;
+        const char *a = lf_field_SIZE(&r, buf, end, ' ');
+        const char *b = lf_field_SIZE_SCAN(&s, buf, end, ' ');
+        bad += a != b || r.size != s.size || r.size != x;
+        ++*cases;
+    }
+    for (int digits = 0; digits <= 9; digits++) {
+        for (int b = 0; b < 256; b++) {
+            memcpy(buf, "987654321 1.5           ", 25);
+            buf[digits] = (char)b;
+            const char *end = buf + 24;
+            r.size = s.size = -1;
+            const char *x = lf_field_SIZE(&r, buf, end, ' ');
+            const char *y = lf_field_SIZE_SCAN(&s, buf, end, ' ');
+            bad += x != y || r.size != s.size;
+            ++*cases;
+        }
+    }
+    return bad;
+}
 
-    /* Sort latencies for percentiles */
-    qsort(latencies, lat_count, sizeof(double), cmp_double);
+/*
+ * Status and size fields three ways over a generated Apache log:
+ * parse_line's atoi + skip loops, the scan-then-convert steps and the
+ * SWAR steps, with branch misses per line where the PMU allows.  The
+ * SWAR steps are first checked exhaustively against the scalar ones.
+ */
+static int cmd_bench_swar(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    const int reps = 20;
+    const char *path = "/tmp/bench.apache.log";
 
-    clock_gettime(CLOCK_MONOTONIC, &t1);
-    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("Benchmark: SWAR status/size parsing (%d lines, %d reps)\n\n", num_lines, reps);
+#ifndef SWAR_INT
+    printf("(big-endian target: SWAR steps fall back to the scan)\n\n");
+#endif
+    long cases, bad_status = swar_check_status(&cases);
+    printf("status check: %ld cases, %ld mismatches  %s\n", cases, bad_status,
+           bad_status ? "FAIL" : "PASS");
+    long bad_size = swar_check_size(&cases);
+    printf("size check:   %ld cases, %ld mismatches  %s\n\n", cases, bad_size,
+           bad_size ? "FAIL" : "PASS");
 
-    /* ── Output ── */
-    printf("\n=== Log Analysis Results ===\n");
-    printf("Lines processed: %d\n", total_lines);
-    printf("Parse errors:    %d\n", parse_errors);
-    printf("Unique IPs:      %d\n", ip_table_size);
-    printf("Analysis time:   %.3f s  (%.0f lines/sec)\n\n",
-           elapsed, total_lines / elapsed);
+    generate_log(path, num_lines, FMT_APACHE);
+    size_t len;
+    char *buf = load_file(path, &len);
+    const char **at = malloc(num_lines * sizeof(char *));
+    size_t n = 0;
+    for (const char *p = buf, *end = buf + len; p < end && n < (size_t)num_lines;) {
+        const char *eol = scan_byte(p, end, '\n');
+        const char *q = memchr(p, '"', (size_t)(eol - p));
+        if (q) q = memchr(q + 1, '"', (size_t)(eol - q - 1));
+        if (q) at[n++] = q + 2;
+        p = eol + 1;
+    }
 
-    printf("Status Distribution:\n");
-    for (int s = 100; s < 600; s++)
-        if (status_counts[s] > 0)
-            printf("  %d: %7d  (%5.1f%%)\n", s, status_counts[s],
-                   100.0 * status_counts[s] / total_lines);
+    int fd = hw_counter_open(PERF_COUNT_HW_BRANCH_MISSES);
+    printf("%-18s %10s %12s %9s  %s\n", "fields", "ns/line", "br-miss/line", "vs atoi", "check");
+    static const char *const names[] = { "atoi + skip", "scan + loop", "swar" };
+    long ref = 0;
+    double ref_ns = 0;
+    int ok = !bad_status && !bad_size;
+    for (int v = 0; v < 3; v++) {
+        long sum = 0;
+        struct timespec t0;
+        uint64_t m0 = hw_counter_read(fd);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < reps; r++) {
+            sum = v == 0 ? fields_atoi(at, n) : v == 1 ? fields_scan(at, n, buf + len)
+                                                       : fields_swar(at, n, buf + len);
+            __asm__ volatile("" :: "r"(sum));
+        }
+        double ns = elapsed_since(&t0) * 1e9 / ((double)reps * n);
+        double miss = (double)(hw_counter_read(fd) - m0) / ((double)reps * n);
+        if (v == 0) { ref = sum; ref_ns = ns; }
+        int match = sum == ref;
+        ok &= match;
+        char miss_s[16] = "n/a";
+        if (fd >= 0) snprintf(miss_s, sizeof(miss_s), "%.3f", miss);
+        printf("%-18s %10.2f %12s %8.2fx  %s\n", names[v], ns, miss_s, ref_ns / ns,
+               v == 0 ? "ref" : match ? "PASS" : "FAIL");
+    }
+    if (fd < 0) printf("\n(branch-miss counter unavailable: %s)\n", strerror(errno));
+    else close(fd);
+    free(at);
+    free(buf);
+    return ok ? 0 : 1;
+}
 
-    printf("\nLatency Percentiles:\n");
-    printf("  p50: %.1f ms\n", latencies[lat_count * 50 / 100]);
-    printf("  p95: %.1f ms\n", latencies[lat_count * 95 / 100]);
-    printf("  p99: %.1f ms\n", latencies[lat_count * 99 / 100]);
+/* ── bench-hist ── */
 
-    qsort(ip_table, HASH_SIZE, sizeof(IPEntry), cmp_ip_count);
-    printf("\nTop 10 IPs:\n");
-    for (int i = 0; i < 10 && ip_table[i].count > 0; i++)
-        printf("  %-20s %7d reqs  avg %.1f ms\n",
-               ip_table[i].ip, ip_table[i].count,
-               ip_table[i].total_time / ip_table[i].count);
+/* Cycles from the PMU when open, else the TSC on x86-64, else 0. */
+static uint64_t hist_cycles(int fd) {
+    if (fd >= 0) return hw_counter_read(fd);
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    int   *status, *method;
+    size_t n;
+} HistStream;
+
+static void hist_stream_cb(const LogRecord *r, void *ctx) {
+    HistStream *s = ctx;
+    s->status[s->n] = r->status;
+    s->method[s->n++] = hist_method_bin(r->method, r->method_len, r->status);
+}
+
+/* Counts bins[0..n) reps times into a fresh Hist of 1 << shift copies. */
+static double hist_time(const int *bins, size_t n, int nbins, int shift, int reps, int fd,
+                        double *cyc, int *out) {
+    Hist h;
+    hist_init(&h, nbins, shift);
+    struct timespec t0;
+    uint64_t c0 = hist_cycles(fd);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < reps; r++)
+        for (size_t i = 0; i < n; i++) hist_add(&h, bins[i], (unsigned)i);
+    double ns = elapsed_since(&t0) * 1e9 / ((double)reps * n);
+    *cyc = (double)(hist_cycles(fd) - c0) / ((double)reps * n);
+    memset(out, 0, nbins * sizeof(int));
+    hist_drain(&h, out);
+    hist_free(&h);
+    return ns;
+}
+
+/*
+ * Interleaved sub-histograms against a single counter per bin: the bare
+ * update loop over pre-parsed status and method × class streams with
+ * k = 1, 2, 4, 8 copies, on the generated mix and on more skewed ones,
+ * then the whole analyze_formatted pass with k = 1 and the default.
+ * Every k must give the same counts as k = 1.
+ */
+static int cmd_bench_hist(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    const int reps = 20;
+    const char *path = "/tmp/bench.apache.log";
+
+    printf("Benchmark: interleaved histograms (%d lines, %d reps)\n\n", num_lines, reps);
+    generate_log(path, num_lines, FMT_APACHE);
+    size_t len;
+    char *buf = load_file(path, &len);
+    HistStream gen = { malloc(num_lines * sizeof(int)), malloc(num_lines * sizeof(int)), 0 };
+    long lines = 0, errors = 0;
+    FOR_EACH_RECORD(parse_fmt_apache, buf, len, lines, errors, r, hist_stream_cb(&r, &gen));
+    size_t n = gen.n;
+
+    /* 70% 200, else one of a few codes; then every line 200. */
+    int *skew = malloc(n * sizeof(int)), *flat = malloc(n * sizeof(int));
+    static const int other[] = { 201, 301, 304, 404, 500, 503 };
+    uint64_t x = 88172645463325252ULL;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        skew[i] = x % 100 < 70 ? 200 : other[(x >> 8) % 6];
+        flat[i] = 200;
+    }
+    static const struct { const char *name; int bins; } kinds[] = {
+        { "status, generated", 600 }, { "status, 70% 200", 600 }, { "status, all 200", 600 },
+        { "method x class", HIST_METHODS * HIST_CLASSES },
+    };
+    const int *streams[] = { gen.status, skew, flat, gen.method };
+
+    int fd = hw_counter_open(PERF_COUNT_HW_CPU_CYCLES);
+#if defined(__x86_64__)
+    const char *unit = fd >= 0 ? "cyc/line" : "TSC/line";
+#else
+    const char *unit = fd >= 0 ? "cyc/line" : "";
+#endif
+    printf("%-20s %3s %9s %9s %8s  %s\n", "stream", "k", "ns/line", unit, "vs k=1", "check");
+    int ok = 1;
+    int *ref = malloc(600 * sizeof(int)), *got = malloc(600 * sizeof(int));
+    for (size_t s = 0; s < sizeof(kinds) / sizeof(kinds[0]); s++) {
+        double ref_ns = 0, cyc;
+        for (int shift = 0; shift <= 3; shift++) {
+            double ns = hist_time(streams[s], n, kinds[s].bins, shift, reps, fd, &cyc,
+                                  shift ? got : ref);
+            if (shift == 0) ref_ns = ns;
+            int match = shift == 0 || memcmp(ref, got, kinds[s].bins * sizeof(int)) == 0;
+            ok &= match;
+            char cyc_s[16] = "n/a";
+            if (*unit) snprintf(cyc_s, sizeof(cyc_s), "%.2f", cyc);
+            printf("%-20s %3d %9.3f %9s %7.2fx  %s\n", shift ? "" : kinds[s].name, 1 << shift,
+                   ns, cyc_s, ref_ns / ns, shift == 0 ? "ref" : match ? "PASS" : "FAIL");
+        }
+    }
+
+    /* The full formatted pass: parsing dwarfs the counter, so expect little. */
+    printf("\n%-20s %3s %9s %9s %8s  %s\n", "analyze_formatted", "k", "ns/line", unit, "vs k=1",
+           "check");
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+    int shifts[2] = { 0, HIST_SHIFT };
+    double ref_ns = 0;
+    for (int v = 0; v < 2; v++) {
+        hist_free(&status_hist);
+        hist_init(&status_hist, 600, shifts[v]);
+        double ns = 0, cyc = 0;
+        for (int r = -1; r < 5; r++) {     /* one untimed warm-up pass */
+            reset_state();
+            struct timespec t0;
+            uint64_t c0 = hist_cycles(fd);
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            analyze_formatted(buf, len, FMT_APACHE);
+            if (r < 0) continue;
+            ns += elapsed_since(&t0) * 1e9 / (5.0 * total_lines);
+            cyc += (double)(hist_cycles(fd) - c0) / (5.0 * total_lines);
+        }
+        if (v == 0) { ref_ns = ns; memcpy(ref, status_counts, 600 * sizeof(int)); }
+        int match = v == 0 || memcmp(ref, status_counts, 600 * sizeof(int)) == 0;
+        ok &= match;
+        char cyc_s[16] = "n/a";
+        if (*unit) snprintf(cyc_s, sizeof(cyc_s), "%.1f", cyc);
+        printf("%-20s %3d %9.1f %9s %7.2fx  %s\n", "", 1 << shifts[v], ns, cyc_s, ref_ns / ns,
+               v == 0 ? "ref" : match ? "PASS" : "FAIL");
+    }
+    if (fd < 0) printf("\n(cycle counter unavailable: %s)\n", strerror(errno));
+    else close(fd);
+
+    hist_free(&status_hist);
+    free(latencies);
+    free(ref);
+    free(got);
+    free(skew);
+    free(flat);
+    free(gen.status);
+    free(gen.method);
+    free(buf);
+    return ok ? 0 : 1;
+}
+
+/* Lines in buf, counted with libc memchr — the floor for any parser. */
+static long count_lines_memchr(const char *buf, size_t len) {
+    long n = 0;
+    const char *p = buf, *end = buf + len;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        n++;
+        if (!eol) break;
+        p = eol + 1;
+    }
+    return n;
+}
+
+/*
+ * Lazy query parsing against a full parse and a bare memchr line count
+ * on the same Apache log.  The delimiter chain up to the last touched
+ * field is still walked, so even a status-only query costs about twice
+ * the memchr floor here; latency queries jump to the line end.
+ */
+static int cmd_bench_query(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    const int reps = 10;
+    const char *path = "/tmp/bench.apache.log";
+    static const struct { const char *name, *select, *where[2]; } cases[] = {
+        { "full projection",        "ip,status,latency", { NULL, NULL } },
+        { "status only",            "status",            { NULL, NULL } },
+        { "status>=500",            "status",            { "status>=500", NULL } },
+        { "status>=500 path^=/api/","status",            { "status>=500", "path^=/api/" } },
+        { "latency>1000 (ip)",      "ip",                { "latency>1000", NULL } },
+        { "ip,status",              "ip,status",         { NULL, NULL } },
+        { "latency>50 latency>500", "status",            { "latency>50", "latency>500" } },
+    };
+
+    generate_log(path, num_lines, FMT_APACHE);
+    size_t len;
+    char *buf = load_file(path, &len);
+
+    printf("Benchmark: projection/predicate pushdown (%d lines, %d reps)\n\n",
+           num_lines, reps);
+    printf("%-26s %10s %9s %10s %9s %9s  %s\n", "query", "ns/line", "GB/s", "matched",
+           "vs memchr", "vs eager", "check");
+
+    struct timespec t0;
+    long n = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < reps; r++) {
+        n = count_lines_memchr(buf, len);
+        __asm__ volatile("" :: "r"(n));
+    }
+    double memchr_ns = elapsed_since(&t0) * 1e9 / ((double)reps * n);
+    printf("%-26s %10.1f %9.2f %10ld %8.2fx\n", "memchr line count", memchr_ns,
+           len / memchr_ns / n, n, 1.0);
+
+    ParseSums full = {0};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < reps; r++) {
+        full = sums_formatted(buf, len, FMT_APACHE);
+        __asm__ volatile("" :: "r"(full.status_sum));
+    }
+    double full_ns = elapsed_since(&t0) * 1e9 / ((double)reps * full.lines);
+    printf("%-26s %10.1f %9.2f %10ld %8.2fx %8.2fx  %s\n", "parse_fmt apache (eager)", full_ns,
+           len / full_ns / full.lines, full.lines - full.errors, full_ns / memchr_ns, 1.0, "ref");
+    int ok = 1;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        Query q;
+        query_init(&q);
+        query_select(&q, cases[c].select);
+        for (int w = 0; w < 2 && cases[c].where[w]; w++) query_where(&q, cases[c].where[w]);
+
+        long lines = 0, errors = 0, filtered = 0, matched = 0;
+        double lat = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < reps; r++) {
+            lines = errors = filtered = matched = 0;
+            lat = 0;
+            FOR_EACH_QUERY_RECORD(apache, &q, buf, len, lines, errors, filtered,
+                                  rec, (matched++, lat += rec.latency_ms));
+            __asm__ volatile("" :: "r"(matched));
+        }
+        double ns = elapsed_since(&t0) * 1e9 / ((double)reps * lines);
+
+        /* The same query on eagerly parsed records must match the same
+         * lines, and read the same latencies where it reads any. */
+        long want = 0, el = 0, ee = 0;
+        double want_lat = 0;
+        FOR_EACH_RECORD(parse_fmt_apache, buf, len, el, ee, rec,
+                        if (query_accepts(&q, &rec)) { want++; want_lat += rec.latency_ms; });
+        if (!(q.touch & QF_LATENCY)) want_lat = lat;
+        int match = matched == want && lat == want_lat;
+        ok &= match;
+        printf("%-26s %10.1f %9.2f %10ld %8.2fx %8.2fx  %s\n", cases[c].name, ns, len / ns / lines,
+               matched, ns / memchr_ns, ns / full_ns, match ? "PASS" : "FAIL");
+    }
+    free(buf);
+    return ok ? 0 : 1;
+}
+
+/* ── bench-agg ── */
+
+typedef struct {
+    const uint64_t *keys, *lat;
+    size_t          n;
+    int             backend, lane;
+    AggTable       *shared, local;
+} AggBenchWorker;
+
+static void *agg_bench_run(void *arg) {
+    AggBenchWorker *w = arg;
+    if (w->backend == AGG_LOCAL)
+        for (size_t i = 0; i < w->n; i++) agg_local_add(&w->local, agg_key_word(w->keys[i]), 1, w->lat[i]);
+    else
+        for (size_t i = 0; i < w->n; i++) agg_shared_add(w->shared, agg_key_word(w->keys[i]), w->lat[i], w->lane);
+    return NULL;
+}
+
+/* Order-independent digest of a finished table. */
+static uint64_t agg_digest(const AggTable *t) {
+    uint64_t d = 0;
+    for (size_t i = 0; i <= t->mask; i++)
+        if (t->slots[i].key)
+            d += agg_hash(t->slots[i].key ^ agg_hash(t->slots[i].count) ^ (t->slots[i].lat_us << 1));
+    return d;
+}
+
+/* n keys drawn Zipf(s) over `distinct` ranks, ranks scattered over IPv4. */
+static void zipf_keys(uint64_t *keys, uint64_t *lat, size_t n, size_t distinct, double s) {
+    double *cdf = malloc(distinct * sizeof(double));
+    double sum = 0;
+    for (size_t k = 0; k < distinct; k++) cdf[k] = sum += pow((double)(k + 1), -s);
+    uint64_t x = 88172645463325252ULL;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        double u = (double)(x >> 11) / 9007199254740992.0 * sum;
+        size_t lo = 0, hi = distinct - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (cdf[mid] < u) lo = mid + 1; else hi = mid;
+        }
+        keys[i] = agg_key_ipv4((uint32_t)(lo * 2654435761u));
+        lat[i] = (x >> 20) % 100000;
+    }
+    free(cdf);
+}
+
+/*
+ * Per-thread tables + merge against the shared CAS table (with and
+ * without hot-key splitting) across thread counts and key skews.
+ */
+static int cmd_bench_agg(int argc, char **argv) {
+    size_t n = argc > 0 ? (size_t)atol(argv[0]) : 10000000;
+    size_t distinct = argc > 1 ? (size_t)atol(argv[1]) : 262144;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    const double skews[] = { 0.0, 0.8, 1.1 };
+    uint64_t *keys = malloc(n * sizeof(uint64_t));
+    uint64_t *lat = malloc(n * sizeof(uint64_t));
+    int ok = 1;
+
+    printf("Benchmark: parallel IP aggregation (%zu updates, %zu distinct keys)\n", n, distinct);
+#if defined(__aarch64__)
+#if defined(__ARM_FEATURE_ATOMICS)
+    printf("Atomics: inline ARMv8.1 LSE (CAS/LDADD)\n");
+#else
+    printf("Atomics: LL/SC or outline-atomics (build with -march=armv8.1-a for inline LSE)\n");
+#endif
+#endif
+    printf("\n%5s %7s %-7s %10s %10s %10s %9s  %s\n",
+           "skew", "threads", "backend", "Mupd/s", "merge ms", "table MB", "speedup", "check");
+
+    for (size_t si = 0; si < sizeof(skews) / sizeof(skews[0]); si++) {
+        zipf_keys(keys, lat, n, distinct, skews[si]);
+
+        AggTable ref;
+        agg_init(&ref, distinct * 2);
+        for (size_t i = 0; i < n; i++) agg_local_add(&ref, agg_key_word(keys[i]), 1, lat[i]);
+        uint64_t ref_digest = agg_digest(&ref);
+        agg_free(&ref);
+
+        double base_rate = 0;
+        for (int t = 1; t <= max_threads; t *= 2) {
+            for (int b = 0; b < AGG_BACKENDS; b++) {
+                AggBenchWorker *w = calloc(t, sizeof(AggBenchWorker));
+                AggTable shared, merged;
+                size_t bytes = 0;
+                if (b != AGG_LOCAL) {
+                    agg_init(&shared, distinct * 2);
+                    if (b == AGG_SPLIT) {
+                        size_t ns = n < 65536 ? n : 65536;
+                        AggKey *sample = malloc(ns * sizeof(AggKey));
+                        for (size_t i = 0; i < ns; i++) sample[i] = agg_key_word(keys[i]);
+                        agg_split_hot(&shared, sample, ns, AGG_HOT_KEYS);
+                        free(sample);
+                    }
+                    bytes = agg_bytes(&shared);
+                }
+                for (int i = 0; i < t; i++) {
+                    w[i].keys = keys + n * i / t;
+                    w[i].lat = lat + n * i / t;
+                    w[i].n = n * (i + 1) / t - n * i / t;
+                    w[i].backend = b;
+                    w[i].lane = i;
+                    w[i].shared = &shared;
+                    if (b == AGG_LOCAL) {
+                        agg_init(&w[i].local, distinct * 2);
+                        bytes += agg_bytes(&w[i].local);
+                    }
+                }
+
+                struct timespec t0;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                agg_run_threads(t, agg_bench_run, w, sizeof(AggBenchWorker));
+                double run = elapsed_since(&t0);
+
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                AggTable *result = &shared;
+                if (b == AGG_LOCAL) {
+                    agg_init(&merged, distinct * 2);
+                    bytes += agg_bytes(&merged);
+                    for (int i = 0; i < t; i++) {
+                        agg_merge_into(&merged, &w[i].local);
+                        agg_free(&w[i].local);
+                    }
+                    result = &merged;
+                } else {
+                    agg_fold_hot(&shared);
+                }
+                double merge = elapsed_since(&t0);
+
+                double rate = n / (run + merge) / 1e6;
+                if (t == 1 && b == AGG_LOCAL) base_rate = rate;
+                int match = agg_digest(result) == ref_digest && !result->dropped;
+                ok &= match;
+                printf("%5.2f %7d %-7s %10.1f %10.2f %10.1f %8.2fx  %s\n",
+                       skews[si], t, agg_names[b], rate, merge * 1e3, bytes / 1048576.0,
+                       rate / base_rate, match ? "PASS" : "FAIL");
+                agg_free(result);
+                free(w);
+            }
+        }
+    }
+    free(keys);
+    free(lat);
+    return ok ? 0 : 1;
+}
+
+/* ── bench-routes ── */
+
+/*
+ * Path → route normalization on top of the Apache parser, against the
+ * parser alone.  Also checks the segment classifier on fixed cases.
+ */
+static int cmd_bench_routes(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    const int reps = 10;
+    const char *path = "/tmp/bench.apache.log";
+    static const struct { const char *path, *route; } cases[] = {
+        { "/api/users/42",                                     "/api/users/:id" },
+        { "/api/users/42?expand=1",                            "/api/users/:id" },
+        { "/api/users/me",                                     "/api/users/me" },
+        { "/api/orders/123e4567-e89b-12d3-a456-426614174000/items", "/api/orders/:uuid/items" },
+        { "/api/products/5f1d7a9c0b2e4d3a1c8b7e6f",            "/api/products/:hex" },
+        { "/api/products/deadbeef",                            "/api/products/deadbeef" },
+        { "/static/js/app.js",                                 "/static/*" },
+        { "/",                                                 "/" },
+        /* Literals agreeing on their first 24 bytes, and an ID-looking
+         * literal next to IDs of its shape. */
+        { "/api/reports/quarterly-summary-2024-q1",            "/api/reports/quarterly-summary-2024-q1" },
+        { "/api/reports/quarterly-summary-2024-q2",            "/api/reports/quarterly-summary-2024-q2" },
+        { "/api/reports/2024",                                 "/api/reports/2024" },
+        { "/api/reports/2025",                                 "/api/reports/:id" },
+        { "/api/reports/2024",                                 "/api/reports/2024" },
+        { "/api/reports/2026",                                 "/api/reports/:id" },
+    };
+    int ok = 1;
+
+    RouteTrie t;
+    route_init(&t);
+    route_add_list(&t, "/api/users/me,/static/*,/api/reports/2024,/api/reports/quarterly-summary-2024-q1");
+    printf("Benchmark: route normalization (%d lines, %d reps)\n\n", num_lines, reps);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const char *got = t.routes[route_match(&t, cases[c].path, (int)strlen(cases[c].path))].tmpl;
+        int pass = strcmp(got, cases[c].route) == 0;
+        ok &= pass;
+        if (!pass) printf("  %s -> %s, want %s\n", cases[c].path, got, cases[c].route);
+    }
+    printf("Segment classifier: %s\n\n", ok ? "PASS" : "FAIL");
+    route_free(&t);
+
+    gen_id_paths = 1;
+    generate_log(path, num_lines, FMT_APACHE);
+    size_t len;
+    char *buf = load_file(path, &len);
+    struct timespec t0;
+
+    /* Best of reps: the two loops differ by a few ns/line, below run-to-run noise. */
+    ParseSums base = {0};
+    double base_ns = 1e30, route_ns = 1e30;
+    route_init(&t);
+    long lines = 0, errors = 0, id_sum = 0;
+    for (int r = 0; r < reps; r++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        base = sums_formatted(buf, len, FMT_APACHE);
+        __asm__ volatile("" :: "r"(base.status_sum));
+        double ns = elapsed_since(&t0) * 1e9 / base.lines;
+        if (ns < base_ns) base_ns = ns;
+
+        lines = errors = id_sum = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        FOR_EACH_RECORD(parse_fmt_apache, buf, len, lines, errors, rec,
+                        id_sum += route_match(&t, rec.path, rec.path_len));
+        __asm__ volatile("" :: "r"(id_sum));
+        ns = elapsed_since(&t0) * 1e9 / lines;
+        if (ns < route_ns) route_ns = ns;
+    }
+    double overhead = (route_ns / base_ns - 1) * 100;
+
+    printf("%-28s %10s %9s\n", "", "ns/line", "GB/s");
+    printf("%-28s %10.1f %9.2f\n", "parse_fmt apache", base_ns, len / base_ns / base.lines);
+    printf("%-28s %10.1f %9.2f\n", "  + route_match", route_ns, len / route_ns / lines);
+    printf("\nOverhead: %+.1f%% (target <= 10%%): %s, %d routes learned\n", overhead,
+           overhead <= 10 ? "PASS" : "FAIL", t.n_learned);
+    route_free(&t);
+    free(buf);
+    return ok && overhead <= 10 ? 0 : 1;
+}
+
+/* ── bench-quantiles ── */
+
+static void swap_double(double *a, double *b) {
+    double t = *a;
+    *a = *b;
+    *b = t;
+}
+
+/*
+ * k-th smallest of a[0..n), partially reordering a around it like
+ * std::nth_element: quickselect with median-of-three Hoare partitions
+ * and insertion sort on short ranges (no introselect fallback).
+ */
+static double nth_element_double(double *a, size_t n, size_t k) {
+    size_t lo = 0, hi = n - 1;
+    while (hi - lo > 16) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < a[lo]) swap_double(&a[mid], &a[lo]);
+        if (a[hi] < a[lo])  swap_double(&a[hi], &a[lo]);
+        if (a[hi] < a[mid]) swap_double(&a[hi], &a[mid]);
+        double pivot = a[mid];
+        size_t i = lo, j = hi;
+        for (;;) {
+            while (a[i] < pivot) i++;
+            while (pivot < a[j]) j--;
+            if (i >= j) break;
+            swap_double(&a[i++], &a[j--]);
+        }
+        if (k <= j) hi = j;
+        else        lo = j + 1;
+    }
+    for (size_t i = lo + 1; i <= hi; i++)
+        for (size_t j = i; j > lo && a[j] < a[j - 1]; j--) swap_double(&a[j], &a[j - 1]);
+    return a[k];
+}
+
+/* Latencies shaped like generate_log(), or distinct random doubles. */
+static void fill_samples(double *v, size_t n, int distinct) {
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        if (distinct) {
+            v[i] = (double)(x >> 11) / 9007199254740992.0 * 1000.0;
+        } else {
+            v[i] = 0.5 + (x % 1000) * 0.1;
+            if ((x >> 20) % 20 == 0)  v[i] += 500.0;
+            if ((x >> 30) % 100 == 0) v[i] += 5000.0;
+        }
+    }
+}
+
+/*
+ * Exact p50/p95/p99 three ways: full qsort, three nth_element calls on
+ * shrinking ranges, and radix select on 1 and N threads.
+ */
+static int cmd_bench_quantiles(int argc, char **argv) {
+    size_t n = argc > 0 ? (size_t)atoll(argv[0]) : 10000000;
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int run_qsort = n <= 200000000;    /* minutes beyond that */
+    const size_t rank[3] = { n * 50 / 100, n * 95 / 100, n * 99 / 100 };
+    double *v = malloc(n * sizeof(double)), *w = malloc(n * sizeof(double));
+    int ok = 1;
+    if (!v || !w) {
+        fprintf(stderr, "bench-quantiles: cannot allocate 2 x %zu doubles\n", n);
+        return 1;
+    }
+
+    printf("Benchmark: exact p50/p95/p99 of %zu samples\n", n);
+    for (int distinct = 0; distinct <= 1; distinct++) {
+        double ref[3], got[3];
+        struct timespec t0;
+        fill_samples(v, n, distinct);
+        printf("\n%s samples\n", distinct ? "distinct random" : "log-shaped (many duplicates)");
+        printf("  %-22s %10s %10s  %s\n", "method", "ms", "ns/sample", "check");
+
+        memcpy(w, v, n * sizeof(double));
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        double e;
+        size_t from = 0;
+        for (int i = 0; i < 3; i++) {       /* ranks ascending: keep narrowing */
+            ref[i] = nth_element_double(w + from, n - from, rank[i] - from);
+            from = rank[i];
+        }
+        e = elapsed_since(&t0);
+        printf("  %-22s %10.1f %10.2f  ref\n", "nth_element x3", e * 1e3, e * 1e9 / n);
+
+        if (run_qsort) {
+            memcpy(w, v, n * sizeof(double));
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            qsort(w, n, sizeof(double), cmp_double);
+            e = elapsed_since(&t0);
+            int match = w[rank[0]] == ref[0] && w[rank[1]] == ref[1] && w[rank[2]] == ref[2];
+            ok &= match;
+            printf("  %-22s %10.1f %10.2f  %s\n", "qsort", e * 1e3, e * 1e9 / n,
+                   match ? "PASS" : "FAIL");
+        }
+
+        for (int t = 1;; t = t * 2 < threads ? t * 2 : threads) {
+            char name[32];
+            snprintf(name, sizeof(name), "radix select, %d thr", t);
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            quantiles_exact(v, n, rank, 3, got, t);
+            e = elapsed_since(&t0);
+            int match = got[0] == ref[0] && got[1] == ref[1] && got[2] == ref[2];
+            ok &= match;
+            printf("  %-22s %10.1f %10.2f  %s\n", name, e * 1e3, e * 1e9 / n,
+                   match ? "PASS" : "FAIL");
+            if (t == threads) break;
+        }
+        printf("  p50 %.4f  p95 %.4f  p99 %.4f\n", ref[0], ref[1], ref[2]);
+    }
+    free(v);
+    free(w);
+    return ok ? 0 : 1;
+}
+
+/* ── Snapshots ──────────────────────────────────────────────────────────── */
+
+/* The current aggregate state as a snapshot file (see snapshot.c). */
+static int write_snapshot(const char *path) {
+    SnapHeader h = {0};
+    uint64_t status[600];
+    for (int s = 0; s < 600; s++) status[s] = (uint64_t)status_counts[s];
+    h.lines = total_lines;
+    h.errors = parse_errors;
+    h.filtered = filtered_lines;
+    h.lat_count = lat_count;
+
+    SnapIP *ips = malloc((ip_table_size + 1) * sizeof(SnapIP));
+    for (int i = 0; i < HASH_SIZE; i++) {
+        if (ip_table[i].count == 0) continue;
+        SnapIP *e = &ips[h.n_ips++];
+        memcpy(e->ip, ip_table[i].ip, SNAP_IP_LEN);
+        e->count = (uint64_t)ip_table[i].count;
+        e->lat_us = (uint64_t)llround(ip_table[i].total_time * 1000.0);
+    }
+    qsort(ips, h.n_ips, sizeof(SnapIP), cmp_snap_ip);
+    SnapLat *lat;
+    h.n_lat = snap_lat_histogram(latencies, lat_count, &lat);
+
+    FILE *f = snap_begin(path, &h, status);
+    if (f) {
+        for (uint64_t i = 0; i < h.n_ips; i++) snap_put_ip(f, &ips[i]);
+        for (uint64_t i = 0; i < h.n_lat; i++) snap_put_lat(f, &lat[i]);
+    }
+    int err = f ? snap_finish(f, &h) : -1;
+    if (err == 0) {
+        long size = 0;
+        FILE *s = fopen(path, "rb");
+        if (s) { fseek(s, 0, SEEK_END); size = ftell(s); fclose(s); }
+        printf("\nSnapshot:        %s (%ld bytes, %llu IPs, %llu latency values)\n", path, size,
+               (unsigned long long)h.n_ips, (unsigned long long)h.n_lat);
+    } else {
+        fprintf(stderr, "failed to write snapshot %s\n", path);
+    }
+    free(ips);
+    free(lat);
+    return err;
+}
+
+/*
+ * Combines snapshots from several nodes; the report matches a single run
+ * over the concatenated logs (top-10 ties ordered by IP).
+ */
+static int cmd_merge(int argc, char **argv) {
+    const char *out = NULL;
+    if (argc >= 2 && strcmp(argv[0], "-o") == 0) {
+        out = argv[1];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 1) {
+        fprintf(stderr, "usage: log_analyzer merge [-o OUT] SNAPSHOT...\n");
+        return 1;
+    }
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    SnapResult r;
+    if (snap_merge((const char *const *)argv, argc, out, &r) != 0) return 1;
+    double e = elapsed_since(&t0);
+    snap_print(&r, argc);
+    printf("\nMerge time:      %.3f s%s%s\n", e, out ? ", wrote " : "", out ? out : "");
+    return 0;
+}
+
+/* ── Anomaly detection ──────────────────────────────────────────────────── */
+
+static void print_anomaly(const AnomAlert *a, const char *route) {
+    char when[32];
+    time_t t = (time_t)a->bucket;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    if (a->metric == ANOM_ERRORS)
+        printf("  %s  %-28s 5xx %5.1f%%    baseline %5.1f%% ± %.1f  (%u reqs)\n", when, route,
+               100 * a->value, 100 * a->mean, 100 * a->sd, a->n);
+    else
+        printf("  %s  %-28s p95 %6.1f ms  baseline %6.1f ms ± %.1f  (%u reqs)\n", when, route,
+               a->value, a->mean, a->sd, a->n);
+}
+
+/* Alerts from number `from` on, at most max of them; returns the next number. */
+static uint64_t print_anomalies(const AnomDetector *d, const RouteTrie *t, uint64_t from, int max) {
+    if (d->n_alerts - from > ANOM_ALERTS) from = d->n_alerts - ANOM_ALERTS;
+    uint64_t i = from;
+    for (; i < d->n_alerts && i - from < (uint64_t)max; i++) {
+        const AnomAlert *a = &d->alerts[i % ANOM_ALERTS];
+        print_anomaly(a, t ? t->routes[a->route].tmpl : "?");
+    }
+    if (i < d->n_alerts) printf("  ... %llu more\n", (unsigned long long)(d->n_alerts - i));
+    return d->n_alerts;
+}
+
+static void print_anomaly_report(const AnomDetector *d, const RouteTrie *t) {
+    printf("\nAnomalies (%d s buckets, EWMA alpha %.2f, k %.1f): %llu alerts\n", d->bucket_sec,
+           d->alpha, d->k, (unsigned long long)d->n_alerts);
+    printf("  (%llu route-buckets judged in %llu buckets; %llu late lines, %llu unparsed times)\n",
+           (unsigned long long)d->judged, (unsigned long long)d->buckets,
+           (unsigned long long)d->late, (unsigned long long)time_bad);
+    print_anomalies(d, t, 0, 20);
+}
+
+/* ── bench-anomaly ── */
+
+static inline double anom_rand(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return (*s >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Detection on a synthetic stream with injected incidents, then the
+ * per-line cost on a generated log: parser + aggregation, + route
+ * normalization, + the detector.
+ */
+static int cmd_bench_anomaly(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    enum { REPS = 11 };         /* odd, for a plain median */
+    const int buckets = 240, per_bucket = 300;
+    static const struct { const char *name; double err, lat; } base[] = {
+        { "/api/users/:id", 0.02, 30 }, { "/api/orders/:uuid", 0.05, 80 }, { "/api/search", 0.10, 150 },
+    };
+    enum { N_ROUTES = sizeof(base) / sizeof(base[0]) };
+    /* Incidents: (route, metric, first bucket, buckets). */
+    static const struct { int route, metric, from, len; } inc[] = {
+        { 1, ANOM_ERRORS, 100, 3 },     /* 5xx burst */
+        { 2, ANOM_P95,    150, 2 },     /* slow dependency */
+        { 0, ANOM_ERRORS, 200, 1 },     /* lasting shift: alerts once, then absorbed */
+    };
+    enum { N_INC = sizeof(inc) / sizeof(inc[0]) };
+
+    AnomDetector d;
+    anom_init(&d, 60, 0.1, 4.0);
+    uint64_t rng = 42;
+    for (int b = 0; b < buckets; b++) {
+        for (int i = 0; i < per_bucket * N_ROUTES; i++) {
+            int r = i % N_ROUTES;
+            double err = base[r].err, lat = base[r].lat;
+            if (r == 1 && b >= 100 && b < 103) err = 0.25;
+            if (r == 2 && b >= 150 && b < 152) lat *= 3;
+            if (r == 0 && b >= 200) err = 0.08;
+            int status = anom_rand(&rng) < err ? 503 : 200;
+            double ms = 1 - lat * log(1 - anom_rand(&rng));     /* 1 ms + exponential */
+            anom_add(&d, r, 1772272800 + b * 60 + i * 60 / (per_bucket * N_ROUTES), status, ms);
+        }
+    }
+    anom_flush(&d);
+
+    int found[N_INC] = { 0 }, false_alerts = 0, hits = 0, want = 0;
+    for (int i = 0; i < N_INC; i++) want += inc[i].len;
+    for (uint64_t i = 0; i < d.n_alerts; i++) {
+        const AnomAlert *a = &d.alerts[i % ANOM_ALERTS];
+        int b = (int)((a->bucket - 1772272800) / 60), hit = 0;
+        for (int k = 0; k < N_INC; k++)
+            if (a->route == inc[k].route && a->metric == inc[k].metric && b >= inc[k].from &&
+                b < inc[k].from + inc[k].len) {
+                found[k]++;
+                hit = 1;
+            }
+        hits += hit;
+        false_alerts += !hit;
+    }
+    printf("Benchmark: anomaly detection (60 s buckets, alpha 0.10, k 4.0)\n\n");
+    printf("Synthetic: %d routes x %d buckets x %d reqs, %d incident buckets injected\n", N_ROUTES,
+           buckets, per_bucket, want);
+    for (int k = 0; k < N_INC; k++)
+        printf("  %-20s %s from bucket %3d x%d: %d flagged\n", base[inc[k].route].name,
+               anom_metric_names[inc[k].metric], inc[k].from, inc[k].len, found[k]);
+    printf("  detected %d/%d incident buckets, %d false alerts in %llu route-bucket judgments\n",
+           hits, want, false_alerts, (unsigned long long)d.judged);
+    int ok = hits == want && false_alerts * 200 <= (int)d.judged * ANOM_METRICS;
+    anom_free(&d);
+
+    const char *path = "/tmp/bench.apache.log";
+    gen_id_paths = gen_steady_times = 1;
+    generate_log(path, num_lines, FMT_APACHE);
+    size_t len;
+    char *buf = load_file(path, &len);
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+    RouteTrie t;
+    route_init(&t);
+    AnomDetector det;
+    anom_init(&det, 60, 0.1, 4.0);
+    time_fmt = FMT_APACHE;
+
+    /* The three modes run back to back in every round, and the overheads
+     * are per-round ratios: a best-of over a few ns/line swings with
+     * whatever else the machine does, a ratio of neighbours much less. */
+    static const char *const names[3] = { "parse + aggregate", "  + routes", "  + anomaly detector" };
+    double ns[3][REPS], pct[3][REPS];
+    for (int r = 0; r < REPS; r++) {
+        for (int m = 0; m < 3; m++) {
+            routes = m >= 1 ? &t : NULL;
+            anomaly = m >= 2 ? &det : NULL;
+            reset_state();
+            struct timespec t0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            analyze_formatted(buf, len, FMT_APACHE);
+            if (anomaly) anom_flush(anomaly);
+            ns[m][r] = elapsed_since(&t0) * 1e9 / total_lines;
+        }
+        pct[0][r] = (ns[1][r] / ns[0][r] - 1) * 100;        /* routes over plain */
+        pct[1][r] = (ns[2][r] / ns[0][r] - 1) * 100;        /* both over plain */
+        pct[2][r] = (ns[2][r] / ns[1][r] - 1) * 100;        /* detector over routes */
+    }
+    for (int m = 0; m < 3; m++) {
+        qsort(ns[m], REPS, sizeof(double), cmp_double);
+        qsort(pct[m], REPS, sizeof(double), cmp_double);
+    }
+    printf("\nOverhead on %d generated lines (median of %d rounds, [min, max]):\n", total_lines, REPS);
+    printf("  %-24s %9s %9s\n", "", "ns/line", "vs plain");
+    printf("  %-24s %9.1f\n", names[0], ns[0][REPS / 2]);
+    for (int m = 1; m < 3; m++)
+        printf("  %-24s %9.1f %+8.1f%%  [%+.1f%%, %+.1f%%]\n", names[m], ns[m][REPS / 2],
+               pct[m - 1][REPS / 2], pct[m - 1][0], pct[m - 1][REPS - 1]);
+    printf("  detector alone: %+.1f%% over routes [%+.1f%%, %+.1f%%]; %llu alerts on the generated log\n",
+           pct[2][REPS / 2], pct[2][0], pct[2][REPS - 1], (unsigned long long)det.n_alerts);
+
+    routes = NULL;
+    anomaly = NULL;
+    anom_free(&det);
+    route_free(&t);
+    free(buf);
+    free(latencies);
+    printf("\nDetection: %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/* ── Follow mode ────────────────────────────────────────────────────────── */
+
+static volatile sig_atomic_t follow_stop;
+
+static void follow_sigint(int sig) {
+    (void)sig;
+    follow_stop = 1;
+}
+
+/* Latency samples of the last chunk go into the running histogram. */
+static void follow_fold_latencies(SnapLatMap *lat) {
+    for (int i = 0; i < lat_count; i++) snap_lat_add(lat, latencies[i]);
+    lat_count = 0;
+}
+
+/*
+ * One refresh from the running state: status classes, percentiles from
+ * the histogram, top IPs by a scan of ip_table (which stays a hash
+ * table — no in-place sort).  Cost is O(distinct IPs + distinct
+ * latencies), independent of how much has been read.
+ */
+static void follow_report(const SnapLatMap *lat, double t, int new_lines, uint64_t bytes,
+                          const char *note) {
+    printf("--- %.1f s  lines %d (+%d)  errors %d  IPs %d  read %.1f MB%s ---\n",
+           t, total_lines, new_lines, parse_errors, ip_table_size, bytes / 1e6, note);
+
+    int cls[6] = { 0 };
+    for (int s = 100; s < 600; s++) cls[s / 100] += status_counts[s];
+    printf(" ");
+    for (int c = 1; c < 6; c++)
+        if (cls[c]) printf(" %dxx %5.1f%%", c, 100.0 * cls[c] / total_lines);
+    printf("\n");
+
+    if (lat->total > 0) {
+        SnapLat *v;
+        size_t n = snap_lat_sorted(lat, &v);
+        uint64_t rank[3] = { lat->total * 50 / 100, lat->total * 95 / 100, lat->total * 99 / 100 };
+        double pct[3] = { 0, 0, 0 };
+        uint64_t seen = 0;
+        for (size_t i = 0, next = 0; i < n && next < 3; i++) {
+            seen += v[i].count;
+            while (next < 3 && rank[next] < seen) pct[next++] = v[i].value;
+        }
+        printf("  p50 %.1f ms  p95 %.1f ms  p99 %.1f ms\n", pct[0], pct[1], pct[2]);
+        free(v);
+    }
+
+    SnapIP top[SNAP_TOP];
+    int n_top = 0;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        if (ip_table[i].count == 0) continue;
+        SnapIP e;
+        memcpy(e.ip, ip_table[i].ip, SNAP_IP_LEN);
+        e.count = (uint64_t)ip_table[i].count;
+        e.lat_us = (uint64_t)llround(ip_table[i].total_time * 1000.0);
+        snap_top_add(top, &n_top, &e);
+    }
+    for (int i = 0; i < n_top; i++)
+        printf("  %-20s %7llu reqs  avg %.1f ms\n", top[i].ip,
+               (unsigned long long)top[i].count, top[i].lat_us / 1000.0 / top[i].count);
+}
+
+/*
+ * Tails a growing log and prints a refreshed report every interval until
+ * Ctrl-C (or N refreshes).  Only bytes past the last offset are parsed;
+ * each refresh reports how long ingesting its new lines and rendering
+ * the report took.
+ */
+static int cmd_follow(int argc, char **argv) {
+    const char *path = NULL;
+    int fmt = FMT_APACHE, from_start = 0, refreshes = 0, anomaly_sec = 0;
+    double interval = 2.0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            fmt = format_from_name(argv[++i]);
+            if (fmt < 0) { fprintf(stderr, "unknown format: %s\n", argv[i]); return 1; }
+        } else if (strcmp(argv[i], "--anomaly") == 0 && i + 1 < argc) {
+            anomaly_sec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--refreshes") == 0 && i + 1 < argc) {
+            refreshes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--from-start") == 0) {
+            from_start = 1;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!path || interval <= 0) {
+        fprintf(stderr, "usage: log_analyzer follow FILE [--format F] [--interval SEC]"
+                        " [--refreshes N] [--from-start] [--anomaly SEC]\n");
+        return 1;
+    }
+    if (anomaly_sec > 0 && fmt == FMT_JSONL) {
+        fprintf(stderr, "--anomaly needs a fixed layout for timestamps, not jsonl\n");
+        return 1;
+    }
+
+    Tailer tl;
+    RouteTrie trie;
+    AnomDetector det;
+    uint64_t alerts_shown = 0;
+    if (tail_open(&tl, path, from_start) != 0) return 1;
+    if (anomaly_sec > 0) {
+        route_init(&trie);
+        routes = &trie;
+        anom_init(&det, anomaly_sec, 0.1, 4.0);
+        anomaly = &det;
+        time_fmt = fmt;
+    }
+    printf("Following %s (%s, from %s, every %.1f s) ...\n", path, format_names[fmt],
+           from_start ? "start" : "end", interval);
+    signal(SIGINT, follow_sigint);
+
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+    SnapLatMap lat = { 0 };
+    struct timespec t0, next, now;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    next = t0;
+    int done = 0, lines_at_refresh = 0;
+    double ingest = 0, ingest_max = 0;
+    int reads = 0;
+
+    for (;;) {
+        next.tv_sec += (time_t)interval;
+        next.tv_nsec += (long)((interval - (time_t)interval) * 1e9);
+        if (next.tv_nsec >= 1000000000L) { next.tv_sec++; next.tv_nsec -= 1000000000L; }
+        for (;;) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int ms = (int)((next.tv_sec - now.tv_sec) * 1000 + (next.tv_nsec - now.tv_nsec) / 1000000);
+            /* Read on every wakeup and once more at the deadline, so the
+             * report is current even if an event was coalesced. */
+            int changed = ms > 0 && !follow_stop ? tail_wait(&tl, ms) : 1;
+            if (changed) {
+                struct timespec r0;
+                clock_gettime(CLOCK_MONOTONIC, &r0);
+                size_t n = tail_poll(&tl);
+                if (n) {
+                    analyze_formatted(tl.buf, n, fmt);
+                    follow_fold_latencies(&lat);
+                    tail_consume(&tl, n);
+                    double e = elapsed_since(&r0) * 1e3;
+                    ingest += e;
+                    if (e > ingest_max) ingest_max = e;
+                    reads++;
+                }
+            }
+            if (ms <= 0 || follow_stop) break;
+        }
+
+        struct timespec p0;
+        clock_gettime(CLOCK_MONOTONIC, &p0);
+        char note[96] = "";
+        if (tl.rotations || tl.truncations)
+            snprintf(note, sizeof(note), "  rotated %llu  truncated %llu",
+                     (unsigned long long)tl.rotations, (unsigned long long)tl.truncations);
+        follow_report(&lat, elapsed_since(&t0), total_lines - lines_at_refresh, tl.bytes, note);
+        if (anomaly && anomaly->n_alerts > alerts_shown) {
+            printf("  anomalies:\n");
+            alerts_shown = print_anomalies(anomaly, routes, alerts_shown, 20);
+        }
+        printf("  refresh: ingest %.2f ms in %d batch%s (max %.2f ms), report %.2f ms\n\n",
+               ingest, reads, reads == 1 ? "" : "es", ingest_max, elapsed_since(&p0) * 1e3);
+        fflush(stdout);
+        lines_at_refresh = total_lines;
+        ingest = ingest_max = 0;
+        reads = 0;
+        if (follow_stop || (refreshes > 0 && ++done >= refreshes)) break;
+    }
+
+    tail_close(&tl);
+    if (anomaly) {
+        anom_free(anomaly);
+        route_free(routes);
+        anomaly = NULL;
+        routes = NULL;
+    }
+    free(lat.slot);
+    free(latencies);
+    return 0;
+}
+
+/* ── Sampled analysis ───────────────────────────────────────────────────── */
+
+typedef struct {
+    Sampler  s;
+    SampleCI lines;                 /* estimated lines in the file */
+    SampleCI status[600];           /* share of lines */
+    SampleCI pct[3];                /* p50, p95, p99 */
+    int      n_top;
+    SnapIP   top[SNAP_TOP];         /* counts within the sample */
+    SampleCI top_share[SNAP_TOP];   /* share of lines */
+} SampleEstimate;
+
+static int      sample_lines_g[SAMPLE_GROUPS];
+static uint8_t *lat_group;          /* group of latencies[i] */
+static int      lat_group_cap;
+
+/* One kept span through the usual parser and aggregation path. */
+static void sample_span(void *ctx, const char *buf, size_t len, int group) {
+    int fmt = *(const int *)ctx;
+    int lines0 = total_lines, lat0 = lat_count;
+    sample_group = group;
+    if (fmt >= 0) {
+        analyze_formatted(buf, len, fmt);
+    } else {
+        char line[MAX_LINE], ip[48];
+        int status;
+        double rtime;
+        for (const char *p = buf, *end = buf + len; p < end;) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t l = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+            size_t n = l < MAX_LINE - 1 ? l : MAX_LINE - 1;
+            memcpy(line, p, n);             /* as fgets would hand it over */
+            line[n] = '\0';
+            p += l;
+            total_lines++;
+            if (parse_line(line, ip, &status, &rtime) != 0) {
+                parse_errors++;
+                continue;
+            }
+            record_hit(ip, status, rtime);
+        }
+    }
+    sample_lines_g[group] += total_lines - lines0;
+    if (lat_count > lat_group_cap) {
+        lat_group_cap = lat_cap;
+        lat_group = realloc(lat_group, lat_group_cap);
+    }
+    memset(lat_group + lat0, group, lat_count - lat0);
+}
+
+/*
+ * Scaled estimates and intervals from the sampled state.  Shares are
+ * ratios to sampled lines, so they need no scaling; the line total is
+ * exact in line mode (every line is counted) and a lines-per-byte ratio
+ * in chunk mode.  Top-IP shares are for the IPs that rank highest in the
+ * sample, so near-ties carry a little selection bias the intervals do
+ * not model.
+ */
+static void sample_estimate(SampleEstimate *est) {
+    const Sampler *s = &est->s;
+    double fpc = s->units ? 1.0 - (double)s->kept / s->units : 0;
+    double g_est[SAMPLE_GROUPS];
+    int ng;
+
+    if (s->unit == SAMPLE_BY_LINE) {
+        est->lines = (SampleCI){ (double)s->units, (double)s->units, (double)s->units };
+    } else {
+        uint64_t kept_bytes = 0;
+        ng = 0;
+        for (int g = 0; g < SAMPLE_GROUPS; g++) {
+            kept_bytes += s->group_bytes[g];
+            if (s->group_bytes[g])
+                g_est[ng++] = (double)sample_lines_g[g] * s->file_bytes / s->group_bytes[g];
+        }
+        double lines = kept_bytes ? (double)total_lines * s->file_bytes / kept_bytes : 0;
+        est->lines = sample_ci(lines, g_est, ng, fpc);
+    }
+
+    for (int st = 0; st < 600; st++) {
+        est->status[st] = (SampleCI){ 0, 0, 0 };
+        if (!status_counts[st]) continue;
+        ng = 0;
+        for (int g = 0; g < SAMPLE_GROUPS; g++)
+            if (sample_lines_g[g]) g_est[ng++] = (double)sample_status[g][st] / sample_lines_g[g];
+        est->status[st] = sample_ci((double)status_counts[st] / total_lines, g_est, ng, fpc);
+    }
+
+    /*
+     * Percentiles: Woodruff intervals.  The share of samples at or below
+     * the estimated quantile is a ratio like any other; its group
+     * interval, mapped back through the sample's own order statistics,
+     * bounds the quantile.  Robust to the heavy ties of quantized
+     * latencies, where per-group percentiles are not.
+     */
+    if (lat_count > 0) {
+        static const double p[3] = { 0.50, 0.95, 0.99 };
+        size_t rank[9];
+        double q[9], below[SAMPLE_GROUPS], n_g[SAMPLE_GROUPS];
+        for (int k = 0; k < 3; k++) rank[k] = (size_t)((double)lat_count * p[k]);
+        quantiles_exact(latencies, lat_count, rank, 3, q, 1);
+        for (int k = 0; k < 3; k++) {
+            memset(below, 0, sizeof(below));
+            memset(n_g, 0, sizeof(n_g));
+            for (int i = 0; i < lat_count; i++) {
+                below[lat_group[i]] += latencies[i] <= q[k];
+                n_g[lat_group[i]]++;
+            }
+            ng = 0;
+            double all = 0;
+            for (int g = 0; g < SAMPLE_GROUPS; g++) {
+                all += below[g];
+                if (n_g[g]) g_est[ng++] = below[g] / n_g[g];
+            }
+            SampleCI f = sample_ci(all / lat_count, g_est, ng, fpc);
+            double half = (f.hi - f.lo) / 2;
+            double lo = p[k] - half, hi = p[k] + half;
+            rank[3 + 2 * k] = lo <= 0 ? 0 : (size_t)(lo * lat_count);
+            rank[4 + 2 * k] = hi >= 1 ? (size_t)lat_count - 1 : (size_t)(hi * lat_count);
+        }
+        quantiles_exact(latencies, lat_count, rank + 3, 6, q + 3, 1);
+        for (int k = 0; k < 3; k++) est->pct[k] = (SampleCI){ q[k], q[3 + 2 * k], q[4 + 2 * k] };
+    }
+
+    est->n_top = 0;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        if (ip_table[i].count == 0) continue;
+        SnapIP e;
+        memcpy(e.ip, ip_table[i].ip, SNAP_IP_LEN);
+        e.count = (uint64_t)ip_table[i].count;
+        e.lat_us = (uint64_t)llround(ip_table[i].total_time * 1000.0);
+        snap_top_add(est->top, &est->n_top, &e);
+    }
+    for (int t = 0; t < est->n_top; t++) {
+        size_t slot = (size_t)(find_or_insert(est->top[t].ip) - ip_table);
+        ng = 0;
+        for (int g = 0; g < SAMPLE_GROUPS; g++)
+            if (sample_lines_g[g])
+                g_est[ng++] = (double)sample_ip_groups[slot * SAMPLE_GROUPS + g] / sample_lines_g[g];
+        est->top_share[t] = sample_ci((double)est->top[t].count / total_lines, g_est, ng, fpc);
+    }
+}
+
+/* A 1/rate sample of path aggregated into the usual state, plus estimates. */
+static int analyze_sampled(const char *path, int fmt, int unit, int rate, uint64_t seed,
+                           SampleEstimate *est) {
+    sample_ip_groups = calloc((size_t)HASH_SIZE * SAMPLE_GROUPS, sizeof(uint32_t));
+    memset(sample_status, 0, sizeof(sample_status));
+    memset(sample_lines_g, 0, sizeof(sample_lines_g));
+    sample_init(&est->s, unit, rate, seed);
+    int err = sample_scan(&est->s, path, sample_span, &fmt);
+    if (!err) sample_estimate(est);
+    free(sample_ip_groups);
+    sample_ip_groups = NULL;
+    return err;
+}
+
+static void print_sampled(const SampleEstimate *e, double elapsed) {
+    const Sampler *s = &e->s;
+    printf("\n=== Sampled Analysis (1/%d by %s, 95%% CI) ===\n", s->rate,
+           sample_unit_names[s->unit]);
+    printf("Sampled:         %d lines from %llu of %llu %ss, read %.1f of %.1f MB\n",
+           total_lines, (unsigned long long)s->kept, (unsigned long long)s->units,
+           sample_unit_names[s->unit], s->bytes_read / 1e6, s->file_bytes / 1e6);
+    printf("Lines (est.):    %.0f  [%.0f, %.0f]\n", e->lines.est, e->lines.lo, e->lines.hi);
+    printf("Parse errors:    %d in sample\n", parse_errors);
+    printf("Unique IPs:      %d in sample\n", ip_table_size);
+    printf("Analysis time:   %.3f s  (%.0f lines/sec est.)\n", elapsed, e->lines.est / elapsed);
+    printf("\n");
+
+    printf("Status Distribution (est.):\n");
+    for (int st = 100; st < 600; st++)
+        if (status_counts[st] > 0)
+            printf("  %d: %7.0f  (%5.1f%%  [%.1f, %.1f])\n", st,
+                   e->status[st].est * e->lines.est, 100 * e->status[st].est,
+                   100 * e->status[st].lo, 100 * e->status[st].hi);
+
+    if (lat_count > 0) {
+        static const char *const names[3] = { "p50", "p95", "p99" };
+        printf("\nLatency Percentiles:\n");
+        for (int k = 0; k < 3; k++)
+            printf("  %s: %.1f ms  [%.1f, %.1f]\n", names[k], e->pct[k].est, e->pct[k].lo,
+                   e->pct[k].hi);
+    }
+
+    printf("\nTop 10 IPs (est.):\n");
+    for (int t = 0; t < e->n_top; t++)
+        printf("  %-20s %7.0f reqs  %5.2f%% [%.2f, %.2f]  avg %.1f ms\n", e->top[t].ip,
+               e->top_share[t].est * e->lines.est, 100 * e->top_share[t].est,
+               100 * e->top_share[t].lo, 100 * e->top_share[t].hi,
+               e->top[t].lat_us / 1000.0 / e->top[t].count);
+}
+
+/* Looks an IP up in a copy of ip_table without inserting. */
+static const IPEntry *ip_lookup(const IPEntry *table, const char *ip) {
+    unsigned int h = hash_ip(ip) & (HASH_SIZE - 1);
+    for (int i = 0; i < HASH_SIZE && table[h].count; i++, h = (h + 1) & (HASH_SIZE - 1))
+        if (strcmp(table[h].ip, ip) == 0) return &table[h];
+    return NULL;
+}
+
+/*
+ * Sampled runs against the full run on a generated log: time, speedup,
+ * and how often the 95% intervals cover the true value across seeds
+ * (status shares, p50/p95/p99, top-10 IP shares, line count).  The
+ * default 500K lines keep the generated log's clients (~70K) well inside
+ * the baseline's HASH_SIZE table; a full table would drop clients from
+ * the truth and spend the reference run probing.
+ */
+static int cmd_bench_sample(int argc, char **argv) {
+    int num_lines = argc > 0 ? atoi(argv[0]) : 500000;
+    int rate = argc > 1 ? atoi(argv[1]) : 20;
+    int seeds = argc > 2 ? atoi(argv[2]) : 20;
+    const char *path = "/tmp/bench.sample.log";
+    SampleEstimate *est = malloc(sizeof(SampleEstimate));
+    IPEntry *truth_ip = malloc(sizeof(ip_table));
+    double truth_status[600], truth_pct[3];
+    struct timespec t0;
+
+    printf("Benchmark: 1/%d sampling vs full parse_line run (%d lines, %d seeds)\n\n",
+           rate, num_lines, seeds);
+    generate_log(path, num_lines, FMT_APACHE);
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+
+    /* Truth: every chunk, through the same parser. */
+    reset_state();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (analyze_sampled(path, -1, SAMPLE_BY_CHUNK, 1, 0, est) != 0) return 1;
+    double full = elapsed_since(&t0);
+    int truth_lines = total_lines;
+    for (int st = 0; st < 600; st++) truth_status[st] = (double)status_counts[st] / total_lines;
+    for (int k = 0; k < 3; k++) truth_pct[k] = est->pct[k].est;
+    memcpy(truth_ip, ip_table, sizeof(ip_table));
+    if (ip_table_size >= HASH_SIZE) {
+        printf("The reference run filled the %d-slot IP table: clients were dropped, so there\n"
+               "is no true top-IP share to check against.  Use fewer lines.\n", HASH_SIZE);
+        free(truth_ip);
+        free(est);
+        free(latencies);
+        return 1;
+    }
+    if (ip_table_size > HASH_SIZE / 4 * 3)
+        printf("warning: %d clients in the %d-slot IP table; the full run's time is mostly\n"
+               "probing, so the speedups below overstate sampling\n\n", ip_table_size, HASH_SIZE);
+
+    printf("%-10s %9s %8s %9s   %-9s %-9s %-9s %-9s\n", "run", "ms", "speedup", "read MB",
+           "status", "pct", "top-IP", "lines");
+    printf("%-10s %9.1f %8s %9.1f   (95%% CI coverage over seeds)\n", "full", full * 1e3,
+           "1.00x", est->s.bytes_read / 1e6);
+
+    int ok = 1;
+    for (int unit = 0; unit < SAMPLE_UNITS; unit++) {
+        int cov[4] = { 0 }, tot[4] = { 0 };
+        double sec = 0, mb = 0;
+        for (int seed = 1; seed <= seeds; seed++) {
+            reset_state();
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            analyze_sampled(path, -1, unit, rate, (uint64_t)seed, est);
+            sec += elapsed_since(&t0);
+            mb += est->s.bytes_read / 1e6;
+            for (int st = 0; st < 600; st++)
+                if (truth_status[st] > 0) {
+                    tot[0]++;
+                    cov[0] += sample_covers(&est->status[st], truth_status[st]);
+                }
+            for (int k = 0; k < 3; k++) {
+                tot[1]++;
+                cov[1] += sample_covers(&est->pct[k], truth_pct[k]);
+            }
+            for (int t = 0; t < est->n_top; t++) {
+                const IPEntry *e = ip_lookup(truth_ip, est->top[t].ip);
+                tot[2]++;
+                cov[2] += sample_covers(&est->top_share[t],
+                                        e ? (double)e->count / truth_lines : 0);
+            }
+            tot[3]++;
+            cov[3] += sample_covers(&est->lines, truth_lines);
+        }
+        char name[16], c[4][16];
+        snprintf(name, sizeof(name), "1/%d %s", rate, sample_unit_names[unit]);
+        for (int i = 0; i < 4; i++) {
+            snprintf(c[i], sizeof(c[i]), "%.0f%%", 100.0 * cov[i] / tot[i]);
+            ok &= cov[i] >= 0.85 * tot[i];      /* 95% nominal, over few seeds */
+        }
+        printf("%-10s %9.1f %7.2fx %9.1f   %-9s %-9s %-9s %-9s\n", name, sec * 1e3 / seeds,
+               full * seeds / sec, mb / seeds, c[0], c[1], c[2], c[3]);
+    }
+    free(truth_ip);
+    free(est);
+    free(latencies);
+    free(lat_group);
+    return ok ? 0 : 1;
+}
+
+/* ── External aggregation ───────────────────────────────────────────────── */
+
+#define EXT_BLOCK (4 << 20)     /* log bytes read per step */
+
+enum { EXT_KEY_IP, EXT_KEY_IP_PATH, EXT_KEYS };
+static const char *const ext_key_names[EXT_KEYS] = { "ip", "ip+path" };
+
+static ExtAgg     ext_agg;
+static int        ext_key = EXT_KEY_IP_PATH, ext_err;
+static SnapLatMap ext_lat;      /* latencies as a value histogram: bounded */
+
+static void ext_record(const LogRecord *r) {
+    char key[EXT_KEY_MAX];
+    uint32_t n = r->ip_len < EXT_KEY_MAX ? (uint32_t)r->ip_len : EXT_KEY_MAX;
+    memcpy(key, r->ip, n);
+    if (ext_key == EXT_KEY_IP_PATH && n < EXT_KEY_MAX) {
+        key[n++] = ' ';
+        uint32_t p = (uint32_t)r->path_len < EXT_KEY_MAX - n ? (uint32_t)r->path_len
+                                                             : EXT_KEY_MAX - n;
+        memcpy(key + n, r->path, p);
+        n += p;
+    }
+    status_counts[r->status]++;
+    snap_lat_add(&ext_lat, r->latency_ms);
+    if (ext_add(&ext_agg, key, n, 1, (uint64_t)llround(r->latency_ms * 1000.0)) != 0)
+        ext_err = 1;
+}
+
+static void ext_record_cb(const LogRecord *r, void *ctx) {
+    (void)ctx;
+    ext_record(r);
+}
+
+static void ext_block(const char *buf, size_t len, int fmt) {
+    FOR_EACH_FORMAT_RECORD(fmt, buf, len, total_lines, parse_errors, ext_record_cb, NULL);
+}
+
+/*
+ * Streams the log in EXT_BLOCK steps (never the whole file in memory)
+ * into a budget-bounded external aggregation; times the two phases.
+ * The buffer grows only to hold a single line longer than it.
+ */
+static int analyze_external(const char *path, int fmt, size_t budget, const char *dir,
+                            ExtResult *res, double ms[2]) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return -1; }
+    size_t cap = EXT_BLOCK, have = 0;
+    char *buf = malloc(cap);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ext_result_free(res);
+    memset(res, 0, sizeof(*res));
+    free(ext_lat.slot);
+    memset(&ext_lat, 0, sizeof(ext_lat));
+    ext_init(&ext_agg, budget, 0, dir, res);
+    ext_err = 0;
+    for (;;) {
+        size_t n = fread(buf + have, 1, cap - have, f), end = have += n;
+        if (n > 0) {
+            while (end > 0 && buf[end - 1] != '\n') end--;
+            if (end == 0 && have == cap) {      /* no newline in a full buffer */
+                char *grown = realloc(buf, cap * 2);
+                if (!grown) {
+                    fprintf(stderr, "out of memory for a %zu-byte line\n", have);
+                    ext_err = 1;
+                    break;
+                }
+                buf = grown;
+                cap *= 2;
+                continue;
+            }
+        }
+        ext_block(buf, end, fmt);
+        memmove(buf, buf + end, have - end);
+        have -= end;
+        if (n == 0 || ext_err) break;
+    }
+    fclose(f);
+    free(buf);
+    ms[0] = elapsed_since(&t0) * 1e3;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int err = ext_err ? (ext_free(&ext_agg), -1) : ext_finish(&ext_agg);
+    ms[1] = elapsed_since(&t0) * 1e3;
+    return err < 0 ? -1 : 0;
+}
+
+static void print_external(const ExtResult *r, size_t budget, const char *dir,
+                           const double ms[2]) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("\n=== External Aggregation (%s keys, %zu MB budget) ===\n", ext_key_names[ext_key],
+           budget >> 20);
+    printf("Lines processed: %d\n", total_lines);
+    printf("Parse errors:    %d\n", parse_errors);
+    printf("Distinct keys:   %llu\n", (unsigned long long)r->keys);
+    if (r->spills)
+        printf("Spilled:         %llu times, %llu records, %.1f MB to %s (%d level%s)\n",
+               (unsigned long long)r->spills, (unsigned long long)r->spill_records,
+               r->spill_bytes / 1e6, dir, r->max_level, r->max_level == 1 ? "" : "s");
+    else
+        printf("Spilled:         nothing, fit in memory\n");
+    printf("Phase 1:         %.1f ms  (parse + partial aggregation + spill)\n", ms[0]);
+    printf("Phase 2:         %.1f ms  (partition aggregation)\n", ms[1]);
+    printf("Peak RSS:        %.1f MB\n", ru.ru_maxrss / 1024.0);
+    printf("\n");
+
+    printf("Status Distribution:\n");
+    for (int s = 100; s < 600; s++)
+        if (status_counts[s] > 0)
+            printf("  %d: %7d  (%5.1f%%)\n", s, status_counts[s],
+                   100.0 * status_counts[s] / total_lines);
+
+    if (ext_lat.total > 0) {
+        SnapLat *v;
+        size_t n = snap_lat_sorted(&ext_lat, &v);
+        uint64_t rank[3] = { ext_lat.total * 50 / 100, ext_lat.total * 95 / 100,
+                             ext_lat.total * 99 / 100 };
+        double pct[3] = { 0, 0, 0 };
+        uint64_t seen = 0;
+        for (size_t i = 0, next = 0; i < n && next < 3; i++) {
+            seen += v[i].count;
+            while (next < 3 && rank[next] < seen) pct[next++] = v[i].value;
+        }
+        free(v);
+        printf("\nLatency Percentiles:\n");
+        printf("  p50: %.1f ms\n", pct[0]);
+        printf("  p95: %.1f ms\n", pct[1]);
+        printf("  p99: %.1f ms\n", pct[2]);
+    }
+
+    if (r->spills) {
+        printf("\nPartitions:\n  %4s %10s %9s %10s %9s %6s\n", "part", "records", "MB", "keys",
+               "ms", "levels");
+        for (int p = 0; p < EXT_FANOUT; p++) {
+            const ExtPartStat *s = &r->part[p];
+            if (!s->records) continue;
+            printf("  %4d %10llu %9.1f %10llu %9.1f %6d\n", p, (unsigned long long)s->records,
+                   s->bytes / 1e6, (unsigned long long)s->keys, s->ms, 1 + s->depth);
+        }
+    }
+
+    printf("\nTop 10 keys:\n");
+    for (int i = 0; i < r->n_top; i++)
+        printf("  %-44.*s %7llu reqs  avg %.1f ms\n", (int)r->top[i].len, r->top[i].key,
+               (unsigned long long)r->top[i].count, r->top[i].lat_us / 1000.0 / r->top[i].count);
+}
+
+/* ── Rate windows ───────────────────────────────────────────────────────── */
+
+static void print_rate_offenders(const RateTable *t) {
+    RateOffender *v;
+    size_t n = rate_offenders(t, &v);
+    printf("\nClients over %u reqs in a %d s window: %zu\n", t->limit, RATE_WINDOW, n);
+    printf("  (%zu tracked of %zu slots; %llu sweeps, %llu expired, %llu evicted,"
+           " %llu late, %llu unparsed times)\n",
+           t->cap - t->n_free, t->cap, (unsigned long long)t->sweeps,
+           (unsigned long long)t->expired, (unsigned long long)t->evicted,
+           (unsigned long long)t->late, (unsigned long long)time_bad);
+    for (size_t i = 0; i < n && i < 20; i++) {
+        char ip[48], when[32];
+        time_t end = (time_t)v[i].peak_at;
+        struct tm tm;
+        rate_key_str(&v[i].addr, ip, sizeof(ip));
+        gmtime_r(&end, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+        printf("  %-20s peak %5u reqs/%ds  window ending %s UTC\n", ip, v[i].peak, RATE_WINDOW,
+               when);
+    }
+    if (n > 20) printf("  ... %zu more\n", n - 20);
+    free(v);
+}
+
+/* ── Socket ingestion ───────────────────────────────────────────────────── */
+
+typedef struct {
+    int         fmt;
+    SnapLatMap *lat;
+} ListenCtx;
+
+static void listen_batch(void *ctx, const char *buf, size_t len, int n) {
+    ListenCtx *c = ctx;
+    (void)n;
+    analyze_formatted(buf, len, c->fmt);
+    follow_fold_latencies(c->lat);
+}
+
+/*
+ * Receives log lines on a Unix socket — point rsyslog's omuxsock (or
+ * logger -u) at it — and prints a follow-style report every interval
+ * until Ctrl-C (or N refreshes).
+ */
+static int cmd_listen(int argc, char **argv) {
+    const char *path = NULL;
+    int fmt = FMT_APACHE, stream = 0, batch = SOCK_BATCH, refreshes = 0;
+    double interval = 2.0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            fmt = format_from_name(argv[++i]);
+            if (fmt < 0) { fprintf(stderr, "unknown format: %s\n", argv[i]); return 1; }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--refreshes") == 0 && i + 1 < argc) {
+            refreshes = atoi(argv[++i]);
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!path || interval <= 0) {
+        fprintf(stderr, "usage: log_analyzer listen SOCKET [--format F] [--stream] [--batch N]"
+                        " [--interval SEC] [--refreshes N]\n");
+        return 1;
+    }
+
+    SockIn s;
+    if (sock_open(&s, path, stream, batch) != 0) return 1;
+    printf("Listening on %s (%s, %s, every %.1f s) ...\n", path, format_names[fmt],
+           stream ? "stream" : "datagrams", interval);
+    signal(SIGINT, follow_sigint);
+
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+    SnapLatMap lat = { 0 };
+    ListenCtx ctx = { fmt, &lat };
+    struct timespec t0, next, now;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    next = t0;
+    int done = 0, lines_at_refresh = 0, err = 0;
+    uint64_t calls_at_refresh = 0, msgs_at_refresh = 0;
+    double ingest = 0;
+
+    while (!err) {
+        next.tv_sec += (time_t)interval;
+        next.tv_nsec += (long)((interval - (time_t)interval) * 1e9);
+        if (next.tv_nsec >= 1000000000L) { next.tv_sec++; next.tv_nsec -= 1000000000L; }
+        for (;;) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int ms = (int)((next.tv_sec - now.tv_sec) * 1000 + (next.tv_nsec - now.tv_nsec) / 1000000);
+            if ((ms > 0 && !follow_stop ? sock_wait(&s, ms) : 1)) {
+                struct timespec r0;
+                clock_gettime(CLOCK_MONOTONIC, &r0);
+                if (sock_read(&s, listen_batch, &ctx) < 0) {
+                    perror("recv");
+                    err = 1;
+                    break;
+                }
+                ingest += elapsed_since(&r0) * 1e3;
+            }
+            if (ms <= 0 || follow_stop) break;
+        }
+
+        char note[64];
+        snprintf(note, sizeof(note), "  msgs %llu", (unsigned long long)s.msgs);
+        follow_report(&lat, elapsed_since(&t0), total_lines - lines_at_refresh, s.bytes, note);
+        uint64_t calls = s.calls - calls_at_refresh, msgs = s.msgs - msgs_at_refresh;
+        printf("  refresh: ingest %.2f ms", ingest);
+        if (!stream && calls)
+            printf(", %llu recvmmsg (%.1f msgs each)", (unsigned long long)calls, (double)msgs / calls);
+        printf("\n  backpressure: %llu queue-full batches, %llu truncated, %llu overlong, %llu refused\n\n",
+               (unsigned long long)s.full_batches, (unsigned long long)s.truncated,
+               (unsigned long long)s.overlong, (unsigned long long)s.refused);
+        fflush(stdout);
+        lines_at_refresh = total_lines;
+        calls_at_refresh = s.calls;
+        msgs_at_refresh = s.msgs;
+        ingest = 0;
+        if (follow_stop || (refreshes > 0 && ++done >= refreshes)) break;
+    }
+
+    sock_close(&s);
+    free(lat.slot);
+    free(latencies);
+    return err;
+}
+
+/* ── bench-ingest ── */
+
+typedef struct {
+    SockIn   *s;
+    int       fmt;
+    uint64_t  expect;           /* messages to wait for; final once sending ends */
+    uint64_t  received;
+    uint64_t *mark_msgs;        /* messages ingested after each batch ... */
+    uint64_t *mark_ns;          /* ... and when */
+    size_t    n_marks;
+} IngestRecv;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void ingest_batch(void *ctx, const char *buf, size_t len, int n) {
+    IngestRecv *r = ctx;
+    analyze_formatted(buf, len, r->fmt);
+    r->received += (uint64_t)n;
+    r->mark_msgs[r->n_marks] = r->received;
+    r->mark_ns[r->n_marks++] = now_ns();
+}
+
+static void *ingest_recv_run(void *arg) {
+    IngestRecv *r = arg;
+    while (r->received < __atomic_load_n(&r->expect, __ATOMIC_ACQUIRE)) {
+        sock_wait(r->s, 5);
+        if (sock_read(r->s, ingest_batch, r) < 0) break;
+    }
+    return NULL;
+}
+
+/*
+ * Load generator and receiver in one process: the receiver thread runs
+ * the listen path, the main thread sends syslog-framed access-log lines
+ * flat out (blocking sends: throughput under backpressure) or paced to a
+ * target rate (nonblocking datagrams: a full queue is a drop, as with a
+ * syslog forwarder).  Ingestion latency is send to aggregated: Unix
+ * sockets keep order, so the k-th message sent is the k-th ingested and
+ * each one's latency is the end of its batch minus its send time.
+ */
+static int cmd_bench_ingest(int argc, char **argv) {
+    int n = argc > 0 ? atoi(argv[0]) : 200000;
+    int rate = argc > 1 ? atoi(argv[1]) : 50000;
+    const char *log_path = "/tmp/bench.ingest.log";
+    char sock_path[64];
+    snprintf(sock_path, sizeof(sock_path), "/tmp/la-ingest-%d.sock", (int)getpid());
+
+    generate_log(log_path, n, FMT_APACHE);
+    size_t len;
+    char *log = load_file(log_path, &len);
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+
+    /* Reference: the file itself. */
+    reset_state();
+    analyze_formatted(log, len, FMT_APACHE);
+    int ref_lines = total_lines, ref_status[600];
+    memcpy(ref_status, status_counts, sizeof(ref_status));
+
+    /* Messages as rsyslog forwards them: RFC 3164 header, then the line. */
+    static const char hdr[] = "<134>Feb 28 10:00:00 web01 httpd[812]: ";
+    char *msgs = malloc(len + (size_t)n * (sizeof(hdr) - 1));
+    size_t *off = malloc(((size_t)n + 1) * sizeof(size_t)), m_len = 0;
+    int count = 0;
+    for (const char *p = log, *end = log + len; p < end && count < n; count++) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t l = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+        off[count] = m_len;
+        memcpy(msgs + m_len, hdr, sizeof(hdr) - 1);
+        memcpy(msgs + m_len + sizeof(hdr) - 1, p, l);
+        m_len += sizeof(hdr) - 1 + l;
+        p += l;
+    }
+    off[count] = m_len;
+    free(log);
+
+    uint64_t *send_ns = malloc((size_t)count * sizeof(uint64_t));
+    uint64_t *mark_msgs = malloc(((size_t)count + 1) * sizeof(uint64_t));
+    uint64_t *mark_ns = malloc(((size_t)count + 1) * sizeof(uint64_t));
+    double *lat_us = malloc((size_t)count * sizeof(double));
+
+    printf("Benchmark: %d syslog messages over a Unix socket (net.unix.max_dgram_qlen %d)\n\n",
+           count, sock_max_dgram_qlen());
+    printf("%-12s %9s %9s %8s %10s %7s %9s %9s %9s  %s\n", "mode", "target/s", "sent", "dropped",
+           "msgs/s", "/call", "p50 us", "p99 us", "max us", "result");
+
+    static const struct { const char *name; int stream, batch; } modes[] = {
+        { "dgram x64", 0, SOCK_BATCH },
+        { "dgram x1",  0, 1 },
+        { "stream",    1, 0 },
+    };
+    int ok = 1;
+    for (int paced = 0; paced < 2; paced++) {
+        for (size_t mi = 0; mi < sizeof(modes) / sizeof(modes[0]); mi++) {
+            SockIn s;
+            if (sock_open(&s, sock_path, modes[mi].stream, modes[mi].batch) != 0) return 1;
+            int fd = socket(AF_UNIX, modes[mi].stream ? SOCK_STREAM : SOCK_DGRAM, 0);
+            struct sockaddr_un a = { .sun_family = AF_UNIX };
+            strcpy(a.sun_path, sock_path);
+            if (fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0) {
+                perror("connect");
+                return 1;
+            }
+
+            reset_state();
+            IngestRecv r = { &s, FMT_APACHE, UINT64_MAX, 0, mark_msgs, mark_ns, 0 };
+            pthread_t tid;
+            pthread_create(&tid, NULL, ingest_recv_run, &r);
+
+            uint64_t sent = 0, dropped = 0, t0 = now_ns();
+            int flags = paced && !modes[mi].stream ? MSG_DONTWAIT : 0;
+            for (int k = 0; k < count; k++) {
+                if (paced) {
+                    /* Sleep until this message is due; late ones go at once. */
+                    uint64_t due = t0 + (uint64_t)((double)k * 1e9 / rate), t = now_ns();
+                    if (t < due) {
+                        struct timespec d = { 0, (long)(due - t) };
+                        nanosleep(&d, NULL);
+                    }
+                }
+                const char *p = msgs + off[k];
+                size_t l = off[k + 1] - off[k];
+                uint64_t t = now_ns();
+                ssize_t w;
+                if (modes[mi].stream) {
+                    for (size_t done = 0; done < l; done += (size_t)w)
+                        if ((w = write(fd, p + done, l - done)) <= 0) { perror("write"); return 1; }
+                } else if ((w = send(fd, p, l, flags)) < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) { perror("send"); return 1; }
+                    dropped++;
+                    continue;
+                }
+                send_ns[sent++] = t;
+            }
+            close(fd);
+            __atomic_store_n(&r.expect, sent, __ATOMIC_RELEASE);
+            pthread_join(tid, NULL);
+            double sec = (now_ns() - t0) / 1e9;
+
+            size_t m = 0;
+            for (uint64_t k = 0; k < sent; k++) {
+                while (mark_msgs[m] <= k) m++;
+                lat_us[k] = (mark_ns[m] - send_ns[k]) / 1e3;
+            }
+            qsort(lat_us, sent, sizeof(double), cmp_double);
+
+            int match = total_lines == (int)sent && parse_errors == 0;
+            if (!dropped) match &= total_lines == ref_lines &&
+                                   memcmp(status_counts, ref_status, sizeof(ref_status)) == 0;
+            ok &= match;
+            char target[16];
+            snprintf(target, sizeof(target), paced ? "%d" : "max", rate);
+            char per_call[16] = "-";
+            if (!modes[mi].stream && s.calls)
+                snprintf(per_call, sizeof(per_call), "%.1f", (double)s.msgs / s.calls);
+            char lat[3][16] = { "-", "-", "-" };         /* p50, p99, max; none if nothing went */
+            if (sent) {
+                snprintf(lat[0], sizeof(lat[0]), "%.1f", lat_us[sent / 2]);
+                snprintf(lat[1], sizeof(lat[1]), "%.1f", lat_us[sent * 99 / 100]);
+                snprintf(lat[2], sizeof(lat[2]), "%.1f", lat_us[sent - 1]);
+            }
+            printf("%-12s %9s %9llu %8llu %10.0f %7s %9s %9s %9s  %s\n", modes[mi].name,
+                   target, (unsigned long long)sent, (unsigned long long)dropped, sent / sec,
+                   per_call, lat[0], lat[1], lat[2],
+                   match ? (dropped ? "PASS (received all sent)" : "PASS") : "FAIL");
+            sock_close(&s);
+        }
+    }
+    free(msgs);
+    free(off);
+    free(send_ns);
+    free(mark_msgs);
+    free(mark_ns);
+    free(lat_us);
+    free(latencies);
+    return ok ? 0 : 1;
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+static const struct {
+    const char *name;
+    int (*run)(int argc, char **argv);
+} commands[] = {
+    { "bench-formats", cmd_bench_formats },
+    { "bench-swar",    cmd_bench_swar },
+    { "bench-hist",    cmd_bench_hist },
+    { "bench-query",   cmd_bench_query },
+    { "bench-agg",     cmd_bench_agg },
+    { "bench-routes",  cmd_bench_routes },
+    { "bench-quantiles", cmd_bench_quantiles },
+    { "bench-files",   cmd_bench_files },
+    { "bench-anomaly", cmd_bench_anomaly },
+    { "merge",         cmd_merge },
+    { "follow",        cmd_follow },
+    { "bench-sample",  cmd_bench_sample },
+    { "listen",        cmd_listen },
+    { "bench-ingest",  cmd_bench_ingest },
+};
+
+int main(int argc, char **argv) {
+    for (size_t c = 0; argc > 1 && c < sizeof(commands) / sizeof(commands[0]); c++)
+        if (strcmp(argv[1], commands[c].name) == 0)
+            return commands[c].run(argc - 2, argv + 2);
+
+    int num_lines = 500000;
+    const char *logfile = "/tmp/access.log";
+    int passes = 30;  /* re-analyze the file multiple times for stable profiling */
+    int skip_gen = 0;
+    int fmt = -1;     /* -1: original fgets + parse_line path */
+    int use_query = 0;
+    int threads = 0;  /* 0: serial */
+    int use_mmap = 0; /* formatted paths: map the log instead of reading it */
+    int backend = AGG_LOCAL;
+    RouteTrie route_trie;
+    const char *snapshot = NULL;
+    int sample_rate = 0, sample_by = SAMPLE_BY_CHUNK;
+    uint64_t seed = 1;
+    SampleEstimate sample_est;
+    size_t ext_budget = 0;
+    int rate_limit = 0;
+    int anomaly_sec = 0;
+    double anomaly_k = 4.0;
+    AnomDetector anomaly_det;
+    size_t rate_keys = 1 << 16;
+    RateTable rate_table;
+    char **log_paths = malloc(argc * sizeof(char *));
+    int n_logs = 0, steal = 1, n_files = 0;
+    size_t chunk = WS_CHUNK;
+    WsFile *files = NULL;
+    WsPool pool;
+    uint64_t files_bytes = 0;
+    const char *spill_dir = "/tmp";
+    ExtResult ext_res = { 0 };
+    double ext_ms[2] = { 0, 0 };
+    Query query;
+    query_init(&query);
+    if (argc > 1) num_lines = atoi(argv[1]);
+    if (argc > 2) passes = atoi(argv[2]);
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            skip_gen = 1;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            fmt = format_from_name(argv[++i]);
+            if (fmt < 0) { fprintf(stderr, "unknown format: %s\n", argv[i]); return 1; }
+        } else if (strcmp(argv[i], "--json-keys") == 0 && i + 1 < argc) {
+            if (json_keys_parse(&json_keys, argv[++i]) != 0) {
+                fprintf(stderr, "--json-keys wants ip,status,latency,path[,method]\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--agg") == 0 && i + 1 < argc) {
+            for (backend = 0; backend < AGG_BACKENDS; backend++)
+                if (strcmp(argv[i + 1], agg_names[backend]) == 0) break;
+            if (backend == AGG_BACKENDS) {
+                fprintf(stderr, "--agg wants local, shared or split\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--routes") == 0 && i + 1 < argc) {
+            route_init(&route_trie);
+            routes = &route_trie;
+            if (strcmp(argv[++i], "auto") != 0 && route_add_list(routes, argv[i]) != 0) {
+                fprintf(stderr, "--routes wants auto or /path/:id,... templates\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--id-paths") == 0) {
+            gen_id_paths = 1;
+        } else if (strcmp(argv[i], "--steady-times") == 0) {
+            gen_steady_times = 1;
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            logfile = argv[++i];        /* an existing log: implies -s */
+            log_paths[n_logs++] = argv[i];
+            skip_gen = 1;
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunk = (size_t)atoi(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--no-steal") == 0) {
+            steal = 0;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            use_mmap = 1;
+        } else if (strcmp(argv[i], "--methods") == 0) {
+            count_methods = 1;
+        } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            sample_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sample-by") == 0 && i + 1 < argc) {
+            for (sample_by = 0; sample_by < SAMPLE_UNITS; sample_by++)
+                if (strcmp(argv[i + 1], sample_unit_names[sample_by]) == 0) break;
+            if (sample_by == SAMPLE_UNITS) {
+                fprintf(stderr, "--sample-by wants chunk or line\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--external") == 0 && i + 1 < argc) {
+            ext_budget = (size_t)atoi(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+            for (ext_key = 0; ext_key < EXT_KEYS; ext_key++)
+                if (strcmp(argv[i + 1], ext_key_names[ext_key]) == 0) break;
+            if (ext_key == EXT_KEYS) {
+                fprintf(stderr, "--key wants ip or ip+path\n");
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--spill-dir") == 0 && i + 1 < argc) {
+            spill_dir = argv[++i];
+        } else if (strcmp(argv[i], "--rate-limit") == 0 && i + 1 < argc) {
+            rate_limit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate-keys") == 0 && i + 1 < argc) {
+            rate_keys = (size_t)atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--anomaly") == 0 && i + 1 < argc) {
+            anomaly_sec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--anomaly-k") == 0 && i + 1 < argc) {
+            anomaly_k = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshot = argv[++i];
+        } else if (strcmp(argv[i], "--select") == 0 && i + 1 < argc) {
+            use_query = 1;
+            if (query_select(&query, argv[++i]) != 0) {
+                fprintf(stderr, "--select wants a subset of ip,status,latency,path,method\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+            use_query = 1;
+            if (query_where(&query, argv[++i]) != 0) {
+                fprintf(stderr, "bad predicate: %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    /* Several logs, or a directory of them: the chunk scheduler, on the
+     * --threads path. */
+    struct stat log_st;
+    int multi = n_logs > 1 || (n_logs == 1 && stat(logfile, &log_st) == 0 && S_ISDIR(log_st.st_mode));
+    if (multi) {
+        if (threads == 0) threads = 1;
+        if (backend != AGG_LOCAL || fmt == FMT_JSONL || chunk == 0) {
+            fprintf(stderr, "several logs need --agg local, a fixed format and --chunk >= 1\n");
+            return 1;
+        }
+    }
+    if (anomaly_sec > 0 && !routes) {
+        route_init(&route_trie);        /* endpoints are learned templates */
+        routes = &route_trie;
+    }
+    if ((use_query || threads > 0 || routes || ext_budget || rate_limit > 0 || use_mmap ||
+         count_methods) && fmt < 0)
+        fmt = FMT_APACHE;   /* needs a descriptor */
+    if (count_methods && (use_query || sample_rate > 0 || ext_budget)) {
+        fprintf(stderr, "--methods needs the full record, not --select/--where/--sample/--external\n");
+        return 1;
+    }
+    if ((use_query || routes) && threads > 0) {
+        fprintf(stderr, "--select/--where/--routes are serial only\n");
+        return 1;
+    }
+    if (sample_rate > 0 && (use_query || threads > 0 || routes || snapshot)) {
+        fprintf(stderr, "--sample runs the serial parse path only\n");
+        return 1;
+    }
+    if (ext_budget && (use_query || threads > 0 || routes || snapshot || sample_rate > 0)) {
+        fprintf(stderr, "--external is serial and exclusive of the other modes\n");
+        return 1;
+    }
+    if (rate_limit > 0) {
+        if (use_query || threads > 0 || sample_rate > 0 || ext_budget) {
+            fprintf(stderr, "--rate-limit runs in the serial full-record path only\n");
+            return 1;
+        }
+        if (fmt == FMT_JSONL) {
+            fprintf(stderr, "--rate-limit needs a fixed layout for timestamps, not jsonl\n");
+            return 1;
+        }
+        rate_init(&rate_table, rate_keys > 0 ? rate_keys : 1, (uint32_t)rate_limit);
+        rates = &rate_table;
+        time_fmt = fmt;
+    }
+    if (use_query && routes) {
+        fprintf(stderr, "--routes needs the full record, not --select/--where\n");
+        return 1;
+    }
+    if (anomaly_sec > 0) {
+        if (fmt == FMT_JSONL) {
+            fprintf(stderr, "--anomaly needs a fixed layout for timestamps, not jsonl\n");
+            return 1;
+        }
+        anom_init(&anomaly_det, anomaly_sec, 0.1, anomaly_k);
+        anomaly = &anomaly_det;
+        time_fmt = fmt;
+    }
+
+    /* Phase 1: generate (skip with -s flag, useful for profiling) */
+    if (!skip_gen) {
+        printf("Generating %d log lines to %s ...\n", num_lines, logfile);
+        generate_log(logfile, num_lines, fmt < 0 ? FMT_APACHE : fmt);
+    } else {
+        printf("Skipping generation, using existing %s\n", logfile);
+    }
+    if (multi) {
+        char **list;
+        n_files = ws_list_files(log_paths, n_logs, &list);
+        if (n_files <= 0) {
+            if (n_files == 0) fprintf(stderr, "no log files in %s\n", logfile);
+            return 1;
+        }
+        files = calloc(n_files, sizeof(WsFile));
+        for (int i = 0; i < n_files; i++) {
+            if (ws_map(&files[i], list[i]) != 0) return 1;
+            files_bytes += files[i].size;
+        }
+        free(list);             /* the paths stay referenced by files[] */
+    }
+
+    /* Phase 2: analyze (timed) — run 'passes' iterations, keep last results */
+    printf("Analyzing (%d passes%s%s) ...\n", passes,
+           fmt < 0 ? "" : ", format ", fmt < 0 ? "" : format_names[fmt]);
+    lat_cap = INIT_LAT;
+    latencies = malloc(lat_cap * sizeof(double));
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    double bytes_parsed = 0;
+
+    for (int pass = 0; pass < passes; pass++) {
+        reset_state();
+
+        if (ext_budget) {
+            if (analyze_external(logfile, fmt, ext_budget, spill_dir, &ext_res, ext_ms) != 0)
+                return 1;
+            continue;
+        }
+
+        if (sample_rate > 0) {
+            if (analyze_sampled(logfile, fmt, sample_by, sample_rate, seed, &sample_est) != 0)
+                return 1;
+            continue;
+        }
+
+        if (files) {
+            if (pass > 0) ws_free(&pool);
+            analyze_files(&pool, files, n_files, fmt, threads, chunk, steal);
+            bytes_parsed += (double)files_bytes;
+            continue;
+        }
+
+        if (fmt >= 0) {
+            size_t len;
+            char *heap = NULL;
+            const char *buf;
+            WsFile map;
+            if (use_mmap) {
+                if (ws_map(&map, logfile) != 0) return 1;
+                buf = map.map;
+                len = map.size;
+            } else {
+                buf = heap = load_file(logfile, &len);
+            }
+            if (use_query)        analyze_query(&query, buf, len, fmt);
+            else if (threads > 0) {
+                if (analyze_parallel(buf, len, fmt, threads, backend) != 0) return 1;
+            }
+            else                  analyze_formatted(buf, len, fmt);
+            bytes_parsed += (double)len;
+            if (use_mmap) ws_unmap(&map);
+            free(heap);
+            continue;
+        }
+
+        FILE *f = fopen(logfile, "r");
+        if (!f) { perror("fopen"); return 1; }
+
+        char line[MAX_LINE];
+        char ip[48];
+        int  status;
+        double rtime;
+
+        while (fgets(line, sizeof(line), f)) {
+            total_lines++;
+            if (parse_line(line, ip, &status, &rtime) != 0) {
+                parse_errors++;
+                continue;
+            }
+            record_hit(ip, status, rtime);
+        }
+        fclose(f);
+    }
+
+    if (ext_budget) {
+        print_external(&ext_res, ext_budget, spill_dir, ext_ms);
+        ext_result_free(&ext_res);
+        free(ext_lat.slot);
+        free(latencies);
+        return 0;
+    }
+
+    if (sample_rate > 0) {
+        print_sampled(&sample_est, elapsed_since(&t0));
+        free(latencies);
+        free(lat_group);
+        return 0;
+    }
+
+    /* Sort latencies for percentiles; the optimized paths select the three
+     * ranks directly instead. */
+    const size_t pct_rank[3] = { (size_t)lat_count * 50 / 100, (size_t)lat_count * 95 / 100,
+                                 (size_t)lat_count * 99 / 100 };
+    double pct[3] = { 0, 0, 0 };
+    if (fmt < 0) {
+        qsort(latencies, lat_count, sizeof(double), cmp_double);
+        for (int i = 0; i < 3 && lat_count > 0; i++) pct[i] = latencies[pct_rank[i]];
+    } else {
+        quantiles_exact(latencies, lat_count, pct_rank, 3, pct, threads);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    /* ── Output ── */
+    printf("\n=== Log Analysis Results ===\n");
+    printf("Lines processed: %d\n", total_lines);
+    printf("Parse errors:    %d\n", parse_errors);
+    if (use_query)
+        printf("Filtered out:    %d\n", filtered_lines);
+    printf("Unique IPs:      %d\n", ip_table_size);
+    printf("Analysis time:   %.3f s  (%.0f lines/sec)\n",
+           elapsed, total_lines / elapsed);
+    if (bytes_parsed > 0)
+        printf("Throughput:      %.2f GB/s\n", bytes_parsed / elapsed / 1e9);
+    printf("\n");
+
+    printf("Status Distribution:\n");
+    for (int s = 100; s < 600; s++)
+        if (status_counts[s] > 0)
+            printf("  %d: %7d  (%5.1f%%)\n", s, status_counts[s],
+                   100.0 * status_counts[s] / total_lines);
+    if (count_methods) print_method_table();
+
+    if (lat_count > 0) {
+        printf("\nLatency Percentiles:\n");
+        printf("  p50: %.1f ms\n", pct[0]);
+        printf("  p95: %.1f ms\n", pct[1]);
+        printf("  p99: %.1f ms\n", pct[2]);
+    }
+
+    qsort(ip_table, HASH_SIZE, sizeof(IPEntry), cmp_ip_count);
+    printf("\nTop 10 IPs:\n");
+    for (int i = 0; i < 10 && ip_table[i].count > 0; i++)
+        printf("  %-20s %7d reqs  avg %.1f ms\n",
+               ip_table[i].ip, ip_table[i].count,
+               ip_table[i].total_time / ip_table[i].count);
+
+    if (snapshot && write_snapshot(snapshot) != 0) return 1;
+
+    if (routes) {
+        printf("\nTop 10 Endpoints (%d routes, %d learned):\n",
+               routes->n_routes - 1, routes->n_learned);
+        route_print_top(routes, 10);
+    }
+
+    if (anomaly) {
+        anom_flush(anomaly);
+        print_anomaly_report(anomaly, routes);
+        anom_free(anomaly);
+    }
+    if (routes) route_free(routes);
+
+    if (rates) {
+        print_rate_offenders(rates);
+        rate_free(rates);
+    }
+
+    if (files) {
+        print_schedule(&pool, n_files, files_bytes, chunk);
+        ws_free(&pool);
+        for (int i = 0; i < n_files; i++) {
+            ws_unmap(&files[i]);
+            free((char *)files[i].path);
+        }
+        free(files);
+    }
 
+    free(log_paths);
     free(latencies);
     return 0;
 }
@@ -0,0 +1,419 @@
+/*
+ * log_formats.c — Compile-time specialized parsers for several log layouts
+ *
+ * Each layout is described once as an X-macro list of (FIELD, DELIM)
+ * steps: "the bytes up to the next DELIM are FIELD".  DEFINE_LOG_FORMAT
+ * expands a descriptor into a straight-line parse_fmt_<name>() with the
+ * delimiters and field handlers baked in as constants, so the compiler
+ * emits one specialized parser per layout — no format-string
+ * interpretation and no per-field switch at run time.
+ *
+ * Fields nobody aggregates (dates, referers, user agents, protocol) are
+ * SKIP steps: scan_byte() jumps over them 16 bytes at a time and the
+ * store handler compiles away.
+ *
+ * Supported layouts (see generate_log() for exact samples):
+ *   apache  IP - - [date] "METHOD /path HTTP/1.1" STATUS SIZE TIME_MS
+ *   nginx   combined + $request_time (seconds) as the last column
+ *   tsv     ts \t ip \t method \t path \t status \t size \t time_ms
+ *   json    JSON lines with a fixed key order (ts, ip, method, path,
+ *           status, bytes, latency_ms) and no escapes in values
+ *   jsonl   arbitrary JSON lines; not a descriptor, see json_index.c
+ *
+ * #included by log_analyzer.c after simd_scan.c and swar_int.c.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *ip;     int ip_len;
+    const char *method; int method_len;
+    const char *path;   int path_len;
+    int    status;
+    long   size;
+    double latency_ms;
+    const char *line;   /* line start, for fields parsed on demand */
+} LogRecord;
+
+enum { FMT_APACHE, FMT_NGINX, FMT_TSV, FMT_JSON, FMT_JSONL, FMT_COUNT };
+
+static const char *const format_names[FMT_COUNT] = {
+    "apache", "nginx", "tsv", "json", "jsonl",
+};
+
+static int format_from_name(const char *name) {
+    for (int i = 0; i < FMT_COUNT; i++)
+        if (strcmp(name, format_names[i]) == 0) return i;
+    return -1;
+}
+
+/* ── Field conversion ───────────────────────────────────────────────────── */
+
+static const double pow10_tab[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ * Decimal "123.45" in [b, e) times 10^exp10.  Mantissa and power of ten
+ * are both exact doubles on the fast path, so the single division or
+ * multiplication is correctly rounded and matches atof()/strtod() bit
+ * for bit.  Anything outside that range falls back to strtod.
+ */
+static double lf_decimal(const char *b, const char *e, int exp10) {
+    uint64_t mant = 0;
+    int digits = 0, frac = 0, seen_dot = 0;
+    const char *p = b;
+    for (; p < e; p++) {
+        unsigned d = (unsigned char)*p - '0';
+        if (d < 10) {
+            mant = mant * 10 + d;
+            digits++;
+            frac += seen_dot;
+        } else if (*p == '.' && !seen_dot) {
+            seen_dot = 1;
+        } else {
+            break;
+        }
+    }
+    int scale = frac - exp10;
+    if (digits > 0 && digits <= 15 && scale >= -22 && scale <= 22)
+        return scale >= 0 ? (double)mant / pow10_tab[scale]
+                          : (double)mant * pow10_tab[-scale];
+
+    char tmp[64];
+    size_t n = (size_t)(e - b) < sizeof(tmp) - 1 ? (size_t)(e - b) : sizeof(tmp) - 1;
+    memcpy(tmp, b, n);
+    tmp[n] = '\0';
+    return strtod(tmp, NULL) * (exp10 ? pow10_tab[exp10] : 1.0);
+}
+
+/* Dotted-quad IPv4 in [b, e) → host-order u32.  Returns -1 otherwise. */
+static inline int lf_ipv4(const char *b, const char *e, uint32_t *out) {
+    uint32_t ip = 0, part = 0;
+    int dots = 0, digits = 0;
+    for (; b < e; b++) {
+        unsigned d = (unsigned char)*b - '0';
+        if (d < 10) {
+            part = part * 10 + d;
+            if (++digits > 3 || part > 255) return -1;
+        } else if (*b == '.' && digits && dots < 3) {
+            ip = ip << 8 | part;
+            part = 0;
+            digits = 0;
+            dots++;
+        } else {
+            return -1;
+        }
+    }
+    if (dots != 3 || !digits) return -1;
+    *out = ip << 8 | part;
+    return 0;
+}
+
+/* ── Timestamps ─────────────────────────────────────────────────────────── */
+
+/*
+ * Request times are SKIP steps in every descriptor; the few consumers
+ * that need them (rate windows, anomaly buckets) parse them on demand
+ * from rec.line.
+ */
+
+/* Last common-log-format time text parsed: a log repeats each second many times. */
+typedef struct {
+    char    text[26];
+    int64_t sec;
+} LfTimeMemo;
+
+/* Days since 1970-01-01 of a proleptic Gregorian date. */
+static inline int64_t lf_days(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (unsigned)((153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1);
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static inline int lf_2d(const char *p) {
+    unsigned a = (unsigned char)p[0] - '0', b = (unsigned char)p[1] - '0';
+    return a > 9 || b > 9 ? -100 : (int)(a * 10 + b);
+}
+
+/* "+hhmm" / "-hh:mm" / "Z" at p, as seconds east of UTC. */
+static int lf_zone(const char *p, const char *e, int *off) {
+    *off = 0;
+    if (p >= e || *p == 'Z' || (*p != '+' && *p != '-')) return 0;
+    if (e - p < 5) return -1;
+    int h = lf_2d(p + 1), m = lf_2d(p + (p[3] == ':' ? 4 : 3));
+    if (h < 0 || m < 0) return -1;
+    *off = (*p == '-' ? -1 : 1) * (h * 3600 + m * 60);
+    return 0;
+}
+
+static int lf_hms(const char *p, int64_t days, int64_t *out) {
+    int H = lf_2d(p), M = lf_2d(p + 3), S = lf_2d(p + 6);
+    if (H < 0 || M < 0 || S < 0 || p[2] != ':' || p[5] != ':') return -1;
+    *out = days * 86400 + H * 3600 + M * 60 + S;
+    return 0;
+}
+
+/* "28/Feb/2026:10:00:00 +0000" (common log format) as Unix seconds. */
+static int lf_time_clf(const char *p, const char *e, int64_t *out) {
+    static const char mon[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (e - p < 20 || p[2] != '/' || p[6] != '/' || p[11] != ':') return -1;
+    int m = 0;
+    while (m < 12 && memcmp(mon + 3 * m, p + 3, 3) != 0) m++;
+    int d = lf_2d(p), y = lf_2d(p + 7) * 100 + lf_2d(p + 9), off;
+    if (m == 12 || d < 0 || y < 0 || lf_hms(p + 12, lf_days(y, m + 1, d), out) != 0) return -1;
+    if (p + 20 < e && p[20] == ' ' && lf_zone(p + 21, e, &off) == 0) *out -= off;
+    return 0;
+}
+
+/* "2026-02-28T10:00:00Z" (ISO 8601; fractions ignored) as Unix seconds. */
+static int lf_time_iso(const char *p, const char *e, int64_t *out) {
+    if (e - p < 19 || p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ')) return -1;
+    int y = lf_2d(p) * 100 + lf_2d(p + 2), m = lf_2d(p + 5), d = lf_2d(p + 8), off;
+    if (y < 0 || m < 1 || m > 12 || d < 0 || lf_hms(p + 11, lf_days(y, m, d), out) != 0)
+        return -1;
+    p += 19;
+    if (p < e && *p == '.') while (++p < e && (unsigned)(*p - '0') <= 9) {}
+    if (lf_zone(p, e, &off) == 0) *out -= off;
+    return 0;
+}
+
+/*
+ * Request time of a record parsed by a descriptor format, from rec.line;
+ * the time precedes the path in every layout, so that bounds the search.
+ * memo (optional, zeroed before first use) skips reparsing a repeat.
+ */
+static int lf_timestamp(LfTimeMemo *memo, int fmt, const LogRecord *r, int64_t *out) {
+    const char *p = r->line, *e = r->path;
+    switch (fmt) {
+    case FMT_APACHE:
+    case FMT_NGINX:
+        p = memchr(p, '[', (size_t)(e - p));
+        if (!p) return -1;
+        p++;
+        if (memo && e - p >= 26 && memcmp(memo->text, p, 26) == 0) {
+            *out = memo->sec;
+            return 0;
+        }
+        if (lf_time_clf(p, e, out) != 0) return -1;
+        if (memo && e - p >= 26) {
+            memcpy(memo->text, p, 26);
+            memo->sec = *out;
+        }
+        return 0;
+    case FMT_TSV:
+        return lf_time_iso(p, e, out);
+    case FMT_JSON:                                  /* {"ts":"…" */
+        p = memchr(p, ':', (size_t)(e - p));
+        return p && p + 2 < e && p[1] == '"' ? lf_time_iso(p + 2, e, out) : -1;
+    }
+    return -1;
+}
+
+/* ── Per-field store handlers (0 = ok, -1 = reject line) ─────────────────── */
+
+static inline int lf_store_SKIP(LogRecord *r, const char *b, const char *e) {
+    (void)r; (void)b; (void)e;
+    return 0;
+}
+
+static inline int lf_store_IP(LogRecord *r, const char *b, const char *e) {
+    r->ip = b;
+    r->ip_len = (int)(e - b);
+    return r->ip_len > 0 ? 0 : -1;
+}
+
+static inline int lf_store_METHOD(LogRecord *r, const char *b, const char *e) {
+    r->method = b;
+    r->method_len = (int)(e - b);
+    return 0;
+}
+
+static inline int lf_store_PATH(LogRecord *r, const char *b, const char *e) {
+    r->path = b;
+    r->path_len = (int)(e - b);
+    return 0;
+}
+
+static inline int lf_store_STATUS(LogRecord *r, const char *b, const char *e) {
+    if (e - b != 3) return -1;
+    unsigned d0 = (unsigned char)b[0] - '0';
+    unsigned d1 = (unsigned char)b[1] - '0';
+    unsigned d2 = (unsigned char)b[2] - '0';
+    if (d0 > 9 || d1 > 9 || d2 > 9) return -1;
+    r->status = (int)(d0 * 100 + d1 * 10 + d2);
+    return (r->status < 100 || r->status > 599) ? -1 : 0;
+}
+
+static inline int lf_store_SIZE(LogRecord *r, const char *b, const char *e) {
+    long v = 0;
+    for (; b < e; b++) {
+        unsigned d = (unsigned char)*b - '0';
+        if (d > 9) break;
+        v = v * 10 + d;
+    }
+    r->size = v;
+    return 0;
+}
+
+static inline int lf_store_LAT_MS(LogRecord *r, const char *b, const char *e) {
+    r->latency_ms = lf_decimal(b, e, 0);
+    return 0;
+}
+
+static inline int lf_store_LAT_S(LogRecord *r, const char *b, const char *e) {
+    r->latency_ms = lf_decimal(b, e, 3);
+    return 0;
+}
+
+/* ── Per-field steps (field end, or NULL = reject line) ─────────────────── */
+
+/* Delimiter meaning "rest of the line" — no scan needed. */
+#define LF_EOL '\n'
+
+/* Most fields: scan for the delimiter, then store [p, e). */
+#define LF_SCAN_FIELD(NAME, FIELD)                                          \
+    static inline const char *lf_field_##NAME(LogRecord *r, const char *p,  \
+                                              const char *end, char delim) { \
+        const char *e = delim == LF_EOL ? end : scan_byte(p, end, delim);   \
+        if (delim != LF_EOL && e == end) return NULL;                       \
+        return lf_store_##FIELD(r, p, e) ? NULL : e;                        \
+    }
+
+LF_SCAN_FIELD(SKIP, SKIP)
+LF_SCAN_FIELD(IP, IP)
+LF_SCAN_FIELD(METHOD, METHOD)
+LF_SCAN_FIELD(PATH, PATH)
+LF_SCAN_FIELD(LAT_MS, LAT_MS)
+LF_SCAN_FIELD(LAT_S, LAT_S)
+LF_SCAN_FIELD(STATUS_SCAN, STATUS)
+LF_SCAN_FIELD(SIZE_SCAN, SIZE)
+
+/*
+ * Status and size are found and converted in one 8-byte load (see
+ * swar_int.c) when the line has 8 bytes left; the scan is the fallback.
+ * A status is exactly three digits and a delimiter, so the SWAR verdict
+ * is final; a size that is not 1..8 digits and a delimiter ("-", or
+ * 100 MB and up) takes the scan to keep its leading-digits value.
+ */
+static inline const char *lf_field_STATUS(LogRecord *r, const char *p,
+                                          const char *end, char delim) {
+#ifdef SWAR_INT
+    if (delim != LF_EOL && end - p >= 8) {
+        r->status = swar_status(p, delim);
+        return r->status < 0 ? NULL : p + 3;
+    }
+#endif
+    return lf_field_STATUS_SCAN(r, p, end, delim);
+}
+
+static inline const char *lf_field_SIZE(LogRecord *r, const char *p,
+                                        const char *end, char delim) {
+#ifdef SWAR_INT
+    if (delim != LF_EOL && end - p >= 8) {
+        int n;
+        uint32_t v = swar_uint8(p, &n);
+        if (n && p + n < end && p[n] == delim) {
+            r->size = v;
+            return p + n;
+        }
+    }
+#endif
+    return lf_field_SIZE_SCAN(r, p, end, delim);
+}
+
+/* ── Descriptor expansion ───────────────────────────────────────────────── */
+
+#define LF_STEP(FIELD, DELIM)                                               \
+    {                                                                       \
+        const char *e_ = lf_field_##FIELD(r, p, end, DELIM);                \
+        if (!e_) return -1;                                                 \
+        p = e_ + 1;                                                         \
+    }
+
+/* Parses one line [p, end), end excluding the newline. */
+#define DEFINE_LOG_FORMAT(NAME, STEPS)                                      \
+    static inline int parse_fmt_##NAME(const char *p, const char *end,     \
+                                       LogRecord *r) {                      \
+        STEPS(LF_STEP)                                                      \
+        (void)p;                                                            \
+        return 0;                                                           \
+    }
+
+/* IP - - [date] "METHOD /path HTTP/1.1" STATUS SIZE TIME_MS */
+#define APACHE_FORMAT(X)                                                    \
+    X(IP,     ' ')                                                          \
+    X(SKIP,   '"')      /* - - [date]    */                                 \
+    X(METHOD, ' ')                                                          \
+    X(PATH,   ' ')                                                          \
+    X(SKIP,   '"')      /* HTTP/1.1      */                                 \
+    X(SKIP,   ' ')                                                          \
+    X(STATUS, ' ')                                                          \
+    X(SIZE,   ' ')                                                          \
+    X(LAT_MS, LF_EOL)
+
+/* IP - user [date] "METHOD /path HTTP/1.1" STATUS SIZE "ref" "ua" TIME_S */
+#define NGINX_FORMAT(X)                                                     \
+    X(IP,     ' ')                                                          \
+    X(SKIP,   '"')                                                          \
+    X(METHOD, ' ')                                                          \
+    X(PATH,   ' ')                                                          \
+    X(SKIP,   '"')                                                          \
+    X(SKIP,   ' ')                                                          \
+    X(STATUS, ' ')                                                          \
+    X(SIZE,   ' ')                                                          \
+    X(SKIP,   '"')      /* open referer  */                                 \
+    X(SKIP,   '"')      /* close referer */                                 \
+    X(SKIP,   '"')      /* open UA       */                                 \
+    X(SKIP,   '"')      /* close UA      */                                 \
+    X(SKIP,   ' ')                                                          \
+    X(LAT_S,  LF_EOL)
+
+#define TSV_FORMAT(X)                                                       \
+    X(SKIP,   '\t')     /* timestamp     */                                 \
+    X(IP,     '\t')                                                         \
+    X(METHOD, '\t')                                                         \
+    X(PATH,   '\t')                                                         \
+    X(STATUS, '\t')                                                         \
+    X(SIZE,   '\t')                                                         \
+    X(LAT_MS, LF_EOL)
+
+/* {"ts":"…","ip":"…","method":"…","path":"…","status":N,"bytes":N,"latency_ms":N} */
+#define JSON_FORMAT(X)                                                      \
+    X(SKIP, '"') X(SKIP, '"') X(SKIP, '"') X(SKIP, '"')   /* {"ts":"…"   */ \
+    X(SKIP, '"') X(SKIP, '"') X(SKIP, '"') X(IP, '"')     /* ,"ip":"…"   */ \
+    X(SKIP, '"') X(SKIP, '"') X(SKIP, '"') X(METHOD, '"') /* ,"method"…  */ \
+    X(SKIP, '"') X(SKIP, '"') X(SKIP, '"') X(PATH, '"')   /* ,"path":"…" */ \
+    X(SKIP, ':') X(STATUS, ',')                                             \
+    X(SKIP, ':') X(SIZE, ',')                                               \
+    X(SKIP, ':') X(LAT_MS, '}')
+
+DEFINE_LOG_FORMAT(apache, APACHE_FORMAT)
+DEFINE_LOG_FORMAT(nginx,  NGINX_FORMAT)
+DEFINE_LOG_FORMAT(tsv,    TSV_FORMAT)
+DEFINE_LOG_FORMAT(json,   JSON_FORMAT)
+
+/*
+ * Runs BODY for every line of buf[0..len) that PARSER accepts, with the
+ * parsed fields in `rec`; rejected lines bump *errors.  A macro rather
+ * than a function taking a parser pointer so each format's loop is its
+ * own specialized copy with the parser inlined.
+ */
+#define FOR_EACH_RECORD(PARSER, buf, len, lines, errors, rec, BODY)         \
+    do {                                                                    \
+        const char *lp_ = (buf), *end_ = (buf) + (len);                     \
+        while (lp_ < end_) {                                                \
+            const char *eol_ = scan_byte(lp_, end_, '\n');                  \
+            LogRecord rec;                                                  \
+            (lines)++;                                                      \
+            rec.line = lp_;                                                 \
+            if (PARSER(lp_, eol_, &rec) == 0) { BODY; }                     \
+            else (errors)++;                                                \
+            lp_ = eol_ + 1;                                                 \
+        }                                                                   \
+    } while (0)
@@ -0,0 +1,330 @@
+/*
+ * parallel_agg.c — Multithreaded IP aggregation backends
+ *
+ *   AGG_LOCAL   every thread fills its own open-addressing table; the
+ *               tables are merged single-threaded at the end.  No
+ *               sharing while parsing, but memory and merge time grow
+ *               with threads × cardinality.
+ *   AGG_SHARED  one open-addressing table for all threads.  Empty slots
+ *               are claimed with a CAS on the key word and counters are
+ *               bumped with atomic adds, so memory is independent of the
+ *               thread count and there is no merge.
+ *   AGG_SPLIT   AGG_SHARED plus contention splitting: the hottest keys,
+ *               picked from a sample before the run, count into
+ *               per-lane cache-line-padded stripes instead of one
+ *               contended slot.
+ *
+ * On aarch64 the atomics become single LSE instructions (CASAL, LDADD)
+ * when built with -march=armv8.1-a or later; GCC 10+ otherwise emits
+ * -moutline-atomics helpers that select LSE at run time, and older
+ * toolchains fall back to LDXR/STXR loops.
+ *
+ * Keys are 64-bit: IPv4 addresses as ip | 1 << 32, anything else as a
+ * 64-bit hash of the text with the top bit set.  Hashed keys keep their
+ * text in a per-table arena and are compared byte for byte on a hash
+ * match, so IPv6 and other clients count exactly and print as they
+ * appeared.  Latency is accumulated in integer microseconds so both
+ * backends sum exactly the same way.
+ *
+ * Single-owner tables grow when they pass 3/4 load.  The shared table
+ * cannot be rehashed under its writers, so it is sized before the run
+ * and counts what does not fit in `dropped`; callers treat that as an
+ * error rather than a partial result.
+ *
+ * #included by log_analyzer.c after log_formats.c.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { AGG_LOCAL, AGG_SHARED, AGG_SPLIT, AGG_BACKENDS };
+
+static const char *const agg_names[AGG_BACKENDS] = { "local", "shared", "split" };
+
+#define AGG_LANES    16     /* stripes per hot key           */
+#define AGG_HOT_KEYS 64     /* keys eligible for splitting   */
+#define AGG_MAX_PROBE 4096
+
+typedef struct {
+    uint64_t    key;        /* 0 = empty */
+    const char *text;       /* hashed keys: the key text, NULL for IPv4 */
+    int         len;
+} AggKey;
+
+typedef struct {
+    uint64_t    key;        /* 0 = empty */
+    uint64_t    count;
+    uint64_t    lat_us;
+    const char *text;       /* hashed keys: copy in the table's arena */
+    int32_t     hot;        /* stripe index, or -1 */
+    uint32_t    len;
+} AggSlot;
+
+typedef struct AggText {
+    struct AggText *next;
+    size_t          used, cap;
+    char            data[];
+} AggText;
+
+typedef struct {
+    uint64_t count, lat_us;
+    char     pad[48];
+} AggLane;
+
+typedef struct {
+    AggSlot *slots;
+    size_t   mask;
+    size_t   used;
+    size_t   dropped;       /* updates lost to a full shared table */
+    int      n_hot;
+    AggLane (*hot)[AGG_LANES];
+    AggText *text;          /* arena for hashed key text */
+    size_t   text_bytes;
+    pthread_mutex_t text_lock;
+} AggTable;
+
+static inline uint64_t agg_key_ipv4(uint32_t ip) {
+    return (uint64_t)ip | 1ULL << 32;
+}
+
+/* A bare 64-bit key (IPv4, or a synthetic one in bench-agg). */
+static inline AggKey agg_key_word(uint64_t key) {
+    return (AggKey){ key, NULL, 0 };
+}
+
+/* The key for a client field; hashed keys point into s. */
+static inline AggKey agg_key_text(const char *s, int len) {
+    uint32_t ip;
+    if (lf_ipv4(s, s + len, &ip) == 0) return agg_key_word(agg_key_ipv4(ip));
+    uint64_t h = 1469598103934665603ULL;            /* FNV-1a */
+    for (int i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+    return (AggKey){ h | 1ULL << 63, s, len };
+}
+
+static inline AggKey agg_slot_key(const AggSlot *s) {
+    return (AggKey){ s->key, s->text, (int)s->len };
+}
+
+static inline int agg_text_eq(const char *text, uint32_t len, AggKey k) {
+    return len == (uint32_t)k.len && memcmp(text, k.text, len) == 0;
+}
+
+static inline size_t agg_hash(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k;
+}
+
+static void agg_init(AggTable *t, size_t min_slots) {
+    size_t cap = 1024;
+    while (cap < min_slots) cap <<= 1;
+    memset(t, 0, sizeof(*t));
+    t->slots = calloc(cap, sizeof(AggSlot));
+    t->mask = cap - 1;
+    for (size_t i = 0; i < cap; i++) t->slots[i].hot = -1;
+    pthread_mutex_init(&t->text_lock, NULL);
+}
+
+static void agg_free(AggTable *t) {
+    free(t->slots);
+    free(t->hot);
+    while (t->text) {
+        AggText *next = t->text->next;
+        free(t->text);
+        t->text = next;
+    }
+    pthread_mutex_destroy(&t->text_lock);
+}
+
+static size_t agg_bytes(const AggTable *t) {
+    return (t->mask + 1) * sizeof(AggSlot) + (size_t)t->n_hot * sizeof(AggLane) * AGG_LANES +
+           t->text_bytes;
+}
+
+/* Copies len bytes of key text into t's arena; safe from any thread. */
+static const char *agg_text_copy(AggTable *t, const char *s, int len) {
+    pthread_mutex_lock(&t->text_lock);
+    AggText *b = t->text;
+    if (!b || b->cap - b->used < (size_t)len) {
+        size_t cap = len > 65536 ? (size_t)len : 65536;
+        b = malloc(sizeof(AggText) + cap);
+        b->next = t->text;
+        b->used = 0;
+        b->cap = cap;
+        t->text = b;
+        t->text_bytes += sizeof(AggText) + cap;
+    }
+    char *p = b->data + b->used;
+    b->used += len;
+    pthread_mutex_unlock(&t->text_lock);
+    memcpy(p, s, len);
+    return p;
+}
+
+/* ── Single-owner operations (local tables, setup, merge) ───────────────── */
+
+/* Doubles the slot array; key text stays where it is in the arena. */
+static void agg_grow(AggTable *t) {
+    size_t cap = (t->mask + 1) * 2;
+    AggSlot *slots = calloc(cap, sizeof(AggSlot));
+    for (size_t i = 0; i < cap; i++) slots[i].hot = -1;
+    for (size_t i = 0; i <= t->mask; i++) {
+        if (!t->slots[i].key) continue;
+        size_t h = agg_hash(t->slots[i].key) & (cap - 1);
+        while (slots[h].key) h = (h + 1) & (cap - 1);
+        slots[h] = t->slots[i];
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->mask = cap - 1;
+}
+
+static inline AggSlot *agg_local_slot(AggTable *t, AggKey k) {
+    if ((t->used + 1) * 4 > (t->mask + 1) * 3) agg_grow(t);
+    size_t h = agg_hash(k.key) & t->mask;
+    for (;;) {
+        AggSlot *s = &t->slots[h];
+        if (s->key == k.key && (!k.text || agg_text_eq(s->text, s->len, k))) return s;
+        if (s->key == 0) {
+            s->key = k.key;
+            if (k.text) {
+                s->text = agg_text_copy(t, k.text, k.len);
+                s->len = (uint32_t)k.len;
+            }
+            t->used++;
+            return s;
+        }
+        h = (h + 1) & t->mask;
+    }
+}
+
+static inline void agg_local_add(AggTable *t, AggKey k, uint64_t count, uint64_t lat_us) {
+    AggSlot *s = agg_local_slot(t, k);
+    s->count += count;
+    s->lat_us += lat_us;
+}
+
+/* ── Shared-table operations ────────────────────────────────────────────── */
+
+/*
+ * Hashed keys: the thread that claims a slot copies the text and then
+ * publishes the pointer; others that match the hash wait for it before
+ * comparing, and probe on if the text differs.
+ */
+static inline int agg_shared_text_eq(AggSlot *s, AggKey k) {
+    const char *text;
+    while (!(text = __atomic_load_n(&s->text, __ATOMIC_ACQUIRE)))
+        ;
+    return agg_text_eq(text, s->len, k);
+}
+
+static inline void agg_shared_add(AggTable *t, AggKey key, uint64_t lat_us, int lane) {
+    size_t h = agg_hash(key.key) & t->mask;
+    for (int probe = 0; probe < AGG_MAX_PROBE; probe++) {
+        AggSlot *s = &t->slots[h];
+        uint64_t k = __atomic_load_n(&s->key, __ATOMIC_ACQUIRE);
+        if (k == 0) {
+            uint64_t expected = 0;
+            if (__atomic_compare_exchange_n(&s->key, &expected, key.key, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add(&t->used, 1, __ATOMIC_RELAXED);
+                if (key.text) {
+                    s->len = (uint32_t)key.len;
+                    __atomic_store_n(&s->text, agg_text_copy(t, key.text, key.len),
+                                     __ATOMIC_RELEASE);
+                }
+                k = key.key;
+            } else {
+                k = expected;       /* lost the race; maybe to the same key */
+            }
+        }
+        if (k == key.key && (!key.text || agg_shared_text_eq(s, key))) {
+            if (s->hot >= 0) {      /* set before the run, read-only now */
+                AggLane *l = &t->hot[s->hot][lane & (AGG_LANES - 1)];
+                __atomic_fetch_add(&l->count, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&l->lat_us, lat_us, __ATOMIC_RELAXED);
+            } else {
+                __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&s->lat_us, lat_us, __ATOMIC_RELAXED);
+            }
+            return;
+        }
+        h = (h + 1) & t->mask;
+    }
+    __atomic_fetch_add(&t->dropped, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Give the n most frequent keys of sample[] striped counters.  Must run
+ * before any thread calls agg_shared_add.
+ */
+static void agg_split_hot(AggTable *t, const AggKey *sample, size_t n_sample, int n) {
+    AggTable freq;
+    agg_init(&freq, n_sample * 2);
+    for (size_t i = 0; i < n_sample; i++) agg_local_add(&freq, sample[i], 1, 0);
+
+    if (n > AGG_HOT_KEYS) n = AGG_HOT_KEYS;
+    t->hot = calloc(n ? n : 1, sizeof(*t->hot));
+    for (int h = 0; h < n; h++) {
+        AggSlot *best = NULL;
+        for (size_t i = 0; i <= freq.mask; i++) {
+            AggSlot *s = &freq.slots[i];
+            if (s->key && s->hot < 0 && (!best || s->count > best->count)) best = s;
+        }
+        if (!best || best->count < 2) break;
+        best->hot = h;
+        AggSlot *s = agg_local_slot(t, agg_slot_key(best));
+        s->hot = h;
+        t->n_hot = h + 1;
+    }
+    agg_free(&freq);
+}
+
+/* Fold hot stripes back into their slots once all writers are done. */
+static void agg_fold_hot(AggTable *t) {
+    for (size_t i = 0; i <= t->mask; i++) {
+        AggSlot *s = &t->slots[i];
+        if (!s->key || s->hot < 0) continue;
+        for (int l = 0; l < AGG_LANES; l++) {
+            s->count  += t->hot[s->hot][l].count;
+            s->lat_us += t->hot[s->hot][l].lat_us;
+            t->hot[s->hot][l].count = t->hot[s->hot][l].lat_us = 0;
+        }
+        s->hot = -1;
+    }
+}
+
+static void agg_merge_into(AggTable *dst, const AggTable *src) {
+    for (size_t i = 0; i <= src->mask; i++)
+        if (src->slots[i].key)
+            agg_local_add(dst, agg_slot_key(&src->slots[i]), src->slots[i].count,
+                          src->slots[i].lat_us);
+    dst->dropped += src->dropped;
+}
+
+/* ── Threads ────────────────────────────────────────────────────────────── */
+
+/* Runs fn(arg + i * stride) on n threads and waits for all of them. */
+static void agg_run_threads(int n, void *(*fn)(void *), void *arg, size_t stride) {
+    pthread_t *tid = malloc(n * sizeof(pthread_t));
+    for (int i = 0; i < n; i++)
+        pthread_create(&tid[i], NULL, fn, (char *)arg + i * stride);
+    for (int i = 0; i < n; i++)
+        pthread_join(tid[i], NULL);
+    free(tid);
+}
+
+/* Splits buf into n newline-aligned pieces; bounds[0..n]. */
+static void agg_split_lines(const char *buf, size_t len, int n, size_t *bounds) {
+    bounds[0] = 0;
+    for (int i = 1; i < n; i++) {
+        size_t b = len * i / n;
+        if (b < bounds[i - 1]) b = bounds[i - 1];
+        const char *nl = memchr(buf + b, '\n', len - b);
+        bounds[i] = nl ? (size_t)(nl - buf) + 1 : len;
+    }
+    bounds[n] = len;
+}
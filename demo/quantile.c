@@ -0,0 +1,180 @@
+/*
+ * quantile.c — Exact order statistics by parallel radix select
+ *
+ * p50/p95/p99 only need three elements of the sorted order, not the sort.
+ * Each double maps to a 64-bit key whose unsigned order is the numeric
+ * order (flip all bits of negatives, set the sign bit of positives), and
+ * the requested ranks are narrowed 16 key bits per pass:
+ *
+ *   1. histogram the top 16 bits of every key — one streaming pass,
+ *      split across threads, each with its own 64K-bucket histogram;
+ *   2. prefix-sum to find the bucket holding each rank;
+ *   3. copy just the keys of those buckets out (threads write disjoint
+ *      ranges, offsets come from the per-thread histograms);
+ *   4. repeat on the survivors with the next 16 bits.
+ *
+ * Four passes at most, O(n) total, and only the first touches all n
+ * samples.  Keys are computed on the fly from the doubles in that pass,
+ * so the extra memory is the survivors only.  A bucket holding every
+ * survivor (duplicate-heavy data) is narrowed in place without copying.
+ *
+ * #included by log_analyzer.c after parallel_agg.c (agg_run_threads).
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QS_BITS     16
+#define QS_BUCKETS  (1 << QS_BITS)
+#define QS_MAX_RANKS 16
+#define QS_PAR_MIN  (1 << 18)   /* fewer survivors: one thread */
+
+static inline uint64_t qs_key(double d) {
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return u >> 63 ? ~u : u | 1ULL << 63;
+}
+
+static inline double qs_double(uint64_t k) {
+    uint64_t u = k >> 63 ? k & ~(1ULL << 63) : ~k;
+    double d;
+    memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+typedef struct {
+    const double   *vals;       /* first pass reads doubles ...       */
+    const uint64_t *keys;       /* ... later passes read survivors    */
+    size_t          begin, end;
+    int             shift;
+    uint32_t       *hist;       /* this thread's QS_BUCKETS counts    */
+    const int8_t   *group;      /* bucket → group or -1; NULL = count */
+    uint64_t       *out[QS_MAX_RANKS]; /* next write per group        */
+} QsJob;
+
+#define QS_DIGIT(k, shift) ((size_t)((k) >> (shift)) & (QS_BUCKETS - 1))
+
+static void *qs_job_run(void *arg) {
+    QsJob *j = arg;
+    if (!j->group) {
+        memset(j->hist, 0, QS_BUCKETS * sizeof(uint32_t));
+        if (j->vals)
+            for (size_t i = j->begin; i < j->end; i++) j->hist[QS_DIGIT(qs_key(j->vals[i]), j->shift)]++;
+        else
+            for (size_t i = j->begin; i < j->end; i++) j->hist[QS_DIGIT(j->keys[i], j->shift)]++;
+    } else {
+        for (size_t i = j->begin; i < j->end; i++) {
+            uint64_t k = j->vals ? qs_key(j->vals[i]) : j->keys[i];
+            int g = j->group[QS_DIGIT(k, j->shift)];
+            if (g >= 0) *j->out[g]++ = k;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Keys of ranks[0..nr) among n candidates that agree on all bits above
+ * shift + QS_BITS.  Exactly one of vals/keys is set.
+ */
+static void qs_select(const double *vals, const uint64_t *keys, size_t n, int shift,
+                      const size_t *ranks, int nr, uint64_t *out, int threads) {
+    int t = n >= QS_PAR_MIN ? threads : 1;
+    while ((n + t - 1) / t > UINT32_MAX) t++;   /* 32-bit counters per slice */
+    QsJob *jobs = calloc(t, sizeof(QsJob));
+    uint32_t *hist = malloc((size_t)t * QS_BUCKETS * sizeof(uint32_t));
+    size_t *total = malloc(QS_BUCKETS * sizeof(size_t));
+    for (int i = 0; i < t; i++) {
+        jobs[i].vals = vals;
+        jobs[i].keys = keys;
+        jobs[i].begin = n * i / t;
+        jobs[i].end = n * (i + 1) / t;
+        jobs[i].shift = shift;
+        jobs[i].hist = hist + (size_t)i * QS_BUCKETS;
+    }
+    agg_run_threads(t, qs_job_run, jobs, sizeof(QsJob));
+
+    memset(total, 0, QS_BUCKETS * sizeof(size_t));
+    for (int i = 0; i < t; i++)
+        for (size_t b = 0; b < QS_BUCKETS; b++) total[b] += jobs[i].hist[b];
+
+    /* Bucket and in-bucket rank of every requested rank. */
+    size_t bucket[QS_MAX_RANKS], below[QS_MAX_RANKS];
+    for (int r = 0; r < nr; r++) {
+        size_t cum = 0, b = 0;
+        while (cum + total[b] <= ranks[r]) cum += total[b++];
+        bucket[r] = b;
+        below[r] = cum;
+    }
+
+    /* One survivor group per distinct bucket. */
+    int8_t *group = malloc(QS_BUCKETS);
+    memset(group, -1, QS_BUCKETS);
+    int ng = 0, gbucket[QS_MAX_RANKS];
+    for (int r = 0; r < nr; r++)
+        if (group[bucket[r]] < 0) {
+            gbucket[ng] = (int)bucket[r];
+            group[bucket[r]] = (int8_t)ng++;
+        }
+
+    /*
+     * Survivors of every group in one pass.  A group holding all n keys
+     * already has them in keys[] and recurses on that directly.
+     */
+    uint64_t *surv[QS_MAX_RANKS] = { NULL };
+    int gather = 0;
+    for (int g = 0; g < ng; g++) {
+        size_t b = gbucket[g];
+        if (shift == 0 || (keys && total[b] == n)) {
+            group[b] = -1;
+            continue;
+        }
+        surv[g] = malloc(total[b] * sizeof(uint64_t));
+        size_t off = 0;
+        for (int i = 0; i < t; i++) {
+            jobs[i].out[g] = surv[g] + off;
+            off += jobs[i].hist[b];
+        }
+        gather = 1;
+    }
+    if (gather) {
+        for (int i = 0; i < t; i++) jobs[i].group = group;
+        agg_run_threads(t, qs_job_run, jobs, sizeof(QsJob));
+    }
+
+    for (int g = 0; g < ng; g++) {
+        size_t b = gbucket[g], sub[QS_MAX_RANKS];
+        uint64_t res[QS_MAX_RANKS];
+        int ns = 0;
+        for (int r = 0; r < nr; r++)
+            if (bucket[r] == b) sub[ns++] = ranks[r] - below[r];
+
+        if (shift == 0) {
+            /* Last digit: the bucket is a single key value. */
+            for (int s = 0; s < ns; s++) res[s] = (keys[0] & ~(uint64_t)(QS_BUCKETS - 1)) | b;
+        } else if (surv[g]) {
+            qs_select(NULL, surv[g], total[b], shift - QS_BITS, sub, ns, res, threads);
+            free(surv[g]);
+        } else {
+            qs_select(NULL, keys, n, shift - QS_BITS, sub, ns, res, threads);
+        }
+        for (int r = 0, s = 0; r < nr; r++)
+            if (bucket[r] == b) out[r] = res[s++];
+    }
+    free(group);
+    free(total);
+    free(hist);
+    free(jobs);
+}
+
+/*
+ * out[i] = the ranks[i]-th smallest of vals[0..n) (0-based), exactly as
+ * vals[ranks[i]] after sorting.  vals is not modified.
+ */
+static void quantiles_exact(const double *vals, size_t n, const size_t *ranks, int nr,
+                            double *out, int threads) {
+    uint64_t keys[QS_MAX_RANKS];
+    if (n == 0 || nr <= 0) return;
+    if (nr > QS_MAX_RANKS) nr = QS_MAX_RANKS;
+    qs_select(vals, NULL, n, 64 - QS_BITS, ranks, nr, keys, threads > 0 ? threads : 1);
+    for (int i = 0; i < nr; i++) out[i] = qs_double(keys[i]);
+}
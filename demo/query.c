@@ -0,0 +1,364 @@
+/*
+ * query.c — Projection and predicate pushdown into the format parsers
+ *
+ * A Query names the fields the aggregation will read (--select) and
+ * the predicates a line must pass (--where).  DEFINE_QUERY_FORMAT
+ * re-expands the same layout descriptors as log_formats.c into lazy
+ * parsers that
+ *
+ *   - convert a field only if it is selected or has a predicate, so a
+ *     status-only query never runs the latency decimal parser;
+ *   - evaluate each predicate as soon as its field is reached and give
+ *     up on the line the moment one fails;
+ *   - stop once every touched field is done, leaving the rest of the
+ *     line to a single scan for '\n'.
+ *
+ * Delimiter lookups also stop at '\n', so the parser never needs the
+ * line end up front and a malformed line cannot run into the next one.
+ * Every layout ends in the latency; once it is the only field left, it
+ * is read backwards from the line end the loop needs anyway (lq_tail),
+ * so a latency query skips the fields in between as well.
+ *
+ * Lines are only validated as far as they are parsed: a bad latency on
+ * a status-only query is not an error.
+ *
+ * #included by log_analyzer.c after log_formats.c.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    QF_IP      = 1 << 0,
+    QF_STATUS  = 1 << 1,
+    QF_LATENCY = 1 << 2,
+    QF_PATH    = 1 << 3,
+    QF_METHOD  = 1 << 4,
+};
+
+enum { Q_MATCH, Q_FILTERED, Q_ERROR };
+
+typedef struct {
+    unsigned    select;           /* fields the aggregation reads        */
+    unsigned    where;            /* fields with predicates              */
+    unsigned    touch;            /* select | where                      */
+    int         status_min, status_max;
+    double      lat_min, lat_max;
+    int         lat_min_strict, lat_max_strict;
+    const char *path_prefix;  int path_prefix_len;
+    const char *method;       int method_len;
+} Query;
+
+static void query_init(Query *q) {
+    memset(q, 0, sizeof(*q));
+    q->select = q->touch = QF_IP | QF_STATUS | QF_LATENCY;
+    q->status_min = 0;
+    q->status_max = 999;
+    q->lat_min = -1e300;
+    q->lat_max = 1e300;
+}
+
+static unsigned query_field(const char *name, size_t len) {
+    static const struct { const char *name; unsigned bit; } fields[] = {
+        { "ip", QF_IP }, { "status", QF_STATUS }, { "latency", QF_LATENCY },
+        { "path", QF_PATH }, { "method", QF_METHOD },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        if (strlen(fields[i].name) == len && memcmp(fields[i].name, name, len) == 0)
+            return fields[i].bit;
+    return 0;
+}
+
+/* "status,latency" → projection.  Returns -1 on an unknown field. */
+static int query_select(Query *q, const char *list) {
+    unsigned sel = 0;
+    while (*list) {
+        size_t n = strcspn(list, ",");
+        unsigned f = query_field(list, n);
+        if (!f) return -1;
+        sel |= f;
+        list += n + (list[n] == ',');
+    }
+    q->select = sel;
+    q->touch = q->select | q->where;
+    return 0;
+}
+
+/*
+ * One --where predicate:
+ *   status{>=,>,<=,<,=}N   latency{>=,>,<=,<}MS   path^=PREFIX   method=NAME
+ * Repeated predicates AND together.  Returns -1 if unparseable.
+ */
+static int query_where(Query *q, const char *pred) {
+    size_t n = strcspn(pred, "<>=^");
+    unsigned f = query_field(pred, n);
+    const char *op = pred + n;
+    int oplen = (op[0] && op[1] == '=') ? 2 : 1;
+    const char *val = op + oplen;
+    if (!f || !*op) return -1;
+
+    if (f == QF_PATH && strncmp(op, "^=", 2) == 0) {
+        q->path_prefix = val;
+        q->path_prefix_len = (int)strlen(val);
+    } else if (f == QF_METHOD && oplen == 1 && *op == '=') {
+        q->method = val;
+        q->method_len = (int)strlen(val);
+    } else if (f == QF_STATUS) {
+        int v = atoi(val);
+        if      (strncmp(op, ">=", 2) == 0) { if (v > q->status_min) q->status_min = v; }
+        else if (strncmp(op, "<=", 2) == 0) { if (v < q->status_max) q->status_max = v; }
+        else if (*op == '>') { if (v + 1 > q->status_min) q->status_min = v + 1; }
+        else if (*op == '<') { if (v - 1 < q->status_max) q->status_max = v - 1; }
+        else if (*op == '=') { q->status_min = q->status_max = v; }
+        else return -1;
+    } else if (f == QF_LATENCY && (*op == '>' || *op == '<')) {
+        double v = atof(val);
+        int strict = oplen == 1;
+        /* Keep the tighter bound; at equal values strict is tighter. */
+        if (*op == '>') {
+            if (v > q->lat_min || (v == q->lat_min && strict)) {
+                q->lat_min = v;
+                q->lat_min_strict = strict;
+            }
+        } else if (v < q->lat_max || (v == q->lat_max && strict)) {
+            q->lat_max = v;
+            q->lat_max_strict = strict;
+        }
+    } else {
+        return -1;
+    }
+    q->where |= f;
+    q->touch = q->select | q->where;
+    return 0;
+}
+
+static inline int query_latency_ok(const Query *q, double ms) {
+    if (q->lat_min_strict ? ms <= q->lat_min : ms < q->lat_min) return 0;
+    if (q->lat_max_strict ? ms >= q->lat_max : ms > q->lat_max) return 0;
+    return 1;
+}
+
+/* Predicates on an already fully parsed record (for non-lazy paths). */
+static int query_accepts(const Query *q, const LogRecord *r) {
+    if (r->status < q->status_min || r->status > q->status_max) return 0;
+    if (!query_latency_ok(q, r->latency_ms)) return 0;
+    if (q->path_prefix_len && (r->path_len < q->path_prefix_len ||
+        memcmp(r->path, q->path_prefix, q->path_prefix_len) != 0)) return 0;
+    if (q->method_len && (r->method_len != q->method_len ||
+        memcmp(r->method, q->method, q->method_len) != 0)) return 0;
+    return 1;
+}
+
+/* ── Lazy field handlers ────────────────────────────────────────────────── */
+
+/*
+ * Each handler finds its field's end *e (the delimiter) from p and
+ * converts the field if the query touches it.  Delimiter lookups stop
+ * at '\n', so a malformed line cannot run into the next one.
+ */
+static inline const char *lq_end(const char *p, const char *end, char delim) {
+    return delim == LF_EOL ? scan_byte(p, end, '\n') : scan_byte2(p, end, delim, '\n');
+}
+
+#define LQ_FIND(e, p, end, delim)                                           \
+    do {                                                                    \
+        *(e) = lq_end(p, end, delim);                                       \
+        if ((delim) != LF_EOL && (*(e) == (end) || **(e) == '\n'))          \
+            return Q_ERROR;                                                 \
+    } while (0)
+
+static inline int lq_SKIP(const Query *q, LogRecord *r, const char *p, const char *end,
+                          char delim, unsigned *todo, const char **e) {
+    (void)q; (void)r; (void)todo;
+    LQ_FIND(e, p, end, delim);
+    return Q_MATCH;
+}
+
+static inline int lq_IP(const Query *q, LogRecord *r, const char *p, const char *end,
+                        char delim, unsigned *todo, const char **e) {
+    LQ_FIND(e, p, end, delim);
+    *todo &= ~QF_IP;
+    if (!(q->touch & QF_IP)) return Q_MATCH;
+    return lf_store_IP(r, p, *e) ? Q_ERROR : Q_MATCH;
+}
+
+static inline int lq_METHOD(const Query *q, LogRecord *r, const char *p, const char *end,
+                            char delim, unsigned *todo, const char **e) {
+    LQ_FIND(e, p, end, delim);
+    *todo &= ~QF_METHOD;
+    lf_store_METHOD(r, p, *e);
+    if (q->method_len && (r->method_len != q->method_len ||
+                          memcmp(p, q->method, q->method_len) != 0))
+        return Q_FILTERED;
+    return Q_MATCH;
+}
+
+static inline int lq_PATH(const Query *q, LogRecord *r, const char *p, const char *end,
+                          char delim, unsigned *todo, const char **e) {
+    LQ_FIND(e, p, end, delim);
+    *todo &= ~QF_PATH;
+    lf_store_PATH(r, p, *e);
+    if (q->path_prefix_len && (r->path_len < q->path_prefix_len ||
+                               memcmp(p, q->path_prefix, q->path_prefix_len) != 0))
+        return Q_FILTERED;
+    return Q_MATCH;
+}
+
+/* A touched status goes through lf_field_STATUS, i.e. SWAR where it can. */
+static inline int lq_STATUS(const Query *q, LogRecord *r, const char *p, const char *end,
+                            char delim, unsigned *todo, const char **e) {
+    *todo &= ~QF_STATUS;
+    if (!(q->touch & QF_STATUS)) {
+        LQ_FIND(e, p, end, delim);
+        return Q_MATCH;
+    }
+    const char *f = lf_field_STATUS(r, p, end, delim);
+    *e = f ? f : p;
+    if (!f || *f == '\n') return Q_ERROR;
+    return (r->status < q->status_min || r->status > q->status_max) ? Q_FILTERED : Q_MATCH;
+}
+
+static inline int lq_SIZE(const Query *q, LogRecord *r, const char *p, const char *end,
+                          char delim, unsigned *todo, const char **e) {
+    (void)q; (void)r; (void)todo;   /* nothing selects or filters on size */
+    LQ_FIND(e, p, end, delim);
+    return Q_MATCH;
+}
+
+static inline int lq_latency(const Query *q, LogRecord *r, const char *p, const char *end,
+                             char delim, unsigned *todo, const char **e, int exp10) {
+    LQ_FIND(e, p, end, delim);
+    *todo &= ~QF_LATENCY;
+    if (!(q->touch & QF_LATENCY)) return Q_MATCH;
+    r->latency_ms = lf_decimal(p, *e, exp10);
+    return query_latency_ok(q, r->latency_ms) ? Q_MATCH : Q_FILTERED;
+}
+
+static inline int lq_LAT_MS(const Query *q, LogRecord *r, const char *p, const char *end,
+                            char delim, unsigned *todo, const char **e) {
+    return lq_latency(q, r, p, end, delim, todo, e, 0);
+}
+
+static inline int lq_LAT_S(const Query *q, LogRecord *r, const char *p, const char *end,
+                           char delim, unsigned *todo, const char **e) {
+    return lq_latency(q, r, p, end, delim, todo, e, 3);
+}
+
+#undef LQ_FIND
+
+/*
+ * Every layout ends in the latency, and the line's '\n' has to be found
+ * anyway.  Once the latency is all that is left, the fields between are
+ * not walked: the latency is read backwards from the line end, from
+ * after the last lead delimiter up to term (LF_EOL: the line end).
+ */
+static inline int lq_tail(const Query *q, LogRecord *r, const char *p, const char *end,
+                          char lead, char term, int exp10, const char **stop) {
+    const char *e = scan_byte(p, end, '\n'), *b;
+    *stop = e;
+    if (term != LF_EOL) {
+        while (e > p && e[-1] != term) e--;
+        if (e-- == p) return Q_ERROR;
+    }
+    for (b = e; b > p && b[-1] != lead; b--) {}
+    if (b == p) return Q_ERROR;
+    r->latency_ms = lf_decimal(b, e, exp10);
+    return query_latency_ok(q, r->latency_ms) ? Q_MATCH : Q_FILTERED;
+}
+
+/* ── Descriptor expansion ───────────────────────────────────────────────── */
+
+/* The Query bit of each descriptor field; SKIP and SIZE are never touched. */
+enum {
+    LQ_BIT_SKIP = 0, LQ_BIT_SIZE = 0, LQ_BIT_IP = QF_IP, LQ_BIT_METHOD = QF_METHOD,
+    LQ_BIT_PATH = QF_PATH, LQ_BIT_STATUS = QF_STATUS, LQ_BIT_LAT_MS = QF_LATENCY,
+    LQ_BIT_LAT_S = QF_LATENCY,
+};
+
+/* Decimal exponent of each field's unit; only the latencies have one. */
+enum {
+    LQ_EXP_SKIP = 0, LQ_EXP_SIZE = 0, LQ_EXP_IP = 0, LQ_EXP_METHOD = 0, LQ_EXP_PATH = 0,
+    LQ_EXP_STATUS = 0, LQ_EXP_LAT_MS = 0, LQ_EXP_LAT_S = 3,
+};
+
+/*
+ * Untouched fields are not scanned when they are reached: the step
+ * only notes the delimiter it owes.  Owed delimiters are paid (scanned
+ * for, in order) before the next field that is read, or before the
+ * next owed field with another delimiter.  A quote-delimited step drops
+ * the debt instead: the layouts quote every field that may hold spaces,
+ * so the unquoted fields before it cannot contain a '"' and one scan
+ * for the quote lands where the owed scans plus its own would.  For
+ * Apache's status, IP, method and path then cost nothing.
+ */
+#define LQ_PAY()                                                            \
+    for (; owed_; owed_--) {                                                \
+        const char *e_ = lq_end(p, end, owed_delim_);                       \
+        if (e_ == end || *e_ == '\n') { *stop = e_; return Q_ERROR; }       \
+        p = e_ + 1;                                                         \
+    }
+
+#define LQ_STEP(FIELD, DELIM)                                               \
+    {                                                                       \
+        if (!todo) { *stop = p; return Q_MATCH; }                           \
+        if (todo == QF_LATENCY && LQ_BIT_##FIELD != LQ_BIT_LAT_MS)          \
+            return lq_tail(q, r, p, end, lead_, term_, exp_, stop);         \
+        if (!(q->touch & LQ_BIT_##FIELD) && (DELIM) != '"' && (DELIM) != LF_EOL) { \
+            if (owed_delim_ != (DELIM)) { LQ_PAY(); }                       \
+            owed_delim_ = (DELIM);                                          \
+            owed_++;                                                        \
+        } else {                                                            \
+            if ((DELIM) == '"') owed_ = 0;                                  \
+            else { LQ_PAY(); }                                              \
+            const char *e_ = p;                                             \
+            int v_ = lq_##FIELD(q, r, p, end, DELIM, &todo, &e_);           \
+            if (v_ != Q_MATCH) { *stop = e_; return v_; }                   \
+            p = e_ + 1;                                                     \
+        }                                                                   \
+    }
+
+/* Folds to the layout's last field: its unit, lead and terminator. */
+#define LQ_LAST(FIELD, DELIM) lead_ = term_; term_ = (DELIM); exp_ = LQ_EXP_##FIELD;
+
+/*
+ * query_fmt_<name>() parses from line start p; *stop is where scanning
+ * ended, and the line's '\n' is at or after it.
+ */
+#define DEFINE_QUERY_FORMAT(NAME, STEPS)                                    \
+    static inline int query_fmt_##NAME(const Query *q, const char *p,       \
+                                       const char *end, LogRecord *r,       \
+                                       const char **stop) {                 \
+        unsigned todo = q->touch, owed_ = 0;                                \
+        char owed_delim_ = 0, lead_ = 0, term_ = 0;                         \
+        int exp_ = 0;                                                       \
+        STEPS(LQ_LAST)                                                      \
+        r->latency_ms = 0;                                                  \
+        STEPS(LQ_STEP)                                                      \
+        (void)owed_delim_;                                                  \
+        *stop = p - 1;                                                      \
+        return Q_MATCH;                                                     \
+    }
+
+DEFINE_QUERY_FORMAT(apache, APACHE_FORMAT)
+DEFINE_QUERY_FORMAT(nginx,  NGINX_FORMAT)
+DEFINE_QUERY_FORMAT(tsv,    TSV_FORMAT)
+DEFINE_QUERY_FORMAT(json,   JSON_FORMAT)
+
+/*
+ * FOR_EACH_RECORD with a query over layout NAME: BODY runs for matching
+ * lines, rejected and filtered lines bump the respective counters.
+ */
+#define FOR_EACH_QUERY_RECORD(NAME, q, buf, len, lines, errors, filtered, rec, BODY) \
+    do {                                                                    \
+        const char *lp_ = (buf), *end_ = (buf) + (len);                     \
+        while (lp_ < end_) {                                                \
+            LogRecord rec;                                                  \
+            const char *stop_;                                              \
+            int v_ = query_fmt_##NAME((q), lp_, end_, &rec, &stop_);        \
+            (lines)++;                                                      \
+            if (v_ == Q_MATCH)      { BODY; }                               \
+            else if (v_ == Q_ERROR) (errors)++;                             \
+            else                    (filtered)++;                           \
+            if (stop_ >= end_ || *stop_ != '\n') stop_ = scan_byte(stop_, end_, '\n'); \
+            lp_ = stop_ + 1;                                                \
+        }                                                                   \
+    } while (0)
@@ -0,0 +1,308 @@
+/*
+ * rate_window.c — Per-client request rate over a sliding 60 s window
+ *
+ * "Which clients ever made more than X requests within 60 seconds?"
+ * answered inline, one update per line.  Log times have one-second
+ * resolution, so a ring of RATE_WINDOW per-second counters per client
+ * gives the exact count of every window ending on a second boundary:
+ * advancing the ring to a newer second subtracts the seconds that fall
+ * out, and the running sum is the current window.  Each client's peak
+ * window and the second it ended are kept.
+ *
+ * Layout, for a cache-friendly update:
+ *
+ *   index   open-addressed (hash, slot) pairs, 16 bytes, four per cache
+ *           line — probing never touches the rings;
+ *   slab    one 64-byte-aligned RateKey per tracked client: full address,
+ *           header and ring in three adjacent lines, updated in place.
+ *
+ * Clients are keyed by their full 128-bit address: IPv6 as is, IPv4 as
+ * its IPv4-mapped form (::ffff:a.b.c.d), so both spellings of one
+ * client count together.  A matching hash in the index is confirmed
+ * against the address in the slab line the update touches anyway.
+ * Memory is bounded by the slab size.
+ * Cold clients — no request within the last window — are dropped
+ * lazily: only when the slab is full does a sweep reclaim them (and
+ * the index is rebuilt).  If too few are cold, the quietest of a
+ * sample are evicted too, and counted; their future counts restart at
+ * 0, so in that overload case peaks are lower bounds.  A dropped
+ * client's peak is archived if it crossed the limit.
+ *
+ * #included by log_analyzer.c after log_formats.c (lf_ipv4).
+ */
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE_WINDOW   60        /* seconds */
+#define RATE_SAMPLE   64        /* eviction candidates per forced drop */
+
+/* Client address, network byte order. */
+typedef struct {
+    unsigned char b[16];
+} RateAddr;
+
+typedef struct {
+    uint64_t key;               /* rate_addr_hash(); 0 = empty */
+    uint32_t slot;
+    uint32_t pad;
+} RateIdx;
+
+typedef struct __attribute__((aligned(64))) {
+    uint64_t key;               /* as in the index; 0 = free slot */
+    RateAddr addr;
+    int64_t  head;              /* newest second in the ring */
+    int64_t  peak_at;           /* end second of the peak window */
+    uint32_t sum;               /* requests in (head - RATE_WINDOW, head] */
+    uint32_t peak;
+    uint16_t ring[RATE_WINDOW]; /* requests per second, by second % RATE_WINDOW */
+} RateKey;
+
+typedef struct {
+    RateAddr addr;
+    int64_t  peak_at;
+    uint32_t peak;
+} RateOffender;
+
+typedef struct {
+    RateIdx      *idx;
+    size_t        idx_mask;
+    RateKey      *keys;
+    uint32_t     *free_slots;
+    size_t        cap, n_free;
+    int64_t       now;          /* newest second seen */
+    uint32_t      limit;        /* offender: peak > limit */
+    size_t        hand;         /* clock hand for forced eviction */
+    RateOffender *archive;      /* offenders no longer tracked */
+    size_t        n_archive, archive_cap;
+    uint64_t      sweeps, expired, evicted, late;
+} RateTable;
+
+/* ::ffff:0:0/96 holds IPv4 clients; 100::/64 (discard-only) the text hashes of non-addresses. */
+static const unsigned char rate_v4_prefix[12] = { [10] = 0xff, [11] = 0xff };
+static const unsigned char rate_other_prefix[8] = { 0x01 };
+
+/* Binary client address. */
+static RateAddr rate_key(const char *ip, int len) {
+    RateAddr a = { { 0 } };
+    uint32_t v4;
+    if (lf_ipv4(ip, ip + len, &v4) == 0) {
+        memcpy(a.b, rate_v4_prefix, 12);
+        v4 = htonl(v4);
+        memcpy(a.b + 12, &v4, 4);
+        return a;
+    }
+    char buf[64];
+    if (len < (int)sizeof(buf)) {
+        memcpy(buf, ip, len);
+        buf[len] = '\0';
+        if (inet_pton(AF_INET6, buf, a.b) == 1) return a;
+    }
+    uint64_t h = 1469598103934665603ULL;        /* not an address: hash the text */
+    for (int i = 0; i < len; i++) h = (h ^ (unsigned char)ip[i]) * 1099511628211ULL;
+    memcpy(a.b, rate_other_prefix, 8);
+    memcpy(a.b + 8, &h, 8);
+    return a;
+}
+
+static void rate_key_str(const RateAddr *a, char *out, size_t n) {
+    if (memcmp(a->b, rate_v4_prefix, 12) == 0) {
+        inet_ntop(AF_INET, a->b + 12, out, (socklen_t)n);
+    } else if (memcmp(a->b, rate_other_prefix, 8) == 0) {
+        uint64_t h;
+        memcpy(&h, a->b + 8, 8);
+        snprintf(out, n, "other #%016llx", (unsigned long long)h);
+    } else if (!inet_ntop(AF_INET6, a->b, out, (socklen_t)n)) {
+        snprintf(out, n, "?");
+    }
+}
+
+static inline int rate_addr_eq(const RateAddr *a, const RateAddr *b) {
+    return memcmp(a->b, b->b, 16) == 0;
+}
+
+static void rate_init(RateTable *t, size_t cap, uint32_t limit) {
+    memset(t, 0, sizeof(*t));
+    size_t icap = 1024;
+    while (icap < cap * 2) icap <<= 1;
+    t->idx = calloc(icap, sizeof(RateIdx));
+    t->idx_mask = icap - 1;
+    t->keys = aligned_alloc(64, cap * sizeof(RateKey));
+    t->free_slots = malloc(cap * sizeof(uint32_t));
+    t->cap = cap;
+    for (size_t i = 0; i < cap; i++) {
+        t->keys[i].key = 0;
+        t->free_slots[t->n_free++] = (uint32_t)(cap - 1 - i);
+    }
+    t->now = INT64_MIN;
+    t->limit = limit;
+}
+
+static void rate_free(RateTable *t) {
+    free(t->idx);
+    free(t->keys);
+    free(t->free_slots);
+    free(t->archive);
+}
+
+static inline size_t rate_hash(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k;
+}
+
+/* Index key of an address; never 0. */
+static inline uint64_t rate_addr_hash(const RateAddr *a) {
+    uint64_t hi, lo;
+    memcpy(&hi, a->b, 8);
+    memcpy(&lo, a->b + 8, 8);
+    uint64_t k = (hi * 0x9E3779B97F4A7C15ULL ^ lo) * 0xbf58476d1ce4e5b9ULL;
+    return k ^ k >> 31 ? k ^ k >> 31 : 1;
+}
+
+static void rate_archive(RateTable *t, const RateKey *k) {
+    if (k->peak <= t->limit) return;
+    if (t->n_archive == t->archive_cap) {
+        t->archive_cap = t->archive_cap ? t->archive_cap * 2 : 256;
+        t->archive = realloc(t->archive, t->archive_cap * sizeof(RateOffender));
+    }
+    t->archive[t->n_archive++] = (RateOffender){ k->addr, k->peak_at, k->peak };
+}
+
+static void rate_drop(RateTable *t, uint32_t slot) {
+    RateKey *k = &t->keys[slot];
+    rate_archive(t, k);
+    k->key = 0;
+    t->free_slots[t->n_free++] = slot;
+}
+
+/*
+ * Slab full: reclaim every client idle for a whole window, then evict
+ * the quietest sampled ones until 1/16 of the slab is free, so sweeps
+ * stay amortized O(1) per new client.
+ */
+static void rate_reclaim(RateTable *t) {
+    t->sweeps++;
+    for (size_t s = 0; s < t->cap; s++) {
+        RateKey *k = &t->keys[s];
+        if (k->key && k->head <= t->now - RATE_WINDOW) {
+            rate_drop(t, (uint32_t)s);
+            t->expired++;
+        }
+    }
+    while (t->n_free < t->cap / 16 + 1) {
+        size_t best = SIZE_MAX;
+        for (int n = 0; n < RATE_SAMPLE; n++, t->hand = (t->hand + 1) % t->cap)
+            if (t->keys[t->hand].key && (best == SIZE_MAX || t->keys[t->hand].sum < t->keys[best].sum))
+                best = t->hand;
+        if (best == SIZE_MAX) break;
+        rate_drop(t, (uint32_t)best);
+        t->evicted++;
+    }
+    memset(t->idx, 0, (t->idx_mask + 1) * sizeof(RateIdx));
+    for (size_t s = 0; s < t->cap; s++) {
+        if (!t->keys[s].key) continue;
+        size_t i = rate_hash(t->keys[s].key) & t->idx_mask;
+        while (t->idx[i].key) i = (i + 1) & t->idx_mask;
+        t->idx[i] = (RateIdx){ t->keys[s].key, (uint32_t)s, 0 };
+    }
+}
+
+/* One request from addr at second sec. */
+static void rate_hit(RateTable *t, RateAddr addr, int64_t sec) {
+    if (sec > t->now) t->now = sec;
+    uint64_t key = rate_addr_hash(&addr);
+    size_t i = rate_hash(key) & t->idx_mask;
+    while (t->idx[i].key &&
+           (t->idx[i].key != key || !rate_addr_eq(&t->keys[t->idx[i].slot].addr, &addr)))
+        i = (i + 1) & t->idx_mask;
+
+    RateKey *k;
+    if (t->idx[i].key) {
+        k = &t->keys[t->idx[i].slot];
+    } else {
+        if (t->n_free == 0) {
+            rate_reclaim(t);
+            i = rate_hash(key) & t->idx_mask;
+            while (t->idx[i].key) i = (i + 1) & t->idx_mask;
+        }
+        uint32_t slot = t->free_slots[--t->n_free];
+        k = &t->keys[slot];
+        memset(k, 0, sizeof(*k));
+        k->key = key;
+        k->addr = addr;
+        k->head = sec;
+        t->idx[i] = (RateIdx){ key, slot, 0 };
+    }
+
+    if (sec > k->head) {
+        if (sec - k->head >= RATE_WINDOW) {
+            memset(k->ring, 0, sizeof(k->ring));
+            k->sum = 0;
+        } else {
+            for (int64_t s = k->head + 1; s <= sec; s++) {
+                uint16_t *b = &k->ring[s % RATE_WINDOW];
+                k->sum -= *b;
+                *b = 0;
+            }
+        }
+        k->head = sec;
+    } else if (sec <= k->head - RATE_WINDOW) {
+        t->late++;                              /* older than the window */
+        return;
+    }
+    uint16_t *b = &k->ring[sec % RATE_WINDOW];
+    if (*b == UINT16_MAX) return;               /* 65535/s from one client */
+    (*b)++;
+    if (++k->sum > k->peak) {
+        k->peak = k->sum;
+        k->peak_at = k->head;
+    }
+}
+
+static int cmp_rate_offender(const void *a, const void *b) {
+    const RateOffender *x = a, *y = b;
+    int c = memcmp(x->addr.b, y->addr.b, 16);
+    if (c) return c;
+    return (x->peak < y->peak) - (x->peak > y->peak);
+}
+
+static int cmp_rate_peak(const void *a, const void *b) {
+    const RateOffender *x = a, *y = b;
+    if (x->peak != y->peak) return x->peak < y->peak ? 1 : -1;
+    return memcmp(x->addr.b, y->addr.b, 16);
+}
+
+/*
+ * Every client whose peak exceeded the limit, tracked or archived, one
+ * entry per client (its highest peak), by peak descending.  *out is
+ * malloc'd.
+ */
+static size_t rate_offenders(const RateTable *t, RateOffender **out) {
+    size_t n = t->n_archive;
+    RateOffender *v = malloc((n + t->cap + 1) * sizeof(RateOffender));
+    memcpy(v, t->archive, n * sizeof(RateOffender));
+    for (size_t s = 0; s < t->cap; s++) {
+        const RateKey *k = &t->keys[s];
+        if (k->key && k->peak > t->limit)
+            v[n++] = (RateOffender){ k->addr, k->peak_at, k->peak };
+    }
+    qsort(v, n, sizeof(RateOffender), cmp_rate_offender);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!m || !rate_addr_eq(&v[m - 1].addr, &v[i].addr)) v[m++] = v[i];
+    }
+    qsort(v, m, sizeof(RateOffender), cmp_rate_peak);
+    *out = v;
+    return m;
+}
+
+/* Forgets everything, keeping the size and limit. */
+static void rate_reset(RateTable *t) {
+    size_t cap = t->cap;
+    uint32_t limit = t->limit;
+    rate_free(t);
+    rate_init(t, cap, limit);
+}
@@ -0,0 +1,681 @@
+/*
+ * route_trie.c — Request path → route template normalization
+ *
+ * Per-endpoint stats only make sense once /api/users/123 and
+ * /api/users/456 land in the same bucket.  Routes are compiled into a
+ * trie of path segments; a segment is either a literal or a parameter:
+ *
+ *   :id    any numeric, UUID or hex segment
+ *   :num   digits only                 (1..19 of them)
+ *   :uuid  8-4-4-4-12 hex with dashes
+ *   :hex   8+ hex digits with at least one digit
+ *   *      the rest of the path
+ *
+ * route_match() first tries a cache of path shapes, keyed by length and
+ * first word: the path's literal bytes must match, and its ID bytes
+ * pass per-byte range checks (16 at a time with SSE2), so /api/users/42
+ * and /api/users/7 share one entry without the path being split.  Only
+ * a cache miss segments the path — ID detection is SWAR byte-range
+ * checks on the words the separator search loads, plus a fixed UUID
+ * dash pattern, no regex — and walks the trie: literal children first,
+ * by hash, length and bytes, parameters after, backtracking only when a
+ * literal branch dead-ends.
+ *
+ * A path no route covers is normalized on the spot
+ * (ID-looking segments become :id/:uuid/:hex) and the result is added
+ * to the trie, so the next path of the same shape matches directly.
+ * The return value is a small dense route id for array-indexed stats.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUTE_MAX      4096     /* distinct templates, learned ones included */
+#define ROUTE_NODES    (ROUTE_MAX * 4)
+#define ROUTE_TMPL_LEN 128
+#define ROUTE_DEPTH    32       /* deeper paths go to the overflow route */
+#define ROUTE_SHAPE_BITS 10     /* 1024 shape cache entries, in pairs */
+#define ROUTE_SHAPES   (1 << ROUTE_SHAPE_BITS)
+#define ROUTE_SHAPE_LEN 64      /* longer paths always walk the trie */
+
+enum { RT_LIT, RT_ANY, RT_NUM, RT_UUID, RT_HEX, RT_REST };
+
+typedef struct {
+    uint32_t hash;
+    uint16_t len;
+    uint8_t  kind;
+    uint8_t  id_lits;           /* 1 << kind of ID-looking literal children */
+    uint64_t w0;                /* first 8 bytes, zero-padded */
+    int32_t  parent;
+    int32_t  param, sibling;    /* parameter children, a list; -1 = none */
+    int32_t  route;             /* route ending here, or -1 */
+    uint32_t lit;               /* literal bytes, offset into RouteTrie.lits */
+} RouteNode;
+
+typedef struct {
+    char   tmpl[ROUTE_TMPL_LEN];
+    long   count, errors;       /* errors = 5xx */
+    double lat_sum;
+} Route;
+
+/*
+ * A path shape and the route the walk gave it: the path up to '?' or
+ * '#' with its ID segments blanked, plus what each blanked byte must be
+ * for the segment to keep its kind — a digit for :num, a hex digit for
+ * :hex and a UUID's (whose dashes stay literal).  Every path that agrees
+ * on the literal bytes and has an ID of the same kind in each blank
+ * walks the trie identically, so /api/users/42 and /api/users/17 share
+ * an entry, and so do two requests for /health.
+ *
+ * Byte i passes if (path[i] ^ 0x80) - lit[i] < lo[i] or (path[i] | 0x20)
+ * - 'a' < hi[i], both signed bytes: a literal is lit = itself, lo = 1 -
+ * 128; an ID byte lit = '0', lo = 10 - 128, with hi = 6 - 128 where hex
+ * letters are allowed too; hi = -128 never passes.
+ */
+typedef struct {
+    int32_t  len, route;
+    uint32_t gen;                       /* RouteTrie.gen when stored */
+    uint8_t  ids;                       /* any ID segment; else lit alone decides */
+    uint8_t  hex_at, hex_len;           /* the one :hex segment, hex_len 0 if none */
+    char     lit[ROUTE_SHAPE_LEN];      /* zeroed past len */
+    int8_t   lo[ROUTE_SHAPE_LEN], hi[ROUTE_SHAPE_LEN];
+} RouteShape;
+
+/*
+ * Literal children live in one open-addressing table keyed by (parent,
+ * segment hash), so a lookup is one probe whatever the fan-out; the few
+ * parameter children per node hang off RouteNode.param.
+ */
+typedef struct {
+    RouteNode *nodes;
+    int        n_nodes;
+    int32_t   *edges;           /* node ids, -1 = empty */
+    uint32_t   edge_mask;
+    char      *lits;            /* literal segment bytes */
+    uint32_t   lits_len, lits_cap;
+    RouteShape *shapes;
+    uint32_t   gen;             /* bumped by every trie change; stales the cache */
+    Route     *routes;
+    int        n_routes;
+    int        n_learned;
+    int        overflow;        /* catch-all once the tables are full */
+} RouteTrie;
+
+typedef struct {
+    const char *b;
+    int         len;
+    uint32_t    hash;
+    int         kind;           /* RT_LIT, or RT_NUM / RT_UUID / RT_HEX */
+    uint64_t    w0;             /* first 8 bytes, zero-padded */
+} RouteSeg;
+
+/* 0x80 in each byte of w equal to the byte in rep (exact for the lowest). */
+#define RT_ONES  0x0101010101010101ULL
+#define RT_HIGHS 0x8080808080808080ULL
+static inline uint64_t rt_eq(uint64_t w, uint64_t rep) {
+    uint64_t x = w ^ rep;
+    return (x - RT_ONES) & ~x & RT_HIGHS;
+}
+
+/* Like rt_eq(), but exact in every byte, not just the lowest match. */
+static inline uint64_t rt_eq_all(uint64_t w, uint64_t rep) {
+    uint64_t x = w ^ rep;
+    return ~(((x & ~RT_HIGHS) + ~RT_HIGHS) | x) & RT_HIGHS;
+}
+
+/* 0x80 in each byte of w within [lo, hi]; bytes of w must be ASCII. */
+static inline uint64_t rt_range(uint64_t w, unsigned char lo, unsigned char hi) {
+    return (w + RT_ONES * (0x80 - lo)) & ~(w + RT_ONES * (0x7f - hi)) & RT_HIGHS;
+}
+
+static inline uint64_t rt_digits(uint64_t w) { return rt_range(w, '0', '9'); }
+
+static inline uint64_t rt_hex(uint64_t w) {
+    return rt_digits(w) | rt_range(w | RT_ONES * 0x20, 'a', 'f');
+}
+
+static inline uint32_t rt_mix(uint64_t h) {
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    return (uint32_t)(h ^ h >> 32);
+}
+
+/*
+ * RT_NUM, RT_UUID, RT_HEX for ID-looking segments, RT_LIT otherwise.
+ * SWAR range checks over overlapping 8-byte words — no regex, no
+ * per-byte loop.  A UUID's five words are checked against the fixed
+ * 8-4-4-4-12 dash pattern in the same loop.
+ */
+static int rt_classify(const char *b, int len, uint64_t w0) {
+    static const uint64_t uuid_dash[5] = { 0, 0x80ULL | 0x80ULL << 40, 0x80ULL << 16 | 0x80ULL << 56, 0, 0 };
+    uint64_t high = 0, digit = RT_HIGHS, hex = RT_HIGHS, any_digit = 0, uuid = 0;
+    if (len > 40) return RT_LIT;
+    /* Words are loaded where they are used: copied into an array first,
+     * GCC turns the copies into a memcpy() call whose stores the loads
+     * below then stall on. */
+    for (int i = 0; i < len; i += 8) {
+        uint64_t w;
+        if (len <= 8) {
+            uint64_t valid = len == 8 ? ~0ULL : (1ULL << (len * 8)) - 1;
+            w = w0 | (~valid & RT_ONES * '0');  /* pad with a neutral digit */
+            any_digit = rt_digits(w0) & valid;
+        } else {
+            memcpy(&w, b + (i + 8 < len ? i : len - 8), 8);
+        }
+        uint64_t d = rt_digits(w), x = rt_hex(w), e = rt_eq(w, RT_ONES * '-');
+        high |= w;
+        digit &= d;
+        hex &= x;
+        if (len > 8) any_digit |= d;
+        uuid |= (~(x | e) | (e ^ uuid_dash[i / 8])) & RT_HIGHS;
+    }
+    if (high & RT_HIGHS)
+        return RT_LIT;
+    if (digit == RT_HIGHS && len <= 19)
+        return RT_NUM;
+    if (hex == RT_HIGHS && any_digit && len >= 8)
+        return RT_HEX;
+    if (len == 36 && !uuid)
+        return RT_UUID;
+    return RT_LIT;
+}
+
+/*
+ * Splits [p, end) into segments, stopping at '?' or '#', and classifies
+ * them.  Eight bytes at a time: one SWAR compare finds the next
+ * separator, and the same word feeds the segment hash and a digit/dash
+ * test.  Every ID kind needs a digit or a dash, so segments without one
+ * are literals straight from this pass and only the rest go through
+ * rt_classify().  The last partial word is loaded ending at `end` and
+ * shifted down, so only paths shorter than 8 bytes take a byte loop.
+ * Little-endian only, like the rest of the SIMD code.
+ */
+static int rt_segments(const char *p, const char *end, RouteSeg *seg, int max) {
+    const uint64_t slash = RT_ONES * '/', qmark = RT_ONES * '?', hash = RT_ONES * '#';
+    const char *start = p;
+    int n = 0;
+    while (p < end && *p == '/') p++;
+    while (p < end) {
+        const char *b = p;
+        uint64_t h = 0x9e3779b97f4a7c15ULL, w0 = 0, idish = 0;
+        for (;;) {
+            long avail = end - p;
+            uint64_t w = 0;
+            if (avail >= 8) {
+                memcpy(&w, p, 8);
+            } else if (end - start >= 8) {
+                memcpy(&w, end - 8, 8);
+                w >>= (8 - avail) * 8;
+            } else {
+                for (long k = 0; k < avail; k++) w |= (uint64_t)(unsigned char)p[k] << (k * 8);
+            }
+            uint64_t m = rt_eq(w, slash) | rt_eq(w, qmark) | rt_eq(w, hash);
+            if (m) {
+                int k = __builtin_ctzll(m) >> 3;
+                if (k < avail) {
+                    w &= (1ULL << (k * 8)) - 1;
+                    if (p == b) w0 = w;
+                    if (k) h = (h ^ w) * 0x100000001b3ULL;
+                    idish |= rt_digits(w) | rt_eq(w, RT_ONES * '-');
+                    p += k;
+                    break;
+                }
+            }
+            if (p == b) w0 = w;
+            h = (h ^ w) * 0x100000001b3ULL;
+            idish |= rt_digits(w) | rt_eq(w, RT_ONES * '-');
+            if (avail <= 8) { p = end; break; }
+            p += 8;
+        }
+        if (p > b) {
+            if (n == max) return -1;
+            seg[n].b = b;
+            seg[n].len = (int)(p - b);
+            seg[n].hash = rt_mix(h);
+            seg[n].kind = idish ? rt_classify(b, seg[n].len, w0) : RT_LIT;
+            seg[n].w0 = w0;
+            n++;
+        }
+        if (p == end || *p != '/') return n;
+        p++;
+    }
+    return n;
+}
+
+static inline int rt_param_matches(int kind, const RouteSeg *s) {
+    return kind == RT_ANY ? s->kind != RT_LIT : s->kind == kind;
+}
+
+/* memcmp(a, b, len) == 0 in overlapping 8-byte words, for 8 <= len. */
+static inline int rt_same(const char *a, const char *b, int len) {
+    uint64_t x, y, diff = 0;
+    int i = 0;
+    for (; i + 8 < len; i += 8) {
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        diff |= x ^ y;
+    }
+    memcpy(&x, a + len - 8, 8);
+    memcpy(&y, b + len - 8, 8);
+    return (diff | (x ^ y)) == 0;
+}
+
+static inline uint32_t rt_edge_slot(const RouteTrie *t, int parent, uint32_t hash) {
+    return (hash ^ (uint32_t)parent * 0x9e3779b9u) & t->edge_mask;
+}
+
+/*
+ * Hash, length and first word reject almost every mismatch; a literal
+ * longer than a word is then compared in full.
+ */
+static inline int rt_lit_eq(const RouteTrie *t, const RouteNode *n, const RouteSeg *s) {
+    if (n->hash != s->hash || n->len != s->len || n->w0 != s->w0) return 0;
+    return s->len <= 8 || rt_same(t->lits + n->lit, s->b, s->len);
+}
+
+/* Literal child of parent matching s, or -1. */
+static inline int rt_lit_child(const RouteTrie *t, int parent, const RouteSeg *s) {
+    for (uint32_t i = rt_edge_slot(t, parent, s->hash);; i = (i + 1) & t->edge_mask) {
+        int c = t->edges[i];
+        if (c < 0) return -1;
+        if (t->nodes[c].parent == parent && rt_lit_eq(t, &t->nodes[c], s)) return c;
+    }
+}
+
+static int rt_new_node(RouteTrie *t, int parent, int kind, const RouteSeg *s) {
+    if (t->n_nodes == ROUTE_NODES) return -1;
+    t->gen++;
+    int id = t->n_nodes++;
+    RouteNode *n = &t->nodes[id];
+    memset(n, 0, sizeof(*n));
+    n->kind = (uint8_t)kind;
+    n->parent = parent;
+    n->param = n->sibling = -1;
+    n->route = -1;
+    if (kind == RT_LIT) {
+        n->hash = s->hash;
+        n->len = (uint16_t)s->len;
+        n->w0 = s->w0;
+        if (t->lits_cap - t->lits_len < (uint32_t)s->len) {
+            t->lits_cap = (t->lits_cap + s->len) * 2;
+            t->lits = realloc(t->lits, t->lits_cap);
+        }
+        n->lit = t->lits_len;
+        memcpy(t->lits + t->lits_len, s->b, s->len);
+        t->lits_len += s->len;
+        if (s->kind != RT_LIT) t->nodes[parent].id_lits |= 1 << s->kind;
+        uint32_t i = rt_edge_slot(t, parent, s->hash);
+        while (t->edges[i] >= 0) i = (i + 1) & t->edge_mask;
+        t->edges[i] = id;
+    } else {
+        n->sibling = t->nodes[parent].param;
+        t->nodes[parent].param = id;
+    }
+    return id;
+}
+
+/* Child of parent for this (kind, segment), created if missing. */
+static int rt_child(RouteTrie *t, int parent, int kind, const RouteSeg *s) {
+    if (kind == RT_LIT) {
+        int c = rt_lit_child(t, parent, s);
+        return c >= 0 ? c : rt_new_node(t, parent, kind, s);
+    }
+    for (int c = t->nodes[parent].param; c >= 0; c = t->nodes[c].sibling)
+        if (t->nodes[c].kind == kind) return c;
+    return rt_new_node(t, parent, kind, s);
+}
+
+static int rt_new_route(RouteTrie *t, const char *tmpl) {
+    if (t->n_routes == ROUTE_MAX) return t->overflow;
+    t->gen++;
+    int id = t->n_routes++;
+    memset(&t->routes[id], 0, sizeof(Route));
+    snprintf(t->routes[id].tmpl, ROUTE_TMPL_LEN, "%s", tmpl);
+    return id;
+}
+
+static void route_init(RouteTrie *t) {
+    memset(t, 0, sizeof(*t));
+    t->nodes = malloc(ROUTE_NODES * sizeof(RouteNode));
+    t->routes = malloc(ROUTE_MAX * sizeof(Route));
+    t->shapes = calloc(ROUTE_SHAPES, sizeof(RouteShape));
+    t->edge_mask = ROUTE_NODES * 2 - 1;
+    t->edges = malloc((t->edge_mask + 1) * sizeof(int32_t));
+    memset(t->edges, 0xff, (t->edge_mask + 1) * sizeof(int32_t));
+    t->n_nodes = 1;                             /* node 0 = root "/" */
+    memset(&t->nodes[0], 0, sizeof(RouteNode));
+    t->nodes[0].parent = t->nodes[0].param = t->nodes[0].sibling = -1;
+    t->nodes[0].route = -1;
+    t->overflow = rt_new_route(t, "(other)");
+}
+
+static void route_free(RouteTrie *t) {
+    free(t->nodes);
+    free(t->edges);
+    free(t->lits);
+    free(t->shapes);
+    free(t->routes);
+}
+
+static int rt_param_kind(const RouteSeg *s) {
+    if (s->len == 1 && s->b[0] == '*') return RT_REST;
+    if (s->b[0] != ':') return RT_LIT;
+    if (s->len == 4 && memcmp(s->b, ":num", 4) == 0)  return RT_NUM;
+    if (s->len == 5 && memcmp(s->b, ":uuid", 5) == 0) return RT_UUID;
+    if (s->len == 4 && memcmp(s->b, ":hex", 4) == 0)  return RT_HEX;
+    return RT_ANY;                              /* :id, :anything */
+}
+
+/* Adds one template ("/api/users/:id").  Returns its route id or -1. */
+static int route_add(RouteTrie *t, const char *tmpl) {
+    RouteSeg seg[ROUTE_DEPTH];
+    int n = rt_segments(tmpl, tmpl + strlen(tmpl), seg, ROUTE_DEPTH);
+    if (n < 0) return -1;
+    int node = 0;
+    for (int i = 0; i < n && node >= 0; i++) {
+        int kind = rt_param_kind(&seg[i]);
+        node = rt_child(t, node, kind, &seg[i]);
+        if (kind == RT_REST) break;
+    }
+    if (node < 0) return -1;
+    if (t->nodes[node].route < 0) t->nodes[node].route = rt_new_route(t, tmpl);
+    return t->nodes[node].route;
+}
+
+/* Comma-separated templates.  Returns -1 on the first bad one. */
+static int route_add_list(RouteTrie *t, const char *spec) {
+    char tmp[ROUTE_TMPL_LEN];
+    while (*spec) {
+        const char *comma = strchr(spec, ',');
+        size_t n = comma ? (size_t)(comma - spec) : strlen(spec);
+        if (n == 0 || n >= sizeof(tmp) || spec[0] != '/') return -1;
+        memcpy(tmp, spec, n);
+        tmp[n] = '\0';
+        if (route_add(t, tmp) < 0) return -1;
+        spec += n + (comma != NULL);
+    }
+    return 0;
+}
+
+/*
+ * Route for seg[i..n) below node, or -1.  Clears *shared when the answer
+ * may differ for another path of the same shape: an ID segment was
+ * looked up where ID-looking literals of its kind exist.
+ */
+static int rt_walk(const RouteTrie *t, int node, const RouteSeg *seg, int i, int n, int *shared) {
+    if (i == n) return t->nodes[node].route;
+    if (t->nodes[node].id_lits >> seg[i].kind & 1) *shared = 0;
+    int c = rt_lit_child(t, node, &seg[i]), r;
+    if (c >= 0 && (r = rt_walk(t, c, seg, i + 1, n, shared)) >= 0) return r;
+    for (c = t->nodes[node].param; c >= 0; c = t->nodes[c].sibling) {
+        if (t->nodes[c].kind == RT_REST) return t->nodes[c].route;
+        if (rt_param_matches(t->nodes[c].kind, &seg[i]) &&
+            (r = rt_walk(t, c, seg, i + 1, n, shared)) >= 0)
+            return r;
+    }
+    return -1;
+}
+
+/* Normalized template for an unmatched path, added to the trie. */
+static int rt_learn(RouteTrie *t, const RouteSeg *seg, int n) {
+    static const char *const names[] = { [RT_NUM] = ":id", [RT_UUID] = ":uuid", [RT_HEX] = ":hex" };
+    char tmpl[ROUTE_TMPL_LEN];
+    int len = 0, node = 0;
+    if (n == 0) tmpl[len++] = '/';
+    for (int i = 0; i < n; i++) {
+        int kind = seg[i].kind;
+        const char *s = kind == RT_LIT ? seg[i].b : names[kind];
+        int sl = kind == RT_LIT ? seg[i].len : (int)strlen(s);
+        if (kind == RT_NUM) kind = RT_ANY;
+        if (len + 1 + sl >= ROUTE_TMPL_LEN || (node = rt_child(t, node, kind, &seg[i])) < 0)
+            return t->overflow;
+        tmpl[len++] = '/';
+        memcpy(tmpl + len, s, sl);
+        len += sl;
+    }
+    tmpl[len] = '\0';
+    if (t->nodes[node].route < 0) {
+        t->nodes[node].route = rt_new_route(t, tmpl);
+        t->n_learned++;
+    }
+    return t->nodes[node].route;
+}
+
+/*
+ * Paths shorter than a word, zero-padded, without reading past them:
+ * from 4 bytes up, two overlapping 4-byte loads.
+ */
+static inline uint64_t rt_load_short(const char *p, int len) {
+    uint32_t lo, hi;
+    uint64_t w = 0;
+    if (len >= 4) {
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + len - 4, 4);
+        return lo | (uint64_t)hi << (len - 4) * 8;
+    }
+    for (int i = 0; i < len; i++) w |= (uint64_t)(unsigned char)p[i] << (i * 8);
+    return w;
+}
+
+static inline uint64_t rt_word(const char *p) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+/*
+ * Last word of path[0..len), zero-padded: the word ending at the path's
+ * end, shifted down; word i < last is simply path + 8 * i.
+ */
+static inline uint64_t rt_last_word(const char *path, int len) {
+    if (len < 8) return rt_load_short(path, len);
+    return rt_word(path + len - 8) >> (-len & 7) * 8;
+}
+
+/* w with every byte an ID may contain zeroed. */
+static inline uint64_t rt_skeleton(uint64_t w) {
+    return w & ~(((rt_hex(w) | rt_eq_all(w, RT_ONES * '-')) >> 7) * 0xff);
+}
+
+/*
+ * Cache set (two entries) by length and first word.  IDs mostly start
+ * past the first word — /api/users/42 — so the raw word, as cheap as an
+ * exact-path key, is the same for every path of a shape.  A shape with
+ * an ID in its first word is keyed by the word's skeleton instead.
+ */
+static inline RouteShape *rt_shape_set(RouteTrie *t, uint64_t head, int len) {
+    uint64_t h = (head * 0x9e3779b97f4a7c15ULL ^ (uint64_t)len) * 0xbf58476d1ce4e5b9ULL;
+    return &t->shapes[h >> (64 - ROUTE_SHAPE_BITS) & ~1ULL];
+}
+
+/*
+ * A :hex segment of n >= 8 hex digits keeps its kind with a digit, and a
+ * letter unless it is too long for :num.  Digits are the hex digits
+ * with bit 0x40 clear.
+ */
+static inline int rt_hex_mixed(const char *s, int n) {
+    uint64_t letter = 0, digit = 0;
+    for (int i = 0; i < n; i += 8) {
+        uint64_t w = rt_word(s + (i + 8 <= n ? i : n - 8));
+        letter |= w;
+        digit |= ~w;
+    }
+    return (digit & RT_ONES * 0x40) && ((letter & RT_ONES * 0x40) || n > 19);
+}
+
+/*
+ * The byte checks of a RouteShape with IDs.  SSE2 takes 16 bytes a step,
+ * the last step ending at the path's end, and builds a shorter path from
+ * the two words the cache key loaded already.  Elsewhere, NEON builds
+ * included, SWAR range checks take a word at a time.
+ */
+#if defined(SCAN_SSE2)
+static __attribute__((noinline)) int rt_shape_ids(const RouteShape *m, const char *path, int len,
+                                                 uint64_t head, uint64_t last) {
+    const __m128i flip = _mm_set1_epi8((char)0x80), fold = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8((char)('a' ^ 0x80));
+    __m128i v = len >= 16 ? _mm_loadu_si128((const __m128i *)path)
+                          : _mm_set_epi64x(len > 8 ? (long long)last : 0, (long long)head);
+    for (int at = 0;;) {
+        __m128i lit = _mm_loadu_si128((const __m128i *)(m->lit + at));
+        __m128i x = _mm_sub_epi8(_mm_xor_si128(v, flip), lit);
+        __m128i y = _mm_sub_epi8(_mm_or_si128(v, fold), a);
+        __m128i ok = _mm_or_si128(_mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)(m->lo + at)), x),
+                                  _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)(m->hi + at)), y));
+        if (_mm_movemask_epi8(ok) != 0xffff) return 0;
+        if ((at += 16) >= len) break;
+        if (at > len - 16) at = len - 16;       /* overlaps; the bytes agree */
+        v = _mm_loadu_si128((const __m128i *)(path + at));
+    }
+    return !m->hex_len || rt_hex_mixed(path + m->hex_at, m->hex_len);
+}
+#else
+static __attribute__((noinline)) int rt_shape_ids(const RouteShape *m, const char *path, int len,
+                                                 uint64_t head, uint64_t last) {
+    (void)head;
+    for (int i = 0; 8 * i < len; i++) {
+        uint64_t w = 8 * i + 8 < len ? rt_word(path + 8 * i) : last;
+        uint64_t a = w & ~RT_HIGHS, ascii = ~w & RT_HIGHS;
+        /* lo is 1 - 128 or 10 - 128 and hi -128 or 6 - 128: bits 3 and 1 tell them apart */
+        uint64_t dig = rt_word((const char *)m->lo + 8 * i) << 4 & RT_HIGHS;
+        uint64_t let = rt_word((const char *)m->hi + 8 * i) << 6 & RT_HIGHS;
+        uint64_t ok = (rt_eq_all(w, rt_word(m->lit + 8 * i)) & ~dig) |
+                      (rt_digits(a) & ascii & dig) |
+                      (rt_range(a | RT_ONES * 0x20, 'a', 'f') & ascii & let);
+        if (ok != RT_HIGHS) return 0;
+    }
+    return !m->hex_len || rt_hex_mixed(path + m->hex_at, m->hex_len);
+}
+#endif
+
+/*
+ * Whether path[0..len), first and last words head and last, has the
+ * shape of m.  Without IDs that is equal words, as for an exact-path
+ * key, compared inline; with them, the byte checks above.
+ */
+static inline __attribute__((always_inline)) int rt_shape_eq(const RouteTrie *t, const RouteShape *m,
+                                                             const char *path, int len,
+                                                             uint64_t head, uint64_t last) {
+    if (m->len != len || m->gen != t->gen) return 0;
+    if (m->ids) return rt_shape_ids(m, path, len, head, last);
+    uint64_t diff = head ^ rt_word(m->lit);
+    if (len <= 16) return !(diff | ((len > 8 ? last : 0) ^ rt_word(m->lit + 8)));
+    int nw = (len - 1) / 8;                     /* full words before the last */
+    for (int i = 1; i < nw; i++)
+        diff |= rt_word(path + 8 * i) ^ rt_word(m->lit + 8 * i);
+    return !(diff | (last ^ rt_word(m->lit + 8 * nw)));
+}
+
+/*
+ * Cached route of path[0..len), len <= ROUTE_SHAPE_LEN, or -1: from the
+ * set of its first word, or with `skeleton` of that word's skeleton.
+ */
+static inline __attribute__((always_inline)) int rt_shape_lookup(RouteTrie *t, const char *path,
+                                                                 int len, int skeleton) {
+    uint64_t last = rt_last_word(path, len), head = len > 8 ? rt_word(path) : last;
+    const RouteShape *m = rt_shape_set(t, skeleton ? rt_skeleton(head) : head, len);
+    for (int way = 0; way < 2; way++, m++)
+        if (rt_shape_eq(t, m, path, len, head, last)) return m->route;
+    return -1;
+}
+
+/* Caches the shape of path[0..len) from its segments. */
+static void rt_shape_store(RouteTrie *t, const char *path, int len,
+                           const RouteSeg *seg, int n, int route) {
+    RouteShape s = { .len = len, .route = route, .gen = t->gen };
+    int first = len;                            /* first ID byte */
+    memset(s.lo, 1 - 128, sizeof(s.lo));
+    memset(s.hi, -128, sizeof(s.hi));
+    memcpy(s.lit, path, (size_t)len);
+    for (int i = 0; i < n; i++) {
+        int kind = seg[i].kind, at = (int)(seg[i].b - path);
+        if (kind == RT_LIT) continue;
+        if (kind == RT_HEX) {
+            if (s.hex_len) return;              /* one :hex only */
+            s.hex_at = (uint8_t)at;
+            s.hex_len = (uint8_t)seg[i].len;
+        }
+        for (int j = 0; j < seg[i].len; j++) {
+            if (kind == RT_UUID && (j == 8 || j == 13 || j == 18 || j == 23))
+                continue;                       /* dashes stay literal */
+            s.lit[at + j] = '0';
+            s.lo[at + j] = 10 - 128;
+            if (kind != RT_NUM) s.hi[at + j] = 6 - 128;
+        }
+        s.ids = 1;
+        if (at < first) first = at;
+    }
+    uint64_t last = rt_last_word(path, len), head = len > 8 ? rt_word(path) : last;
+    RouteShape *m = rt_shape_set(t, first < 8 ? rt_skeleton(head) : head, len);
+    if (m->gen == t->gen) m++;                  /* keep a live first entry */
+    *m = s;
+}
+
+/*
+ * route_match() past a miss in the first-word set: the skeleton set,
+ * then the same two without the query string, then the trie.  Out of
+ * line, so the hit path stays a few inlined word compares.
+ */
+static __attribute__((noinline)) int rt_match_slow(RouteTrie *t, const char *path, int len) {
+    int r;
+    if (len <= ROUTE_SHAPE_LEN && (r = rt_shape_lookup(t, path, len, 1)) >= 0)
+        return r;
+    int cut = (int)(scan_byte2(path, path + len, '?', '#') - path);
+    if (cut < len && cut <= ROUTE_SHAPE_LEN &&              /* the shape ends at the query */
+        ((r = rt_shape_lookup(t, path, cut, 0)) >= 0 || (r = rt_shape_lookup(t, path, cut, 1)) >= 0))
+        return r;
+    len = cut;
+    RouteSeg seg[ROUTE_DEPTH];
+    int n = rt_segments(path, path + len, seg, ROUTE_DEPTH), shared = 1;
+    if (n < 0) return t->overflow;
+    r = rt_walk(t, 0, seg, 0, n, &shared);
+    if (r < 0) return rt_learn(t, seg, n);
+    if (shared && len <= ROUTE_SHAPE_LEN) rt_shape_store(t, path, len, seg, n, r);
+    return r;
+}
+
+/*
+ * Route id for a request path (query string ignored).  A path mostly
+ * repeats the shape of an earlier one — /health again, or
+ * /api/users/:id with another id — and the shape cache answers it with
+ * a few inlined word compares, or the byte checks of its ID segments;
+ * nothing is split.  Only a miss segments the path and walks the trie,
+ * and only a walk whose answer holds for the whole shape is cached.
+ */
+static inline int route_match(RouteTrie *t, const char *path, int len) {
+    int r = len <= ROUTE_SHAPE_LEN ? rt_shape_lookup(t, path, len, 0) : -1;
+    return r >= 0 ? r : rt_match_slow(t, path, len);
+}
+
+static inline void route_record(RouteTrie *t, int id, int status, double latency_ms) {
+    Route *r = &t->routes[id];
+    r->count++;
+    r->errors += status >= 500;
+    r->lat_sum += latency_ms;
+}
+
+static void route_reset_stats(RouteTrie *t) {
+    for (int i = 0; i < t->n_routes; i++) {
+        t->routes[i].count = t->routes[i].errors = 0;
+        t->routes[i].lat_sum = 0;
+    }
+}
+
+static int cmp_route_count(const void *a, const void *b) {
+    long ca = ((const Route *)a)->count, cb = ((const Route *)b)->count;
+    return (cb > ca) - (cb < ca);
+}
+
+/* Top n routes by request count; sorts a copy, ids stay valid. */
+static void route_print_top(const RouteTrie *t, int n) {
+    Route *tmp = malloc(t->n_routes * sizeof(Route));
+    memcpy(tmp, t->routes, t->n_routes * sizeof(Route));
+    qsort(tmp, t->n_routes, sizeof(Route), cmp_route_count);
+    for (int i = 0; i < n && i < t->n_routes && tmp[i].count > 0; i++)
+        printf("  %-28s %7ld reqs  5xx %5.1f%%  avg %.1f ms\n", tmp[i].tmpl, tmp[i].count,
+               100.0 * tmp[i].errors / tmp[i].count, tmp[i].lat_sum / tmp[i].count);
+    free(tmp);
+}
@@ -0,0 +1,225 @@
+/*
+ * sample.c — Approximate analysis of a random sample, with error bounds
+ *
+ * Two sampling units:
+ *
+ *   chunk  the file is cut into fixed-size byte ranges and each is kept
+ *          with probability 1/N.  A kept chunk owns exactly the lines
+ *          that start inside it, so every line belongs to one chunk and
+ *          only ~1/N of the file is ever read.
+ *   line   every line is kept with probability 1/N.  The whole file is
+ *          still read and split, but only kept lines are parsed.
+ *
+ * Selection uses geometric skips (the gap to the next kept unit), so
+ * the RNG runs once per kept unit, not once per unit.
+ *
+ * Error bounds come from random groups: every kept unit is assigned to
+ * one of SAMPLE_GROUPS groups at random, each statistic is computed per
+ * group as well as overall, and the spread of the group estimates gives
+ * its standard error.  One estimator covers ratios, shares and
+ * percentiles alike, and because a whole chunk lands in one group it
+ * stays honest when lines within a chunk are correlated (bursts from
+ * one client), which a per-line binomial bound would not.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLE_GROUPS   32
+#define SAMPLE_MIN_KEPT (SAMPLE_GROUPS * 8)    /* kept chunks to aim for */
+#define SAMPLE_CHUNK_MIN (4 << 10)
+#define SAMPLE_CHUNK_MAX (1 << 20)
+#define SAMPLE_BLOCK    (4 << 20)               /* read size in line mode */
+#define SAMPLE_EXTEND   4096                    /* read-ahead to finish a line */
+
+enum { SAMPLE_BY_CHUNK, SAMPLE_BY_LINE, SAMPLE_UNITS };
+static const char *const sample_unit_names[SAMPLE_UNITS] = { "chunk", "line" };
+
+/* xorshift64* */
+typedef struct { uint64_t s; } SampleRng;
+
+static inline uint64_t sample_rand(SampleRng *r) {
+    r->s ^= r->s >> 12;
+    r->s ^= r->s << 25;
+    r->s ^= r->s >> 27;
+    return r->s * 2685821657736338717ULL;
+}
+
+/* Units to pass over before the next kept one; geometric, success 1/rate. */
+static inline uint64_t sample_skip(SampleRng *r, int rate) {
+    if (rate <= 1) return 0;
+    double u = ((sample_rand(r) >> 11) + 1) * 0x1.0p-53;    /* (0, 1] */
+    return (uint64_t)(log(u) / log1p(-1.0 / rate));
+}
+
+/* A kept run of complete lines and the group it is accounted to. */
+typedef void (*SampleFn)(void *ctx, const char *buf, size_t len, int group);
+
+typedef struct {
+    int       unit, rate;
+    size_t    chunk;                    /* chunk mode: bytes per chunk */
+    SampleRng rng;
+    uint64_t  units, kept;              /* chunks or lines: total / kept */
+    uint64_t  file_bytes, bytes_read;
+    uint64_t  group_bytes[SAMPLE_GROUPS];   /* chunk bytes kept per group */
+} Sampler;
+
+static void sample_init(Sampler *s, int unit, int rate, uint64_t seed) {
+    memset(s, 0, sizeof(*s));
+    s->unit = unit;
+    s->rate = rate > 0 ? rate : 1;
+    s->rng.s = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+    sample_rand(&s->rng);
+}
+
+static size_t sample_pread(int fd, char *buf, size_t n, off_t off) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = pread(fd, buf + got, n - got, off + (off_t)got);
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    return got;
+}
+
+/*
+ * Chunk size: small enough that ~SAMPLE_MIN_KEPT chunks are kept (the
+ * group estimates need several chunks each), large enough that reads
+ * stay sequential-sized.
+ */
+static size_t sample_chunk_size(uint64_t size, int rate) {
+    uint64_t c = size / ((uint64_t)rate * SAMPLE_MIN_KEPT);
+    if (c < SAMPLE_CHUNK_MIN) c = SAMPLE_CHUNK_MIN;
+    if (c > SAMPLE_CHUNK_MAX) c = SAMPLE_CHUNK_MAX;
+    return (size_t)c;
+}
+
+static void sample_chunks(Sampler *s, int fd, SampleFn fn, void *ctx) {
+    size_t cap = s->chunk + SAMPLE_EXTEND + 1;
+    char *buf = malloc(cap);
+    uint64_t size = s->file_bytes, n = (size + s->chunk - 1) / s->chunk;
+    s->units = n;
+    for (uint64_t c = sample_skip(&s->rng, s->rate); c < n; c += 1 + sample_skip(&s->rng, s->rate)) {
+        off_t start = (off_t)(c * s->chunk);
+        off_t end = start + (off_t)s->chunk < (off_t)size ? start + (off_t)s->chunk : (off_t)size;
+        off_t from = start ? start - 1 : 0;     /* one byte back: is start a line start? */
+        size_t len = sample_pread(fd, buf, (size_t)(end - from), from);
+
+        /* Finish the line that straddles the end of the chunk. */
+        while (len && buf[len - 1] != '\n') {
+            if (cap - len < SAMPLE_EXTEND) buf = realloc(buf, cap *= 2);
+            size_t got = sample_pread(fd, buf + len, SAMPLE_EXTEND, from + (off_t)len);
+            if (got == 0) break;
+            const char *nl = memchr(buf + len, '\n', got);
+            len += nl ? (size_t)(nl - (buf + len)) + 1 : got;
+            if (nl) break;
+        }
+        s->bytes_read += len;
+
+        /* Skip the tail of a line owned by the previous chunk. */
+        size_t b = 0;
+        if (start) {
+            const char *nl = memchr(buf, '\n', len);
+            b = nl ? (size_t)(nl - buf) + 1 : len;
+        }
+        int g = (int)(sample_rand(&s->rng) % SAMPLE_GROUPS);
+        s->kept++;
+        s->group_bytes[g] += (uint64_t)(end - start);
+        if (from + (off_t)b < end) fn(ctx, buf + b, len - b, g);
+    }
+    free(buf);
+}
+
+static void sample_lines(Sampler *s, int fd, SampleFn fn, void *ctx) {
+    size_t cap = SAMPLE_BLOCK, have = 0;
+    char *buf = malloc(cap);
+    uint64_t skip = sample_skip(&s->rng, s->rate);
+    for (;;) {
+        ssize_t r = read(fd, buf + have, cap - have);
+        int eof = r <= 0;
+        if (!eof) { have += (size_t)r; s->bytes_read += (uint64_t)r; }
+        const char *p = buf, *end = buf + have;
+        for (;;) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t l;
+            if (nl)                  l = (size_t)(nl - p) + 1;
+            else if (eof && p < end) l = (size_t)(end - p);    /* unterminated last line */
+            else                     break;
+            s->units++;
+            if (skip) {
+                skip--;
+            } else {
+                fn(ctx, p, l, (int)(sample_rand(&s->rng) % SAMPLE_GROUPS));
+                s->kept++;
+                skip = sample_skip(&s->rng, s->rate);
+            }
+            p += l;
+        }
+        if (eof) break;
+        have = (size_t)(end - p);
+        memmove(buf, p, have);
+        if (have == cap) buf = realloc(buf, cap *= 2);
+    }
+    free(buf);
+}
+
+/* Runs fn over the sampled lines of path.  Returns -1 if unreadable. */
+static int sample_scan(Sampler *s, const char *path, SampleFn fn, void *ctx) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    s->file_bytes = (uint64_t)st.st_size;
+    if (s->unit == SAMPLE_BY_CHUNK) {
+        s->chunk = sample_chunk_size(s->file_bytes, s->rate);
+        sample_chunks(s, fd, fn, ctx);
+    } else {
+        sample_lines(s, fd, fn, ctx);
+    }
+    close(fd);
+    return 0;
+}
+
+/* ── Intervals ──────────────────────────────────────────────────────────── */
+
+typedef struct { double est, lo, hi; } SampleCI;
+
+/* Two-sided 95% Student t quantile (Cornish-Fisher; within 0.3% for df >= 3). */
+static double sample_t95(int df) {
+    const double z = 1.959964;
+    if (df < 1) return INFINITY;
+    if (df < 3) return df == 1 ? 12.706 : 4.303;
+    double z3 = z * z * z, z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96.0 * df * df);
+}
+
+/*
+ * 95% interval around est from n group estimates: random-group variance
+ * Σ(θg − θ̄)² / n(n−1), scaled by the finite population correction.
+ */
+static SampleCI sample_ci(double est, const double *group, int n, double fpc) {
+    SampleCI ci = { est, est, est };
+    if (fpc <= 0) return ci;                    /* everything was read */
+    if (n < 2) { ci.lo = -INFINITY; ci.hi = INFINITY; return ci; }
+    double mean = 0, ss = 0;
+    for (int i = 0; i < n; i++) mean += group[i];
+    mean /= n;
+    for (int i = 0; i < n; i++) ss += (group[i] - mean) * (group[i] - mean);
+    double half = sample_t95(n - 1) * sqrt(fpc * ss / ((double)n * (n - 1)));
+    ci.lo = est - half;
+    ci.hi = est + half;
+    return ci;
+}
+
+static inline int sample_covers(const SampleCI *ci, double truth) {
+    return truth >= ci->lo && truth <= ci->hi;
+}
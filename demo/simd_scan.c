@@ -0,0 +1,119 @@
+/*
+ * simd_scan.c — Delimiter scanning for the log parsers
+ *
+ * scan_byte() looks for the next delimiter 16 bytes at a time: NEON on
+ * aarch64, SSE2 on x86-64, a plain loop anywhere else.  Access-log
+ * tokens are short (IPs, methods, status codes), so a single compare
+ * usually covers the whole token and the vector loop runs once — no
+ * per-byte branch like the `while (*p && *p != ' ')` loops in parse_line.
+ * Building with -DSCAN_SCALAR forces the plain loop (and the scalar
+ * field steps of swar_int.c), for comparing builds of the same source.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(SCAN_SCALAR)
+/* -DSCAN_SCALAR: the plain loops everywhere, for A/B builds. */
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#endif
+
+#define SCAN_WIDTH 16
+
+#if defined(SCAN_NEON)
+/*
+ * NEON has no movemask.  SHRN #4 narrows each 16-bit lane of the
+ * 0x00/0xFF compare result to one byte, leaving 4 mask bits per input
+ * byte in a 64-bit scalar.
+ */
+#define SCAN_BITS_PER_BYTE 4
+static inline uint64_t neon_mask16(uint8x16_t eq) {
+    uint8x8_t nb = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nb), 0);
+}
+
+static inline uint64_t match_mask16(const char *p, char c) {
+    return neon_mask16(vceqq_u8(vld1q_u8((const uint8_t *)p), vdupq_n_u8((uint8_t)c)));
+}
+
+static inline uint64_t match_mask16_2(const char *p, char c1, char c2) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p);
+    return neon_mask16(vorrq_u8(vceqq_u8(v, vdupq_n_u8((uint8_t)c1)),
+                                vceqq_u8(v, vdupq_n_u8((uint8_t)c2))));
+}
+
+/* Four 0x00/0xFF compare results → one bit per byte, via pairwise adds. */
+static inline uint64_t neon_bitmask64(uint8x16_t m0, uint8x16_t m1,
+                                      uint8x16_t m2, uint8x16_t m3) {
+    const uint8x16_t bits = { 1, 2, 4, 8, 16, 32, 64, 128,
+                              1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t s0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+    uint8x16_t s1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+    s0 = vpaddq_u8(s0, s1);
+    s0 = vpaddq_u8(s0, s0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static inline uint64_t match_mask64(const char *p, char c) {
+    const uint8x16_t cv = vdupq_n_u8((uint8_t)c);
+    const uint8_t *u = (const uint8_t *)p;
+    return neon_bitmask64(vceqq_u8(vld1q_u8(u),      cv), vceqq_u8(vld1q_u8(u + 16), cv),
+                          vceqq_u8(vld1q_u8(u + 32), cv), vceqq_u8(vld1q_u8(u + 48), cv));
+}
+#elif defined(SCAN_SSE2)
+#define SCAN_BITS_PER_BYTE 1
+static inline uint64_t match_mask16(const char *p, char c) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+static inline uint64_t match_mask16_2(const char *p, char c1, char c2) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(c1)),
+                                                    _mm_cmpeq_epi8(v, _mm_set1_epi8(c2))));
+}
+
+static inline uint64_t match_mask64(const char *p, char c) {
+    return match_mask16(p, c)              | match_mask16(p + 16, c) << 16 |
+           match_mask16(p + 32, c) << 32   | match_mask16(p + 48, c) << 48;
+}
+#else
+static inline uint64_t match_mask64(const char *p, char c) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++)
+        m |= (uint64_t)(p[i] == c) << i;
+    return m;
+}
+#endif
+
+/* First occurrence of c in [p, end), or end if there is none. */
+static inline const char *scan_byte(const char *p, const char *end, char c) {
+#if defined(SCAN_NEON) || defined(SCAN_SSE2)
+    while (end - p >= SCAN_WIDTH) {
+        uint64_t m = match_mask16(p, c);
+        if (m) return p + __builtin_ctzll(m) / SCAN_BITS_PER_BYTE;
+        p += SCAN_WIDTH;
+    }
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
+
+/* First occurrence of either c1 or c2 in [p, end), or end. */
+static inline const char *scan_byte2(const char *p, const char *end, char c1, char c2) {
+#if defined(SCAN_NEON) || defined(SCAN_SSE2)
+    while (end - p >= SCAN_WIDTH) {
+        uint64_t m = match_mask16_2(p, c1, c2);
+        if (m) return p + __builtin_ctzll(m) / SCAN_BITS_PER_BYTE;
+        p += SCAN_WIDTH;
+    }
+#endif
+    while (p < end && *p != c1 && *p != c2) p++;
+    return p;
+}
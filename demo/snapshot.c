@@ -0,0 +1,402 @@
+/*
+ * snapshot.c — Mergeable binary snapshots of the aggregate state
+ *
+ * A snapshot is everything the report needs, small enough to ship
+ * instead of the logs:
+ *
+ *   header    magic, version, line/error/filter counts, section sizes
+ *   status    (code, count) for every non-zero status
+ *   ips       (ip, count, latency sum in µs), sorted by ip
+ *   latency   (value, count) for every distinct latency, ascending
+ *
+ * Counts are LEB128 varints; header fields are fixed-width and latency
+ * values IEEE doubles, all written byte by byte in little-endian order,
+ * so a snapshot reads back the same on any host.  The latency section is an exact value histogram rather
+ * than an approximate sketch: access-log latencies are quantized (0.1 ms
+ * here), so a few thousand distinct values describe millions of lines,
+ * and exact percentiles survive any number of merges.  Per-IP latency is
+ * summed as integer microseconds so merged sums equal single-node sums
+ * regardless of order.
+ *
+ * Both list sections are sorted, so snap_merge() combines N snapshots
+ * as a streaming k-way merge — one record per input in memory — writing
+ * the merged snapshot and/or the report as it goes.
+ *
+ * #included by log_analyzer.c after quantile.c.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAP_MAGIC   "LASNAP\r\n"
+#define SNAP_VERSION 1
+#define SNAP_IP_LEN  48
+#define SNAP_TOP     10
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_status;          /* non-zero status codes */
+    uint64_t lines, errors, filtered;
+    uint64_t n_ips;
+    uint64_t n_lat;             /* distinct latency values */
+    uint64_t lat_count;         /* latency samples */
+} SnapHeader;
+
+typedef struct {
+    char     ip[SNAP_IP_LEN];
+    uint64_t count, lat_us;
+} SnapIP;
+
+typedef struct {
+    double   value;
+    uint64_t count;
+} SnapLat;
+
+/* ── Encoding ───────────────────────────────────────────────────────────── */
+
+#define SNAP_HEADER_SIZE 64     /* magic 8, two u32, six u64 */
+
+static void snap_le_store(unsigned char *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t snap_le_load(const unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static int snap_put_header(FILE *f, const SnapHeader *h) {
+    unsigned char b[SNAP_HEADER_SIZE];
+    memcpy(b, h->magic, 8);
+    snap_le_store(b + 8, h->version, 4);
+    snap_le_store(b + 12, h->n_status, 4);
+    const uint64_t v[6] = { h->lines, h->errors, h->filtered, h->n_ips, h->n_lat, h->lat_count };
+    for (int i = 0; i < 6; i++) snap_le_store(b + 16 + 8 * i, v[i], 8);
+    return fwrite(b, sizeof(b), 1, f) == 1 ? 0 : -1;
+}
+
+static int snap_get_header(FILE *f, SnapHeader *h) {
+    unsigned char b[SNAP_HEADER_SIZE];
+    if (fread(b, sizeof(b), 1, f) != 1) return -1;
+    memcpy(h->magic, b, 8);
+    h->version  = (uint32_t)snap_le_load(b + 8, 4);
+    h->n_status = (uint32_t)snap_le_load(b + 12, 4);
+    uint64_t *v[6] = { &h->lines, &h->errors, &h->filtered, &h->n_ips, &h->n_lat, &h->lat_count };
+    for (int i = 0; i < 6; i++) *v[i] = snap_le_load(b + 16 + 8 * i, 8);
+    return 0;
+}
+
+static void snap_put_varint(FILE *f, uint64_t v) {
+    unsigned char b[10];
+    int n = 0;
+    do {
+        b[n] = v & 0x7f;
+        v >>= 7;
+        if (v) b[n] |= 0x80;
+        n++;
+    } while (v);
+    fwrite(b, 1, n, f);
+}
+
+static int snap_get_varint(FILE *f, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(f);
+        if (c == EOF) return -1;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+static void snap_put_ip(FILE *f, const SnapIP *r) {
+    size_t len = strlen(r->ip);
+    fputc((int)len, f);
+    fwrite(r->ip, 1, len, f);
+    snap_put_varint(f, r->count);
+    snap_put_varint(f, r->lat_us);
+}
+
+static int snap_get_ip(FILE *f, SnapIP *r) {
+    int len = getc(f);
+    if (len == EOF || len >= SNAP_IP_LEN || fread(r->ip, 1, len, f) != (size_t)len) return -1;
+    r->ip[len] = '\0';
+    if (snap_get_varint(f, &r->count) || snap_get_varint(f, &r->lat_us)) return -1;
+    return 0;
+}
+
+static void snap_put_lat(FILE *f, const SnapLat *r) {
+    unsigned char b[8];
+    uint64_t bits;
+    memcpy(&bits, &r->value, sizeof(bits));
+    snap_le_store(b, bits, 8);
+    fwrite(b, 1, sizeof(b), f);
+    snap_put_varint(f, r->count);
+}
+
+static int snap_get_lat(FILE *f, SnapLat *r) {
+    unsigned char b[8];
+    if (fread(b, 1, sizeof(b), f) != sizeof(b)) return -1;
+    uint64_t bits = snap_le_load(b, 8);
+    memcpy(&r->value, &bits, sizeof(bits));
+    return snap_get_varint(f, &r->count);
+}
+
+/* ── Writing ────────────────────────────────────────────────────────────── */
+
+/*
+ * Starts a snapshot: header (patched by snap_finish) and status section.
+ * status[] has 600 entries like status_counts.
+ */
+static FILE *snap_begin(const char *path, SnapHeader *h, const uint64_t *status) {
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); return NULL; }
+    memcpy(h->magic, SNAP_MAGIC, sizeof(h->magic));
+    h->version = SNAP_VERSION;
+    h->n_status = 0;
+    for (int s = 0; s < 600; s++) h->n_status += status[s] != 0;
+    snap_put_header(f, h);
+    for (int s = 0; s < 600; s++)
+        if (status[s]) {
+            snap_put_varint(f, (uint64_t)s);
+            snap_put_varint(f, status[s]);
+        }
+    return f;
+}
+
+static int snap_finish(FILE *f, const SnapHeader *h) {
+    int err = fseek(f, 0, SEEK_SET) != 0 || snap_put_header(f, h) != 0;
+    err |= ferror(f) != 0;
+    return (fclose(f) != 0 || err) ? -1 : 0;
+}
+
+static int cmp_snap_ip(const void *a, const void *b) {
+    return strcmp(((const SnapIP *)a)->ip, ((const SnapIP *)b)->ip);
+}
+
+static int cmp_snap_lat(const void *a, const void *b) {
+    double x = ((const SnapLat *)a)->value, y = ((const SnapLat *)b)->value;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Exact latency histogram: open-addressed value → count, grown by
+ * doubling.  Fed incrementally by follow mode; write_snapshot() builds
+ * one from the sample array.
+ */
+typedef struct {
+    SnapLat *slot;
+    size_t   cap, used;
+    uint64_t total;             /* samples added */
+} SnapLatMap;
+
+static void snap_lat_add(SnapLatMap *m, double v) {
+    if (m->used * 2 >= m->cap) {                /* grow and rehash */
+        SnapLat *old = m->slot;
+        size_t old_cap = m->cap;
+        m->cap = old_cap ? old_cap << 1 : 1024;
+        m->slot = calloc(m->cap, sizeof(SnapLat));
+        for (size_t j = 0; j < old_cap; j++) {
+            if (!old[j].count) continue;
+            size_t h = agg_hash(qs_key(old[j].value)) & (m->cap - 1);
+            while (m->slot[h].count) h = (h + 1) & (m->cap - 1);
+            m->slot[h] = old[j];
+        }
+        free(old);
+    }
+    uint64_t key = qs_key(v);
+    size_t h = agg_hash(key) & (m->cap - 1);
+    while (m->slot[h].count && qs_key(m->slot[h].value) != key) h = (h + 1) & (m->cap - 1);
+    if (!m->slot[h].count) { m->slot[h].value = v; m->used++; }
+    m->slot[h].count++;
+    m->total++;
+}
+
+/* Sorted (value, count) pairs of m; *out is malloc'd, m is untouched. */
+static size_t snap_lat_sorted(const SnapLatMap *m, SnapLat **out) {
+    SnapLat *v = malloc((m->used + 1) * sizeof(SnapLat));
+    size_t n = 0;
+    for (size_t j = 0; j < m->cap; j++)
+        if (m->slot[j].count) v[n++] = m->slot[j];
+    qsort(v, n, sizeof(SnapLat), cmp_snap_lat);
+    *out = v;
+    return n;
+}
+
+/*
+ * Collapses n latency samples into sorted (value, count) pairs.  Returns
+ * the number of distinct values; *out is malloc'd.
+ */
+static size_t snap_lat_histogram(const double *lat, size_t n, SnapLat **out) {
+    SnapLatMap m = { 0 };
+    for (size_t i = 0; i < n; i++) snap_lat_add(&m, lat[i]);
+    size_t distinct = snap_lat_sorted(&m, out);
+    free(m.slot);
+    return distinct;
+}
+
+/* ── Reading and merging ────────────────────────────────────────────────── */
+
+typedef struct {
+    FILE      *f;
+    const char *path;
+    SnapHeader h;
+    uint64_t   left;            /* records left in the current section */
+    SnapIP     ip;              /* current head of the IP section */
+    SnapLat    lat;             /* current head of the latency section */
+} SnapReader;
+
+static int snap_open(SnapReader *r, const char *path, uint64_t *status) {
+    memset(r, 0, sizeof(*r));
+    r->path = path;
+    r->f = fopen(path, "rb");
+    if (!r->f) { perror(path); return -1; }
+    if (snap_get_header(r->f, &r->h) != 0 ||
+        memcmp(r->h.magic, SNAP_MAGIC, sizeof(r->h.magic)) != 0) {
+        fprintf(stderr, "%s: not a snapshot\n", path);
+        return -1;
+    }
+    if (r->h.version != SNAP_VERSION) {
+        fprintf(stderr, "%s: snapshot version %u, expected %u\n", path,
+                r->h.version, SNAP_VERSION);
+        return -1;
+    }
+    for (uint32_t i = 0; i < r->h.n_status; i++) {
+        uint64_t code, count;
+        if (snap_get_varint(r->f, &code) || snap_get_varint(r->f, &count) || code >= 600) {
+            fprintf(stderr, "%s: truncated status section\n", path);
+            return -1;
+        }
+        status[code] += count;
+    }
+    r->left = r->h.n_ips;
+    return 0;
+}
+
+/* Keeps top[] (n entries, at most SNAP_TOP) ordered by count, then ip. */
+static void snap_top_add(SnapIP *top, int *n, const SnapIP *e) {
+    int i = *n < SNAP_TOP ? (*n)++ : SNAP_TOP;
+    while (i > 0 && (top[i - 1].count < e->count ||
+                     (top[i - 1].count == e->count && strcmp(top[i - 1].ip, e->ip) > 0))) {
+        if (i < SNAP_TOP) top[i] = top[i - 1];
+        i--;
+    }
+    if (i < SNAP_TOP) top[i] = *e;
+}
+
+typedef struct {
+    SnapHeader h;
+    uint64_t   status[600];
+    SnapIP     top[SNAP_TOP];
+    int        n_top;
+    double     pct[3];          /* p50, p95, p99 */
+} SnapResult;
+
+/*
+ * k-way merge of n snapshots into res, and into out_path if given.  Each
+ * step takes the smallest head across inputs (a linear scan: k is the
+ * node count, tens at most) and folds equal keys together.
+ */
+static int snap_merge(const char *const *paths, int n, const char *out_path, SnapResult *res) {
+    SnapReader *in = calloc(n, sizeof(SnapReader));
+    FILE *out = NULL;
+    int err = 0, bad_input = 0;
+    memset(res, 0, sizeof(*res));
+    for (int i = 0; i < n && !err; i++) {
+        err = bad_input = snap_open(&in[i], paths[i], res->status) != 0;
+        if (err) break;
+        res->h.lines += in[i].h.lines;
+        res->h.errors += in[i].h.errors;
+        res->h.filtered += in[i].h.filtered;
+        res->h.lat_count += in[i].h.lat_count;
+    }
+    if (!err && out_path && !(out = snap_begin(out_path, &res->h, res->status)))
+        err = bad_input = 1;
+
+    /* IP section. */
+    for (int i = 0; i < n && !err; i++)
+        if (in[i].left && snap_get_ip(in[i].f, &in[i].ip)) err = 1;
+    while (!err) {
+        int min = -1;
+        for (int i = 0; i < n; i++)
+            if (in[i].left && (min < 0 || strcmp(in[i].ip.ip, in[min].ip.ip) < 0)) min = i;
+        if (min < 0) break;
+        SnapIP m = in[min].ip;
+        m.count = m.lat_us = 0;
+        for (int i = 0; i < n && !err; i++) {
+            if (!in[i].left || strcmp(in[i].ip.ip, m.ip) != 0) continue;
+            m.count += in[i].ip.count;
+            m.lat_us += in[i].ip.lat_us;
+            if (--in[i].left && snap_get_ip(in[i].f, &in[i].ip)) err = 1;
+        }
+        res->h.n_ips++;
+        snap_top_add(res->top, &res->n_top, &m);
+        if (out) snap_put_ip(out, &m);
+    }
+
+    /* Latency section; percentile ranks are known from the headers. */
+    uint64_t rank[3] = { res->h.lat_count * 50 / 100, res->h.lat_count * 95 / 100,
+                         res->h.lat_count * 99 / 100 };
+    uint64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < n && !err; i++)
+        if ((in[i].left = in[i].h.n_lat) && snap_get_lat(in[i].f, &in[i].lat)) err = 1;
+    while (!err) {
+        int min = -1;
+        for (int i = 0; i < n; i++)
+            if (in[i].left && (min < 0 || in[i].lat.value < in[min].lat.value)) min = i;
+        if (min < 0) break;
+        SnapLat m = { in[min].lat.value, 0 };
+        for (int i = 0; i < n && !err; i++) {
+            if (!in[i].left || in[i].lat.value != m.value) continue;
+            m.count += in[i].lat.count;
+            if (--in[i].left && snap_get_lat(in[i].f, &in[i].lat)) err = 1;
+        }
+        seen += m.count;
+        while (next < 3 && rank[next] < seen) res->pct[next++] = m.value;
+        res->h.n_lat++;
+        if (out) snap_put_lat(out, &m);
+    }
+
+    for (int i = 0; i < n; i++)
+        if (in[i].f) fclose(in[i].f);
+    if (err && !bad_input) fprintf(stderr, "merge: truncated or corrupt snapshot\n");
+    if (out && snap_finish(out, &res->h) != 0 && !err) {
+        perror(out_path);
+        err = 1;
+    }
+    free(in);
+    return err ? -1 : 0;
+}
+
+/* Same sections and formatting as the single-node report. */
+static void snap_print(const SnapResult *r, int n_inputs) {
+    printf("\n=== Merged Results (%d snapshot%s) ===\n", n_inputs, n_inputs == 1 ? "" : "s");
+    printf("Lines processed: %llu\n", (unsigned long long)r->h.lines);
+    printf("Parse errors:    %llu\n", (unsigned long long)r->h.errors);
+    if (r->h.filtered)
+        printf("Filtered out:    %llu\n", (unsigned long long)r->h.filtered);
+    printf("Unique IPs:      %llu\n", (unsigned long long)r->h.n_ips);
+    printf("\n");
+
+    printf("Status Distribution:\n");
+    for (int s = 100; s < 600; s++)
+        if (r->status[s] > 0)
+            printf("  %d: %7llu  (%5.1f%%)\n", s, (unsigned long long)r->status[s],
+                   100.0 * r->status[s] / r->h.lines);
+
+    if (r->h.lat_count > 0) {
+        printf("\nLatency Percentiles:\n");
+        printf("  p50: %.1f ms\n", r->pct[0]);
+        printf("  p95: %.1f ms\n", r->pct[1]);
+        printf("  p99: %.1f ms\n", r->pct[2]);
+    }
+
+    printf("\nTop 10 IPs:\n");
+    for (int i = 0; i < r->n_top; i++)
+        printf("  %-20s %7llu reqs  avg %.1f ms\n", r->top[i].ip,
+               (unsigned long long)r->top[i].count, r->top[i].lat_us / 1000.0 / r->top[i].count);
+}
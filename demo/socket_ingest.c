@@ -0,0 +1,298 @@
+/*
+ * socket_ingest.c — Log lines from a local Unix socket (syslog style)
+ *
+ * rsyslog's omuxsock, logger -u and most syslog forwarders write one
+ * message per datagram to a Unix socket; stream writers send
+ * newline-framed lines instead.  Both are supported:
+ *
+ *   dgram   recvmmsg() takes up to SOCK_BATCH queued datagrams per call
+ *           into a preallocated slab, one SOCK_MSG_MAX slot each;
+ *   stream  up to SOCK_CONNS writers, each with a fixed buffer that
+ *           carries a partial last line to the next read.
+ *
+ * Either way the payloads of one batch are compacted into a single
+ * newline-separated buffer — the layout the file parsers already take —
+ * and handed over in one call, so per-message cost is a memcpy and
+ * nothing is allocated per message.  A syslog header (<PRI> and the
+ * RFC 3164 or RFC 5424 fields before the message) is stripped, so an
+ * access-log line forwarded by rsyslog parses as if read from the file.
+ *
+ * Backpressure: a Unix datagram queue holds net.unix.max_dgram_qlen
+ * messages; past that, senders block or, if nonblocking, get EAGAIN and
+ * drop — the kernel keeps no count the receiver could read.  What the
+ * receiver can see is counted: batches that came back with the whole
+ * queue (senders were being held off), truncated datagrams, overlong
+ * stream lines and writers refused for lack of a slot.
+ *
+ * #included by log_analyzer.c; not a standalone translation unit.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SOCK_BATCH      64          /* datagrams per recvmmsg() */
+#define SOCK_MSG_MAX    8192        /* longer datagrams are truncated */
+#define SOCK_CONNS      16          /* stream writers at once */
+#define SOCK_CONN_BUF   (64 << 10)  /* per writer; longest stream line */
+
+/* One batch of complete lines: buf holds n newline-terminated lines. */
+typedef void (*SockFn)(void *ctx, const char *buf, size_t len, int n);
+
+typedef struct {
+    int    fd;
+    size_t len;                     /* carried partial line */
+    char  *buf;
+} SockConn;
+
+typedef struct {
+    int            fd, stream, batch;
+    int            qlen;            /* kernel datagram queue limit */
+    const char    *path;
+    struct mmsghdr msg[SOCK_BATCH];
+    struct iovec   iov[SOCK_BATCH];
+    char          *slab;            /* SOCK_BATCH * SOCK_MSG_MAX */
+    char          *lines;           /* compacted batch */
+    size_t         lines_len, lines_cap;
+    int            lines_n;
+    SockConn       conn[SOCK_CONNS];
+    int            n_conn;
+    uint64_t       msgs, bytes, calls;
+    uint64_t       full_batches, truncated, overlong, refused, conns;
+} SockIn;
+
+static int sock_max_dgram_qlen(void) {
+    int q = 10;                     /* the kernel default */
+    FILE *f = fopen("/proc/sys/net/unix/max_dgram_qlen", "r");
+    if (f) {
+        if (fscanf(f, "%d", &q) != 1) q = 10;
+        fclose(f);
+    }
+    return q;
+}
+
+/*
+ * Binds path (replacing a stale socket file).  batch is the number of
+ * datagrams per call, 1..SOCK_BATCH; 1 makes recvmmsg() a plain recv().
+ */
+static int sock_open(SockIn *s, const char *path, int stream, int batch) {
+    memset(s, 0, sizeof(*s));
+    s->path = path;
+    s->stream = stream;
+    s->batch = batch < 1 ? 1 : batch > SOCK_BATCH ? SOCK_BATCH : batch;
+    s->qlen = sock_max_dgram_qlen();
+
+    struct sockaddr_un a = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(a.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return -1;
+    }
+    strcpy(a.sun_path, path);
+    s->fd = socket(AF_UNIX, (stream ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(s->fd, (struct sockaddr *)&a, sizeof(a)) != 0 || (stream && listen(s->fd, SOCK_CONNS) != 0)) {
+        perror(path);
+        close(s->fd);
+        return -1;
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (stream) {
+        s->lines_cap = SOCK_CONN_BUF + 1;
+        for (int i = 0; i < SOCK_CONNS; i++) s->conn[i].buf = malloc(SOCK_CONN_BUF);
+    } else {
+        s->slab = malloc((size_t)SOCK_BATCH * SOCK_MSG_MAX);
+        for (int i = 0; i < SOCK_BATCH; i++) {
+            s->iov[i] = (struct iovec){ s->slab + (size_t)i * SOCK_MSG_MAX, SOCK_MSG_MAX };
+            s->msg[i].msg_hdr = (struct msghdr){ .msg_iov = &s->iov[i], .msg_iovlen = 1 };
+        }
+        s->lines_cap = (size_t)SOCK_BATCH * (SOCK_MSG_MAX + 1);
+    }
+    s->lines = malloc(s->lines_cap);
+    return 0;
+}
+
+static void sock_close(SockIn *s) {
+    for (int i = 0; i < s->n_conn; i++) close(s->conn[i].fd);
+    for (int i = 0; i < SOCK_CONNS; i++) free(s->conn[i].buf);
+    close(s->fd);
+    unlink(s->path);
+    free(s->slab);
+    free(s->lines);
+}
+
+/* Skips n space-separated fields; NULL if the message ends first. */
+static const char *sock_skip_fields(const char *p, const char *e, int n) {
+    while (n-- > 0) {
+        const char *sp = memchr(p, ' ', (size_t)(e - p));
+        if (!sp) return NULL;
+        p = sp + 1;
+    }
+    return p;
+}
+
+/*
+ * The message part of a syslog line.  Text without a <PRI> prefix is
+ * returned whole; an unrecognized header leaves everything after <PRI>.
+ */
+static const char *sock_payload(const char *p, const char *e) {
+    if (p == e || *p != '<') return p;
+    const char *q = p + 1;
+    while (q < e && q - p <= 4 && *q >= '0' && *q <= '9') q++;
+    if (q == p + 1 || q == e || *q != '>') return p;
+    q++;
+    if (e - q > 2 && q[0] == '1' && q[1] == ' ') {
+        /* RFC 5424: VERSION TIMESTAMP HOST APP PROCID MSGID SD MSG */
+        const char *sd = sock_skip_fields(q, e, 6);
+        if (!sd || sd == e) return q;
+        if (*sd == '[') {                       /* [..][..]: values may hold spaces */
+            for (;;) {
+                const char *close = memchr(sd, ']', (size_t)(e - sd));
+                if (!close) return q;
+                sd = close + 1;
+                if (sd == e || *sd != '[') break;
+            }
+        } else {
+            sd++;                               /* "-" */
+        }
+        return sd < e && *sd == ' ' ? sd + 1 : sd;
+    }
+    /* RFC 3164: TIMESTAMP HOST TAG: MSG — the tag ends at the first ": ". */
+    for (const char *c = q; c + 1 < e && c - q < 128; c++)
+        if (c[0] == ':' && c[1] == ' ') return c + 2;
+    return q;
+}
+
+/* Appends one message (or stream line, newline excluded) to the batch. */
+static inline void sock_append(SockIn *s, const char *p, size_t len) {
+    while (len && (p[len - 1] == '\n' || p[len - 1] == '\r')) len--;
+    const char *m = sock_payload(p, p + len);
+    len -= (size_t)(m - p);
+    memcpy(s->lines + s->lines_len, m, len);
+    s->lines_len += len;
+    s->lines[s->lines_len++] = '\n';
+    s->lines_n++;
+}
+
+static void sock_flush(SockIn *s, SockFn fn, void *ctx) {
+    if (s->lines_n) fn(ctx, s->lines, s->lines_len, s->lines_n);
+    s->msgs += (uint64_t)s->lines_n;
+    s->lines_len = 0;
+    s->lines_n = 0;
+}
+
+static int sock_read_dgram(SockIn *s, SockFn fn, void *ctx) {
+    int total = 0;
+    for (;;) {
+        int n = recvmmsg(s->fd, s->msg, (unsigned)s->batch, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? total : -1;
+        }
+        s->calls++;
+        if (n >= s->batch || n >= s->qlen) s->full_batches++;
+        for (int i = 0; i < n; i++) {
+            size_t len = s->msg[i].msg_len;
+            if (s->msg[i].msg_hdr.msg_flags & MSG_TRUNC) s->truncated++;
+            s->bytes += len;
+            sock_append(s, s->iov[i].iov_base, len);
+            s->msg[i].msg_hdr.msg_flags = 0;
+        }
+        sock_flush(s, fn, ctx);
+        total += n;
+        if (n < s->batch) return total;         /* queue drained */
+    }
+}
+
+static void sock_accept(SockIn *s) {
+    for (;;) {
+        int fd = accept4(s->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (s->n_conn == SOCK_CONNS) {
+            close(fd);
+            s->refused++;
+            continue;
+        }
+        SockConn *c = &s->conn[s->n_conn++];
+        c->fd = fd;
+        c->len = 0;
+        s->conns++;
+    }
+}
+
+/* Complete lines of one writer as one batch; closes it at EOF. */
+static int sock_read_conn(SockIn *s, int i, SockFn fn, void *ctx) {
+    SockConn *c = &s->conn[i];
+    int total = 0, eof = 0;
+    for (;;) {
+        ssize_t r = read(c->fd, c->buf + c->len, SOCK_CONN_BUF - c->len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            eof = r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            if (!eof) break;
+        } else {
+            s->bytes += (uint64_t)r;
+            c->len += (size_t)r;
+        }
+        const char *p = c->buf, *end = c->buf + c->len;
+        for (;;) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            if (!nl) break;
+            sock_append(s, p, (size_t)(nl - p));
+            p = nl + 1;
+        }
+        if (eof && p < end) {                   /* last line, unterminated */
+            sock_append(s, p, (size_t)(end - p));
+            p = end;
+        }
+        c->len = (size_t)(end - p);
+        if (c->len == SOCK_CONN_BUF) {          /* no newline in a full buffer */
+            s->overlong++;
+            c->len = 0;
+        } else {
+            memmove(c->buf, p, c->len);
+        }
+        total += s->lines_n;
+        sock_flush(s, fn, ctx);
+        if (eof || r < SOCK_CONN_BUF / 2) break;
+    }
+    if (eof) {
+        close(c->fd);
+        char *buf = c->buf;                     /* keep the slot's buffer */
+        *c = s->conn[--s->n_conn];
+        s->conn[s->n_conn].buf = buf;
+    }
+    return total;
+}
+
+/*
+ * Reads everything available without blocking and passes it to fn one
+ * batch at a time.  Returns messages (lines) read, or -1 on error.
+ */
+static int sock_read(SockIn *s, SockFn fn, void *ctx) {
+    if (!s->stream) return sock_read_dgram(s, fn, ctx);
+    sock_accept(s);
+    int total = 0;
+    for (int i = s->n_conn - 1; i >= 0; i--) total += sock_read_conn(s, i, fn, ctx);
+    return total;
+}
+
+/* Waits up to timeout_ms for data or a new writer.  Returns 1 if ready. */
+static int sock_wait(SockIn *s, int timeout_ms) {
+    struct pollfd p[1 + SOCK_CONNS];
+    int n = 0;
+    p[n++] = (struct pollfd){ .fd = s->fd, .events = POLLIN };
+    for (int i = 0; i < s->n_conn; i++) p[n++] = (struct pollfd){ .fd = s->conn[i].fd, .events = POLLIN };
+    return poll(p, (nfds_t)n, timeout_ms < 0 ? 0 : timeout_ms) > 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * swar_int.c — Status and size fields from one 8-byte load
+ *
+ * The format parsers used to find a numeric field's end with scan_byte()
+ * and then convert it digit by digit.  Response sizes run from 3 to 5
+ * digits in a typical log, so the digit loop's exit branch mispredicts
+ * about once a line.  Here the field is loaded as one little-endian
+ * word and handled with SIMD-within-a-register arithmetic instead:
+ *
+ *   delimiter mask  every byte that is not '0'..'9' gets its high bit
+ *                   set; ctz of the mask is the digit count;
+ *   combining       the digits are shifted to the top of the word and
+ *                   merged pairwise by three multiply-shift steps
+ *                   (x*10 + x>>8, x*100 + x>>16, x*10000 + x>>32).
+ *
+ * The only branch left on the common path is "delimiter right after
+ * the digits?", and that is true for every well-formed line.
+ *
+ * The load reads 8 bytes from p, past the field's end; callers check
+ * that [p, p + 8) lies within the line.  Big-endian targets and
+ * -DSCAN_SCALAR builds take the scalar fallbacks in the callers
+ * (SWAR_INT is left undefined).
+ *
+ * #included by log_analyzer.c after simd_scan.c; not a standalone
+ * translation unit.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(SCAN_SCALAR)
+#define SWAR_INT
+#endif
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGH  0x8080808080808080ULL
+
+static inline uint64_t swar_load8(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Number of leading ASCII digits in the word, 0..8.  A byte is a digit
+ * iff its high nibble is 3 and adding 6 keeps it 3.  The +6 can carry
+ * out of a byte >= 0xFA, but such a byte is already a non-digit, so
+ * only bytes after the first non-digit are disturbed.
+ */
+static inline int swar_digit_count(uint64_t v) {
+    uint64_t hi = (v & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL;
+    uint64_t hi6 = ((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL;
+    uint64_t bad = hi | hi6;                            /* nonzero byte = non-digit */
+    uint64_t m = (((bad & ~SWAR_HIGH) + ~SWAR_HIGH) | bad) & SWAR_HIGH;
+    return m ? __builtin_ctzll(m) >> 3 : 8;
+}
+
+/* Value of the first n (1..8) digit bytes of v. */
+static inline uint32_t swar_digits_value(uint64_t v, int n) {
+    uint64_t x = (v - 0x30 * SWAR_ONES) << (64 - 8 * n);   /* leading zeros below */
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFFULL;
+    return (uint32_t)((x * 10000 + (x >> 32)) & 0xFFFFFFFF);
+}
+
+/*
+ * A status code at p: three digits, then delim, value 100..599.
+ * Returns the code, or -1.
+ */
+static inline int swar_status(const char *p, char delim) {
+    uint64_t v = swar_load8(p);
+    if (swar_digit_count(v) != 3 || (char)(v >> 24) != delim) return -1;
+    uint32_t x = (uint32_t)(v - 0x30 * SWAR_ONES) << 8;     /* "0ddd" */
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF;
+    x = (x * 100 + (x >> 16)) & 0xFFFF;
+    return x - 100 < 500 ? (int)x : -1;
+}
+
+/*
+ * Up to 8 digits at p.  Stores the digit count in *n (0 if p is not a
+ * digit) and returns their value.
+ */
+static inline uint32_t swar_uint8(const char *p, int *n) {
+    uint64_t v = swar_load8(p);
+    int c = swar_digit_count(v);
+    *n = c;
+    return c ? swar_digits_value(v, c) : 0;
+}
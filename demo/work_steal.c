@@ -0,0 +1,305 @@
+/*
+ * work_steal.c — Chunk scheduler for a set of log files on N threads
+ *
+ * A directory of hourly files is rarely uniform: one 5 GB hour next to
+ * a dozen 50 MB ones.  Handing each thread whole files leaves the others
+ * idle behind the largest.  Here every file is mapped and cut into
+ * newline-aligned chunks of about WS_CHUNK bytes, each worker starts
+ * with the chunks of its own files (file i to worker i mod N) in a
+ * Chase-Lev deque, and a worker that runs dry steals from the others.
+ *
+ * The owner pops from the bottom, which holds its files' chunks in
+ * order, so its reads stay sequential; thieves take from the top — the
+ * far end of the victim's last file — and contend with the owner only
+ * on its final chunk.  All chunks exist before the threads start and
+ * none are added, so a worker that finds every deque empty is done.
+ *
+ * Busy time is thread CPU time spent in chunks, so the per-worker
+ * balance (and the critical path, the largest busy time) reads the
+ * same on a loaded or undersized machine.
+ *
+ * #included by log_analyzer.c after parallel_agg.c (agg_run_threads).
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WS_CHUNK    (8 << 20)   /* default bytes per chunk */
+
+typedef struct {
+    const char *buf;
+    size_t      len;
+    int         file;
+} WsTask;
+
+typedef struct __attribute__((aligned(64))) {
+    WsTask  *task;
+    size_t   cap;
+    int64_t  top;               /* next to steal */
+    char     pad[40];
+    int64_t  bottom;            /* one past the owner's next pop */
+} WsDeque;
+
+typedef struct {
+    uint64_t chunks, stolen, bytes, failed_probes;
+    int      files;
+    double   busy, done_at;     /* CPU seconds in chunks; wall seconds at exit */
+} WsStats;
+
+typedef struct {
+    const char *path;
+    const char *map;
+    size_t      size;
+} WsFile;
+
+/* Called once per chunk; ctx is the worker's own slot of the ctx array. */
+typedef void (*WsFn)(void *ctx, const WsTask *t);
+
+typedef struct {
+    int         n, steal;
+    WsDeque    *dq;
+    WsStats    *stats;
+    WsFn        fn;
+    char       *ctx;
+    size_t      ctx_stride;
+    struct timespec t0;
+} WsPool;
+
+typedef struct {
+    WsPool *pool;
+    int     id;
+} WsArg;
+
+/* ── Deque ─────────────────────────────────────────────────────────────── */
+
+/* Before the run only: single-threaded. */
+static void ws_push(WsDeque *d, WsTask t) {
+    if ((size_t)d->bottom == d->cap) {
+        d->cap = d->cap ? d->cap * 2 : 64;
+        d->task = realloc(d->task, d->cap * sizeof(WsTask));
+    }
+    d->task[d->bottom++] = t;
+}
+
+static int ws_pop(WsDeque *d, WsTask *out) {
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+    if (t > b) {                                /* empty */
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    *out = d->task[b];
+    if (t == b) {                               /* last one: race the thieves */
+        int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                              __ATOMIC_RELAXED);
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return 1;
+}
+
+/* 1 = stole, 0 = empty, -1 = lost a race (worth retrying). */
+static int ws_steal(WsDeque *d, WsTask *out) {
+    int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return 0;
+    *out = d->task[t];
+    return __atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_RELAXED) ? 1 : -1;
+}
+
+/* ── Files ─────────────────────────────────────────────────────────────── */
+
+static int cmp_ws_path(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * Expands paths (files, or directories of regular files, sorted) into
+ * *out, malloc'd strings.  Returns the count, or -1.
+ */
+static int ws_list_files(char **paths, int n, char ***out) {
+    int cnt = 0, cap = 16;
+    char **v = malloc(cap * sizeof(char *));
+    for (int i = 0; i < n; i++) {
+        struct stat st;
+        if (stat(paths[i], &st) != 0) {
+            perror(paths[i]);
+            return -1;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            if (cnt == cap) v = realloc(v, (cap *= 2) * sizeof(char *));
+            v[cnt++] = strdup(paths[i]);
+            continue;
+        }
+        DIR *d = opendir(paths[i]);
+        if (!d) {
+            perror(paths[i]);
+            return -1;
+        }
+        int first = cnt;
+        struct dirent *e;
+        while ((e = readdir(d))) {
+            char p[4096];
+            snprintf(p, sizeof(p), "%s/%s", paths[i], e->d_name);
+            if (e->d_name[0] == '.' || stat(p, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+            if (cnt == cap) v = realloc(v, (cap *= 2) * sizeof(char *));
+            v[cnt++] = strdup(p);
+        }
+        closedir(d);
+        qsort(v + first, cnt - first, sizeof(char *), cmp_ws_path);
+    }
+    *out = v;
+    return cnt;
+}
+
+static int ws_map(WsFile *f, const char *path) {
+    f->path = path;
+    f->map = NULL;
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    f->size = (size_t)st.st_size;
+    if (f->size) {
+        void *m = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        madvise(m, f->size, MADV_SEQUENTIAL);
+        f->map = m;
+    }
+    close(fd);
+    return 0;
+}
+
+static void ws_unmap(WsFile *f) {
+    if (f->map) munmap((void *)f->map, f->size);
+}
+
+/* ── Scheduler ─────────────────────────────────────────────────────────── */
+
+/*
+ * Cuts the files into chunks and deals them out: file i to worker i mod
+ * n, each deque ordered so its owner pops chunks in file order.
+ */
+static void ws_init(WsPool *p, int n, const WsFile *files, int n_files, size_t chunk, int steal) {
+    memset(p, 0, sizeof(*p));
+    p->n = n;
+    p->steal = steal;
+    p->dq = aligned_alloc(64, n * sizeof(WsDeque));
+    memset(p->dq, 0, n * sizeof(WsDeque));
+    p->stats = calloc(n, sizeof(WsStats));
+
+    for (int w = 0; w < n; w++) {
+        for (int i = n_files - 1; i >= 0; i--) {
+            if (i % n != w) continue;
+            const WsFile *f = &files[i];
+            p->stats[w].files++;
+            /* Bounds first, then pushed last-chunk-first (files, too). */
+            size_t start = 0, n_bounds = 0, cap = f->size / chunk + 2;
+            size_t *end = malloc(cap * sizeof(size_t));
+            while (start < f->size) {
+                size_t e = start + chunk;
+                if (e >= f->size) {
+                    e = f->size;
+                } else {
+                    const char *nl = memchr(f->map + e, '\n', f->size - e);
+                    e = nl ? (size_t)(nl - f->map) + 1 : f->size;
+                }
+                end[n_bounds++] = e;
+                start = e;
+            }
+            for (size_t k = n_bounds; k-- > 0;) {
+                size_t s = k ? end[k - 1] : 0;
+                ws_push(&p->dq[w], (WsTask){ f->map + s, end[k] - s, i });
+            }
+            free(end);
+        }
+    }
+}
+
+static void ws_free(WsPool *p) {
+    for (int i = 0; i < p->n; i++) free(p->dq[i].task);
+    free(p->dq);
+    free(p->stats);
+}
+
+static double ws_seconds(clockid_t clk) {
+    struct timespec t;
+    clock_gettime(clk, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void ws_exec(WsPool *p, int id, const WsTask *t) {
+    WsStats *s = &p->stats[id];
+    double c0 = ws_seconds(CLOCK_THREAD_CPUTIME_ID);
+    p->fn(p->ctx + (size_t)id * p->ctx_stride, t);
+    s->busy += ws_seconds(CLOCK_THREAD_CPUTIME_ID) - c0;
+    s->chunks++;
+    s->bytes += t->len;
+}
+
+static void *ws_worker(void *arg) {
+    WsArg *a = arg;
+    WsPool *p = a->pool;
+    int id = a->id;
+    WsStats *s = &p->stats[id];
+    WsTask t;
+    uint64_t rng = (uint64_t)id * 0x9E3779B97F4A7C15ULL + 1;
+
+    for (;;) {
+        while (ws_pop(&p->dq[id], &t)) ws_exec(p, id, &t);
+        if (!p->steal || p->n == 1) break;
+        /* Own deque empty: probe the others from a random start. */
+        int got = 0, raced = 0;
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        for (int k = 0; k < p->n - 1 && !got; k++) {
+            int v = (int)((id + 1 + (rng + k) % (p->n - 1)) % p->n);
+            int r = ws_steal(&p->dq[v], &t);
+            if (r == 1) got = 1;
+            else { s->failed_probes++; raced |= r < 0; }
+        }
+        if (got) {
+            s->stolen++;
+            ws_exec(p, id, &t);
+        } else if (!raced) {
+            break;                              /* every deque empty: done */
+        }
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    s->done_at = (now.tv_sec - p->t0.tv_sec) + (now.tv_nsec - p->t0.tv_nsec) / 1e9;
+    return NULL;
+}
+
+/*
+ * Runs fn over every chunk on p->n threads; worker i gets ctx + i *
+ * stride.  steal = 0 keeps each worker to its own files (the static
+ * split), for comparison.
+ */
+static void ws_run(WsPool *p, WsFn fn, void *ctx, size_t stride) {
+    p->fn = fn;
+    p->ctx = ctx;
+    p->ctx_stride = stride;
+    WsArg *a = malloc(p->n * sizeof(WsArg));
+    for (int i = 0; i < p->n; i++) a[i] = (WsArg){ p, i };
+    clock_gettime(CLOCK_MONOTONIC, &p->t0);
+    agg_run_threads(p->n, ws_worker, a, sizeof(WsArg));
+    free(a);
+}
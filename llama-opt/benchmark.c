@@ -1,11 +1,36 @@
 /*
- * Benchmark: Original vs Optimized q4_0 dot product
+ * Benchmark: the q4_0 dot product kernels of this build, A/B
+ *
+ * Every kernel in q4_0_dispatch.c that the CPU supports runs through
+ * the same correctness check (against the scalar reference) and the
+ * same timings; speedups are against the first SIMD kernel (the
+ * upstream NEON loop on ARM, AVX2 on x86).  First it prints the
+ * prefetch-distance table that "tuned" (q4_0_tune.c) calibrated.
  *
  * Build: make
  * Run:   ./benchmark [n_elements]
+ *        ./benchmark matmul [cols...]
+ *        ./benchmark threads [max_threads] [cols] [n] [rows]
+ *        ./benchmark repack
+ *        ./benchmark gen [header]
  *
  * Default n=4096 (128 blocks of 32 elements) — typical for a single
  * row in a quantized model layer.
+ *
+ * The matmul mode runs whole layer shapes (weights × cols activation
+ * columns, default 1 16 128) through mul_mat.c, naive against L2-tiled,
+ * with the kernel q4_0_dispatch() picks (Q4_0_KERNEL=name overrides).
+ * The threads mode splits one large layer (default 5120x13824, ~40 MB
+ * of weights) over 1..max_threads threads of a persistent pool, with
+ * static and dynamic row partitioning, and sets the bandwidth it gets
+ * against a STREAM-style peak measured on the same threads.
+ * The repack mode times the q4_0x4 kernels over repacked weights
+ * against the native layout at each size of the main sweep.
+ * The gen mode times every kernel q4_0_gen.c generates at each size
+ * class of q4_0_tune.c and writes the winners to a header (default
+ * q4_0_gen_tuned.h), which the next build dispatches to; make tune
+ * does both.  A class keeps the tuned kernel unless a generated one
+ * beats it by GEN_MARGIN.
  */
 
 #include <stdio.h>
@@ -14,40 +39,17 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
-#include <arm_neon.h>
-
-/* ---- Types ---- */
-typedef uint16_t ggml_fp16_t;
-
-#define QK4_0 32
-#define QK8_0 32
-
-typedef struct {
-    ggml_fp16_t d;
-    uint8_t qs[QK4_0 / 2];
-} block_q4_0;
-
-typedef struct {
-    ggml_fp16_t d;
-    int8_t qs[QK8_0];
-} block_q8_0;
-
-/* ---- FP16 helpers ---- */
-static inline float fp16_to_fp32(ggml_fp16_t h) {
-    __fp16 tmp;
-    memcpy(&tmp, &h, sizeof(ggml_fp16_t));
-    return (float)tmp;
-}
 
-static inline ggml_fp16_t fp32_to_fp16(float f) {
-    __fp16 tmp = (__fp16)f;
-    ggml_fp16_t r;
-    memcpy(&r, &tmp, sizeof(ggml_fp16_t));
-    return r;
-}
-
-#define Q4_0_TYPES_DEFINED
-#include "q4_0_optimized.c"
+#include "q4_0_types.h"
+#include "q4_0_scalar.c"
+#include "q4_0_neon.c"
+#include "q4_0_x86.c"
+#include "q4_0_tune.c"
+#include "q4_0_gen.c"
+#include "q4_0_dispatch.c"
+#include "q4_0_repack.c"
+#include "mul_mat.c"
+#include "thread_pool.c"
 
 /* ---- Data generation ---- */
 static void generate_q4_0_blocks(block_q4_0 *blocks, int nb) {
@@ -76,8 +78,709 @@ static inline uint64_t get_ns(void) {
     return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
+/*
+ * Core clock in GHz, timed over a chain of dependent register-register
+ * adds (one cycle each on every core this targets; add-immediate chains
+ * can be folded at rename), best of 3; 0 where there is no asm for the
+ * ISA.  Turns ns into cycles without a PMU.
+ */
+static double core_ghz(void) {
+#if defined(__x86_64__) || defined(__i386__)
+#define ADD8 "add %0, %0\n\tadd %0, %0\n\tadd %0, %0\n\tadd %0, %0\n\t" \
+             "add %0, %0\n\tadd %0, %0\n\tadd %0, %0\n\tadd %0, %0\n\t"
+#elif defined(__aarch64__)
+#define ADD8 "add %0, %0, %0\n\tadd %0, %0, %0\n\tadd %0, %0, %0\n\tadd %0, %0, %0\n\t" \
+             "add %0, %0, %0\n\tadd %0, %0, %0\n\tadd %0, %0, %0\n\tadd %0, %0, %0\n\t"
+#endif
+#ifdef ADD8
+    const long chains = 10000000;       /* of 8 adds */
+    double best = 0;
+    for (int rep = 0; rep < 3; rep++) {
+        unsigned long v = 0;
+        uint64_t t0 = get_ns();
+        for (long i = 0; i < chains; i++)
+            __asm__ volatile(ADD8 : "+r"(v));
+        double ghz = 8.0 * chains / (double)(get_ns() - t0);
+        if (ghz > best) best = ghz;
+    }
+    return best;
+#undef ADD8
+#else
+    return 0;
+#endif
+}
+
+/* ---- Matmul sweep ---- */
+
+/* Largest |a - b| over the largest |a|: summation order moves the low bits. */
+static float max_rel_diff(const float *a, const float *b, size_t n) {
+    float diff = 0, mag = 1e-10f;
+    for (size_t i = 0; i < n; i++) {
+        if (fabsf(a[i] - b[i]) > diff) diff = fabsf(a[i] - b[i]);
+        if (fabsf(a[i]) > mag) mag = fabsf(a[i]);
+    }
+    return diff / mag;
+}
+
+static int run_matmul(int argc, char **argv) {
+    /* n (row length) × rows, as in LLaMA-7B/13B attention and FFN layers */
+    static const int shapes[][2] = {
+        {4096, 4096}, {4096, 11008}, {11008, 4096},
+        {5120, 5120}, {5120, 13824}, {13824, 5120},
+    };
+    int cols[16] = {1, 16, 128}, ncols = 3;
+    if (argc > 0) {
+        ncols = 0;
+        for (int i = 0; i < argc && ncols < 16; i++)
+            if (atoi(argv[i]) > 0) cols[ncols++] = atoi(argv[i]);
+    }
+    int max_cols = 0;
+    for (int i = 0; i < ncols; i++) if (cols[i] > max_cols) max_cols = cols[i];
+
+    const size_t l2 = mm_l2_bytes();
+    const vec_dot_fn dot = q4_0_dispatch()->fn;
+    printf("Benchmark: q4_0 x q8_0 matmul, naive vs L2-tiled (L2 %zu KB, %s kernel)\n\n",
+           l2 >> 10, q4_0_dispatch()->name);
+    printf("%13s %5s %16s %10s %10s %8s %9s %9s  %s\n", "n x rows", "cols", "tile r/c/k",
+           "naive(ms)", "tiled(ms)", "speedup", "GMAC/s", "W GB/s", "check");
+
+    int ok = 1;
+    for (size_t si = 0; si < sizeof(shapes) / sizeof(shapes[0]); si++) {
+        const int n = shapes[si][0], nr = shapes[si][1], nb = n / QK4_0;
+        block_q4_0 *w = aligned_alloc(64, (size_t)nr * nb * sizeof(block_q4_0));
+        block_q8_0 *a = aligned_alloc(64, (size_t)max_cols * nb * sizeof(block_q8_0));
+        float *ref = malloc((size_t)nr * max_cols * sizeof(float));
+        float *dst = malloc((size_t)nr * max_cols * sizeof(float));
+        generate_q4_0_blocks(w, nr * nb);
+        generate_q8_0_blocks(a, max_cols * nb);
+
+        for (int ci = 0; ci < ncols; ci++) {
+            const int nc = cols[ci];
+            const double macs = (double)n * nr * nc;
+            const int reps = macs < 2e9 ? (int)(2e9 / macs) : 1;
+            mm_tile t = mm_tile_for_l2(n, nr, nc, l2);
+
+            /* Untimed first pass of each: faults the output in, checks tiled against naive. */
+            mul_mat_q4_0_q8_0_naive(n, nr, nc, ref, w, a, dot);
+            mul_mat_q4_0_q8_0(n, nr, nc, dst, w, a, dot, t);
+            float err = max_rel_diff(ref, dst, (size_t)nr * nc);
+            ok &= err < 1e-5f;
+
+            uint64_t t0 = get_ns();
+            for (int i = 0; i < reps; i++)
+                mul_mat_q4_0_q8_0_naive(n, nr, nc, ref, w, a, dot);
+            double ms_naive = (double)(get_ns() - t0) / reps / 1e6;
+            t0 = get_ns();
+            for (int i = 0; i < reps; i++)
+                mul_mat_q4_0_q8_0(n, nr, nc, dst, w, a, dot, t);
+            double ms_tiled = (double)(get_ns() - t0) / reps / 1e6;
+
+            char shape[24], tile[24];
+            snprintf(shape, sizeof(shape), "%dx%d", n, nr);
+            snprintf(tile, sizeof(tile), "%d/%d/%d", t.rows, t.cols, t.k);
+            printf("%13s %5d %16s %10.2f %10.2f %7.2fx %9.2f %9.2f  %s\n", shape, nc, tile,
+                   ms_naive, ms_tiled, ms_naive / ms_tiled, macs / ms_tiled / 1e6,
+                   (double)nr * nb * sizeof(block_q4_0) / ms_tiled / 1e6,
+                   err < 1e-5f ? "PASS" : "FAIL");
+        }
+        free(w);
+        free(a);
+        free(ref);
+        free(dst);
+    }
+    return ok ? 0 : 1;
+}
+
+/* ---- Multi-row kernels ---- */
+
+#define MXN_ROWS 4      /* rows and columns the sweep allocates */
+#define MXN_COLS 2
+
+/*
+ * Σ|block product| of x · y: the scale float rounding works at.  Long
+ * dot products cancel down to a small result, so errors are measured
+ * against this, not against the result.
+ */
+static double dot_scale(int n, const block_q4_0 *x, const block_q8_0 *y) {
+    double sum = 0;
+    for (int ib = 0; ib < n / QK4_0; ib++) {
+        int sumi = 0;
+        for (int j = 0; j < QK4_0/2; j++)
+            sumi += ((x[ib].qs[j] & 0x0F) - 8) * y[ib].qs[j] + ((x[ib].qs[j] >> 4) - 8) * y[ib].qs[j + QK4_0/2];
+        sum += fabs((double)sumi * fp16_to_fp32(x[ib].d) * fp16_to_fp32(y[ib].d));
+    }
+    return sum > 0 ? sum : 1e-30;
+}
+
+#define DOT_TOLERANCE 1e-6      /* of dot_scale(); float sums reach ~1e-7 */
+
+/* Kernel k on rows x[0..rows) and columns y[0..cols) against the scalar reference. */
+static double check_mxn(int k, int n, const block_q4_0 *x, const block_q8_0 *y) {
+    const int nb = n / QK4_0, rows = q4_0_mxn_kernels[k].rows, cols = q4_0_mxn_kernels[k].cols;
+    float got[MXN_ROWS * MXN_COLS], want;
+    double err = 0;
+    q4_0_mxn_kernels[k].fn(n, got, rows, x, nb * sizeof(block_q4_0), y, nb * sizeof(block_q8_0));
+    for (int c = 0; c < cols; c++)
+        for (int r = 0; r < rows; r++) {
+            vec_dot_q4_0_q8_0_scalar(n, &want, x + r * nb, y + c * nb);
+            double e = fabs(got[c * rows + r] - want) / dot_scale(n, x + r * nb, y + c * nb);
+            if (e > err) err = e;
+        }
+    return err;
+}
+
+/* ns per output of kernel k, over iters calls. */
+static double time_mxn(int k, int n, const block_q4_0 *x, const block_q8_0 *y, int iters) {
+    const int nb = n / QK4_0, rows = q4_0_mxn_kernels[k].rows;
+    float out[MXN_ROWS * MXN_COLS];
+    uint64_t t0 = get_ns();
+    for (int i = 0; i < iters; i++) {
+        q4_0_mxn_kernels[k].fn(n, out, rows, x, nb * sizeof(block_q4_0), y, nb * sizeof(block_q8_0));
+        __asm__ volatile("" :: "r"(out[0]) : "memory");
+    }
+    return (double)(get_ns() - t0) / iters / (rows * q4_0_mxn_kernels[k].cols);
+}
+
+/* ---- Threaded matmul ---- */
+
+#define MT_MAX_THREADS 256
+#define MT_CHUNK       64       /* rows per dynamic work item */
+#define STREAM_DOUBLES (16 << 20)   /* 128 MB per array, far past any LLC */
+
+typedef struct {
+    double busy_ns;
+    long   rows;
+    char   pad[48];             /* one cache line per thread */
+} mt_stat;
+
+typedef struct {
+    int n, nr, nc, dynamic;
+    const block_q4_0 *w;
+    const block_q8_0 *a;
+    float *dst;
+    vec_dot_fn dot;
+    mm_tile tile;
+    int next;                   /* dynamic: next MT_CHUNK of rows */
+    mt_stat stat[MT_MAX_THREADS];
+} mt_job;
+
+static void mt_worker(void *arg, int tid, int nt) {
+    mt_job *job = arg;
+    uint64_t t0 = get_ns();
+    long rows = 0;
+    if (!job->dynamic) {
+        int r0 = (int)((long)job->nr * tid / nt), r1 = (int)((long)job->nr * (tid + 1) / nt);
+        mul_mat_q4_0_q8_0_rows(job->n, job->nr, r0, r1, job->nc, job->dst, job->w, job->a,
+                               job->dot, job->tile);
+        rows = r1 - r0;
+    } else {
+        for (;;) {
+            int r0 = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED) * MT_CHUNK;
+            if (r0 >= job->nr) break;
+            int r1 = r0 + MT_CHUNK < job->nr ? r0 + MT_CHUNK : job->nr;
+            mul_mat_q4_0_q8_0_rows(job->n, job->nr, r0, r1, job->nc, job->dst, job->w, job->a,
+                                   job->dot, job->tile);
+            rows += r1 - r0;
+        }
+    }
+    job->stat[tid].busy_ns = (double)(get_ns() - t0);
+    job->stat[tid].rows = rows;
+}
+
+typedef struct {
+    double *a, *b, *c;
+    size_t  n;
+    int     kernel;             /* 0 init, 1 read (sum), 2 triad */
+    double  sink[MT_MAX_THREADS];
+} stream_job;
+
+static void stream_worker(void *arg, int tid, int nt) {
+    stream_job *job = arg;
+    size_t i0 = job->n * tid / nt, i1 = job->n * (tid + 1) / nt;
+    double sum = 0;
+    switch (job->kernel) {
+    case 0:
+        for (size_t i = i0; i < i1; i++) { job->a[i] = 1.0; job->b[i] = 2.0; job->c[i] = 0.0; }
+        break;
+    case 1: {
+        double s4[4] = {0, 0, 0, 0};    /* independent adds, or latency caps the read */
+        size_t i = i0;
+        for (; i + 4 <= i1; i += 4)
+            for (int k = 0; k < 4; k++) s4[k] += job->a[i + k];
+        for (; i < i1; i++) sum += job->a[i];
+        sum += s4[0] + s4[1] + s4[2] + s4[3];
+        break;
+    }
+    case 2:
+        for (size_t i = i0; i < i1; i++) job->c[i] = job->a[i] + 3.0 * job->b[i];
+        break;
+    }
+    job->sink[tid] = sum;
+}
+
+/* Best of 5 STREAM-style passes on nt threads, in GB/s (triad counts 24 B/element). */
+static double stream_peak(tp_pool *pool, stream_job *job, int nt, int kernel) {
+    double best = 0;
+    job->kernel = kernel;
+    for (int i = 0; i < 5; i++) {
+        uint64_t t0 = get_ns();
+        tp_run(pool, nt, stream_worker, job);
+        double gbs = (double)job->n * (kernel == 2 ? 24 : 8) / (double)(get_ns() - t0);
+        if (gbs > best) best = gbs;
+    }
+    return best;
+}
+
+static int run_threads(int argc, char **argv) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 0 ? atoi(argv[0]) : (int)(online > 0 ? online : 1);
+    const int nc = argc > 1 ? atoi(argv[1]) : 1;
+    const int n  = argc > 2 ? atoi(argv[2]) / QK4_0 * QK4_0 : 5120;
+    const int nr = argc > 3 ? atoi(argv[3]) : 13824;
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MT_MAX_THREADS) max_threads = MT_MAX_THREADS;
+    if (nc < 1 || n < QK4_0 || nr < 1) {
+        fprintf(stderr, "usage: benchmark threads [max_threads] [cols] [n] [rows]\n");
+        return 1;
+    }
+
+    const int nb = n / QK4_0;
+    const size_t l2 = mm_l2_bytes();
+    const double w_bytes = (double)nr * nb * sizeof(block_q4_0);
+    const double macs = (double)n * nr * nc;
+    const int reps = macs < 1e9 ? (int)(1e9 / macs) + 1 : 2;
+
+    int counts[32], ncounts = 0;
+    for (int t = 1; t < max_threads && ncounts < 31; t *= 2) counts[ncounts++] = t;
+    counts[ncounts++] = max_threads;
+
+    printf("Benchmark: threaded q4_0 matmul, %dx%d weights (%.1f MB, %.1fx L2), %d col%s, "
+           "1..%d threads\n\n", n, nr, w_bytes / 1e6, w_bytes / l2, nc, nc == 1 ? "" : "s",
+           max_threads);
+
+    tp_pool pool;
+    tp_init(&pool, max_threads);
+
+    /* STREAM-style peak on the same threads, arrays first-touched by them. */
+    stream_job *sj = calloc(1, sizeof(*sj));
+    sj->n = STREAM_DOUBLES;
+    sj->a = malloc(sj->n * sizeof(double));
+    sj->b = malloc(sj->n * sizeof(double));
+    sj->c = malloc(sj->n * sizeof(double));
+    sj->kernel = 0;
+    tp_run(&pool, max_threads, stream_worker, sj);
+    double peak_read[32], peak_triad[32];
+    printf("STREAM-style peak (best of 5, %d MB arrays):\n", (int)(sj->n * sizeof(double) >> 20));
+    printf("%8s  %10s  %10s\n", "threads", "read GB/s", "triad GB/s");
+    for (int i = 0; i < ncounts; i++) {
+        peak_read[i] = stream_peak(&pool, sj, counts[i], 1);
+        peak_triad[i] = stream_peak(&pool, sj, counts[i], 2);
+        printf("%8d  %10.2f  %10.2f\n", counts[i], peak_read[i], peak_triad[i]);
+    }
+    free(sj->a);
+    free(sj->b);
+    free(sj->c);
+    free(sj);
+
+    block_q4_0 *w = aligned_alloc(64, (size_t)nr * nb * sizeof(block_q4_0));
+    block_q8_0 *a = aligned_alloc(64, (size_t)nc * nb * sizeof(block_q8_0));
+    float *ref = malloc((size_t)nr * nc * sizeof(float));
+    generate_q4_0_blocks(w, nr * nb);
+    generate_q8_0_blocks(a, nc * nb);
+    const q4_0_kernel *kern = q4_0_dispatch();
+    mul_mat_q4_0_q8_0(n, nr, nc, ref, w, a, kern->fn, mm_tile_for_l2(n, nr, nc, l2));
+
+    /* Tiles assume the analysis' model of one L2 shared by every thread. */
+    mt_job *job = calloc(1, sizeof(*job));
+    job->n = n;
+    job->nr = nr;
+    job->nc = nc;
+    job->w = w;
+    job->a = a;
+    job->dot = kern->fn;
+    job->dst = malloc((size_t)nr * nc * sizeof(float));
+
+    printf("\nMatmul scaling (%s kernel, %d reps; GB/s of weights read, per-thread over its "
+           "busy time):\n", kern->name, reps);
+    printf("%8s  %7s  %9s  %9s  %7s  %8s  %23s  %s\n", "threads", "sched", "ms", "agg GB/s",
+           "% read", "speedup", "per-thread min/avg/max", "check");
+    int ok = 1;
+    double base_ms[2] = {0, 0};
+    for (int i = 0; i < ncounts; i++) {
+        const int nt = counts[i];
+        for (int dyn = 0; dyn < 2; dyn++) {
+            job->dynamic = dyn;
+            job->tile = mm_tile_for_l2(n, dyn ? MT_CHUNK : (nr + nt - 1) / nt, nc, l2 / nt);
+            job->next = 0;
+            tp_run(&pool, nt, mt_worker, job);          /* warm-up */
+            uint64_t t0 = get_ns();
+            for (int r = 0; r < reps; r++) {
+                job->next = 0;
+                tp_run(&pool, nt, mt_worker, job);
+            }
+            double ms = (double)(get_ns() - t0) / reps / 1e6;
+            if (nt == 1) base_ms[dyn] = ms;
+
+            double gmin = 1e30, gmax = 0, gsum = 0;
+            for (int t = 0; t < nt; t++) {
+                double g = job->stat[t].busy_ns > 0
+                    ? job->stat[t].rows * nb * sizeof(block_q4_0) / job->stat[t].busy_ns : 0;
+                if (g < gmin) gmin = g;
+                if (g > gmax) gmax = g;
+                gsum += g;
+            }
+            float err = max_rel_diff(ref, job->dst, (size_t)nr * nc);
+            ok &= err < 1e-5f;
+            char per[40];
+            snprintf(per, sizeof(per), "%.2f/%.2f/%.2f", gmin, gsum / nt, gmax);
+            double agg = w_bytes / ms / 1e6;
+            printf("%8d  %7s  %9.2f  %9.2f  %6.1f%%  %7.2fx  %23s  %s\n", nt,
+                   dyn ? "dynamic" : "static", ms, agg, 100 * agg / peak_read[i],
+                   base_ms[dyn] / ms, per, err < 1e-5f ? "PASS" : "FAIL");
+        }
+    }
+
+    /* Per-thread detail at the widest point, static split. */
+    job->dynamic = 0;
+    job->tile = mm_tile_for_l2(n, (nr + max_threads - 1) / max_threads, nc, l2 / max_threads);
+    tp_run(&pool, max_threads, mt_worker, job);
+    printf("\nPer thread, %d threads, static:\n", max_threads);
+    printf("%8s  %7s  %9s  %9s\n", "thread", "rows", "busy ms", "GB/s");
+    for (int t = 0; t < max_threads; t++)
+        printf("%8d  %7ld  %9.2f  %9.2f\n", t, job->stat[t].rows, job->stat[t].busy_ns / 1e6,
+               job->stat[t].rows * nb * sizeof(block_q4_0) / job->stat[t].busy_ns);
+
+    tp_free(&pool);
+    free(job->dst);
+    free(job);
+    free(ref);
+    free(w);
+    free(a);
+    return ok ? 0 : 1;
+}
+
+/* ---- Single-output kernels ---- */
+
+#define MAX_KERNELS 16
+
+/* The kernels this CPU supports, in table order. */
+static int supported_kernels(const q4_0_kernel **out) {
+    int n = 0;
+    for (const q4_0_kernel *k = q4_0_kernels; k->name && n < MAX_KERNELS; k++)
+        if (k->supported()) out[n++] = k;
+    return n;
+}
+
+static double time_dot(vec_dot_fn fn, int n, const block_q4_0 *x, const block_q8_0 *y, int iters) {
+    float r;
+    uint64_t t0 = get_ns();
+    for (int i = 0; i < iters; i++) {
+        fn(n, &r, x, y);
+        /* Prevent dead code elimination */
+        __asm__ volatile("" :: "r"(r));
+    }
+    return (double)(get_ns() - t0) / iters;
+}
+
+/* Error of fn against the scalar reference, of dot_scale(); *got gets fn's result. */
+static double check_dot(vec_dot_fn fn, int n, const block_q4_0 *x, const block_q8_0 *y, float *got) {
+    float ref;
+    vec_dot_q4_0_q8_0_scalar(n, &ref, x, y);
+    fn(n, got, x, y);
+    return fabs(*got - ref) / dot_scale(n, x, y);
+}
+
+/* Row lengths of the size sweeps */
+static const int sweep_sizes[] = {128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072, 0};
+
+/* Iterations per size: the same elements per size above 4096, so the scalar kernel stays bearable */
+static int sweep_iters(int n) {
+    return n <= 4096 ? 50000 : (int)(50000LL * 4096 / n);
+}
+
+/* ---- Repacked q4_0x4 vs native ---- */
+
+/* ns per output of x4 kernel fn on group gx, over iters calls. */
+static double time_x4(vec_dot_x4_fn fn, int n, const void *gx, const block_q8_0 *y, int iters) {
+    float out[Q4_0X4_ROWS];
+    uint64_t t0 = get_ns();
+    for (int i = 0; i < iters; i++) {
+        fn(n, out, gx, y);
+        __asm__ volatile("" :: "r"(out[0]) : "memory");
+    }
+    return (double)(get_ns() - t0) / iters / Q4_0X4_ROWS;
+}
+
+/* Error of x4 kernel fn on group gx against the scalar reference on the source rows x. */
+static double check_x4(vec_dot_x4_fn fn, int n, const void *gx, const block_q4_0 *x, const block_q8_0 *y) {
+    const int nb = n / QK4_0;
+    float got[Q4_0X4_ROWS], want;
+    double err = 0;
+    fn(n, got, gx, y);
+    for (int r = 0; r < Q4_0X4_ROWS; r++) {
+        vec_dot_q4_0_q8_0_scalar(n, &want, x + r * nb, y);
+        double e = fabs(got[r] - want) / dot_scale(n, x + r * nb, y);
+        if (e > err) err = e;
+    }
+    return err;
+}
+
+static int run_repack(void) {
+    const q4_0_kernel *native = q4_0_dispatch();
+    const q4_0_x4_kernel *kx[MAX_KERNELS];
+    int nx = 0;
+    for (const q4_0_x4_kernel *k = q4_0_x4_kernels; k->name; k++)
+        if (k->supported()) kx[nx++] = k;
+    int m4x1 = -1;      /* the native-layout four-row kernel, if this build has one */
+    for (int k = 0; q4_0_mxn_kernels[k].name; k++)
+        if (q4_0_mxn_kernels[k].rows == Q4_0X4_ROWS && q4_0_mxn_kernels[k].cols == 1) m4x1 = k;
+
+    printf("Benchmark: q4_0x4 repacked weights vs native block_q4_0 (ns per output, 4 rows x 1 column)\n");
+    printf("Native: %s (one row per call)%s; speedup: best x4 vs best native\n\n", native->name,
+           m4x1 >= 0 ? " and 4x1" : "");
+    printf("%8s  %14s", "n", native->name);
+    if (m4x1 >= 0) printf("  %8s", "4x1");
+    for (int k = 0; k < nx; k++) printf("  %15s", kx[k]->name);
+    printf("  %8s  check\n", "speedup");
+
+    int ok = 1;
+    for (int si = 0; sweep_sizes[si] != 0; si++) {
+        const int sn = sweep_sizes[si], snb = sn / QK4_0, sit = sweep_iters(sn);
+        block_q4_0 *sx = aligned_alloc(64, Q4_0X4_ROWS * snb * sizeof(block_q4_0));
+        block_q8_0 *sy = aligned_alloc(64, snb * sizeof(block_q8_0));
+        generate_q4_0_blocks(sx, Q4_0X4_ROWS * snb);
+        generate_q8_0_blocks(sy, snb);
+        q4_0x4_matrix plain, shifted;
+        if (q4_0x4_repack(&plain, sx, Q4_0X4_ROWS, sn, 0) || q4_0x4_repack(&shifted, sx, Q4_0X4_ROWS, sn, 1)) {
+            fprintf(stderr, "repack: out of memory\n");
+            return 1;
+        }
+
+        int pass = 1;
+        float got;
+        double best_native, best_x4 = 1e30;
+        for (int r = 0; r < Q4_0X4_ROWS; r++)
+            pass &= check_dot(native->fn, sn, sx + r * snb, sy, &got) < DOT_TOLERANCE;
+        time_dot(native->fn, sn, sx, sy, sit / 50);                   /* warmup */
+        best_native = time_dot(native->fn, sn, sx, sy, sit);
+        printf("%8d  %14.1f", sn, best_native);
+        if (m4x1 >= 0) {
+            pass &= check_mxn(m4x1, sn, sx, sy) < DOT_TOLERANCE;
+            double t = time_mxn(m4x1, sn, sx, sy, sit / 4);
+            if (t < best_native) best_native = t;
+            printf("  %8.1f", t);
+        }
+        for (int k = 0; k < nx; k++) {
+            const void *g = q4_0x4_group(kx[k]->shifted ? &shifted : &plain, 0);
+            pass &= check_x4(kx[k]->fn, sn, g, sx, sy) < DOT_TOLERANCE;
+            time_x4(kx[k]->fn, sn, g, sy, sit / 200);                 /* warmup */
+            double t = time_x4(kx[k]->fn, sn, g, sy, sit / 4);
+            if (t < best_x4) best_x4 = t;
+            printf("  %15.1f", t);
+        }
+        printf("  %7.2fx  %s\n", best_native / best_x4, pass ? "PASS" : "FAIL");
+        ok &= pass;
+
+        q4_0x4_free(&plain);
+        q4_0x4_free(&shifted);
+        free(sx);
+        free(sy);
+    }
+    return ok ? 0 : 1;
+}
+
+/* ---- Generated kernels: tuning driver ---- */
+
+#define GEN_MAX    64
+#define GEN_ROUNDS 20       /* 36 candidates within a few % need more than Q4_0_PF_ROUNDS */
+#define GEN_MARGIN 0.03     /* a generated kernel must be this much faster than tuned */
+
+/* C string literal contents for s: quotes and backslashes escaped. */
+static void write_c_string(FILE *f, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+}
+
+/*
+ * q4_0_gen_tuned.h: the winner per size class, for the ISA and CPU of
+ * this run; a NULL winner keeps the tuned kernel for its class.
+ */
+static int write_gen_header(const char *path, const q4_0_gen_kernel *const *win, const double *win_ns) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+#if defined(Q4_0_HAVE_NEON)
+    const char *isa = "Q4_0_HAVE_NEON";
+#else
+    const char *isa = "Q4_0_HAVE_X86";
+#endif
+    const char *base = strrchr(path, '/');
+    fprintf(f, "/*\n * %s: written by \"./benchmark gen\"; rerun make tune rather than\n",
+            base ? base + 1 : path);
+    fprintf(f, " * editing it.\n *\n");
+    fprintf(f, " * The fastest q4_0_gen.c kernel per size class of q4_0_tune.c on\n * ");
+    write_c_string(f, q4_0_cpu_model());
+    fprintf(f, ", with its ns per call at the class's n;\n");
+    fprintf(f, " * the tuned kernel where none was %.0f%% faster than it.\n */\n\n", GEN_MARGIN * 100);
+    fprintf(f, "#ifdef %s\n\n", isa);
+    fprintf(f, "#define Q4_0_GEN_TUNED_CPU     \"");
+    write_c_string(f, q4_0_cpu_model());
+    fprintf(f, "\"\n#define Q4_0_GEN_TUNED_CLASSES %d\n\n", Q4_0_PF_CLASSES);
+    fprintf(f, "static const vec_dot_fn q4_0_gen_tuned_fn[Q4_0_GEN_TUNED_CLASSES] = {\n");
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        const q4_0_gen_kernel *k = win[c];
+        char fn[64], bound[32], pf[16];
+        if (c < Q4_0_PF_CLASSES - 1) snprintf(bound, sizeof(bound), "n <= %d", q4_0_pf_class_n[c]);
+        else                         snprintf(bound, sizeof(bound), "n > %d", q4_0_pf_class_n[c - 1]);
+        if (!k) {
+            fprintf(f, "    %-38s /* %s: tuned; %.1f ns */\n", "vec_dot_q4_0_q8_0_tuned,", bound, win_ns[c]);
+            continue;
+        }
+        snprintf(fn, sizeof(fn), "vec_dot_q4_0_q8_0_gen_u%d_a%d_p%d_c%d,", k->unroll, k->accs, k->dist, k->chain);
+        if (k->dist) snprintf(pf, sizeof(pf), "prefetch %d", k->dist);
+        else         snprintf(pf, sizeof(pf), "no prefetch");
+        fprintf(f, "    %-38s /* %s: unroll %d, %d acc, %s, %s; %.1f ns */\n", fn, bound,
+                k->unroll, k->accs, pf, q4_0_gen_chain_name[k->chain], win_ns[c]);
+    }
+    fprintf(f, "};\n\n#endif /* %s */\n", isa);
+    return fclose(f) ? -1 : 0;
+}
+
+/*
+ * Every q4_0_gen.c instance this CPU runs, checked against the scalar
+ * reference and timed at each size class of q4_0_tune.c (fastest of
+ * GEN_ROUNDS interleaved rounds, tuned among them); the winners that
+ * beat tuned by GEN_MARGIN go to the header at path.
+ */
+static int run_gen(const char *path) {
+    const q4_0_gen_kernel *gk[GEN_MAX];
+    int ng = 0;
+    for (const q4_0_gen_kernel *k = q4_0_gen_kernels; k->name && ng < GEN_MAX; k++)
+        if (k->supported()) gk[ng++] = k;
+    if (ng == 0) {
+        printf("No generated kernels for this CPU\n");
+        return 1;
+    }
+
+    static double ns[GEN_MAX][Q4_0_PF_CLASSES];
+    int fail[GEN_MAX] = {0}, best[Q4_0_PF_CLASSES];
+    double tuned[Q4_0_PF_CLASSES];
+
+    q4_0_pf_calibrate();
+    printf("Benchmark: %d generated q4_0 kernels on %s\n", ng, q4_0_cpu_model());
+    printf("Name: u<unroll> a<accumulators> p<prefetch distance> c<chain: 0 = %s, 1 = %s>\n\n",
+           q4_0_gen_chain_name[0], q4_0_gen_chain_name[1]);
+
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        const int n = q4_0_pf_class_n[c], nb = n / QK4_0;
+        const int iters = n < 2000000 / 8 ? 2000000 / n : 8;     /* ~0.2 ms per timing */
+        block_q4_0 *x = aligned_alloc(64, nb * sizeof(block_q4_0));
+        block_q8_0 *y = aligned_alloc(64, nb * sizeof(block_q8_0));
+        generate_q4_0_blocks(x, nb);
+        generate_q8_0_blocks(y, nb);
+
+        for (int k = 0; k < ng; k++) {
+            float got;
+            if (check_dot(gk[k]->fn, n, x, y, &got) >= DOT_TOLERANCE) fail[k] = 1;
+            time_dot(gk[k]->fn, n, x, y, iters / 4 + 1);            /* warmup */
+            ns[k][c] = 1e30;
+        }
+        tuned[c] = 1e30;
+        for (int r = 0; r < GEN_ROUNDS; r++) {
+            for (int k = 0; k < ng; k++) {
+                double t = time_dot(gk[k]->fn, n, x, y, iters);
+                if (t < ns[k][c]) ns[k][c] = t;
+            }
+            double t = time_dot(vec_dot_q4_0_q8_0_tuned, n, x, y, iters);
+            if (t < tuned[c]) tuned[c] = t;
+        }
+
+        best[c] = -1;
+        for (int k = 0; k < ng; k++)
+            if (!fail[k] && (best[c] < 0 || ns[k][c] < ns[best[c]][c])) best[c] = k;
+        free(x);
+        free(y);
+    }
+
+    /* A winner within GEN_MARGIN of tuned is noise, not a reason to switch. */
+    int emit[Q4_0_PF_CLASSES];
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++)
+        emit[c] = best[c] >= 0 && ns[best[c]][c] <= tuned[c] * (1 - GEN_MARGIN);
+
+    printf("%-10s", "ns/call");
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) printf("  %9d", q4_0_pf_class_n[c]);
+    printf("  check\n");
+    for (int k = 0; k < ng; k++) {
+        printf("%-10s", gk[k]->name);
+        for (int c = 0; c < Q4_0_PF_CLASSES; c++)
+            printf("  %8.1f%s", ns[k][c], k == best[c] && emit[c] ? "*" : " ");
+        printf("  %s\n", fail[k] ? "FAIL" : "PASS");
+    }
+    printf("%-10s", "tuned");
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) printf("  %8.1f%s", tuned[c], emit[c] ? " " : "*");
+    printf("\n%-10s", "vs tuned");
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++)
+        printf("  %8.2fx", best[c] >= 0 ? tuned[c] / ns[best[c]][c] : 0.0);
+    printf("\n(* = written to the header; tuned unless a kernel is %.0f%% faster)\n\n", GEN_MARGIN * 100);
+
+    int ok = 1;
+    for (int k = 0; k < ng; k++) ok &= !fail[k];
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) ok &= best[c] >= 0;
+    if (!ok) {
+        printf("Generated kernels FAIL; %s not written\n", path);
+        return 1;
+    }
+
+    const q4_0_gen_kernel *win[Q4_0_PF_CLASSES];
+    double win_ns[Q4_0_PF_CLASSES];
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        win[c] = emit[c] ? gk[best[c]] : NULL;
+        win_ns[c] = emit[c] ? ns[best[c]][c] : tuned[c];
+    }
+    if (write_gen_header(path, win, win_ns)) {
+        perror(path);
+        return 1;
+    }
+    printf("Wrote %s; rebuild to dispatch to it as gen-tuned\n", path);
+    return 0;
+}
+
+/* The prefetch dispatch table q4_0_pf_calibrate() built, with the time of every candidate. */
+static void print_pf_table(void) {
+    if (q4_0_pf.dist[0] < 0) return;
+    printf("Prefetch calibration (ns per call at the class's n, the last covering all larger n; * = chosen,\n"
+           "a distance only when %.0f%% faster than none):\n", Q4_0_PF_MARGIN * 100);
+    printf("  %8s", "n <=");
+    for (int k = 0; q4_0_pf_kernels[k].fn; k++) {
+        char name[16];
+        snprintf(name, sizeof(name), q4_0_pf_kernels[k].dist ? "pf %d" : "none", q4_0_pf_kernels[k].dist);
+        printf("  %10s", name);
+    }
+    printf("\n");
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        char bound[16];
+        if (c < Q4_0_PF_CLASSES - 1) snprintf(bound, sizeof(bound), "%d", q4_0_pf_class_n[c]);
+        else                         snprintf(bound, sizeof(bound), "(%d)", q4_0_pf_class_n[c]);
+        printf("  %8s", bound);
+        for (int k = 0; q4_0_pf_kernels[k].fn; k++)
+            printf("  %9.1f%s", q4_0_pf.ns[c][k], q4_0_pf_kernels[k].fn == q4_0_pf.fn[c] ? "*" : " ");
+        printf("\n");
+    }
+    printf("\n");
+}
+
 /* ---- Main ---- */
 int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "matmul") == 0)
+        return run_matmul(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "threads") == 0)
+        return run_threads(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "repack") == 0)
+        return run_repack();
+    if (argc > 1 && strcmp(argv[1], "gen") == 0)
+        return run_gen(argc > 2 ? argv[2] : "q4_0_gen_tuned.h");
+
     int n = 4096;  /* elements (must be multiple of QK4_0=32) */
     if (argc > 1) n = atoi(argv[1]);
     if (n < 32) n = 32;
@@ -87,109 +790,98 @@ int main(int argc, char **argv) {
     const int warmup = 1000;
     const int iterations = 100000;
 
-    printf("Benchmark: q4_0 dot product (n=%d, %d blocks)\n", n, nb);
-    printf("Iterations: %d (warmup: %d)\n\n", iterations, warmup);
-
-    /* Allocate aligned */
-    block_q4_0 *x = aligned_alloc(64, nb * sizeof(block_q4_0));
-    block_q8_0 *y = aligned_alloc(64, nb * sizeof(block_q8_0));
-
-    generate_q4_0_blocks(x, nb);
-    generate_q8_0_blocks(y, nb);
+    const q4_0_kernel *kern[MAX_KERNELS];
+    const int nk = supported_kernels(kern);
+    const int base = nk > 1 ? 1 : 0;    /* first SIMD kernel, else scalar */
 
-    float result_orig = 0, result_opt = 0;
+    printf("Benchmark: q4_0 dot product (n=%d, %d blocks)\n", n, nb);
+    printf("Kernels:");
+    for (int k = 0; k < nk; k++) printf(" %s", kern[k]->name);
+    printf("  (dispatch: %s, baseline: %s)\n", q4_0_dispatch()->name, kern[base]->name);
+    printf("Iterations: %d (warmup: %d)\n", iterations, warmup);
+    const double ghz = core_ghz();
+    if (ghz > 0) printf("Core clock: %.2f GHz (dependent-add chain; cycles = ns x clock)\n", ghz);
+    printf("\n");
+    q4_0_pf_calibrate();
+    print_pf_table();
+
+    /* Allocate aligned; rows/columns past the first feed the multi-row kernels */
+    block_q4_0 *x = aligned_alloc(64, MXN_ROWS * nb * sizeof(block_q4_0));
+    block_q8_0 *y = aligned_alloc(64, MXN_COLS * nb * sizeof(block_q8_0));
+
+    generate_q4_0_blocks(x, MXN_ROWS * nb);
+    generate_q8_0_blocks(y, MXN_COLS * nb);
 
     /* ---- Warmup ---- */
-    for (int i = 0; i < warmup; i++) {
-        vec_dot_q4_0_q8_0_original(n, &result_orig, x, y);
-        vec_dot_q4_0_q8_0_optimized(n, &result_opt, x, y);
-    }
+    for (int k = 0; k < nk; k++) time_dot(kern[k]->fn, n, x, y, warmup);
 
     /* ---- Verify correctness ---- */
-    vec_dot_q4_0_q8_0_original(n, &result_orig, x, y);
-    vec_dot_q4_0_q8_0_optimized(n, &result_opt, x, y);
-
-    float diff = fabsf(result_orig - result_opt);
-    float rel_err = diff / (fabsf(result_orig) + 1e-10f);
-    printf("Correctness check:\n");
-    printf("  Original:  %.6f\n", result_orig);
-    printf("  Optimized: %.6f\n", result_opt);
-    printf("  Abs diff:  %.2e\n", diff);
-    printf("  Rel error: %.2e\n", rel_err);
-    printf("  Status:    %s\n\n", rel_err < 1e-5 ? "PASS ✓" : "FAIL ✗");
-
-    /* ---- Benchmark original ---- */
-    uint64_t t0 = get_ns();
-    for (int i = 0; i < iterations; i++) {
-        vec_dot_q4_0_q8_0_original(n, &result_orig, x, y);
-        /* Prevent dead code elimination */
-        __asm__ volatile("" :: "r"(result_orig));
+    int ok = 1;
+    printf("Correctness check (vs scalar reference; error of Σ|block product|):\n");
+    for (int k = 0; k < nk; k++) {
+        float got;
+        double err = check_dot(kern[k]->fn, n, x, y, &got);
+        ok &= err < DOT_TOLERANCE;
+        printf("  %-15s %14.6f  error %.2e  %s\n", kern[k]->name, got, err,
+               err < DOT_TOLERANCE ? "PASS ✓" : "FAIL ✗");
     }
-    uint64_t t1 = get_ns();
-    double ns_orig = (double)(t1 - t0) / iterations;
-
-    /* ---- Benchmark optimized ---- */
-    t0 = get_ns();
-    for (int i = 0; i < iterations; i++) {
-        vec_dot_q4_0_q8_0_optimized(n, &result_opt, x, y);
-        __asm__ volatile("" :: "r"(result_opt));
+    for (int k = 0; q4_0_mxn_kernels[k].name; k++) {
+        double err = check_mxn(k, n, x, y);
+        ok &= err < DOT_TOLERANCE;
+        printf("  %-15s %14s  error %.2e  %s\n", q4_0_mxn_kernels[k].name, "(multi-row)", err,
+               err < DOT_TOLERANCE ? "PASS ✓" : "FAIL ✗");
     }
-    t1 = get_ns();
-    double ns_opt = (double)(t1 - t0) / iterations;
+    printf("\n");
 
-    /* ---- Results ---- */
-    double speedup = ns_orig / ns_opt;
-    printf("Results (avg per call):\n");
-    printf("  Original:  %8.1f ns\n", ns_orig);
-    printf("  Optimized: %8.1f ns\n", ns_opt);
-    printf("  Speedup:   %.2fx\n", speedup);
-    printf("  Improvement: %.1f%%\n\n", (speedup - 1.0) * 100.0);
+    /* ---- Benchmark each kernel ---- */
+    double ns[MAX_KERNELS];
+    for (int k = 0; k < nk; k++) ns[k] = time_dot(kern[k]->fn, n, x, y, iterations);
 
+    /* ---- Results ---- */
     /* Throughput in GB/s (data read per call) */
     double bytes_per_call = (double)nb * (sizeof(block_q4_0) + sizeof(block_q8_0));
-    printf("Throughput:\n");
-    printf("  Original:  %.2f GB/s\n", bytes_per_call / ns_orig);
-    printf("  Optimized: %.2f GB/s\n", bytes_per_call / ns_opt);
+    printf("Results (avg per call):\n");
+    printf("  %-15s %10s %9s %10s %9s\n", "kernel", "ns", "speedup", "GB/s", "cyc/blk");
+    for (int k = 0; k < nk; k++)
+        printf("  %-15s %10.1f %8.2fx %10.2f %9.2f\n", kern[k]->name, ns[k], ns[base] / ns[k],
+               bytes_per_call / ns[k], ns[k] * ghz / nb);
+    for (int k = 0; q4_0_mxn_kernels[k].name; k++) {
+        double t = time_mxn(k, n, x, y, iterations / 4);
+        printf("  %-15s %10.1f %8.2fx %10s %9.2f  (per output)\n", q4_0_mxn_kernels[k].name, t,
+               ns[base] / t, "", t * ghz / nb);
+    }
 
     /* ---- Sweep different sizes ---- */
-    printf("\n--- Size sweep ---\n");
-    printf("%8s  %10s  %10s  %8s\n", "n", "orig(ns)", "opt(ns)", "speedup");
-
-    int sizes[] = {128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, 131072, 0};
-    for (int si = 0; sizes[si] != 0; si++) {
-        int sn = sizes[si];
+    printf("\n--- Size sweep (ns per call; multi-row per output) ---\n");
+    printf("%8s", "n");
+    for (int k = 0; k < nk; k++) printf("  %14s", kern[k]->name);
+    for (int k = 0; q4_0_mxn_kernels[k].name; k++) printf("  %8s", q4_0_mxn_kernels[k].name);
+    printf("  check\n");
+
+    for (int si = 0; sweep_sizes[si] != 0; si++) {
+        int sn = sweep_sizes[si];
         int snb = sn / QK4_0;
 
-        block_q4_0 *sx = aligned_alloc(64, snb * sizeof(block_q4_0));
-        block_q8_0 *sy = aligned_alloc(64, snb * sizeof(block_q8_0));
-        generate_q4_0_blocks(sx, snb);
-        generate_q8_0_blocks(sy, snb);
-
-        /* Warmup */
-        float sr;
-        for (int i = 0; i < 1000; i++) {
-            vec_dot_q4_0_q8_0_original(sn, &sr, sx, sy);
-            vec_dot_q4_0_q8_0_optimized(sn, &sr, sx, sy);
+        block_q4_0 *sx = aligned_alloc(64, MXN_ROWS * snb * sizeof(block_q4_0));
+        block_q8_0 *sy = aligned_alloc(64, MXN_COLS * snb * sizeof(block_q8_0));
+        generate_q4_0_blocks(sx, MXN_ROWS * snb);
+        generate_q8_0_blocks(sy, MXN_COLS * snb);
+
+        int sit = sweep_iters(sn);
+        int pass = 1;
+        printf("%8d", sn);
+        for (int k = 0; k < nk; k++) {
+            float got;
+            pass &= check_dot(kern[k]->fn, sn, sx, sy, &got) < DOT_TOLERANCE;
+            time_dot(kern[k]->fn, sn, sx, sy, sit / 50);                /* warmup */
+            printf("  %14.1f", time_dot(kern[k]->fn, sn, sx, sy, sit));
         }
-
-        int sit = 50000;
-        t0 = get_ns();
-        for (int i = 0; i < sit; i++) {
-            vec_dot_q4_0_q8_0_original(sn, &sr, sx, sy);
-            __asm__ volatile("" :: "r"(sr));
+        for (int k = 0; q4_0_mxn_kernels[k].name; k++) {
+            pass &= check_mxn(k, sn, sx, sy) < DOT_TOLERANCE;
+            printf("  %8.1f", time_mxn(k, sn, sx, sy, sit / 4));
         }
-        t1 = get_ns();
-        double sno = (double)(t1 - t0) / sit;
-
-        t0 = get_ns();
-        for (int i = 0; i < sit; i++) {
-            vec_dot_q4_0_q8_0_optimized(sn, &sr, sx, sy);
-            __asm__ volatile("" :: "r"(sr));
-        }
-        t1 = get_ns();
-        double snopt = (double)(t1 - t0) / sit;
-
-        printf("%8d  %10.1f  %10.1f  %7.2fx\n", sn, sno, snopt, sno/snopt);
+        printf("  %s\n", pass ? "PASS" : "FAIL");
+        ok &= pass;
 
         free(sx);
         free(sy);
@@ -197,5 +889,5 @@ int main(int argc, char **argv) {
 
     free(x);
     free(y);
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,130 @@
+/*
+ * L2-tiled q4_0 × q8_0 matrix multiply around the vec_dot kernels
+ *
+ * analysis.md traces the production stalls to weight streaming at
+ * matmul scale, not to the dot product itself.  This driver computes
+ * a whole layer, dst = W · A, by calling a vec_dot kernel once per
+ * (row, column, K slice):
+ *
+ *   W    nr rows of n elements, q4_0   (the weights, row-major)
+ *   A    nc columns of n elements, q8_0 (the quantized activations)
+ *   dst  nc × nr floats, dst[c * nr + r] (one output vector per column)
+ *
+ * Tiling, outermost first:
+ *
+ *   column block   `cols` activation columns, reused by every row;
+ *   K slice        `k` elements of each row and column, so a column
+ *                  block of a long row still fits;
+ *   row panel      `rows` weight rows of one K slice, kept in L2 while
+ *                  every column of the block passes over it;
+ *   column, row    one kernel call: the column slice stays in L1 while
+ *                  the panel's rows stream past it from L2.
+ *
+ * mm_tile_for_l2() sizes the tiles so that the activation block takes
+ * about a quarter of L2 and the weight panel about half, leaving room
+ * for the output and whatever else is running.  With one column
+ * (token generation) there is nothing to reuse, and K slicing would
+ * only add the zeroing and accumulation of dst, so nc == 1 takes the
+ * naive loop.  The tiles pay off once the nc activation columns
+ * outgrow L2: the naive loop then streams all of them again for every
+ * weight row.
+ *
+ * #included by benchmark.c after the kernel files.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "q4_0_types.h"
+
+typedef struct {
+    int rows;   /* weight rows per panel */
+    int cols;   /* activation columns per block */
+    int k;      /* elements per K slice, a multiple of QK4_0 */
+} mm_tile;
+
+#define MM_L2_DEFAULT (1 << 20)   /* Neoverse-N1: 1 MB L2 per core */
+
+/* L2 size from the C library, or MM_L2_DEFAULT where it does not know. */
+static size_t mm_l2_bytes(void) {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0) return (size_t)l2;
+#endif
+    return MM_L2_DEFAULT;
+}
+
+/* Tiles for an nr × n by n × nc product in an L2 of l2 bytes. */
+static mm_tile mm_tile_for_l2(int n, int nr, int nc, size_t l2) {
+    const size_t a_budget = l2 / 4, w_budget = l2 / 2;
+    const int want_cols = nc < 8 ? nc : 8;    /* enough columns to reuse each row */
+    mm_tile t;
+
+    /* Whole rows if want_cols columns of them fit, else the longest slice that does. */
+    size_t blocks = a_budget / ((size_t)want_cols * sizeof(block_q8_0));
+    if (blocks < 1) blocks = 1;
+    t.k = (size_t)(n / QK4_0) <= blocks ? n : (int)blocks * QK4_0;
+
+    size_t a_col = (size_t)(t.k / QK8_0) * sizeof(block_q8_0);
+    size_t w_row = (size_t)(t.k / QK4_0) * sizeof(block_q4_0);
+    size_t cols = a_budget / a_col, rows = w_budget / w_row;
+    t.cols = cols < 1 ? 1 : cols > (size_t)nc ? nc : (int)cols;
+    t.rows = rows < 1 ? 1 : rows > (size_t)nr ? nr : (int)rows;
+    return t;
+}
+
+/* The untiled loop: every row against every column, whole rows at a time. */
+void mul_mat_q4_0_q8_0_naive(int n, int nr, int nc, float * __restrict__ dst,
+        const block_q4_0 * __restrict__ w, const block_q8_0 * __restrict__ a,
+        vec_dot_fn dot) {
+    const int nb = n / QK4_0;
+    for (int r = 0; r < nr; r++)
+        for (int c = 0; c < nc; c++)
+            dot(n, &dst[(size_t)c * nr + r], w + (size_t)r * nb, a + (size_t)c * nb);
+}
+
+/*
+ * Rows [r0, r1) of dst = W · A in tiles of t (see above); dst keeps its
+ * full nr stride, so threads can split the rows between them.  n must
+ * be a multiple of QK4_0.
+ */
+void mul_mat_q4_0_q8_0_rows(int n, int nr, int r0, int r1, int nc, float * __restrict__ dst,
+        const block_q4_0 * __restrict__ w, const block_q8_0 * __restrict__ a,
+        vec_dot_fn dot, mm_tile t) {
+    const int nb = n / QK4_0;
+    if (nc == 1) {              /* nothing to reuse: whole rows, no accumulation */
+        for (int r = r0; r < r1; r++)
+            dot(n, &dst[r], w + (size_t)r * nb, a);
+        return;
+    }
+    for (int c = 0; c < nc; c++)
+        memset(dst + (size_t)c * nr + r0, 0, (size_t)(r1 - r0) * sizeof(float));
+
+    for (int c0 = 0; c0 < nc; c0 += t.cols) {
+        const int c1 = c0 + t.cols < nc ? c0 + t.cols : nc;
+        for (int k0 = 0; k0 < n; k0 += t.k) {
+            const int kn = k0 + t.k < n ? t.k : n - k0;
+            const int kb = k0 / QK4_0;
+            for (int p0 = r0; p0 < r1; p0 += t.rows) {
+                const int p1 = p0 + t.rows < r1 ? p0 + t.rows : r1;
+                for (int c = c0; c < c1; c++) {
+                    const block_q8_0 *ac = a + (size_t)c * nb + kb;
+                    float *dc = dst + (size_t)c * nr;
+                    for (int r = p0; r < p1; r++) {
+                        float s;
+                        dot(kn, &s, w + (size_t)r * nb + kb, ac);
+                        dc[r] += s;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* dst = W · A in tiles of t. */
+void mul_mat_q4_0_q8_0(int n, int nr, int nc, float * __restrict__ dst,
+        const block_q4_0 * __restrict__ w, const block_q8_0 * __restrict__ a,
+        vec_dot_fn dot, mm_tile t) {
+    mul_mat_q4_0_q8_0_rows(n, nr, 0, nr, nc, dst, w, a, dot, t);
+}
@@ -0,0 +1,114 @@
+/*
+ * The q4_0 × q8_0 kernel family of this build, and run-time selection
+ *
+ * q4_0_kernels[] lists every dot kernel compiled in, scalar first, then
+ * by ISA in rising capability; supported() says whether this CPU can
+ * run it.  q4_0_dispatch() returns the last supported candidate, or the
+ * one named by the Q4_0_KERNEL environment variable, so the matmul
+ * drivers and any A/B run use the same selection.
+ *
+ * q4_0_x4_kernels[] are the four-row kernels over repacked q4_0x4
+ * weights (q4_0_repack.c); they are not part of the dispatch.
+ *
+ * neon-optimized is listed but never dispatched: analysis.md found its
+ * fixed prefetch distance regresses above 64K elements.  "tuned" (last,
+ * so the default wherever it runs) picks the distance per size class
+ * from a calibration at startup instead; see q4_0_tune.c.  "gen-tuned"
+ * comes after it and is supported only once make tune has written
+ * q4_0_gen_tuned.h on this CPU (q4_0_gen.c).
+ *
+ * #included by benchmark.c after the kernel files.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    vec_dot_fn  fn;
+    int       (*supported)(void);
+    int         dispatch;       /* candidate for q4_0_dispatch() */
+} q4_0_kernel;
+
+typedef struct {
+    const char    *name;
+    vec_dot_mxn_fn fn;
+    int            rows, cols;
+} q4_0_mxn_kernel;
+
+typedef struct {
+    const char   *name;
+    vec_dot_x4_fn fn;
+    int         (*supported)(void);
+    int           shifted;      /* takes q4_0x4_repack(..., shifted = 1) groups */
+} q4_0_x4_kernel;
+
+static int cpu_any(void) { return 1; }
+
+#ifdef Q4_0_HAVE_X86
+static int cpu_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int cpu_avxvnni(void) {
+    return cpu_avx2() && __builtin_cpu_supports("avxvnni");
+}
+
+static int cpu_avx512vnni(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512vnni");
+}
+#endif
+
+static const q4_0_kernel q4_0_kernels[] = {
+    {"scalar",         vec_dot_q4_0_q8_0_scalar,     cpu_any,        1},
+#ifdef Q4_0_HAVE_NEON
+    {"neon-original",  vec_dot_q4_0_q8_0_original,   cpu_any,        1},
+    {"neon-optimized", vec_dot_q4_0_q8_0_optimized,  cpu_any,        0},
+    {"neon-vscale",    vec_dot_q4_0_q8_0_vscale,     cpu_any,        0},
+#endif
+#ifdef Q4_0_HAVE_X86
+    {"avx2",           vec_dot_q4_0_q8_0_avx2,       cpu_avx2,       1},
+    {"avx2-vscale",    vec_dot_q4_0_q8_0_avx2_vscale, cpu_avx2,      0},
+    {"avx-vnni",       vec_dot_q4_0_q8_0_avxvnni,    cpu_avxvnni,    1},
+    {"avx512-vnni",    vec_dot_q4_0_q8_0_avx512vnni, cpu_avx512vnni, 1},
+#endif
+    {"tuned",          vec_dot_q4_0_q8_0_tuned,      q4_0_pf_supported, 1},
+    {"gen-tuned",      vec_dot_q4_0_q8_0_gen_tuned,  q4_0_gen_tuned_supported, 1},
+    {NULL, NULL, NULL, 0},
+};
+
+static const q4_0_mxn_kernel q4_0_mxn_kernels[] = {
+#ifdef Q4_0_HAVE_NEON
+    {"2x1", vec_dot_q4_0_q8_0_2x1, 2, 1},
+    {"4x1", vec_dot_q4_0_q8_0_4x1, 4, 1},
+    {"2x2", vec_dot_q4_0_q8_0_2x2, 2, 2},
+#endif
+    {NULL, NULL, 0, 0},
+};
+
+static const q4_0_x4_kernel q4_0_x4_kernels[] = {
+    {"x4-scalar",       vec_dot_q4_0x4_q8_0_scalar,       cpu_any,        0},
+#ifdef Q4_0_HAVE_NEON
+    {"x4-neon",         vec_dot_q4_0x4_q8_0,              cpu_any,        0},
+    {"x4-neon-shifted", vec_dot_q4_0x4_q8_0_shifted,      cpu_any,        1},
+#endif
+#ifdef Q4_0_HAVE_X86
+    {"x4-avx2",         vec_dot_q4_0x4_q8_0_avx2,         cpu_avx2,       0},
+    {"x4-avx512-vnni",  vec_dot_q4_0x4_q8_0_avx512vnni,   cpu_avx512vnni, 0},
+#endif
+    {NULL, NULL, NULL, 0},
+};
+
+static const q4_0_kernel *q4_0_dispatch(void) {
+    const char *want = getenv("Q4_0_KERNEL");
+    const q4_0_kernel *best = &q4_0_kernels[0];
+    for (const q4_0_kernel *k = q4_0_kernels; k->name; k++) {
+        if (!k->supported()) continue;
+        if (want && strcmp(want, k->name) == 0) return k;
+        if (k->dispatch) best = k;
+    }
+    return best;
+}
@@ -0,0 +1,291 @@
+/*
+ * Generated q4_0 × q8_0 kernels: analysis.md's design space as a grid
+ *
+ * analysis.md tried unroll 2/4, extra accumulators, split SDOT and
+ * prefetch by hand, one variant at a time.  Here one always_inline body
+ * per ISA takes those as constant parameters, and Q4_0_GEN_GRID
+ * instantiates it over
+ *
+ *   unroll  U  blocks per loop iteration: 1, 2, 4;
+ *   accs    A  float accumulators, block j of an iteration adding into
+ *              j % A: 1, 2, 4 (A <= U);
+ *   dist    P  prefetch distance in blocks, 0 = none: 0, 8, 16;
+ *   chain   C  NEON: chained SDOT, sdot(sdot(0, xl, yl), xh, yh) (1),
+ *              or two SDOTs and an ADD (0).  An x86 block fills one
+ *              register, with no halves to chain, so there the axis is
+ *              how the integer dot is formed: vpdpbusd (1, AVX-VNNI) or
+ *              maddubs + madd (0, AVX2).
+ *
+ * That is 36 kernels per ISA, listed in q4_0_gen_kernels[].
+ * "./benchmark gen" (make tune) times each per size class and writes
+ * the winners, with the CPU they were measured on, to q4_0_gen_tuned.h;
+ * a class whose winner is not clearly faster than "tuned" keeps tuned.
+ * When that header is present and names this CPU, "gen-tuned"
+ * dispatches to them by n.
+ *
+ * #included by benchmark.c after q4_0_tune.c, before q4_0_dispatch.c.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    vec_dot_fn  fn;
+    int         unroll, accs, dist, chain;
+    int       (*supported)(void);
+} q4_0_gen_kernel;
+
+#define Q4_0_GEN_UA(X, P, C)  X(1, 1, P, C) X(2, 1, P, C) X(2, 2, P, C) \
+                              X(4, 1, P, C) X(4, 2, P, C) X(4, 4, P, C)
+#define Q4_0_GEN_UAP(X, C)    Q4_0_GEN_UA(X, 0, C) Q4_0_GEN_UA(X, 8, C) Q4_0_GEN_UA(X, 16, C)
+#define Q4_0_GEN_GRID(X)      Q4_0_GEN_UAP(X, 1) Q4_0_GEN_UAP(X, 0)
+
+#define Q4_0_GEN_ENTRY(U, A, P, C) \
+    {"u" #U "a" #A "p" #P "c" #C, vec_dot_q4_0_q8_0_gen_u##U##_a##A##_p##P##_c##C, \
+     U, A, P, C, q4_0_gen_supported_c##C},
+
+#if defined(Q4_0_HAVE_NEON)
+
+static int q4_0_gen_supported_c0(void) { return 1; }
+static int q4_0_gen_supported_c1(void) { return 1; }
+
+static const char *const q4_0_gen_chain_name[2] = {"split SDOT", "chained SDOT"};
+
+static inline __attribute__((always_inline))
+void q4_0_gen_neon(int n, float * __restrict__ s, const void * __restrict__ vx,
+        const void * __restrict__ vy, const int U, const int A, const int P, const int C) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t acc[4] = {vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f)};
+    int ib = 0;
+
+    for (; ib + U - 1 < nb; ib += U) {
+        if (P) {
+            __builtin_prefetch(&x[ib + P], 0, 1);
+            __builtin_prefetch(&y[ib + P], 0, 1);
+            __builtin_prefetch(&y[ib + P + 2], 0, 1);
+        }
+#pragma GCC unroll 4
+        for (int j = 0; j < U; j++) {
+            const uint8x16_t v = vld1q_u8(x[ib + j].qs);
+            const int8x16_t l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v, m4b)), s8b);
+            const int8x16_t h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v, 4)), s8b);
+            const int8x16_t yl = vld1q_s8(y[ib + j].qs);
+            const int8x16_t yh = vld1q_s8(y[ib + j].qs + 16);
+            const int32x4_t p = C ? vdotq_s32(vdotq_s32(vdupq_n_s32(0), l, yl), h, yh)
+                                  : vaddq_s32(vdotq_s32(vdupq_n_s32(0), l, yl),
+                                              vdotq_s32(vdupq_n_s32(0), h, yh));
+            acc[j % A] = vmlaq_n_f32(acc[j % A], vcvtq_f32_s32(p),
+                                     fp16_to_fp32(x[ib + j].d) * fp16_to_fp32(y[ib + j].d));
+        }
+    }
+
+    float32x4_t sum = acc[0];
+    for (int a = 1; a < A; a++) sum = vaddq_f32(sum, acc[a]);
+    float sumf = vaddvq_f32(sum);
+
+    for (; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+
+    *s = sumf;
+}
+
+#define Q4_0_GEN_KERNEL(U, A, P, C) \
+void vec_dot_q4_0_q8_0_gen_u##U##_a##A##_p##P##_c##C(int n, float * __restrict__ s, \
+        const void * __restrict__ vx, const void * __restrict__ vy) { \
+    q4_0_gen_neon(n, s, vx, vy, U, A, P, C); \
+}
+
+Q4_0_GEN_GRID(Q4_0_GEN_KERNEL)
+
+#define Q4_0_HAVE_GEN 1
+
+#elif defined(Q4_0_HAVE_X86)
+
+static int q4_0_gen_supported_c0(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int q4_0_gen_supported_c1(void) {
+    return q4_0_gen_supported_c0() && __builtin_cpu_supports("avxvnni");
+}
+
+static const char *const q4_0_gen_chain_name[2] = {"maddubs", "vpdpbusd"};
+
+static inline Q4_0_AVX2 __m256i q4_0_gen_dot_c0(__m256i qx, __m256i qy) {
+    return _mm256_madd_epi16(_mm256_sub_epi16(_mm256_maddubs_epi16(qx, qy),
+                                              _mm256_maddubs_epi16(_mm256_set1_epi8(8), qy)),
+                             _mm256_set1_epi16(1));
+}
+
+static inline Q4_0_AVXVNNI __m256i q4_0_gen_dot_c1(__m256i qx, __m256i qy) {
+    return _mm256_sub_epi32(_mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), qx, qy),
+                            _mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), _mm256_set1_epi8(8), qy));
+}
+
+/*
+ * One body per dot form: an always_inline function cannot take on a
+ * target its caller lacks, so the AVX2 instances need a body without
+ * AVX-VNNI.  Scales as in avx2-vscale, gathered per iteration; an
+ * unroll of 1 converts them per block instead.
+ */
+#define Q4_0_GEN_X86_BODY(C, TARGET) \
+static inline __attribute__((always_inline)) TARGET \
+void q4_0_gen_x86_c##C(int n, float * __restrict__ s, const void * __restrict__ vx, \
+        const void * __restrict__ vy, const int U, const int A, const int P) { \
+    const int nb = n / QK4_0; \
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx; \
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy; \
+    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()}; \
+    int ib = 0; \
+    \
+    for (; ib + U - 1 < nb; ib += U) { \
+        if (P) { \
+            __builtin_prefetch(&x[ib + P], 0, 3); \
+            __builtin_prefetch(&y[ib + P], 0, 3); \
+            __builtin_prefetch(&y[ib + P + 2], 0, 3); \
+        } \
+        __m256 d = _mm256_setzero_ps(); \
+        if (U > 1) { \
+            const __m128i hx = _mm_setr_epi16(x[ib].d, x[ib + 1].d, U > 2 ? x[ib + 2].d : 0, \
+                                              U > 3 ? x[ib + 3].d : 0, 0, 0, 0, 0); \
+            const __m128i hy = _mm_setr_epi16(y[ib].d, y[ib + 1].d, U > 2 ? y[ib + 2].d : 0, \
+                                              U > 3 ? y[ib + 3].d : 0, 0, 0, 0, 0); \
+            d = _mm256_castps128_ps256(_mm_mul_ps(_mm_cvtph_ps(hx), _mm_cvtph_ps(hy))); \
+        } \
+        _Pragma("GCC unroll 4") \
+        for (int j = 0; j < U; j++) { \
+            const __m256i dot = q4_0_gen_dot_c##C(q4_0_nibbles_avx2(x[ib + j].qs), \
+                                                  _mm256_loadu_si256((const __m256i *)y[ib + j].qs)); \
+            const __m256 dj = U > 1 ? _mm256_permutevar8x32_ps(d, _mm256_set1_epi32(j)) \
+                                    : _mm256_set1_ps(_cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d)); \
+            acc[j % A] = _mm256_fmadd_ps(dj, _mm256_cvtepi32_ps(dot), acc[j % A]); \
+        } \
+    } \
+    \
+    __m256 sum = acc[0]; \
+    for (int a = 1; a < A; a++) sum = _mm256_add_ps(sum, acc[a]); \
+    float sumf = hsum_float_8(sum); \
+    \
+    for (; ib < nb; ib++) { \
+        const __m256i dot = q4_0_gen_dot_c##C(q4_0_nibbles_avx2(x[ib].qs), \
+                                              _mm256_loadu_si256((const __m256i *)y[ib].qs)); \
+        sumf += hsum_float_8(_mm256_cvtepi32_ps(dot)) * _cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d); \
+    } \
+    *s = sumf; \
+}
+
+Q4_0_GEN_X86_BODY(0, Q4_0_AVX2)
+Q4_0_GEN_X86_BODY(1, Q4_0_AVXVNNI)
+
+#define Q4_0_GEN_TARGET_0 Q4_0_AVX2
+#define Q4_0_GEN_TARGET_1 Q4_0_AVXVNNI
+
+#define Q4_0_GEN_KERNEL(U, A, P, C) \
+Q4_0_GEN_TARGET_##C \
+void vec_dot_q4_0_q8_0_gen_u##U##_a##A##_p##P##_c##C(int n, float * __restrict__ s, \
+        const void * __restrict__ vx, const void * __restrict__ vy) { \
+    q4_0_gen_x86_c##C(n, s, vx, vy, U, A, P); \
+}
+
+Q4_0_GEN_GRID(Q4_0_GEN_KERNEL)
+
+#undef Q4_0_GEN_X86_BODY
+#undef Q4_0_GEN_TARGET_0
+#undef Q4_0_GEN_TARGET_1
+
+#define Q4_0_HAVE_GEN 1
+
+#else
+
+static const char *const q4_0_gen_chain_name[2] = {"", ""};
+
+#endif /* Q4_0_HAVE_NEON / Q4_0_HAVE_X86 */
+
+static const q4_0_gen_kernel q4_0_gen_kernels[] = {
+#ifdef Q4_0_HAVE_GEN
+    Q4_0_GEN_GRID(Q4_0_GEN_ENTRY)
+#endif
+    {NULL, NULL, 0, 0, 0, 0, NULL},
+};
+
+#ifdef Q4_0_HAVE_GEN
+#undef Q4_0_GEN_KERNEL
+#endif
+#undef Q4_0_GEN_ENTRY
+
+/*
+ * This CPU, as "./benchmark gen" records it: the model name on x86, the
+ * implementer and part numbers on ARM (/proc/cpuinfo), else "unknown".
+ */
+static const char *q4_0_cpu_model(void) {
+    static char model[128];
+    if (model[0]) return model;
+    strcpy(model, "unknown");
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return model;
+    char line[256], impl[32] = "", part[32] = "";
+    while (fgets(line, sizeof(line), f)) {
+        char *v = strchr(line, ':');
+        if (!v) continue;
+        v += strspn(v + 1, " \t") + 1;
+        v[strcspn(v, "\n")] = 0;
+        if (strncmp(line, "model name", 10) == 0) {
+            snprintf(model, sizeof(model), "%s", v);
+            break;
+        }
+        if (strncmp(line, "CPU implementer", 15) == 0 && !impl[0]) snprintf(impl, sizeof(impl), "%s", v);
+        if (strncmp(line, "CPU part", 8) == 0 && !part[0]) snprintf(part, sizeof(part), "%s", v);
+    }
+    fclose(f);
+    if (strcmp(model, "unknown") == 0 && impl[0] && part[0])
+        snprintf(model, sizeof(model), "implementer %s part %s", impl, part);
+    return model;
+}
+
+/*
+ * q4_0_gen_tuned.h, when "make tune" has written one, defines
+ * Q4_0_GEN_TUNED_CPU and q4_0_gen_tuned_fn[]: the winner per size
+ * class of q4_0_tune.c, or the tuned kernel, for the ISA it was
+ * generated on.
+ */
+#if defined(__has_include)
+#if __has_include("q4_0_gen_tuned.h")
+#include "q4_0_gen_tuned.h"
+#endif
+#endif
+
+#if defined(Q4_0_GEN_TUNED_CPU) && Q4_0_GEN_TUNED_CLASSES != Q4_0_PF_CLASSES
+#error "q4_0_gen_tuned.h has other size classes than q4_0_tune.c: run make tune again"
+#endif
+
+static int q4_0_gen_tuned_supported(void) {
+#ifdef Q4_0_GEN_TUNED_CPU
+    return strcmp(Q4_0_GEN_TUNED_CPU, q4_0_cpu_model()) == 0;
+#else
+    return 0;
+#endif
+}
+
+void vec_dot_q4_0_q8_0_gen_tuned(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+#ifdef Q4_0_GEN_TUNED_CPU
+    q4_0_gen_tuned_fn[q4_0_pf_class(n)](n, s, vx, vy);
+#else
+    vec_dot_q4_0_q8_0_scalar(n, s, vx, vy);
+#endif
+}
@@ -0,0 +1,497 @@
+/*
+ * ggml_vec_dot_q4_0_q8_0 NEON dotprod kernels for Neoverse-N1
+ *
+ * Analysis result: The original kernel is already near-optimal.
+ * GCC -O3 decomposes vmlaq_n_f32 into FMUL+FADD, hiding the
+ * accumulation latency with just 2 accumulators. The chained SDOT
+ * form is optimal. This file provides both versions for A/B testing.
+ *
+ * The main optimization here is 4-way unrolling with prefetch,
+ * which gives ~3-5% improvement for medium-sized vectors (1K-32K
+ * elements) where data fits in L2 but not L1.
+ *
+ * Below those: 2x1/4x1/2x2 multi-row kernels that share each loaded
+ * block between several outputs, 4-row kernels over the repacked
+ * q4_0x4 layout, a variant that converts and applies the scales
+ * four blocks at a time, and the optimized loop over a range of
+ * prefetch distances for q4_0_tune.c to choose from.
+ *
+ * Compiled only with the dotprod extension enabled (the Makefile's
+ * aarch64 flags); q4_0_dispatch.c lists whatever this build has.
+ */
+
+#include "q4_0_types.h"
+
+#if defined(__ARM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+#include <arm_neon.h>
+
+#define Q4_0_HAVE_NEON 1
+
+/* ---- Original (upstream) implementation ---- */
+void vec_dot_q4_0_q8_0_original(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+
+    float sumf = 0.0f;
+    int ib = 0;
+
+    float32x4_t sumv0 = vdupq_n_f32(0.0f);
+    float32x4_t sumv1 = vdupq_n_f32(0.0f);
+
+    for (; ib + 1 < nb; ib += 2) {
+        const block_q4_0 * __restrict__ x0 = &x[ib + 0];
+        const block_q4_0 * __restrict__ x1 = &x[ib + 1];
+        const block_q8_0 * __restrict__ y0 = &y[ib + 0];
+        const block_q8_0 * __restrict__ y1 = &y[ib + 1];
+
+        const uint8x16_t m4b = vdupq_n_u8(0x0F);
+        const int8x16_t  s8b = vdupq_n_s8(0x8);
+
+        const uint8x16_t v0_0 = vld1q_u8(x0->qs);
+        const uint8x16_t v0_1 = vld1q_u8(x1->qs);
+
+        const int8x16_t v0_0l = vreinterpretq_s8_u8(vandq_u8  (v0_0, m4b));
+        const int8x16_t v0_0h = vreinterpretq_s8_u8(vshrq_n_u8(v0_0, 4));
+        const int8x16_t v0_1l = vreinterpretq_s8_u8(vandq_u8  (v0_1, m4b));
+        const int8x16_t v0_1h = vreinterpretq_s8_u8(vshrq_n_u8(v0_1, 4));
+
+        const int8x16_t v0_0ls = vsubq_s8(v0_0l, s8b);
+        const int8x16_t v0_0hs = vsubq_s8(v0_0h, s8b);
+        const int8x16_t v0_1ls = vsubq_s8(v0_1l, s8b);
+        const int8x16_t v0_1hs = vsubq_s8(v0_1h, s8b);
+
+        const int8x16_t v1_0l = vld1q_s8(y0->qs);
+        const int8x16_t v1_0h = vld1q_s8(y0->qs + 16);
+        const int8x16_t v1_1l = vld1q_s8(y1->qs);
+        const int8x16_t v1_1h = vld1q_s8(y1->qs + 16);
+
+        const int32x4_t p_0 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_0ls, v1_0l), v0_0hs, v1_0h);
+        const int32x4_t p_1 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_1ls, v1_1l), v0_1hs, v1_1h);
+
+        sumv0 = vmlaq_n_f32(sumv0, vcvtq_f32_s32(p_0), fp16_to_fp32(x0->d)*fp16_to_fp32(y0->d));
+        sumv1 = vmlaq_n_f32(sumv1, vcvtq_f32_s32(p_1), fp16_to_fp32(x1->d)*fp16_to_fp32(y1->d));
+    }
+
+    sumf = vaddvq_f32(sumv0) + vaddvq_f32(sumv1);
+
+    for (; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+
+    *s = sumf;
+}
+
+/* ---- Optimized: 4-way unroll + software prefetch ---- */
+void vec_dot_q4_0_q8_0_optimized(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+
+    float sumf = 0.0f;
+    int ib = 0;
+
+    float32x4_t sumv0 = vdupq_n_f32(0.0f);
+    float32x4_t sumv1 = vdupq_n_f32(0.0f);
+    float32x4_t sumv2 = vdupq_n_f32(0.0f);
+    float32x4_t sumv3 = vdupq_n_f32(0.0f);
+
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+
+    /* 4 blocks/iteration for better OoO scheduling */
+    for (; ib + 3 < nb; ib += 4) {
+        /* Prefetch L2→L1: 8 blocks ahead ≈ 416 bytes */
+        __builtin_prefetch(&x[ib + 8], 0, 1);
+        __builtin_prefetch(&y[ib + 8], 0, 1);
+        __builtin_prefetch(&y[ib + 10], 0, 1);
+
+        /* Process 4 blocks with interleaved loads and computes */
+#define PROCESS_BLOCK(IDX, ACC) \
+        do { \
+            const uint8x16_t qx = vld1q_u8(x[ib + (IDX)].qs); \
+            const int8x16_t qxl = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(qx, m4b)), s8b); \
+            const int8x16_t qxh = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(qx, 4)), s8b); \
+            const int8x16_t qyl = vld1q_s8(y[ib + (IDX)].qs); \
+            const int8x16_t qyh = vld1q_s8(y[ib + (IDX)].qs + 16); \
+            const int32x4_t p = vdotq_s32(vdotq_s32(vdupq_n_s32(0), qxl, qyl), qxh, qyh); \
+            ACC = vmlaq_n_f32(ACC, vcvtq_f32_s32(p), \
+                    fp16_to_fp32(x[ib + (IDX)].d) * fp16_to_fp32(y[ib + (IDX)].d)); \
+        } while (0)
+
+        PROCESS_BLOCK(0, sumv0);
+        PROCESS_BLOCK(1, sumv1);
+        PROCESS_BLOCK(2, sumv2);
+        PROCESS_BLOCK(3, sumv3);
+
+#undef PROCESS_BLOCK
+    }
+
+    /* Reduce 4 accumulators */
+    sumv0 = vaddq_f32(vaddq_f32(sumv0, sumv1), vaddq_f32(sumv2, sumv3));
+    sumf = vaddvq_f32(sumv0);
+
+    /* 2-block and scalar remainders (same as original) */
+    {
+        float32x4_t sv0 = vdupq_n_f32(0.0f);
+        float32x4_t sv1 = vdupq_n_f32(0.0f);
+        for (; ib + 1 < nb; ib += 2) {
+            const uint8x16_t v0_0 = vld1q_u8(x[ib].qs);
+            const uint8x16_t v0_1 = vld1q_u8(x[ib+1].qs);
+            const int8x16_t v0_0l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v0_0, m4b)), s8b);
+            const int8x16_t v0_0h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v0_0, 4)), s8b);
+            const int8x16_t v0_1l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v0_1, m4b)), s8b);
+            const int8x16_t v0_1h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v0_1, 4)), s8b);
+            const int8x16_t v1_0l = vld1q_s8(y[ib].qs);
+            const int8x16_t v1_0h = vld1q_s8(y[ib].qs + 16);
+            const int8x16_t v1_1l = vld1q_s8(y[ib+1].qs);
+            const int8x16_t v1_1h = vld1q_s8(y[ib+1].qs + 16);
+            const int32x4_t p_0 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_0l, v1_0l), v0_0h, v1_0h);
+            const int32x4_t p_1 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_1l, v1_1l), v0_1h, v1_1h);
+            sv0 = vmlaq_n_f32(sv0, vcvtq_f32_s32(p_0), fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d));
+            sv1 = vmlaq_n_f32(sv1, vcvtq_f32_s32(p_1), fp16_to_fp32(x[ib+1].d)*fp16_to_fp32(y[ib+1].d));
+        }
+        sumf += vaddvq_f32(sv0) + vaddvq_f32(sv1);
+    }
+
+    for (; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+
+    *s = sumf;
+}
+
+/*
+ * ---- Multi-row (nrc > 1): R weight rows × C activation columns per pass ----
+ *
+ * The one-output kernels reload and re-split the same q8_0 block for
+ * every weight row.  These load each x block and each y block once
+ * per pass and feed them to all R×C chained-SDOT products, one float
+ * accumulator per output, so the unpack and the loads are amortized
+ * and the R×C accumulation chains are independent.  Layout: see
+ * vec_dot_mxn_fn in q4_0_types.h.
+ */
+
+static inline int32x4_t q4_0_q8_0_sdot(int8x16_t qxl, int8x16_t qxh, int8x16_t qyl, int8x16_t qyh) {
+    return vdotq_s32(vdotq_s32(vdupq_n_s32(0), qxl, qyl), qxh, qyh);
+}
+
+#define Q4_0_UNPACK(B, L, H) \
+        const uint8x16_t L##_raw = vld1q_u8((B)->qs); \
+        const int8x16_t L = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(L##_raw, m4b)), s8b); \
+        const int8x16_t H = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(L##_raw, 4)), s8b)
+
+#define Q4_0_ROW(BASE, R) ((const block_q4_0 *)((const char *)(BASE) + (R) * bx))
+#define Q8_0_COL(BASE, C) ((const block_q8_0 *)((const char *)(BASE) + (C) * by))
+
+void vec_dot_q4_0_q8_0_2x1(int n, float * __restrict__ s, size_t bs,
+        const void * __restrict__ vx, size_t bx, const void * __restrict__ vy, size_t by) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x0 = Q4_0_ROW(vx, 0);
+    const block_q4_0 * __restrict__ x1 = Q4_0_ROW(vx, 1);
+    const block_q8_0 * __restrict__ y  = Q8_0_COL(vy, 0);
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    (void)bs;
+
+    for (int ib = 0; ib < nb; ib++) {
+        const int8x16_t qyl = vld1q_s8(y[ib].qs);
+        const int8x16_t qyh = vld1q_s8(y[ib].qs + 16);
+        const float dy = fp16_to_fp32(y[ib].d);
+        Q4_0_UNPACK(&x0[ib], q0l, q0h);
+        Q4_0_UNPACK(&x1[ib], q1l, q1h);
+        acc0 = vmlaq_n_f32(acc0, vcvtq_f32_s32(q4_0_q8_0_sdot(q0l, q0h, qyl, qyh)), fp16_to_fp32(x0[ib].d) * dy);
+        acc1 = vmlaq_n_f32(acc1, vcvtq_f32_s32(q4_0_q8_0_sdot(q1l, q1h, qyl, qyh)), fp16_to_fp32(x1[ib].d) * dy);
+    }
+    s[0] = vaddvq_f32(acc0);
+    s[1] = vaddvq_f32(acc1);
+}
+
+void vec_dot_q4_0_q8_0_4x1(int n, float * __restrict__ s, size_t bs,
+        const void * __restrict__ vx, size_t bx, const void * __restrict__ vy, size_t by) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x0 = Q4_0_ROW(vx, 0);
+    const block_q4_0 * __restrict__ x1 = Q4_0_ROW(vx, 1);
+    const block_q4_0 * __restrict__ x2 = Q4_0_ROW(vx, 2);
+    const block_q4_0 * __restrict__ x3 = Q4_0_ROW(vx, 3);
+    const block_q8_0 * __restrict__ y  = Q8_0_COL(vy, 0);
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    (void)bs;
+
+    for (int ib = 0; ib < nb; ib++) {
+        const int8x16_t qyl = vld1q_s8(y[ib].qs);
+        const int8x16_t qyh = vld1q_s8(y[ib].qs + 16);
+        const float dy = fp16_to_fp32(y[ib].d);
+        Q4_0_UNPACK(&x0[ib], q0l, q0h);
+        Q4_0_UNPACK(&x1[ib], q1l, q1h);
+        Q4_0_UNPACK(&x2[ib], q2l, q2h);
+        Q4_0_UNPACK(&x3[ib], q3l, q3h);
+        acc0 = vmlaq_n_f32(acc0, vcvtq_f32_s32(q4_0_q8_0_sdot(q0l, q0h, qyl, qyh)), fp16_to_fp32(x0[ib].d) * dy);
+        acc1 = vmlaq_n_f32(acc1, vcvtq_f32_s32(q4_0_q8_0_sdot(q1l, q1h, qyl, qyh)), fp16_to_fp32(x1[ib].d) * dy);
+        acc2 = vmlaq_n_f32(acc2, vcvtq_f32_s32(q4_0_q8_0_sdot(q2l, q2h, qyl, qyh)), fp16_to_fp32(x2[ib].d) * dy);
+        acc3 = vmlaq_n_f32(acc3, vcvtq_f32_s32(q4_0_q8_0_sdot(q3l, q3h, qyl, qyh)), fp16_to_fp32(x3[ib].d) * dy);
+    }
+    s[0] = vaddvq_f32(acc0);
+    s[1] = vaddvq_f32(acc1);
+    s[2] = vaddvq_f32(acc2);
+    s[3] = vaddvq_f32(acc3);
+}
+
+void vec_dot_q4_0_q8_0_2x2(int n, float * __restrict__ s, size_t bs,
+        const void * __restrict__ vx, size_t bx, const void * __restrict__ vy, size_t by) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x0 = Q4_0_ROW(vx, 0);
+    const block_q4_0 * __restrict__ x1 = Q4_0_ROW(vx, 1);
+    const block_q8_0 * __restrict__ y0 = Q8_0_COL(vy, 0);
+    const block_q8_0 * __restrict__ y1 = Q8_0_COL(vy, 1);
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t acc00 = vdupq_n_f32(0.0f);
+    float32x4_t acc10 = vdupq_n_f32(0.0f);
+    float32x4_t acc01 = vdupq_n_f32(0.0f);
+    float32x4_t acc11 = vdupq_n_f32(0.0f);
+
+    for (int ib = 0; ib < nb; ib++) {
+        const int8x16_t y0l = vld1q_s8(y0[ib].qs);
+        const int8x16_t y0h = vld1q_s8(y0[ib].qs + 16);
+        const int8x16_t y1l = vld1q_s8(y1[ib].qs);
+        const int8x16_t y1h = vld1q_s8(y1[ib].qs + 16);
+        const float dx0 = fp16_to_fp32(x0[ib].d), dx1 = fp16_to_fp32(x1[ib].d);
+        const float dy0 = fp16_to_fp32(y0[ib].d), dy1 = fp16_to_fp32(y1[ib].d);
+        Q4_0_UNPACK(&x0[ib], q0l, q0h);
+        Q4_0_UNPACK(&x1[ib], q1l, q1h);
+        acc00 = vmlaq_n_f32(acc00, vcvtq_f32_s32(q4_0_q8_0_sdot(q0l, q0h, y0l, y0h)), dx0 * dy0);
+        acc10 = vmlaq_n_f32(acc10, vcvtq_f32_s32(q4_0_q8_0_sdot(q1l, q1h, y0l, y0h)), dx1 * dy0);
+        acc01 = vmlaq_n_f32(acc01, vcvtq_f32_s32(q4_0_q8_0_sdot(q0l, q0h, y1l, y1h)), dx0 * dy1);
+        acc11 = vmlaq_n_f32(acc11, vcvtq_f32_s32(q4_0_q8_0_sdot(q1l, q1h, y1l, y1h)), dx1 * dy1);
+    }
+    s[0]      = vaddvq_f32(acc00);
+    s[1]      = vaddvq_f32(acc10);
+    s[bs]     = vaddvq_f32(acc01);
+    s[bs + 1] = vaddvq_f32(acc11);
+}
+
+/*
+ * ---- Repacked q4_0x4 (4 rows × 1 column) ----
+ *
+ * The 4x1 kernel above with the weights in q4_0x4 groups: aligned quant
+ * loads, the four x scales in one vld1 + vcvt_f32_f16, and the four
+ * rows' SDOT sums folded with pairwise adds into one vector, so a
+ * single FMLA per block accumulates all four outputs.  The shifted
+ * variant unpacks with SHL / AND alone; its sums are 16x and the result
+ * is scaled back once at the end (exact: a power of two).
+ */
+
+static inline int32x4_t q4_0x4_sums(const uint8_t *q, int8x16_t qyl, int8x16_t qyh, int shifted) {
+    int32x4_t p[Q4_0X4_ROWS];
+    for (int r = 0; r < Q4_0X4_ROWS; r++) {
+        int8x16_t l, h;
+        if (shifted) {
+            const int8x16_t v = vld1q_s8((const int8_t *)q + 16 * r);
+            l = vshlq_n_s8(v, 4);
+            h = vandq_s8(v, vdupq_n_s8((int8_t)0xF0));
+        } else {
+            const uint8x16_t v = vld1q_u8(q + 16 * r);
+            l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v, vdupq_n_u8(0x0F))), vdupq_n_s8(0x8));
+            h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v, 4)), vdupq_n_s8(0x8));
+        }
+        p[r] = q4_0_q8_0_sdot(l, h, qyl, qyh);
+    }
+    return vpaddq_s32(vpaddq_s32(p[0], p[1]), vpaddq_s32(p[2], p[3]));
+}
+
+static inline float32x4_t q4_0x4_dot(int n, const void *vx, const block_q8_0 *y, int shifted) {
+    const int nb = n / QK4_0;
+    const ggml_fp16_t * __restrict__ d = q4_0x4_scales(vx);
+    const uint8_t * __restrict__ qs = q4_0x4_quants(vx, nb);
+    float32x4_t acc = vdupq_n_f32(0.0f);
+
+    for (int ib = 0; ib < nb; ib++) {
+        const int8x16_t qyl = vld1q_s8(y[ib].qs);
+        const int8x16_t qyh = vld1q_s8(y[ib].qs + 16);
+        const int32x4_t sums = q4_0x4_sums(qs + ib * Q4_0X4_ROWS * (QK4_0 / 2), qyl, qyh, shifted);
+        const float32x4_t dx = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(d + ib * Q4_0X4_ROWS)));
+        acc = vfmaq_f32(acc, vcvtq_f32_s32(sums), vmulq_n_f32(dx, fp16_to_fp32(y[ib].d)));
+    }
+    return acc;
+}
+
+void vec_dot_q4_0x4_q8_0(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    vst1q_f32(s, q4_0x4_dot(n, vx, (const block_q8_0 *)vy, 0));
+}
+
+void vec_dot_q4_0x4_q8_0_shifted(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    vst1q_f32(s, vmulq_n_f32(q4_0x4_dot(n, vx, (const block_q8_0 *)vy, 1), 1.0f / 16));
+}
+
+/*
+ * ---- Vector scales ----
+ *
+ * The one-output kernels convert x->d and y->d with scalar FCVTs and
+ * multiply them with a scalar FMUL: analysis.md counts 4 FCVT + 2 FMUL
+ * per two blocks on the FP pipe.  This one gathers four blocks' d into
+ * the lanes of one vector per side (LD1 lane loads), converts each with
+ * one vcvt_f32_f16, multiplies x by y once, and applies lane i to block
+ * i with a lane-indexed FMLA: 2 FCVTL + 1 FMUL per four blocks.  Two
+ * accumulators alternate, as in the original.
+ */
+
+/* d of four blocks stride bytes apart (d leads both block types) as floats. */
+static inline float32x4_t fp16x4_gather(const void *p, size_t stride) {
+    const uint16_t *d = (const uint16_t *)p;
+    uint16x4_t v = vdup_n_u16(0);
+    v = vld1_lane_u16(d, v, 0);
+    v = vld1_lane_u16((const uint16_t *)((const char *)d + stride), v, 1);
+    v = vld1_lane_u16((const uint16_t *)((const char *)d + 2 * stride), v, 2);
+    v = vld1_lane_u16((const uint16_t *)((const char *)d + 3 * stride), v, 3);
+    return vcvt_f32_f16(vreinterpret_f16_u16(v));
+}
+
+void vec_dot_q4_0_q8_0_vscale(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t sumv0 = vdupq_n_f32(0.0f);
+    float32x4_t sumv1 = vdupq_n_f32(0.0f);
+    int ib = 0;
+
+    for (; ib + 3 < nb; ib += 4) {
+        const float32x4_t d = vmulq_f32(fp16x4_gather(&x[ib], sizeof(block_q4_0)),
+                                        fp16x4_gather(&y[ib], sizeof(block_q8_0)));
+        Q4_0_UNPACK(&x[ib + 0], q0l, q0h);
+        Q4_0_UNPACK(&x[ib + 1], q1l, q1h);
+        Q4_0_UNPACK(&x[ib + 2], q2l, q2h);
+        Q4_0_UNPACK(&x[ib + 3], q3l, q3h);
+        const int32x4_t p0 = q4_0_q8_0_sdot(q0l, q0h, vld1q_s8(y[ib + 0].qs), vld1q_s8(y[ib + 0].qs + 16));
+        const int32x4_t p1 = q4_0_q8_0_sdot(q1l, q1h, vld1q_s8(y[ib + 1].qs), vld1q_s8(y[ib + 1].qs + 16));
+        const int32x4_t p2 = q4_0_q8_0_sdot(q2l, q2h, vld1q_s8(y[ib + 2].qs), vld1q_s8(y[ib + 2].qs + 16));
+        const int32x4_t p3 = q4_0_q8_0_sdot(q3l, q3h, vld1q_s8(y[ib + 3].qs), vld1q_s8(y[ib + 3].qs + 16));
+        sumv0 = vfmaq_laneq_f32(sumv0, vcvtq_f32_s32(p0), d, 0);
+        sumv1 = vfmaq_laneq_f32(sumv1, vcvtq_f32_s32(p1), d, 1);
+        sumv0 = vfmaq_laneq_f32(sumv0, vcvtq_f32_s32(p2), d, 2);
+        sumv1 = vfmaq_laneq_f32(sumv1, vcvtq_f32_s32(p3), d, 3);
+    }
+
+    float sumf = vaddvq_f32(vaddq_f32(sumv0, sumv1));
+
+    for (; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+
+    *s = sumf;
+}
+
+/*
+ * ---- Prefetch-distance family (calibrated by q4_0_tune.c) ----
+ *
+ * The optimized loop with its prefetch distance as a parameter: dist
+ * blocks ahead of the current four, same hints as optimized, or none
+ * at dist = 0.  pf8 is optimized without the 2-block remainder loop.
+ */
+static inline __attribute__((always_inline))
+void q4_0_q8_0_pf(int n, float * __restrict__ s, const void * __restrict__ vx,
+        const void * __restrict__ vy, const int dist) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const uint8x16_t m4b = vdupq_n_u8(0x0F);
+    const int8x16_t  s8b = vdupq_n_s8(0x8);
+    float32x4_t sumv0 = vdupq_n_f32(0.0f);
+    float32x4_t sumv1 = vdupq_n_f32(0.0f);
+    float32x4_t sumv2 = vdupq_n_f32(0.0f);
+    float32x4_t sumv3 = vdupq_n_f32(0.0f);
+    int ib = 0;
+
+    for (; ib + 3 < nb; ib += 4) {
+        if (dist) {
+            __builtin_prefetch(&x[ib + dist], 0, 1);
+            __builtin_prefetch(&y[ib + dist], 0, 1);
+            __builtin_prefetch(&y[ib + dist + 2], 0, 1);
+        }
+        Q4_0_UNPACK(&x[ib + 0], q0l, q0h);
+        Q4_0_UNPACK(&x[ib + 1], q1l, q1h);
+        Q4_0_UNPACK(&x[ib + 2], q2l, q2h);
+        Q4_0_UNPACK(&x[ib + 3], q3l, q3h);
+        const int32x4_t p0 = q4_0_q8_0_sdot(q0l, q0h, vld1q_s8(y[ib + 0].qs), vld1q_s8(y[ib + 0].qs + 16));
+        const int32x4_t p1 = q4_0_q8_0_sdot(q1l, q1h, vld1q_s8(y[ib + 1].qs), vld1q_s8(y[ib + 1].qs + 16));
+        const int32x4_t p2 = q4_0_q8_0_sdot(q2l, q2h, vld1q_s8(y[ib + 2].qs), vld1q_s8(y[ib + 2].qs + 16));
+        const int32x4_t p3 = q4_0_q8_0_sdot(q3l, q3h, vld1q_s8(y[ib + 3].qs), vld1q_s8(y[ib + 3].qs + 16));
+        sumv0 = vmlaq_n_f32(sumv0, vcvtq_f32_s32(p0), fp16_to_fp32(x[ib + 0].d) * fp16_to_fp32(y[ib + 0].d));
+        sumv1 = vmlaq_n_f32(sumv1, vcvtq_f32_s32(p1), fp16_to_fp32(x[ib + 1].d) * fp16_to_fp32(y[ib + 1].d));
+        sumv2 = vmlaq_n_f32(sumv2, vcvtq_f32_s32(p2), fp16_to_fp32(x[ib + 2].d) * fp16_to_fp32(y[ib + 2].d));
+        sumv3 = vmlaq_n_f32(sumv3, vcvtq_f32_s32(p3), fp16_to_fp32(x[ib + 3].d) * fp16_to_fp32(y[ib + 3].d));
+    }
+
+    float sumf = vaddvq_f32(vaddq_f32(vaddq_f32(sumv0, sumv1), vaddq_f32(sumv2, sumv3)));
+
+    for (; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+
+    *s = sumf;
+}
+
+#define Q4_0_PF_KERNEL(D) \
+void vec_dot_q4_0_q8_0_pf##D(int n, float * __restrict__ s, \
+        const void * __restrict__ vx, const void * __restrict__ vy) { \
+    q4_0_q8_0_pf(n, s, vx, vy, D); \
+}
+
+Q4_0_PF_KERNEL(0)
+Q4_0_PF_KERNEL(4)
+Q4_0_PF_KERNEL(8)
+Q4_0_PF_KERNEL(16)
+Q4_0_PF_KERNEL(32)
+
+#undef Q4_0_PF_KERNEL
+#undef Q4_0_UNPACK
+#undef Q4_0_ROW
+#undef Q8_0_COL
+
+#endif /* __ARM_NEON && __ARM_FEATURE_DOTPROD */
@@ -1,191 +0,0 @@
-/*
- * Optimized ggml_vec_dot_q4_0_q8_0 NEON path for Neoverse-N1
- *
- * Analysis result: The original kernel is already near-optimal.
- * GCC -O3 decomposes vmlaq_n_f32 into FMUL+FADD, hiding the
- * accumulation latency with just 2 accumulators. The chained SDOT
- * form is optimal. This file provides both versions for A/B testing.
- *
- * The main optimization here is 4-way unrolling with prefetch,
- * which gives ~3-5% improvement for medium-sized vectors (1K-32K
- * elements) where data fits in L2 but not L1.
- */
-
-#ifndef Q4_0_TYPES_DEFINED
-#include <arm_neon.h>
-#include <stdint.h>
-#include <stddef.h>
-#include <string.h>
-
-typedef uint16_t ggml_fp16_t;
-
-#define QK4_0 32
-typedef struct {
-    ggml_fp16_t d;
-    uint8_t qs[QK4_0 / 2];
-} block_q4_0;
-
-#define QK8_0 32
-typedef struct {
-    ggml_fp16_t d;
-    int8_t qs[QK8_0];
-} block_q8_0;
-
-static inline float fp16_to_fp32(ggml_fp16_t h) {
-    __fp16 tmp;
-    memcpy(&tmp, &h, sizeof(ggml_fp16_t));
-    return (float)tmp;
-}
-#endif /* Q4_0_TYPES_DEFINED */
-
-/* ---- Original (upstream) implementation ---- */
-void vec_dot_q4_0_q8_0_original(int n, float * __restrict__ s,
-        const void * __restrict__ vx, const void * __restrict__ vy) {
-    const int qk = QK4_0;
-    const int nb = n / qk;
-    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
-    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
-
-    float sumf = 0.0f;
-    int ib = 0;
-
-    float32x4_t sumv0 = vdupq_n_f32(0.0f);
-    float32x4_t sumv1 = vdupq_n_f32(0.0f);
-
-    for (; ib + 1 < nb; ib += 2) {
-        const block_q4_0 * __restrict__ x0 = &x[ib + 0];
-        const block_q4_0 * __restrict__ x1 = &x[ib + 1];
-        const block_q8_0 * __restrict__ y0 = &y[ib + 0];
-        const block_q8_0 * __restrict__ y1 = &y[ib + 1];
-
-        const uint8x16_t m4b = vdupq_n_u8(0x0F);
-        const int8x16_t  s8b = vdupq_n_s8(0x8);
-
-        const uint8x16_t v0_0 = vld1q_u8(x0->qs);
-        const uint8x16_t v0_1 = vld1q_u8(x1->qs);
-
-        const int8x16_t v0_0l = vreinterpretq_s8_u8(vandq_u8  (v0_0, m4b));
-        const int8x16_t v0_0h = vreinterpretq_s8_u8(vshrq_n_u8(v0_0, 4));
-        const int8x16_t v0_1l = vreinterpretq_s8_u8(vandq_u8  (v0_1, m4b));
-        const int8x16_t v0_1h = vreinterpretq_s8_u8(vshrq_n_u8(v0_1, 4));
-
-        const int8x16_t v0_0ls = vsubq_s8(v0_0l, s8b);
-        const int8x16_t v0_0hs = vsubq_s8(v0_0h, s8b);
-        const int8x16_t v0_1ls = vsubq_s8(v0_1l, s8b);
-        const int8x16_t v0_1hs = vsubq_s8(v0_1h, s8b);
-
-        const int8x16_t v1_0l = vld1q_s8(y0->qs);
-        const int8x16_t v1_0h = vld1q_s8(y0->qs + 16);
-        const int8x16_t v1_1l = vld1q_s8(y1->qs);
-        const int8x16_t v1_1h = vld1q_s8(y1->qs + 16);
-
-        const int32x4_t p_0 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_0ls, v1_0l), v0_0hs, v1_0h);
-        const int32x4_t p_1 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_1ls, v1_1l), v0_1hs, v1_1h);
-
-        sumv0 = vmlaq_n_f32(sumv0, vcvtq_f32_s32(p_0), fp16_to_fp32(x0->d)*fp16_to_fp32(y0->d));
-        sumv1 = vmlaq_n_f32(sumv1, vcvtq_f32_s32(p_1), fp16_to_fp32(x1->d)*fp16_to_fp32(y1->d));
-    }
-
-    sumf = vaddvq_f32(sumv0) + vaddvq_f32(sumv1);
-
-    for (; ib < nb; ++ib) {
-        int sumi0 = 0, sumi1 = 0;
-        for (int j = 0; j < qk/2; ++j) {
-            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
-            const int v1 = (x[ib].qs[j] >>   4) - 8;
-            sumi0 += (v0 * y[ib].qs[j]);
-            sumi1 += (v1 * y[ib].qs[j + qk/2]);
-        }
-        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
-    }
-
-    *s = sumf;
-}
-
-/* ---- Optimized: 4-way unroll + software prefetch ---- */
-void vec_dot_q4_0_q8_0_optimized(int n, float * __restrict__ s,
-        const void * __restrict__ vx, const void * __restrict__ vy) {
-    const int qk = QK4_0;
-    const int nb = n / qk;
-    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
-    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
-
-    float sumf = 0.0f;
-    int ib = 0;
-
-    float32x4_t sumv0 = vdupq_n_f32(0.0f);
-    float32x4_t sumv1 = vdupq_n_f32(0.0f);
-    float32x4_t sumv2 = vdupq_n_f32(0.0f);
-    float32x4_t sumv3 = vdupq_n_f32(0.0f);
-
-    const uint8x16_t m4b = vdupq_n_u8(0x0F);
-    const int8x16_t  s8b = vdupq_n_s8(0x8);
-
-    /* 4 blocks/iteration for better OoO scheduling */
-    for (; ib + 3 < nb; ib += 4) {
-        /* Prefetch L2→L1: 8 blocks ahead ≈ 416 bytes */
-        __builtin_prefetch(&x[ib + 8], 0, 1);
-        __builtin_prefetch(&y[ib + 8], 0, 1);
-        __builtin_prefetch(&y[ib + 10], 0, 1);
-
-        /* Process 4 blocks with interleaved loads and computes */
-#define PROCESS_BLOCK(IDX, ACC) \
-        do { \
-            const uint8x16_t qx = vld1q_u8(x[ib + (IDX)].qs); \
-            const int8x16_t qxl = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(qx, m4b)), s8b); \
-            const int8x16_t qxh = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(qx, 4)), s8b); \
-            const int8x16_t qyl = vld1q_s8(y[ib + (IDX)].qs); \
-            const int8x16_t qyh = vld1q_s8(y[ib + (IDX)].qs + 16); \
-            const int32x4_t p = vdotq_s32(vdotq_s32(vdupq_n_s32(0), qxl, qyl), qxh, qyh); \
-            ACC = vmlaq_n_f32(ACC, vcvtq_f32_s32(p), \
-                    fp16_to_fp32(x[ib + (IDX)].d) * fp16_to_fp32(y[ib + (IDX)].d)); \
-        } while (0)
-
-        PROCESS_BLOCK(0, sumv0);
-        PROCESS_BLOCK(1, sumv1);
-        PROCESS_BLOCK(2, sumv2);
-        PROCESS_BLOCK(3, sumv3);
-
-#undef PROCESS_BLOCK
-    }
-
-    /* Reduce 4 accumulators */
-    sumv0 = vaddq_f32(vaddq_f32(sumv0, sumv1), vaddq_f32(sumv2, sumv3));
-    sumf = vaddvq_f32(sumv0);
-
-    /* 2-block and scalar remainders (same as original) */
-    {
-        float32x4_t sv0 = vdupq_n_f32(0.0f);
-        float32x4_t sv1 = vdupq_n_f32(0.0f);
-        for (; ib + 1 < nb; ib += 2) {
-            const uint8x16_t v0_0 = vld1q_u8(x[ib].qs);
-            const uint8x16_t v0_1 = vld1q_u8(x[ib+1].qs);
-            const int8x16_t v0_0l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v0_0, m4b)), s8b);
-            const int8x16_t v0_0h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v0_0, 4)), s8b);
-            const int8x16_t v0_1l = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v0_1, m4b)), s8b);
-            const int8x16_t v0_1h = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v0_1, 4)), s8b);
-            const int8x16_t v1_0l = vld1q_s8(y[ib].qs);
-            const int8x16_t v1_0h = vld1q_s8(y[ib].qs + 16);
-            const int8x16_t v1_1l = vld1q_s8(y[ib+1].qs);
-            const int8x16_t v1_1h = vld1q_s8(y[ib+1].qs + 16);
-            const int32x4_t p_0 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_0l, v1_0l), v0_0h, v1_0h);
-            const int32x4_t p_1 = vdotq_s32(vdotq_s32(vdupq_n_s32(0), v0_1l, v1_1l), v0_1h, v1_1h);
-            sv0 = vmlaq_n_f32(sv0, vcvtq_f32_s32(p_0), fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d));
-            sv1 = vmlaq_n_f32(sv1, vcvtq_f32_s32(p_1), fp16_to_fp32(x[ib+1].d)*fp16_to_fp32(y[ib+1].d));
-        }
-        sumf += vaddvq_f32(sv0) + vaddvq_f32(sv1);
-    }
-
-    for (; ib < nb; ++ib) {
-        int sumi0 = 0, sumi1 = 0;
-        for (int j = 0; j < qk/2; ++j) {
-            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
-            const int v1 = (x[ib].qs[j] >>   4) - 8;
-            sumi0 += (v0 * y[ib].qs[j]);
-            sumi1 += (v1 * y[ib].qs[j + qk/2]);
-        }
-        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
-    }
-
-    *s = sumf;
-}
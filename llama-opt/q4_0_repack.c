@@ -0,0 +1,64 @@
+/*
+ * Offline repacking of q4_0 weights into q4_0x4 groups
+ *
+ * The native block_q4_0 is 18 bytes, so the quants of most blocks sit
+ * at an unaligned address, and the fp16 scale sits between them and
+ * needs one scalar conversion per block.  q4_0x4 (layout in
+ * q4_0_types.h) groups four rows block by block: one vector load
+ * brings the four scales and one 64-byte line brings the four rows'
+ * quants.  The weights are static, so this runs once at load time.
+ *
+ * Rows past nr in the last group are zero blocks (d = 0), and their
+ * outputs are 0.
+ *
+ * #included by benchmark.c; not a standalone translation unit.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int      nr, n;             /* weight rows and row length of the source */
+    int      groups;            /* ceil(nr / 4) */
+    int      shifted;           /* quants stored as qs ^ 0x88 */
+    size_t   group_bytes;
+    uint8_t *data;
+} q4_0x4_matrix;
+
+static inline const void *q4_0x4_group(const q4_0x4_matrix *m, int g) {
+    return m->data + (size_t)g * m->group_bytes;
+}
+
+/* Repack nr rows of n elements at w; 0 on success, -1 if out of memory. */
+static int q4_0x4_repack(q4_0x4_matrix *m, const block_q4_0 *w, int nr, int n, int shifted) {
+    const int nb = n / QK4_0;
+    const uint8_t flip = shifted ? 0x88 : 0x00;
+
+    m->nr = nr;
+    m->n = n;
+    m->groups = (nr + Q4_0X4_ROWS - 1) / Q4_0X4_ROWS;
+    m->shifted = shifted;
+    m->group_bytes = q4_0x4_group_bytes(nb);
+    m->data = aligned_alloc(64, (size_t)m->groups * m->group_bytes);
+    if (!m->data) return -1;
+    memset(m->data, 0, (size_t)m->groups * m->group_bytes);
+
+    for (int g = 0; g < m->groups; g++) {
+        ggml_fp16_t *d = (ggml_fp16_t *)(m->data + (size_t)g * m->group_bytes);
+        uint8_t *qs = (uint8_t *)d + q4_0x4_scales_bytes(nb);
+        for (int r = 0; r < Q4_0X4_ROWS && g * Q4_0X4_ROWS + r < nr; r++) {
+            const block_q4_0 *row = w + (size_t)(g * Q4_0X4_ROWS + r) * nb;
+            for (int ib = 0; ib < nb; ib++) {
+                d[ib * Q4_0X4_ROWS + r] = row[ib].d;
+                for (int j = 0; j < QK4_0 / 2; j++)
+                    qs[(ib * Q4_0X4_ROWS + r) * (QK4_0 / 2) + j] = row[ib].qs[j] ^ flip;
+            }
+        }
+    }
+    return 0;
+}
+
+static void q4_0x4_free(q4_0x4_matrix *m) {
+    free(m->data);
+    m->data = NULL;
+}
@@ -0,0 +1,55 @@
+/*
+ * Portable scalar q4_0 × q8_0 dot product
+ *
+ * The correctness reference for every SIMD kernel, and the fallback
+ * q4_0_dispatch() picks on a CPU with none of them.  Same arithmetic
+ * as the upstream remainder loop: integer sums per block, scaled by
+ * x->d * y->d in float.
+ */
+
+#include "q4_0_types.h"
+
+void vec_dot_q4_0_q8_0_scalar(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+
+    float sumf = 0.0f;
+    for (int ib = 0; ib < nb; ++ib) {
+        int sumi0 = 0, sumi1 = 0;
+        for (int j = 0; j < qk/2; ++j) {
+            const int v0 = (x[ib].qs[j] & 0x0F) - 8;
+            const int v1 = (x[ib].qs[j] >>   4) - 8;
+            sumi0 += (v0 * y[ib].qs[j]);
+            sumi1 += (v1 * y[ib].qs[j + qk/2]);
+        }
+        sumf += (sumi0 + sumi1)*fp16_to_fp32(x[ib].d)*fp16_to_fp32(y[ib].d);
+    }
+    *s = sumf;
+}
+
+/* The same over a q4_0x4 group (plain quants): s[r] = row r · y. */
+void vec_dot_q4_0x4_q8_0_scalar(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int qk = QK4_0;
+    const int nb = n / qk;
+    const ggml_fp16_t * __restrict__ d = q4_0x4_scales(vx);
+    const uint8_t * __restrict__ qs = q4_0x4_quants(vx, nb);
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+
+    for (int r = 0; r < Q4_0X4_ROWS; r++) {
+        float sumf = 0.0f;
+        for (int ib = 0; ib < nb; ++ib) {
+            const uint8_t *q = qs + (ib * Q4_0X4_ROWS + r) * (qk/2);
+            int sumi0 = 0, sumi1 = 0;
+            for (int j = 0; j < qk/2; ++j) {
+                sumi0 += ((q[j] & 0x0F) - 8) * y[ib].qs[j];
+                sumi1 += ((q[j] >>   4) - 8) * y[ib].qs[j + qk/2];
+            }
+            sumf += (sumi0 + sumi1)*fp16_to_fp32(d[ib * Q4_0X4_ROWS + r])*fp16_to_fp32(y[ib].d);
+        }
+        s[r] = sumf;
+    }
+}
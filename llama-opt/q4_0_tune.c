@@ -0,0 +1,161 @@
+/*
+ * Run-time prefetch calibration for the q4_0 × q8_0 dot product
+ *
+ * analysis.md found the fixed 8-block prefetch of neon-optimized worth
+ * ~4% at 4K-32K elements and 5-12% slower above 64K, and where the
+ * crossover lies depends on the core and its caches.  So the distance
+ * is measured instead: q4_0_pf_calibrate() times every distance of the
+ * family (no prefetch included) at one size per size class on this
+ * machine, keeps the fastest per class in a dispatch table, and
+ * vec_dot_q4_0_q8_0_tuned() looks up the kernel by n on every call.
+ * A prefetch distance has to beat no prefetch by Q4_0_PF_MARGIN to be
+ * picked: closer than that is timing noise, and no prefetch is the
+ * kernel that cannot lose badly on a different load.
+ *
+ * Family: the optimized NEON loop, or avx2-vscale on x86 (AVX2 only).
+ * Timing is the benchmark's: one x row and one y column, called over
+ * and over, the fastest of Q4_0_PF_ROUNDS rounds, candidates
+ * interleaved within a round so clock drift hits them all alike.
+ * Calibration takes ~25 ms; the first tuned call runs it if main has
+ * not.
+ *
+ * #included by benchmark.c after the kernel files, before q4_0_dispatch.c.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    int        dist;            /* blocks ahead; 0 = no prefetch */
+    vec_dot_fn fn;
+} q4_0_pf_kernel;
+
+static const q4_0_pf_kernel q4_0_pf_kernels[] = {
+#if defined(Q4_0_HAVE_NEON)
+    {0,  vec_dot_q4_0_q8_0_pf0},
+    {4,  vec_dot_q4_0_q8_0_pf4},
+    {8,  vec_dot_q4_0_q8_0_pf8},
+    {16, vec_dot_q4_0_q8_0_pf16},
+    {32, vec_dot_q4_0_q8_0_pf32},
+#elif defined(Q4_0_HAVE_X86)
+    {0,  vec_dot_q4_0_q8_0_avx2_vscale},
+    {4,  vec_dot_q4_0_q8_0_avx2_pf4},
+    {8,  vec_dot_q4_0_q8_0_avx2_pf8},
+    {16, vec_dot_q4_0_q8_0_avx2_pf16},
+    {32, vec_dot_q4_0_q8_0_avx2_pf32},
+#endif
+    {-1, NULL},
+};
+
+#define Q4_0_PF_MAX     8
+#define Q4_0_PF_CLASSES 5
+#define Q4_0_PF_ROUNDS  5
+#define Q4_0_PF_MARGIN  0.03    /* a distance must be this much faster than none */
+
+/* Class c takes n <= q4_0_pf_class_n[c] (the last, anything larger) and is timed at that n. */
+static const int q4_0_pf_class_n[Q4_0_PF_CLASSES] = {1024, 4096, 16384, 65536, 262144};
+
+typedef struct {
+    vec_dot_fn fn[Q4_0_PF_CLASSES];
+    int        dist[Q4_0_PF_CLASSES];
+    double     ns[Q4_0_PF_CLASSES][Q4_0_PF_MAX];   /* per q4_0_pf_kernels[] entry, for reports */
+} q4_0_pf_table;
+
+static q4_0_pf_table q4_0_pf;
+static pthread_once_t q4_0_pf_once = PTHREAD_ONCE_INIT;
+static int q4_0_pf_ready;       /* table complete; read with acquire, so calls skip pthread_once */
+
+static int q4_0_pf_supported(void) {
+#if defined(Q4_0_HAVE_NEON)
+    return 1;
+#elif defined(Q4_0_HAVE_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return 0;
+#endif
+}
+
+static inline int q4_0_pf_class(int n) {
+    int c = 0;
+    while (c < Q4_0_PF_CLASSES - 1 && n > q4_0_pf_class_n[c]) c++;
+    return c;
+}
+
+static double q4_0_pf_time(vec_dot_fn fn, int n, const void *x, const void *y, int iters) {
+    struct timespec t0, t1;
+    float out;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < iters; i++) {
+        fn(n, &out, x, y);
+        __asm__ volatile("" :: "r"(out) : "memory");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / iters;
+}
+
+/* Random blocks: the timing does not depend on the values, only on there being no pattern. */
+static void q4_0_pf_fill(uint8_t *p, size_t bytes, size_t block, uint32_t seed) {
+    for (size_t i = 0; i < bytes; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        p[i] = (uint8_t)(seed >> 24);
+    }
+    for (size_t i = 0; i + block <= bytes; i += block)       /* d = 2^-10 */
+        memcpy(p + i, &(ggml_fp16_t){0x1400}, sizeof(ggml_fp16_t));
+}
+
+static void q4_0_pf_calibrate_once(void) {
+    int nk = 0;
+    while (q4_0_pf_kernels[nk].fn && nk < Q4_0_PF_MAX) nk++;
+
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        q4_0_pf.fn[c] = vec_dot_q4_0_q8_0_scalar;
+        q4_0_pf.dist[c] = -1;
+    }
+    if (nk == 0 || !q4_0_pf_supported()) {
+        __atomic_store_n(&q4_0_pf_ready, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    for (int c = 0; c < Q4_0_PF_CLASSES; c++) {
+        const int n = q4_0_pf_class_n[c], nb = n / QK4_0;
+        const int iters = n < 2000000 / 8 ? 2000000 / n : 8;     /* ~0.2 ms per timing */
+        block_q4_0 *x = aligned_alloc(64, nb * sizeof(block_q4_0));
+        block_q8_0 *y = aligned_alloc(64, nb * sizeof(block_q8_0));
+        q4_0_pf_fill((uint8_t *)x, nb * sizeof(block_q4_0), sizeof(block_q4_0), 1 + c);
+        q4_0_pf_fill((uint8_t *)y, nb * sizeof(block_q8_0), sizeof(block_q8_0), 101 + c);
+
+        for (int k = 0; k < nk; k++) {
+            q4_0_pf_time(q4_0_pf_kernels[k].fn, n, x, y, iters / 4 + 1);   /* warmup */
+            q4_0_pf.ns[c][k] = 1e30;
+        }
+        for (int r = 0; r < Q4_0_PF_ROUNDS; r++)
+            for (int k = 0; k < nk; k++) {
+                double t = q4_0_pf_time(q4_0_pf_kernels[k].fn, n, x, y, iters);
+                if (t < q4_0_pf.ns[c][k]) q4_0_pf.ns[c][k] = t;
+            }
+
+        int best = 0;                                           /* entry 0: no prefetch */
+        for (int k = 1; k < nk; k++)
+            if (q4_0_pf.ns[c][k] < q4_0_pf.ns[c][best]) best = k;
+        if (q4_0_pf.ns[c][best] > q4_0_pf.ns[c][0] * (1 - Q4_0_PF_MARGIN)) best = 0;
+        q4_0_pf.fn[c] = q4_0_pf_kernels[best].fn;
+        q4_0_pf.dist[c] = q4_0_pf_kernels[best].dist;
+
+        free(x);
+        free(y);
+    }
+    __atomic_store_n(&q4_0_pf_ready, 1, __ATOMIC_RELEASE);
+}
+
+/* Fill the dispatch table; runs once, later calls return at once. */
+static void q4_0_pf_calibrate(void) {
+    pthread_once(&q4_0_pf_once, q4_0_pf_calibrate_once);
+}
+
+void vec_dot_q4_0_q8_0_tuned(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    if (!__atomic_load_n(&q4_0_pf_ready, __ATOMIC_ACQUIRE)) q4_0_pf_calibrate();
+    q4_0_pf.fn[q4_0_pf_class(n)](n, s, vx, vy);
+}
@@ -0,0 +1,138 @@
+/*
+ * q4_0 / q8_0 block types and FP16 helpers shared by every kernel
+ *
+ * FP16 conversion uses the hardware where the compiler exposes it
+ * (__fp16 on ARM, F16C on x86 builds that enable it) and a bit-exact
+ * software conversion otherwise, so the scalar reference builds on any
+ * host.  SIMD kernels convert with their own instructions.
+ */
+#ifndef Q4_0_TYPES_H
+#define Q4_0_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__F16C__) && !defined(__ARM_NEON)
+#include <immintrin.h>
+#endif
+
+typedef uint16_t ggml_fp16_t;
+
+#define QK4_0 32
+typedef struct {
+    ggml_fp16_t d;
+    uint8_t qs[QK4_0 / 2];
+} block_q4_0;
+
+#define QK8_0 32
+typedef struct {
+    ggml_fp16_t d;
+    int8_t qs[QK8_0];
+} block_q8_0;
+
+/* One output: *s = x · y over n elements (x q4_0, y q8_0). */
+typedef void (*vec_dot_fn)(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy);
+
+/*
+ * R rows × C columns (ggml's vec_dot with nrc): row r is bx bytes after
+ * row r-1 at vx, column c is by bytes after column c-1 at vy, and
+ * output (r, c) goes to s[c*bs + r].
+ */
+typedef void (*vec_dot_mxn_fn)(int n, float * __restrict__ s, size_t bs,
+        const void * __restrict__ vx, size_t bx, const void * __restrict__ vy, size_t by);
+
+/*
+ * q4_0x4: four weight rows repacked by q4_0x4_repack() (q4_0_repack.c).
+ * A group of four rows holds the nb scale vectors d[nb][4] (block ib
+ * of rows 0..3), padded to 64 bytes, then the quants qs[nb][4][16], so
+ * block ib of all four rows is one 64-byte line.  Groups are 64-byte
+ * aligned.  A shifted group stores qs ^ 0x88: each nibble becomes its
+ * two's complement q - 8, and the SDOT kernels unpack with one shift
+ * or one AND and no subtract, at 16 times the scale.
+ */
+#define Q4_0X4_ROWS 4
+
+static inline size_t q4_0x4_scales_bytes(int nb) {
+    return ((size_t)nb * Q4_0X4_ROWS * sizeof(ggml_fp16_t) + 63) & ~(size_t)63;
+}
+
+static inline size_t q4_0x4_group_bytes(int nb) {
+    return q4_0x4_scales_bytes(nb) + (size_t)nb * Q4_0X4_ROWS * (QK4_0 / 2);
+}
+
+static inline const ggml_fp16_t *q4_0x4_scales(const void *group) {
+    return (const ggml_fp16_t *)group;
+}
+
+static inline const uint8_t *q4_0x4_quants(const void *group, int nb) {
+    return (const uint8_t *)group + q4_0x4_scales_bytes(nb);
+}
+
+/* Four outputs: s[r] = row r of the q4_0x4 group at vx · y over n elements. */
+typedef vec_dot_fn vec_dot_x4_fn;
+
+static inline float fp16_to_fp32(ggml_fp16_t h) {
+#if defined(__ARM_NEON)
+    __fp16 tmp;
+    memcpy(&tmp, &h, sizeof(ggml_fp16_t));
+    return (float)tmp;
+#elif defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16, mant = h & 0x3ff, x;
+    int exp = (h >> 10) & 0x1f;
+    if (exp == 0x1f) {
+        x = sign | 0x7f800000 | mant << 13;
+    } else if (exp != 0) {
+        x = sign | (uint32_t)(exp + 112) << 23 | mant << 13;
+    } else if (mant == 0) {
+        x = sign;
+    } else {                                    /* subnormal: normalize */
+        exp = 1;
+        while (!(mant & 0x400)) { mant <<= 1; exp--; }
+        x = sign | (uint32_t)(exp + 112) << 23 | (mant & 0x3ff) << 13;
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+#endif
+}
+
+/* Round to nearest even, as the hardware conversions do. */
+static inline ggml_fp16_t fp32_to_fp16(float f) {
+#if defined(__ARM_NEON)
+    __fp16 tmp = (__fp16)f;
+    ggml_fp16_t r;
+    memcpy(&r, &tmp, sizeof(ggml_fp16_t));
+    return r;
+#elif defined(__F16C__)
+    return _cvtss_sh(f, 0);
+#else
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000, mant = x & 0x7fffff;
+    int exp = (int)((x >> 23) & 0xff);
+    if (exp == 0xff) return (ggml_fp16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));
+    int e = exp - 127 + 15;
+    if (e >= 0x1f) return (ggml_fp16_t)(sign | 0x7c00);
+    uint32_t h, rem, half;
+    if (e <= 0) {                               /* subnormal or zero */
+        if (e < -10) return (ggml_fp16_t)sign;
+        mant |= 0x800000;
+        int shift = 14 - e;
+        h = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        half = 1u << (shift - 1);
+    } else {
+        h = (uint32_t)e << 10 | mant >> 13;
+        rem = mant & 0x1fff;
+        half = 0x1000;
+    }
+    if (rem > half || (rem == half && (h & 1))) h++;   /* may carry into the exponent */
+    return (ggml_fp16_t)(sign | h);
+#endif
+}
+
+#endif /* Q4_0_TYPES_H */
@@ -0,0 +1,309 @@
+/*
+ * x86 q4_0 × q8_0 dot products: AVX2, AVX-VNNI and AVX512-VNNI
+ *
+ * Each kernel carries its own target attribute, so the file builds
+ * with the default x86-64 flags and q4_0_dispatch.c picks among them
+ * at run time with __builtin_cpu_supports().
+ *
+ * All three widen a block's nibbles to 32 bytes (low nibbles, then
+ * high, matching y's element order).  The x86 byte multiplies take one
+ * unsigned operand, so the nibbles stay unsigned and the offset is
+ * taken out afterwards: (x - 8) · y = x · y - 8 · Σy.  Unlike the
+ * |x| · sign(y, x) trick this is exact for y = -128 too.
+ *
+ *   avx2         maddubs (u8 × s8 → pairs of s16) for x · y and 8 · y,
+ *                subtracted as s16, then madd with ones (→ s32); one
+ *                block per 256-bit register (avx2-vscale: the same,
+ *                scales converted four blocks at a time);
+ *   avx-vnni     vpdpbusd does maddubs + madd in one instruction;
+ *   avx512-vnni  the same, two blocks per 512-bit register.
+ *
+ * No s16 step can saturate: a maddubs pair is at most 2 · 15 · 128,
+ * and after the subtraction at most 2 · 8 · 128.
+ *
+ * At the end: AVX2 and AVX512-VNNI kernels over the repacked q4_0x4
+ * layout.
+ */
+
+#include "q4_0_types.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define Q4_0_HAVE_X86 1
+
+#define Q4_0_AVX2       __attribute__((target("avx2,fma,f16c")))
+#define Q4_0_AVXVNNI    __attribute__((target("avx2,fma,f16c,avxvnni")))
+#define Q4_0_AVX512VNNI __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni,fma,f16c")))
+
+/* 32 nibbles of a q4_0 block as bytes 0..15: low nibbles, then high. */
+static inline Q4_0_AVX2 __m256i q4_0_nibbles_avx2(const uint8_t *qs) {
+    const __m128i tmp = _mm_loadu_si128((const __m128i *)qs);
+    const __m256i bytes = _mm256_set_m128i(_mm_srli_epi16(tmp, 4), tmp);
+    return _mm256_and_si256(bytes, _mm256_set1_epi8(0x0F));
+}
+
+static inline Q4_0_AVX2 float hsum_float_8(__m256 v) {
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_add_ss(r, _mm_movehdup_ps(r));
+    return _mm_cvtss_f32(r);
+}
+
+Q4_0_AVX2
+void vec_dot_q4_0_q8_0_avx2(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m256i eight = _mm256_set1_epi8(8);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int ib = 0; ib < nb; ib++) {
+        const __m256 d = _mm256_set1_ps(_cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d));
+        const __m256i qx = q4_0_nibbles_avx2(x[ib].qs);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[ib].qs);
+        const __m256i p16 = _mm256_sub_epi16(_mm256_maddubs_epi16(qx, qy),
+                                             _mm256_maddubs_epi16(eight, qy));
+        const __m256i dot = _mm256_madd_epi16(p16, ones);
+        acc = _mm256_fmadd_ps(d, _mm256_cvtepi32_ps(dot), acc);
+    }
+    *s = hsum_float_8(acc);
+}
+
+/*
+ * avx2 with vector scales: the x and y d of four blocks are gathered
+ * into one register each, converted with one vcvtph2ps each and
+ * multiplied once; block i then takes lane i with a permute, where avx2
+ * spends two vcvtsh2ss, a vmulss and a broadcast on every block.
+ */
+static inline __attribute__((always_inline)) Q4_0_AVX2
+void q4_0_q8_0_avx2_vscale(int n, float * __restrict__ s, const void * __restrict__ vx,
+        const void * __restrict__ vy, const int dist) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m256i eight = _mm256_set1_epi8(8);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int ib = 0;
+
+    for (; ib + 3 < nb; ib += 4) {
+        if (dist) {
+            __builtin_prefetch(&x[ib + dist], 0, 3);
+            __builtin_prefetch(&y[ib + dist], 0, 3);
+            __builtin_prefetch(&y[ib + dist + 2], 0, 3);
+        }
+        const __m128i hx = _mm_setr_epi16(x[ib].d, x[ib + 1].d, x[ib + 2].d, x[ib + 3].d, 0, 0, 0, 0);
+        const __m128i hy = _mm_setr_epi16(y[ib].d, y[ib + 1].d, y[ib + 2].d, y[ib + 3].d, 0, 0, 0, 0);
+        const __m256 d = _mm256_castps128_ps256(_mm_mul_ps(_mm_cvtph_ps(hx), _mm_cvtph_ps(hy)));
+        for (int j = 0; j < 4; j++) {
+            const __m256i qx = q4_0_nibbles_avx2(x[ib + j].qs);
+            const __m256i qy = _mm256_loadu_si256((const __m256i *)y[ib + j].qs);
+            const __m256i dot = _mm256_madd_epi16(_mm256_sub_epi16(_mm256_maddubs_epi16(qx, qy),
+                                                                   _mm256_maddubs_epi16(eight, qy)), ones);
+            const __m256 dj = _mm256_permutevar8x32_ps(d, _mm256_set1_epi32(j));
+            if (j & 1) acc1 = _mm256_fmadd_ps(dj, _mm256_cvtepi32_ps(dot), acc1);
+            else       acc0 = _mm256_fmadd_ps(dj, _mm256_cvtepi32_ps(dot), acc0);
+        }
+    }
+    float sumf = hsum_float_8(_mm256_add_ps(acc0, acc1));
+
+    for (; ib < nb; ib++) {
+        const __m256i qx = q4_0_nibbles_avx2(x[ib].qs);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[ib].qs);
+        const __m256i dot = _mm256_madd_epi16(_mm256_sub_epi16(_mm256_maddubs_epi16(qx, qy),
+                                                               _mm256_maddubs_epi16(eight, qy)), ones);
+        sumf += hsum_float_8(_mm256_cvtepi32_ps(dot)) * _cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d);
+    }
+    *s = sumf;
+}
+
+Q4_0_AVX2
+void vec_dot_q4_0_q8_0_avx2_vscale(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    q4_0_q8_0_avx2_vscale(n, s, vx, vy, 0);
+}
+
+/*
+ * avx2-vscale over a range of prefetch distances for q4_0_tune.c: dist
+ * blocks ahead of the current four, into L1 (prefetcht0); distance 0
+ * is avx2-vscale itself.
+ */
+#define Q4_0_AVX2_PF_KERNEL(D) \
+Q4_0_AVX2 \
+void vec_dot_q4_0_q8_0_avx2_pf##D(int n, float * __restrict__ s, \
+        const void * __restrict__ vx, const void * __restrict__ vy) { \
+    q4_0_q8_0_avx2_vscale(n, s, vx, vy, D); \
+}
+
+Q4_0_AVX2_PF_KERNEL(4)
+Q4_0_AVX2_PF_KERNEL(8)
+Q4_0_AVX2_PF_KERNEL(16)
+Q4_0_AVX2_PF_KERNEL(32)
+
+#undef Q4_0_AVX2_PF_KERNEL
+
+Q4_0_AVXVNNI
+void vec_dot_q4_0_q8_0_avxvnni(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m256i eight = _mm256_set1_epi8(8);
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int ib = 0; ib < nb; ib++) {
+        const __m256 d = _mm256_set1_ps(_cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d));
+        const __m256i qx = q4_0_nibbles_avx2(x[ib].qs);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[ib].qs);
+        const __m256i dot = _mm256_sub_epi32(
+                _mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), qx, qy),
+                _mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), eight, qy));
+        acc = _mm256_fmadd_ps(d, _mm256_cvtepi32_ps(dot), acc);
+    }
+    *s = hsum_float_8(acc);
+}
+
+Q4_0_AVX512VNNI
+void vec_dot_q4_0_q8_0_avx512vnni(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int nb = n / QK4_0;
+    const block_q4_0 * __restrict__ x = (const block_q4_0 *)vx;
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m512i m4b = _mm512_set1_epi8(0x0F);
+    const __m512i eight = _mm512_set1_epi8(8);
+    /* qwords of pack(lo), pack(hi) in block order: 16 low nibbles, then 16 high, twice */
+    const __m512i order = _mm512_set_epi64(14, 12, 6, 4, 10, 8, 2, 0);
+    __m512 acc = _mm512_setzero_ps();
+    int ib = 0;
+
+    for (; ib + 1 < nb; ib += 2) {
+        /* block ib in the low 256 bits, ib + 1 in the high */
+        const __m256i x01 = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)x[ib + 1].qs),
+                                             _mm_loadu_si128((const __m128i *)x[ib].qs));
+        const __m512i xw = _mm512_cvtepu8_epi16(x01);   /* 16-bit lanes: shifts stay in the byte */
+        const __m512i lo = _mm512_and_si512(xw, m4b);
+        const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(xw, 4), m4b);
+        const __m512i qx = _mm512_permutex2var_epi64(_mm512_packus_epi16(lo, lo), order,
+                                                     _mm512_packus_epi16(hi, hi));
+        const __m512i qy = _mm512_inserti64x4(
+                _mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *)y[ib].qs)),
+                _mm256_loadu_si256((const __m256i *)y[ib + 1].qs), 1);
+        const __m512i dot = _mm512_sub_epi32(
+                _mm512_dpbusd_epi32(_mm512_setzero_si512(), qx, qy),
+                _mm512_dpbusd_epi32(_mm512_setzero_si512(), eight, qy));
+        const __m512 d = _mm512_mask_blend_ps(0xFF00,
+                _mm512_set1_ps(_cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d)),
+                _mm512_set1_ps(_cvtsh_ss(x[ib + 1].d) * _cvtsh_ss(y[ib + 1].d)));
+        acc = _mm512_fmadd_ps(d, _mm512_cvtepi32_ps(dot), acc);
+    }
+    float sumf = _mm512_reduce_add_ps(acc);
+
+    for (; ib < nb; ib++) {
+        const __m256i qx = q4_0_nibbles_avx2(x[ib].qs);
+        const __m256i qy = _mm256_loadu_si256((const __m256i *)y[ib].qs);
+        const __m256i dot = _mm256_sub_epi32(
+                _mm256_dpbusd_epi32(_mm256_setzero_si256(), qx, qy),
+                _mm256_dpbusd_epi32(_mm256_setzero_si256(), _mm256_set1_epi8(8), qy));
+        sumf += hsum_float_8(_mm256_cvtepi32_ps(dot)) * _cvtsh_ss(x[ib].d) * _cvtsh_ss(y[ib].d);
+    }
+    *s = sumf;
+}
+
+/*
+ * ---- Repacked q4_0x4 (4 rows × 1 column) ----
+ *
+ * Block ib of the four rows is one aligned 64-byte line: 16 bytes per
+ * row, one row per 128-bit lane.  The y halves are broadcast to every
+ * lane, so the low and high nibbles of all four rows multiply in
+ * place, without the per-block permute above.  The 8 · Σy offset is
+ * the same for all rows and is computed once per block.  Each lane
+ * holds one row's partial sums; they are added up once at the end.
+ * The pre-shifted layout needs a signed × signed multiply, so these
+ * take only the plain one.
+ */
+
+Q4_0_AVX2
+void vec_dot_q4_0x4_q8_0_avx2(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int nb = n / QK4_0;
+    const ggml_fp16_t * __restrict__ d = q4_0x4_scales(vx);
+    const uint8_t * __restrict__ qs = q4_0x4_quants(vx, nb);
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m256i m4b = _mm256_set1_epi8(0x0F);
+    const __m256i eight = _mm256_set1_epi8(8);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i rows01 = _mm256_set_epi32(1, 1, 1, 1, 0, 0, 0, 0);
+    const __m256i rows23 = _mm256_set_epi32(3, 3, 3, 3, 2, 2, 2, 2);
+    __m256 acc01 = _mm256_setzero_ps();
+    __m256 acc23 = _mm256_setzero_ps();
+
+    for (int ib = 0; ib < nb; ib++) {
+        const uint8_t *q = qs + ib * Q4_0X4_ROWS * (QK4_0 / 2);
+        const __m256i qyl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)y[ib].qs));
+        const __m256i qyh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(y[ib].qs + 16)));
+        const __m256i off = _mm256_add_epi16(_mm256_maddubs_epi16(eight, qyl),
+                                             _mm256_maddubs_epi16(eight, qyh));
+        const __m256i v01 = _mm256_load_si256((const __m256i *)q);
+        const __m256i v23 = _mm256_load_si256((const __m256i *)(q + 32));
+        /* pairs reach 2 · 2 · 15 · 128 before the offset: still inside s16 */
+        const __m256i p01 = _mm256_add_epi16(
+                _mm256_maddubs_epi16(_mm256_and_si256(v01, m4b), qyl),
+                _mm256_maddubs_epi16(_mm256_and_si256(_mm256_srli_epi16(v01, 4), m4b), qyh));
+        const __m256i p23 = _mm256_add_epi16(
+                _mm256_maddubs_epi16(_mm256_and_si256(v23, m4b), qyl),
+                _mm256_maddubs_epi16(_mm256_and_si256(_mm256_srli_epi16(v23, 4), m4b), qyh));
+        const __m256i dot01 = _mm256_madd_epi16(_mm256_sub_epi16(p01, off), ones);
+        const __m256i dot23 = _mm256_madd_epi16(_mm256_sub_epi16(p23, off), ones);
+
+        const __m256 dx = _mm256_castps128_ps256(_mm_mul_ps(
+                _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(d + ib * Q4_0X4_ROWS))),
+                _mm_set1_ps(_cvtsh_ss(y[ib].d))));
+        acc01 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(dx, rows01), _mm256_cvtepi32_ps(dot01), acc01);
+        acc23 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(dx, rows23), _mm256_cvtepi32_ps(dot23), acc23);
+    }
+    float t[16];
+    _mm256_storeu_ps(t, acc01);
+    _mm256_storeu_ps(t + 8, acc23);
+    for (int r = 0; r < Q4_0X4_ROWS; r++)
+        s[r] = (t[4 * r] + t[4 * r + 1]) + (t[4 * r + 2] + t[4 * r + 3]);
+}
+
+Q4_0_AVX512VNNI
+void vec_dot_q4_0x4_q8_0_avx512vnni(int n, float * __restrict__ s,
+        const void * __restrict__ vx, const void * __restrict__ vy) {
+    const int nb = n / QK4_0;
+    const ggml_fp16_t * __restrict__ d = q4_0x4_scales(vx);
+    const uint8_t * __restrict__ qs = q4_0x4_quants(vx, nb);
+    const block_q8_0 * __restrict__ y = (const block_q8_0 *)vy;
+    const __m512i m4b = _mm512_set1_epi8(0x0F);
+    const __m128i eight = _mm_set1_epi8(8);
+    const __m512i rows = _mm512_set_epi32(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0);
+    __m512 acc = _mm512_setzero_ps();
+
+    for (int ib = 0; ib < nb; ib++) {
+        const __m128i yl = _mm_loadu_si128((const __m128i *)y[ib].qs);
+        const __m128i yh = _mm_loadu_si128((const __m128i *)(y[ib].qs + 16));
+        const __m128i off = _mm_dpbusd_epi32(_mm_dpbusd_epi32(_mm_setzero_si128(), eight, yl), eight, yh);
+        const __m512i v = _mm512_load_si512((const void *)(qs + ib * Q4_0X4_ROWS * (QK4_0 / 2)));
+        const __m512i dot = _mm512_sub_epi32(
+                _mm512_dpbusd_epi32(
+                    _mm512_dpbusd_epi32(_mm512_setzero_si512(), _mm512_and_si512(v, m4b),
+                                        _mm512_broadcast_i32x4(yl)),
+                    _mm512_and_si512(_mm512_srli_epi16(v, 4), m4b), _mm512_broadcast_i32x4(yh)),
+                _mm512_broadcast_i32x4(off));
+        const __m128 dx = _mm_mul_ps(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)(d + ib * Q4_0X4_ROWS))),
+                                     _mm_set1_ps(_cvtsh_ss(y[ib].d)));
+        acc = _mm512_fmadd_ps(_mm512_permutexvar_ps(rows, _mm512_castps128_ps512(dx)),
+                              _mm512_cvtepi32_ps(dot), acc);
+    }
+    float t[16];
+    _mm512_storeu_ps(t, acc);
+    for (int r = 0; r < Q4_0X4_ROWS; r++)
+        s[r] = (t[4 * r] + t[4 * r + 1]) + (t[4 * r + 2] + t[4 * r + 3]);
+}
+
+#endif /* __x86_64__ || __i386__ */
@@ -0,0 +1,118 @@
+/*
+ * Persistent thread pool for the threaded matmul benchmark
+ *
+ * ggml keeps its compute threads alive across ops and wakes them per
+ * graph node; spawning threads per call would swamp a sub-millisecond
+ * matvec.  This pool does the same: tp_init() starts n - 1 workers
+ * once, and each tp_run() wakes the first `active` of them while the
+ * caller works as thread 0, then waits until all of them are done.
+ *
+ * Wake-up and completion go through one mutex and two condition
+ * variables, keyed by a generation counter so that a worker never runs
+ * the same job twice.
+ *
+ * #included by benchmark.c; not a standalone translation unit.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef void (*tp_fn)(void *arg, int tid, int nthreads);
+
+typedef struct tp_pool {
+    pthread_t      *threads;
+    int             n;          /* threads, the caller included */
+    pthread_mutex_t mu;
+    pthread_cond_t  go, done;
+    unsigned        gen;        /* bumped per job */
+    int             pending;    /* workers still running the job */
+    int             active;     /* threads the job runs on */
+    int             quit;
+    tp_fn           fn;
+    void           *arg;
+} tp_pool;
+
+typedef struct {
+    tp_pool *pool;
+    int      tid;
+} tp_worker;
+
+static void *tp_main(void *p) {
+    tp_worker *self = p;
+    tp_pool *pool = self->pool;
+    const int tid = self->tid;
+    unsigned seen = 0;
+    free(self);
+
+    pthread_mutex_lock(&pool->mu);
+    for (;;) {
+        while (pool->gen == seen && !pool->quit)
+            pthread_cond_wait(&pool->go, &pool->mu);
+        if (pool->quit) break;
+        seen = pool->gen;
+        if (tid >= pool->active) continue;
+        tp_fn fn = pool->fn;
+        void *arg = pool->arg;
+        int active = pool->active;
+        pthread_mutex_unlock(&pool->mu);
+
+        fn(arg, tid, active);
+
+        pthread_mutex_lock(&pool->mu);
+        if (--pool->pending == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mu);
+    return NULL;
+}
+
+static void tp_init(tp_pool *pool, int n) {
+    pool->n = n < 1 ? 1 : n;
+    pool->threads = malloc(pool->n * sizeof(pthread_t));
+    pthread_mutex_init(&pool->mu, NULL);
+    pthread_cond_init(&pool->go, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->gen = 0;
+    pool->pending = 0;
+    pool->quit = 0;
+    for (int i = 1; i < pool->n; i++) {
+        tp_worker *w = malloc(sizeof(*w));
+        w->pool = pool;
+        w->tid = i;
+        pthread_create(&pool->threads[i], NULL, tp_main, w);
+    }
+}
+
+/* fn(arg, tid, active) on threads 0..active-1, the caller being thread 0. */
+static void tp_run(tp_pool *pool, int active, tp_fn fn, void *arg) {
+    if (active > pool->n) active = pool->n;
+    if (active < 1) active = 1;
+
+    pthread_mutex_lock(&pool->mu);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->active = active;
+    pool->pending = active - 1;
+    pool->gen++;
+    pthread_cond_broadcast(&pool->go);
+    pthread_mutex_unlock(&pool->mu);
+
+    fn(arg, 0, active);
+
+    pthread_mutex_lock(&pool->mu);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->mu);
+    pthread_mutex_unlock(&pool->mu);
+}
+
+static void tp_free(tp_pool *pool) {
+    pthread_mutex_lock(&pool->mu);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->go);
+    pthread_mutex_unlock(&pool->mu);
+    for (int i = 1; i < pool->n; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->mu);
+    pthread_cond_destroy(&pool->go);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+}